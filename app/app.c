@@ -170,6 +170,7 @@ app_run (const gchar         *full_prog_name,
          const gchar         *session_name,
          const gchar         *batch_interpreter,
          const gchar        **batch_commands,
+         gint                 batch_jobs,
          gboolean             as_new,
          gboolean             no_interface,
          gboolean             no_data,
@@ -428,7 +429,7 @@ app_run (const gchar         *full_prog_name,
     }
 
   if (run_loop)
-    gimp_batch_run (gimp, batch_interpreter, batch_commands);
+    gimp_batch_run (gimp, batch_interpreter, batch_commands, batch_jobs);
 
   if (run_loop)
     g_main_loop_run (loop);
@@ -48,6 +48,7 @@ enum
   PROP_SWAP_PATH,
   PROP_NUM_PROCESSORS,
   PROP_TILE_CACHE_SIZE,
+  PROP_TEMP_BUF_POOL_SIZE,
   PROP_USE_OPENCL,
 
   /* ignored, only for backward compatibility: */
@@ -139,6 +140,14 @@ gimp_gegl_config_class_init (GimpGeglConfigClass *klass)
                             GIMP_PARAM_STATIC_STRINGS |
                             GIMP_CONFIG_PARAM_CONFIRM);
 
+  GIMP_CONFIG_PROP_MEMSIZE (object_class, PROP_TEMP_BUF_POOL_SIZE,
+                            "temp-buf-pool-size",
+                            "Temporary buffer pool size",
+                            TEMP_BUF_POOL_SIZE_BLURB,
+                            0, GIMP_MAX_MEM_PROCESS,
+                            32 << 20,
+                            GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_USE_OPENCL,
                             "use-opencl",
                             "Use OpenCL",
@@ -204,6 +213,9 @@ gimp_gegl_config_set_property (GObject      *object,
     case PROP_TILE_CACHE_SIZE:
       gegl_config->tile_cache_size = g_value_get_uint64 (value);
       break;
+    case PROP_TEMP_BUF_POOL_SIZE:
+      gegl_config->temp_buf_pool_size = g_value_get_uint64 (value);
+      break;
     case PROP_USE_OPENCL:
       gegl_config->use_opencl = g_value_get_boolean (value);
       break;
@@ -240,6 +252,9 @@ gimp_gegl_config_get_property (GObject    *object,
     case PROP_TILE_CACHE_SIZE:
       g_value_set_uint64 (value, gegl_config->tile_cache_size);
       break;
+    case PROP_TEMP_BUF_POOL_SIZE:
+      g_value_set_uint64 (value, gegl_config->temp_buf_pool_size);
+      break;
     case PROP_USE_OPENCL:
       g_value_set_boolean (value, gegl_config->use_opencl);
       break;
@@ -39,6 +39,7 @@ struct _GimpGeglConfig
   gchar    *swap_path;
   gint      num_processors;
   guint64   tile_cache_size;
+  guint64   temp_buf_pool_size;
   gboolean  use_opencl;
 };
 
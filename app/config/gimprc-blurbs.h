@@ -464,6 +464,10 @@ _("Save changed keyboard shortcuts when GIMP exits.")
 #define RESTORE_ACCELS_BLURB \
 _("Restore saved keyboard shortcuts on each GIMP startup.")
 
+#define TEMP_BUF_POOL_SIZE_BLURB \
+_("Sets the amount of memory GIMP keeps around for reuse by temporary " \
+  "buffers, such as the brush masks created while painting.")
+
 #define TEMP_PATH_BLURB \
 _("Sets the folder for temporary storage. Files will appear here " \
   "during the course of running GIMP.  Most files will disappear " \
@@ -228,6 +228,7 @@ typedef struct _GimpCoords                      GimpCoords;
 typedef struct _GimpGradientSegment             GimpGradientSegment;
 typedef struct _GimpPaletteEntry                GimpPaletteEntry;
 typedef struct _GimpScanConvert                 GimpScanConvert;
+typedef struct _GimpSummedAreaTable             GimpSummedAreaTable;
 typedef struct _GimpTempBuf                     GimpTempBuf;
 typedef         guint32                         GimpTattoo;
 
@@ -27,6 +27,8 @@
 
 #include "core-types.h"
 
+#include "config/gimpgeglconfig.h"
+
 #include "gimp.h"
 #include "gimp-batch.h"
 #include "gimpparamspecs.h"
@@ -34,25 +36,81 @@
 #include "pdb/gimppdb.h"
 #include "pdb/gimpprocedure.h"
 
+#include "plug-in/gimpplugin.h"
+#include "plug-in/gimppluginmanager.h"
+#include "plug-in/gimppluginprocedure.h"
+
 #include "gimp-intl.h"
 
 
 #define BATCH_DEFAULT_EVAL_PROC   "plug-in-script-fu-eval"
 
 
-static void  gimp_batch_exit_after_callback (Gimp          *gimp) G_GNUC_NORETURN;
+typedef struct _GimpBatchJob  GimpBatchJob;
+typedef struct _GimpBatchPool GimpBatchPool;
 
-static void  gimp_batch_run_cmd             (Gimp          *gimp,
-                                             const gchar   *proc_name,
-                                             GimpProcedure *procedure,
-                                             GimpRunMode    run_mode,
-                                             const gchar   *cmd);
+struct _GimpBatchJob
+{
+  gint         index;
+  const gchar *cmd;
+  GimpPlugIn  *plug_in;
+};
+
+struct _GimpBatchPool
+{
+  Gimp          *gimp;
+  const gchar   *proc_name;
+  GimpProcedure *procedure;
+
+  const gchar  **commands;
+  gint           n_commands;
+  gint           n_jobs;
+
+  gint           next_command;
+  GList         *running;
+
+  GimpBatchJob  *launching;
+  GMainLoop     *main_loop;
+};
+
+
+static void  gimp_batch_exit_after_callback (Gimp              *gimp) G_GNUC_NORETURN;
+
+static GimpValueArray *
+             gimp_batch_get_arguments       (GimpProcedure     *procedure,
+                                             GimpRunMode        run_mode,
+                                             const gchar       *cmd);
+static void  gimp_batch_report_result       (gint               index,
+                                             GimpValueArray    *return_vals,
+                                             GError            *error);
+
+static void  gimp_batch_run_cmd             (Gimp              *gimp,
+                                             const gchar       *proc_name,
+                                             GimpProcedure     *procedure,
+                                             GimpRunMode        run_mode,
+                                             const gchar       *cmd);
+
+static void  gimp_batch_run_parallel        (Gimp              *gimp,
+                                             const gchar       *proc_name,
+                                             GimpProcedure     *procedure,
+                                             const gchar      **commands,
+                                             gint               n_commands,
+                                             gint               n_jobs);
+static gboolean
+             gimp_batch_pool_launch         (GimpBatchPool     *pool);
+static void  gimp_batch_pool_plug_in_opened (GimpPlugInManager *manager,
+                                             GimpPlugIn        *plug_in,
+                                             GimpBatchPool     *pool);
+static void  gimp_batch_pool_plug_in_closed (GimpPlugInManager *manager,
+                                             GimpPlugIn        *plug_in,
+                                             GimpBatchPool     *pool);
 
 
 void
 gimp_batch_run (Gimp         *gimp,
                 const gchar  *batch_interpreter,
-                const gchar **batch_commands)
+                const gchar **batch_commands,
+                gint          batch_jobs)
 {
   gulong  exit_id;
 
@@ -100,9 +158,28 @@ gimp_batch_run (Gimp         *gimp,
 
       if (eval_proc)
         {
-          gint i;
-
-          for (i = 0; batch_commands[i]; i++)
+          gint n_commands = g_strv_length ((gchar **) batch_commands);
+          gint i          = 0;
+
+          if (batch_jobs <= 0)
+            batch_jobs = GIMP_GEGL_CONFIG (gimp->config)->num_processors;
+
+          /*  independent jobs can only run concurrently if each one
+           *  gets its own interpreter process; the last command is
+           *  kept as a barrier, so that e.g. "(gimp-quit 0)" still
+           *  runs after everything else is done.
+           */
+          if (batch_jobs > 1 && n_commands > 2 &&
+              GIMP_IS_PLUG_IN_PROCEDURE (eval_proc))
+            {
+              gimp_batch_run_parallel (gimp, batch_interpreter, eval_proc,
+                                       batch_commands, n_commands - 1,
+                                       batch_jobs);
+
+              i = n_commands - 1;
+            }
+
+          for (; batch_commands[i]; i++)
             gimp_batch_run_cmd (gimp, batch_interpreter, eval_proc,
                                 GIMP_RUN_NONINTERACTIVE, batch_commands[i]);
         }
@@ -141,17 +218,13 @@ GIMP_IS_PARAM_SPEC_RUN_MODE (GParamSpec *pspec)
           pspec->value_type == GIMP_TYPE_RUN_MODE);
 }
 
-static void
-gimp_batch_run_cmd (Gimp          *gimp,
-                    const gchar   *proc_name,
-                    GimpProcedure *procedure,
-                    GimpRunMode    run_mode,
-                    const gchar   *cmd)
+static GimpValueArray *
+gimp_batch_get_arguments (GimpProcedure *procedure,
+                          GimpRunMode    run_mode,
+                          const gchar   *cmd)
 {
   GimpValueArray *args;
-  GimpValueArray *return_vals;
-  GError         *error = NULL;
-  gint            i     = 0;
+  gint            i = 0;
 
   args = gimp_procedure_get_arguments (procedure);
 
@@ -167,43 +240,83 @@ gimp_batch_run_cmd (Gimp          *gimp,
       g_value_set_static_string (gimp_value_array_index (args, i++), cmd);
     }
 
-  return_vals =
-    gimp_pdb_execute_procedure_by_name_args (gimp->pdb,
-                                             gimp_get_user_context (gimp),
-                                             NULL, &error,
-                                             proc_name, args);
+  return args;
+}
+
+static void
+gimp_batch_report_result (gint            index,
+                          GimpValueArray *return_vals,
+                          GError         *error)
+{
+  GimpPDBStatusType  status = GIMP_PDB_EXECUTION_ERROR;
+  gchar             *what;
+
+  if (index >= 0)
+    what = g_strdup_printf ("batch job %d", index + 1);
+  else
+    what = g_strdup ("batch command");
+
+  if (return_vals && gimp_value_array_length (return_vals) > 0)
+    status = g_value_get_enum (gimp_value_array_index (return_vals, 0));
 
-  switch (g_value_get_enum (gimp_value_array_index (return_vals, 0)))
+  switch (status)
     {
     case GIMP_PDB_EXECUTION_ERROR:
       if (error)
         {
-          g_printerr ("batch command experienced an execution error:\n"
-                      "%s\n", error->message);
+          g_printerr ("%s experienced an execution error:\n"
+                      "%s\n", what, error->message);
         }
       else
         {
-          g_printerr ("batch command experienced an execution error\n");
+          g_printerr ("%s experienced an execution error\n", what);
         }
       break;
 
     case GIMP_PDB_CALLING_ERROR:
       if (error)
         {
-          g_printerr ("batch command experienced a calling error:\n"
-                      "%s\n", error->message);
+          g_printerr ("%s experienced a calling error:\n"
+                      "%s\n", what, error->message);
         }
       else
         {
-          g_printerr ("batch command experienced a calling error\n");
+          g_printerr ("%s experienced a calling error\n", what);
         }
       break;
 
     case GIMP_PDB_SUCCESS:
-      g_printerr ("batch command executed successfully\n");
+      g_printerr ("%s executed successfully\n", what);
+      break;
+
+    default:
       break;
     }
 
+  g_free (what);
+}
+
+static void
+gimp_batch_run_cmd (Gimp          *gimp,
+                    const gchar   *proc_name,
+                    GimpProcedure *procedure,
+                    GimpRunMode    run_mode,
+                    const gchar   *cmd)
+{
+  GimpValueArray *args;
+  GimpValueArray *return_vals;
+  GError         *error = NULL;
+
+  args = gimp_batch_get_arguments (procedure, run_mode, cmd);
+
+  return_vals =
+    gimp_pdb_execute_procedure_by_name_args (gimp->pdb,
+                                             gimp_get_user_context (gimp),
+                                             NULL, &error,
+                                             proc_name, args);
+
+  gimp_batch_report_result (-1, return_vals, error);
+
   gimp_value_array_unref (return_vals);
   gimp_value_array_unref (args);
 
@@ -212,3 +325,148 @@ gimp_batch_run_cmd (Gimp          *gimp,
 
   return;
 }
+
+/*  Runs @commands as independent jobs, keeping up to @n_jobs
+ *  interpreter plug-ins running at the same time, and returns when
+ *  all of them have finished.  Each job's plug-in process is tracked
+ *  through the plug-in manager's "plug-in-opened" and "plug-in-closed"
+ *  signals, and its result is reported as soon as it exits.
+ */
+static void
+gimp_batch_run_parallel (Gimp           *gimp,
+                         const gchar    *proc_name,
+                         GimpProcedure  *procedure,
+                         const gchar   **commands,
+                         gint            n_commands,
+                         gint            n_jobs)
+{
+  GimpBatchPool pool = { 0, };
+
+  pool.gimp       = gimp;
+  pool.proc_name  = proc_name;
+  pool.procedure  = procedure;
+  pool.commands   = commands;
+  pool.n_commands = n_commands;
+  pool.n_jobs     = n_jobs;
+
+  if (gimp->be_verbose)
+    g_printerr ("Running %d batch jobs, %d at a time\n", n_commands, n_jobs);
+
+  g_signal_connect (gimp->plug_in_manager, "plug-in-opened",
+                    G_CALLBACK (gimp_batch_pool_plug_in_opened),
+                    &pool);
+  g_signal_connect (gimp->plug_in_manager, "plug-in-closed",
+                    G_CALLBACK (gimp_batch_pool_plug_in_closed),
+                    &pool);
+
+  while (g_list_length (pool.running) < pool.n_jobs &&
+         gimp_batch_pool_launch (&pool));
+
+  if (pool.running)
+    {
+      pool.main_loop = g_main_loop_new (NULL, FALSE);
+
+      g_main_loop_run (pool.main_loop);
+
+      g_clear_pointer (&pool.main_loop, g_main_loop_unref);
+    }
+
+  g_signal_handlers_disconnect_by_func (gimp->plug_in_manager,
+                                        gimp_batch_pool_plug_in_opened,
+                                        &pool);
+  g_signal_handlers_disconnect_by_func (gimp->plug_in_manager,
+                                        gimp_batch_pool_plug_in_closed,
+                                        &pool);
+}
+
+/*  Starts the next pending job, returns FALSE when there is none left.  */
+static gboolean
+gimp_batch_pool_launch (GimpBatchPool *pool)
+{
+  while (pool->next_command < pool->n_commands)
+    {
+      GimpBatchJob   *job;
+      GimpValueArray *args;
+      GError         *error = NULL;
+
+      job = g_slice_new0 (GimpBatchJob);
+
+      job->index = pool->next_command++;
+      job->cmd   = pool->commands[job->index];
+
+      args = gimp_batch_get_arguments (pool->procedure,
+                                       GIMP_RUN_NONINTERACTIVE, job->cmd);
+
+      pool->launching = job;
+
+      gimp_procedure_execute_async (pool->procedure, pool->gimp,
+                                    gimp_get_user_context (pool->gimp),
+                                    NULL, args, NULL, &error);
+
+      pool->launching = NULL;
+
+      gimp_value_array_unref (args);
+
+      if (job->plug_in)
+        {
+          pool->running = g_list_append (pool->running, job);
+
+          return TRUE;
+        }
+
+      /*  the interpreter could not be started, report the failure
+       *  and go on with the next job
+       */
+      gimp_batch_report_result (job->index, NULL, error);
+
+      g_clear_error (&error);
+      g_slice_free (GimpBatchJob, job);
+    }
+
+  return FALSE;
+}
+
+static void
+gimp_batch_pool_plug_in_opened (GimpPlugInManager *manager,
+                                GimpPlugIn        *plug_in,
+                                GimpBatchPool     *pool)
+{
+  /*  only the first plug-in opened while launching a job is the job's
+   *  interpreter, plug-ins it calls later are opened from the main loop
+   */
+  if (pool->launching && ! pool->launching->plug_in)
+    pool->launching->plug_in = g_object_ref (plug_in);
+}
+
+static void
+gimp_batch_pool_plug_in_closed (GimpPlugInManager *manager,
+                                GimpPlugIn        *plug_in,
+                                GimpBatchPool     *pool)
+{
+  GList *list;
+
+  for (list = pool->running; list; list = g_list_next (list))
+    {
+      GimpBatchJob *job = list->data;
+
+      if (job->plug_in == plug_in)
+        {
+          pool->running = g_list_delete_link (pool->running, list);
+
+          gimp_batch_report_result (job->index,
+                                    plug_in->main_proc_frame.return_vals,
+                                    NULL);
+
+          g_object_unref (job->plug_in);
+          g_slice_free (GimpBatchJob, job);
+
+          while (g_list_length (pool->running) < pool->n_jobs &&
+                 gimp_batch_pool_launch (pool));
+
+          if (! pool->running && pool->main_loop)
+            g_main_loop_quit (pool->main_loop);
+
+          break;
+        }
+    }
+}
@@ -26,12 +26,16 @@
 
 #include "core-types.h"
 
+#include "gimpasync.h"
 #include "gimpboundary.h"
 
 
 /* GimpBoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* number of scanlines scanned as a unit by generate_boundary() */
+#define BAND_HEIGHT   64
+
 
 typedef struct _GimpBoundary GimpBoundary;
 
@@ -45,13 +49,30 @@ struct _GimpBoundary
   /*  The array of vertical segments  */
   gint         *vert_segs;
 
-  /*  The empty segment arrays */
-  gint         *empty_segs_n;
-  gint         *empty_segs_c;
-  gint         *empty_segs_l;
+  /*  The maximal size of an empty segment array  */
   gint          max_empty_segs;
 };
 
+typedef struct
+{
+  GimpAsync           *async;
+  GeglBuffer          *buffer;
+  const GeglRectangle *region;
+  const Babl          *format;
+  GimpBoundaryType     type;
+  gint                 x1;
+  gint                 y1;
+  gint                 x2;
+  gint                 y2;
+  gfloat               threshold;
+  gint                 start;
+  gint                 end;
+  gint                 max_empty_segs;
+
+  /*  The horizontal segments of each band, in scanline order  */
+  GArray             **horiz_segs;
+} BoundaryBandData;
+
 
 /*  local function prototypes  */
 
@@ -84,14 +105,18 @@ static void           process_horiz_seg        (GimpBoundary        *boundary,
                                                 gint                 x2,
                                                 gint                 y2,
                                                 gboolean             open);
-static void           make_horiz_segs          (GimpBoundary        *boundary,
+static void           make_horiz_segs          (GArray              *horiz_segs,
                                                 gint                 start,
                                                 gint                 end,
                                                 gint                 scanline,
                                                 gint                 empty[],
                                                 gint                 num_empty,
                                                 gint                 top);
-static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
+static void           generate_boundary_bands  (gsize                offset,
+                                                gsize                size,
+                                                BoundaryBandData    *data);
+static GimpBoundary * generate_boundary        (GimpAsync           *async,
+                                                GeglBuffer          *buffer,
                                                 const GeglRectangle *region,
                                                 const Babl          *format,
                                                 GimpBoundaryType     type,
@@ -163,10 +188,46 @@ gimp_boundary_find (GeglBuffer          *buffer,
                     int                  y2,
                     gfloat               threshold,
                     int                 *num_segs)
+{
+  return gimp_boundary_find_full (NULL, buffer, region, format, type,
+                                  x1, y1, x2, y2, threshold, num_segs);
+}
+
+/**
+ * gimp_boundary_find_full:
+ * @async:     a #GimpAsync, or %NULL
+ * @buffer:    a #GeglBuffer
+ * @format:    a #Babl float format representing the component to analyze
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        bottom side of bounds
+ * @threshold: pixel value of boundary line
+ * @num_segs:  number of returned #GimpBoundSeg's
+ *
+ * Like gimp_boundary_find(), but when called from the thread running
+ * @async, the scan stops as soon as @async is canceled.
+ *
+ * Return value: the boundary array, or %NULL if @async was canceled.
+ **/
+GimpBoundSeg *
+gimp_boundary_find_full (GimpAsync           *async,
+                         GeglBuffer          *buffer,
+                         const GeglRectangle *region,
+                         const Babl          *format,
+                         GimpBoundaryType     type,
+                         int                  x1,
+                         int                  y1,
+                         int                  x2,
+                         int                  y2,
+                         gfloat               threshold,
+                         int                 *num_segs)
 {
   GimpBoundary  *boundary;
   GeglRectangle  rect = { 0, };
 
+  g_return_val_if_fail (async == NULL || GIMP_IS_ASYNC (async), NULL);
   g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
   g_return_val_if_fail (num_segs != NULL, NULL);
   g_return_val_if_fail (format != NULL, NULL);
@@ -183,9 +244,16 @@ gimp_boundary_find (GeglBuffer          *buffer,
       rect.height = gegl_buffer_get_height (buffer);
     }
 
-  boundary = generate_boundary (buffer, &rect, format, type,
+  boundary = generate_boundary (async, buffer, &rect, format, type,
                                 x1, y1, x2, y2, threshold);
 
+  if (! boundary)
+    {
+      *num_segs = 0;
+
+      return NULL;
+    }
+
   *num_segs = boundary->num_segs;
 
   return gimp_boundary_free (boundary, FALSE);
@@ -432,10 +500,6 @@ gimp_boundary_new (const GeglRectangle *region)
        *  given the current mask
        */
       boundary->max_empty_segs = region->width + 3;
-
-      boundary->empty_segs_n = g_new (gint, boundary->max_empty_segs);
-      boundary->empty_segs_c = g_new (gint, boundary->max_empty_segs);
-      boundary->empty_segs_l = g_new (gint, boundary->max_empty_segs);
     }
 
   return boundary;
@@ -453,9 +517,6 @@ gimp_boundary_free (GimpBoundary *boundary,
     segs = boundary->segs;
 
   g_free (boundary->vert_segs);
-  g_free (boundary->empty_segs_n);
-  g_free (boundary->empty_segs_c);
-  g_free (boundary->empty_segs_l);
 
   g_slice_free (GimpBoundary, boundary);
 
@@ -632,16 +693,21 @@ process_horiz_seg (GimpBoundary *boundary,
 }
 
 static void
-make_horiz_segs (GimpBoundary *boundary,
-                 gint          start,
-                 gint          end,
-                 gint          scanline,
-                 gint          empty[],
-                 gint          num_empty,
-                 gint          top)
+make_horiz_segs (GArray *horiz_segs,
+                 gint    start,
+                 gint    end,
+                 gint    scanline,
+                 gint    empty[],
+                 gint    num_empty,
+                 gint    top)
 {
-  gint empty_index;
-  gint e_s, e_e;    /* empty segment start and end values */
+  GimpBoundSeg seg = { 0, };
+  gint         empty_index;
+  gint         e_s, e_e;    /* empty segment start and end values */
+
+  seg.y1   = scanline;
+  seg.y2   = scanline;
+  seg.open = top;
 
   for (empty_index = 0; empty_index < num_empty; empty_index += 2)
     {
@@ -650,21 +716,161 @@ make_horiz_segs (GimpBoundary *boundary,
 
       if (e_s <= start && e_e >= end)
         {
-          process_horiz_seg (boundary,
-                             start, scanline, end, scanline, top);
+          seg.x1 = start;
+          seg.x2 = end;
+
+          g_array_append_val (horiz_segs, seg);
         }
       else if ((e_s > start && e_s < end) ||
                (e_e < end && e_e > start))
         {
-          process_horiz_seg (boundary,
-                             MAX (e_s, start), scanline,
-                             MIN (e_e, end), scanline, top);
+          seg.x1 = MAX (e_s, start);
+          seg.x2 = MIN (e_e, end);
+
+          g_array_append_val (horiz_segs, seg);
         }
     }
 }
 
+static void
+generate_boundary_bands (gsize             offset,
+                         gsize             size,
+                         BoundaryBandData *data)
+{
+  GeglRectangle  line_rect = { 0, };
+  gfloat        *line_data;
+  gfloat        *next_data;
+  gint          *empty_segs_n;
+  gint          *empty_segs_c;
+  gint          *empty_segs_l;
+  gint          *tmp_segs;
+  gint           band;
+
+  line_rect.width  = gegl_buffer_get_width (data->buffer);
+  line_rect.height = 1;
+
+  line_data = g_new (gfloat, line_rect.width);
+
+  empty_segs_n = g_new (gint, data->max_empty_segs);
+  empty_segs_c = g_new (gint, data->max_empty_segs);
+  empty_segs_l = g_new (gint, data->max_empty_segs);
+
+  for (band = offset; band < (gint) (offset + size); band++)
+    {
+      GArray *horiz_segs;
+      gint    start;
+      gint    end;
+      gint    scanline;
+      gint    i;
+      gint    num_empty_n = 0;
+      gint    num_empty_c = 0;
+      gint    num_empty_l = 0;
+
+      start = data->start + band * BAND_HEIGHT;
+      end   = MIN (start + BAND_HEIGHT, data->end);
+
+      horiz_segs = g_array_new (FALSE, FALSE, sizeof (GimpBoundSeg));
+
+      /*  Find the empty segments for the previous and current scanlines.
+       *  The scanline above the first band is never part of the
+       *  boundary, all other bands need to look at the last scanline
+       *  of the band above them.
+       */
+      next_data = NULL;
+
+      if (start > data->start)
+        {
+          line_rect.y = start - 1;
+          gegl_buffer_get (data->buffer, &line_rect, 1.0, data->format,
+                           line_data, GEGL_AUTO_ROWSTRIDE,
+                           GEGL_ABYSS_NONE);
+
+          next_data = line_data;
+        }
+
+      find_empty_segs (data->region, next_data,
+                       start - 1, empty_segs_l,
+                       data->max_empty_segs, &num_empty_l,
+                       data->type, data->x1, data->y1, data->x2, data->y2,
+                       data->threshold);
+
+      line_rect.y = start;
+      gegl_buffer_get (data->buffer, &line_rect, 1.0, data->format,
+                       line_data, GEGL_AUTO_ROWSTRIDE,
+                       GEGL_ABYSS_NONE);
+
+      find_empty_segs (data->region, line_data,
+                       start, empty_segs_c,
+                       data->max_empty_segs, &num_empty_c,
+                       data->type, data->x1, data->y1, data->x2, data->y2,
+                       data->threshold);
+
+      for (scanline = start; scanline < end; scanline++)
+        {
+          if (data->async && gimp_async_is_canceled (data->async))
+            {
+              g_array_free (horiz_segs, TRUE);
+
+              goto out;
+            }
+
+          /*  find the empty segment list for the next scanline  */
+          next_data = NULL;
+
+          if (scanline + 1 < data->end)
+            {
+              line_rect.y = scanline + 1;
+              gegl_buffer_get (data->buffer, &line_rect, 1.0, data->format,
+                               line_data, GEGL_AUTO_ROWSTRIDE,
+                               GEGL_ABYSS_NONE);
+
+              next_data = line_data;
+            }
+
+          find_empty_segs (data->region, next_data,
+                           scanline + 1, empty_segs_n,
+                           data->max_empty_segs, &num_empty_n,
+                           data->type, data->x1, data->y1, data->x2, data->y2,
+                           data->threshold);
+
+          /*  process the segments on the current scanline  */
+          for (i = 1; i < num_empty_c - 1; i += 2)
+            {
+              make_horiz_segs (horiz_segs,
+                               empty_segs_c [i],
+                               empty_segs_c [i+1],
+                               scanline,
+                               empty_segs_l, num_empty_l, 1);
+              make_horiz_segs (horiz_segs,
+                               empty_segs_c [i],
+                               empty_segs_c [i+1],
+                               scanline + 1,
+                               empty_segs_n, num_empty_n, 0);
+            }
+
+          /*  get the next scanline of empty segments, swap others  */
+          tmp_segs     = empty_segs_l;
+          empty_segs_l = empty_segs_c;
+          num_empty_l  = num_empty_c;
+          empty_segs_c = empty_segs_n;
+          num_empty_c  = num_empty_n;
+          empty_segs_n = tmp_segs;
+        }
+
+      data->horiz_segs[band] = horiz_segs;
+    }
+
+ out:
+  g_free (empty_segs_n);
+  g_free (empty_segs_c);
+  g_free (empty_segs_l);
+
+  g_free (line_data);
+}
+
 static GimpBoundary *
-generate_boundary (GeglBuffer          *buffer,
+generate_boundary (GimpAsync           *async,
+                   GeglBuffer          *buffer,
                    const GeglRectangle *region,
                    const Babl          *format,
                    GimpBoundaryType     type,
@@ -674,25 +880,14 @@ generate_boundary (GeglBuffer          *buffer,
                    gint                 y2,
                    gfloat               threshold)
 {
-  GimpBoundary  *boundary;
-  GeglRectangle  line_rect = { 0, };
-  gfloat        *line_data;
-  gint           scanline;
-  gint           i;
-  gint           start, end;
-  gint          *tmp_segs;
-
-  gint          num_empty_n = 0;
-  gint          num_empty_c = 0;
-  gint          num_empty_l = 0;
+  GimpBoundary     *boundary;
+  BoundaryBandData  data = { 0, };
+  gint              n_bands;
+  gint              band;
+  gint              start, end;
 
   boundary = gimp_boundary_new (region);
 
-  line_rect.width  = gegl_buffer_get_width (buffer);
-  line_rect.height = 1;
-
-  line_data = g_alloca (sizeof (gfloat) * line_rect.width);
-
   start = 0;
   end   = 0;
 
@@ -707,65 +902,73 @@ generate_boundary (GeglBuffer          *buffer,
       end   = region->y + region->height;
     }
 
-  /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (region, NULL,
-                   start - 1, boundary->empty_segs_l,
-                   boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
+  if (end <= start)
+    return boundary;
+
+  /*  Scanning the buffer for the horizontal segments is independent for
+   *  each band of scanlines, so do it in parallel.  Pairing up the
+   *  segments' end points into vertical segments needs to see the
+   *  horizontal segments in scanline order, but is cheap, so we stitch
+   *  the bands together afterwards, yielding exactly the segments the
+   *  sequential scan would find.
+   */
+  n_bands = (end - start + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+  data.async          = async;
+  data.buffer         = buffer;
+  data.region         = region;
+  data.format         = format;
+  data.type           = type;
+  data.x1             = x1;
+  data.y1             = y1;
+  data.x2             = x2;
+  data.y2             = y2;
+  data.threshold      = threshold;
+  data.start          = start;
+  data.end            = end;
+  data.max_empty_segs = boundary->max_empty_segs;
+  data.horiz_segs     = g_new0 (GArray *, n_bands);
+
+  gegl_parallel_distribute_range (
+    n_bands, 1,
+    (GeglParallelDistributeRangeFunc) generate_boundary_bands,
+    &data);
+
+  /*  the bands that saw the cancellation are missing  */
+  if (async && gimp_async_is_canceled (async))
+    {
+      for (band = 0; band < n_bands; band++)
+        {
+          if (data.horiz_segs[band])
+            g_array_free (data.horiz_segs[band], TRUE);
+        }
+
+      g_free (data.horiz_segs);
 
-  line_rect.y = start;
-  gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                   line_data, GEGL_AUTO_ROWSTRIDE,
-                   GEGL_ABYSS_NONE);
+      gimp_boundary_free (boundary, TRUE);
 
-  find_empty_segs (region, line_data,
-                   start, boundary->empty_segs_c,
-                   boundary->max_empty_segs, &num_empty_c,
-                   type, x1, y1, x2, y2,
-                   threshold);
+      return NULL;
+    }
 
-  for (scanline = start; scanline < end; scanline++)
+  for (band = 0; band < n_bands; band++)
     {
-      /*  find the empty segment list for the next scanline  */
-      line_rect.y = scanline + 1;
-      if (scanline + 1 == end)
-        line_data = NULL;
-      else
-        gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                         line_data, GEGL_AUTO_ROWSTRIDE,
-                         GEGL_ABYSS_NONE);
-
-      find_empty_segs (region, line_data,
-                       scanline + 1, boundary->empty_segs_n,
-                       boundary->max_empty_segs, &num_empty_n,
-                       type, x1, y1, x2, y2,
-                       threshold);
-
-      /*  process the segments on the current scanline  */
-      for (i = 1; i < num_empty_c - 1; i += 2)
+      GArray *horiz_segs = data.horiz_segs[band];
+      gint    i;
+
+      for (i = 0; i < horiz_segs->len; i++)
         {
-          make_horiz_segs (boundary,
-                           boundary->empty_segs_c [i],
-                           boundary->empty_segs_c [i+1],
-                           scanline,
-                           boundary->empty_segs_l, num_empty_l, 1);
-          make_horiz_segs (boundary,
-                           boundary->empty_segs_c [i],
-                           boundary->empty_segs_c [i+1],
-                           scanline + 1,
-                           boundary->empty_segs_n, num_empty_n, 0);
+          const GimpBoundSeg *seg = &g_array_index (horiz_segs,
+                                                    GimpBoundSeg, i);
+
+          process_horiz_seg (boundary,
+                             seg->x1, seg->y1, seg->x2, seg->y2, seg->open);
         }
 
-      /*  get the next scanline of empty segments, swap others  */
-      tmp_segs               = boundary->empty_segs_l;
-      boundary->empty_segs_l = boundary->empty_segs_c;
-      num_empty_l            = num_empty_c;
-      boundary->empty_segs_c = boundary->empty_segs_n;
-      num_empty_c            = num_empty_n;
-      boundary->empty_segs_n = tmp_segs;
+      g_array_free (horiz_segs, TRUE);
     }
 
+  g_free (data.horiz_segs);
+
   return boundary;
 }
 
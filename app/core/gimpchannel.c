@@ -40,8 +40,11 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimp-utils.h"
+#include "gimpasync.h"
 #include "gimpboundary.h"
+#include "gimpcancelable.h"
 #include "gimpcontainer.h"
 #include "gimperror.h"
 #include "gimpimage.h"
@@ -57,6 +60,7 @@
 #include "gimppaintinfo.h"
 #include "gimppickable.h"
 #include "gimpstrokeoptions.h"
+#include "gimpwaitable.h"
 
 #include "gimp-intl.h"
 
@@ -70,6 +74,23 @@ enum
 };
 
 
+typedef struct
+{
+  GeglBuffer    *buffer;
+  GeglRectangle  rect;
+  gint           x1, y1;        /*  bounds of the outer boundary  */
+  gint           x2, y2;
+  gboolean       find_in;
+  gint           in_x1, in_y1;  /*  bounds of the inner boundary  */
+  gint           in_x2, in_y2;
+
+  GimpBoundSeg  *segs_in;
+  GimpBoundSeg  *segs_out;
+  gint           num_segs_in;
+  gint           num_segs_out;
+} BoundaryData;
+
+
 static void gimp_channel_pickable_iface_init (GimpPickableInterface *iface);
 
 static void       gimp_channel_finalize      (GObject           *object);
@@ -220,6 +241,23 @@ static void      gimp_channel_buffer_changed (GeglBuffer          *buffer,
                                               const GeglRectangle *rect,
                                               GimpChannel         *channel);
 
+static BoundaryData * gimp_channel_boundary_data_new   (GimpChannel  *channel,
+                                                        gint          x1,
+                                                        gint          y1,
+                                                        gint          x2,
+                                                        gint          y2,
+                                                        gboolean      copy);
+static void           gimp_channel_boundary_data_free  (BoundaryData *data);
+static void           gimp_channel_boundary_data_find  (BoundaryData *data,
+                                                        GimpAsync    *async);
+static void           gimp_channel_set_boundary        (GimpChannel  *channel,
+                                                        BoundaryData *data);
+static void           gimp_channel_boundary_async_func (GimpAsync    *async,
+                                                        BoundaryData *data);
+static void           gimp_channel_boundary_async_callback
+                                                       (GimpAsync    *async,
+                                                        GimpChannel  *channel);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpChannel, gimp_channel, GIMP_TYPE_DRAWABLE,
                          G_IMPLEMENT_INTERFACE (GIMP_TYPE_PICKABLE,
@@ -328,6 +366,7 @@ gimp_channel_init (GimpChannel *channel)
 
   /*  Selection mask variables  */
   channel->boundary_known = FALSE;
+  channel->boundary_async = NULL;
   channel->segs_in        = NULL;
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
@@ -351,6 +390,13 @@ gimp_channel_finalize (GObject *object)
 {
   GimpChannel *channel = GIMP_CHANNEL (object);
 
+  if (channel->boundary_async)
+    {
+      gimp_cancelable_cancel (GIMP_CANCELABLE (channel->boundary_async));
+
+      g_clear_object (&channel->boundary_async);
+    }
+
   g_clear_pointer (&channel->segs_in,  g_free);
   g_clear_pointer (&channel->segs_out, g_free);
 
@@ -989,6 +1035,14 @@ gimp_channel_invalidate_boundary (GimpDrawable *drawable)
 {
   GimpChannel *channel = GIMP_CHANNEL (drawable);
 
+  /*  a boundary still being computed is out of date as well  */
+  if (channel->boundary_async)
+    {
+      gimp_cancelable_cancel (GIMP_CANCELABLE (channel->boundary_async));
+
+      g_clear_object (&channel->boundary_async);
+    }
+
   channel->boundary_known = FALSE;
   channel->bounds_known   = FALSE;
 }
@@ -1081,59 +1135,25 @@ gimp_channel_real_boundary (GimpChannel         *channel,
                             gint                 x2,
                             gint                 y2)
 {
+  /*  if the boundary is being computed in the background, wait for
+   *  it, its callback stores the result
+   */
+  if (channel->boundary_async)
+    gimp_waitable_wait (GIMP_WAITABLE (channel->boundary_async));
+
   if (! channel->boundary_known)
     {
-      gint x3, y3, x4, y4;
+      BoundaryData *data;
 
-      /* free the out of date boundary segments */
-      g_free (channel->segs_in);
-      g_free (channel->segs_out);
+      data = gimp_channel_boundary_data_new (channel, x1, y1, x2, y2, FALSE);
 
-      if (gimp_item_bounds (GIMP_ITEM (channel), &x3, &y3, &x4, &y4))
-        {
-          GeglBuffer    *buffer;
-          GeglRectangle  rect = { x3, y3, x4, y4 };
-
-          x4 += x3;
-          y4 += y3;
-
-          buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
-
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
-          x1 = MAX (x1, x3);
-          y1 = MAX (y1, y3);
-          x2 = MIN (x2, x4);
-          y2 = MIN (y2, y4);
-
-          if (x2 > x1 && y2 > y1)
-            {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
-            }
-          else
-            {
-              channel->segs_in     = NULL;
-              channel->num_segs_in = 0;
-            }
-        }
-      else
-        {
-          channel->segs_in      = NULL;
-          channel->segs_out     = NULL;
-          channel->num_segs_in  = 0;
-          channel->num_segs_out = 0;
-        }
+      if (data)
+        gimp_channel_boundary_data_find (data, NULL);
+
+      gimp_channel_set_boundary (channel, data);
 
-      channel->boundary_known = TRUE;
+      if (data)
+        gimp_channel_boundary_data_free (data);
     }
 
   *segs_in      = channel->segs_in;
@@ -1555,6 +1575,160 @@ gimp_channel_buffer_changed (GeglBuffer          *buffer,
   gimp_drawable_invalidate_boundary (GIMP_DRAWABLE (channel));
 }
 
+static BoundaryData *
+gimp_channel_boundary_data_new (GimpChannel *channel,
+                                gint         x1,
+                                gint         y1,
+                                gint         x2,
+                                gint         y2,
+                                gboolean     copy)
+{
+  BoundaryData *data;
+  GeglBuffer   *buffer;
+  gint          x3, y3, x4, y4;
+
+  if (! gimp_item_bounds (GIMP_ITEM (channel), &x3, &y3, &x4, &y4))
+    return NULL;
+
+  data = g_slice_new0 (BoundaryData);
+
+  data->rect.x      = x3;
+  data->rect.y      = y3;
+  data->rect.width  = x4;
+  data->rect.height = y4;
+
+  x4 += x3;
+  y4 += y3;
+
+  data->x1 = x1;
+  data->y1 = y1;
+  data->x2 = x2;
+  data->y2 = y2;
+
+  data->in_x1 = MAX (x1, x3);
+  data->in_y1 = MAX (y1, y3);
+  data->in_x2 = MIN (x2, x4);
+  data->in_y2 = MIN (y2, y4);
+
+  data->find_in = (data->in_x2 > data->in_x1 &&
+                   data->in_y2 > data->in_y1);
+
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
+
+  /*  when running asynchronously, work on a copy, so that the mask can
+   *  keep changing in the meantime
+   */
+  if (copy)
+    data->buffer = gegl_buffer_dup (buffer);
+  else
+    data->buffer = g_object_ref (buffer);
+
+  return data;
+}
+
+static void
+gimp_channel_boundary_data_free (BoundaryData *data)
+{
+  g_clear_object (&data->buffer);
+
+  g_free (data->segs_in);
+  g_free (data->segs_out);
+
+  g_slice_free (BoundaryData, data);
+}
+
+static void
+gimp_channel_boundary_data_find (BoundaryData *data,
+                                 GimpAsync    *async)
+{
+  /*  the scans stop early when the computation is canceled  */
+  data->segs_out = gimp_boundary_find_full (async,
+                                            data->buffer, &data->rect,
+                                            babl_format ("Y float"),
+                                            GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                            data->x1, data->y1,
+                                            data->x2, data->y2,
+                                            GIMP_BOUNDARY_HALF_WAY,
+                                            &data->num_segs_out);
+
+  if (async && gimp_async_is_canceled (async))
+    return;
+
+  if (data->find_in)
+    {
+      data->segs_in = gimp_boundary_find_full (async,
+                                               data->buffer, NULL,
+                                               babl_format ("Y float"),
+                                               GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                               data->in_x1, data->in_y1,
+                                               data->in_x2, data->in_y2,
+                                               GIMP_BOUNDARY_HALF_WAY,
+                                               &data->num_segs_in);
+    }
+}
+
+static void
+gimp_channel_set_boundary (GimpChannel  *channel,
+                           BoundaryData *data)
+{
+  /* free the out of date boundary segments */
+  g_free (channel->segs_in);
+  g_free (channel->segs_out);
+
+  if (data)
+    {
+      channel->segs_in      = data->segs_in;
+      channel->segs_out     = data->segs_out;
+      channel->num_segs_in  = data->num_segs_in;
+      channel->num_segs_out = data->num_segs_out;
+
+      data->segs_in  = NULL;
+      data->segs_out = NULL;
+    }
+  else
+    {
+      channel->segs_in      = NULL;
+      channel->segs_out     = NULL;
+      channel->num_segs_in  = 0;
+      channel->num_segs_out = 0;
+    }
+
+  channel->boundary_known = TRUE;
+}
+
+static void
+gimp_channel_boundary_async_func (GimpAsync    *async,
+                                  BoundaryData *data)
+{
+  gimp_channel_boundary_data_find (data, async);
+
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_channel_boundary_data_free (data);
+
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  gimp_async_finish_full (async, data,
+                          (GDestroyNotify) gimp_channel_boundary_data_free);
+}
+
+static void
+gimp_channel_boundary_async_callback (GimpAsync   *async,
+                                      GimpChannel *channel)
+{
+  /*  the channel was invalidated in the meantime  */
+  if (channel->boundary_async != async)
+    return;
+
+  if (gimp_async_is_finished (async))
+    gimp_channel_set_boundary (channel, gimp_async_get_result (async));
+
+  g_clear_object (&channel->boundary_async);
+}
+
 
 /*  public functions  */
 
@@ -1881,6 +2055,64 @@ gimp_channel_boundary (GimpChannel         *channel,
                                                      x2, y2);
 }
 
+/**
+ * gimp_channel_boundary_async:
+ * @channel: a #GimpChannel
+ * @x1:      left side of the bounds of the inner boundary
+ * @y1:      top side of the bounds of the inner boundary
+ * @x2:      right side of the bounds of the inner boundary
+ * @y2:      bottom side of the bounds of the inner boundary
+ *
+ * Starts computing the boundary of @channel in a separate thread, if
+ * it's not known yet.  Once the returned #GimpAsync is finished, the
+ * boundary is known, and gimp_channel_boundary() returns it without
+ * delay, as long as @channel didn't change in the meantime; changing
+ * @channel cancels the computation.
+ *
+ * Return value: the #GimpAsync computing the boundary, or %NULL if the
+ *               boundary is already known.
+ **/
+GimpAsync *
+gimp_channel_boundary_async (GimpChannel *channel,
+                             gint         x1,
+                             gint         y1,
+                             gint         x2,
+                             gint         y2)
+{
+  BoundaryData *data;
+
+  g_return_val_if_fail (GIMP_IS_CHANNEL (channel), NULL);
+
+  if (channel->boundary_async)
+    return channel->boundary_async;
+
+  if (channel->boundary_known)
+    return NULL;
+
+  data = gimp_channel_boundary_data_new (channel, x1, y1, x2, y2, TRUE);
+
+  if (! data)
+    {
+      gimp_channel_set_boundary (channel, NULL);
+
+      return NULL;
+    }
+
+  channel->boundary_async = gimp_parallel_run_async_full (
+    +1,
+    (GimpParallelRunAsyncFunc) gimp_channel_boundary_async_func,
+    data,
+    (GDestroyNotify) gimp_channel_boundary_data_free);
+
+  gimp_async_add_callback_for_object (
+    channel->boundary_async,
+    (GimpAsyncCallback) gimp_channel_boundary_async_callback,
+    channel,
+    channel);
+
+  return channel->boundary_async;
+}
+
 gboolean
 gimp_channel_is_empty (GimpChannel *channel)
 {
@@ -45,6 +45,7 @@ struct _GimpChannel
 
   /*  Selection mask variables  */
   gboolean      boundary_known;    /*  is the current boundary valid  */
+  GimpAsync    *boundary_async;    /*  boundary being computed        */
   GimpBoundSeg *segs_in;           /*  outline of selected region     */
   GimpBoundSeg *segs_out;          /*  outline of selected region     */
   gint          num_segs_in;       /*  number of lines in boundary    */
@@ -176,6 +177,11 @@ gboolean      gimp_channel_boundary           (GimpChannel            *mask,
                                                gint                    y1,
                                                gint                    x2,
                                                gint                    y2);
+GimpAsync   * gimp_channel_boundary_async     (GimpChannel            *mask,
+                                               gint                    x1,
+                                               gint                    y1,
+                                               gint                    x2,
+                                               gint                    y2);
 gboolean      gimp_channel_is_empty           (GimpChannel            *mask);
 
 void          gimp_channel_feather            (GimpChannel            *mask,
@@ -22,11 +22,15 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-loops.h"
 #include "gegl/gimp-gegl-utils.h"
 
+#include "gimp-parallel.h"
+#include "gimpasync.h"
 #include "gimpchannel.h"
 #include "gimpdrawable.h"
 #include "gimpdrawable-foreground-extract.h"
@@ -36,6 +40,95 @@
 #include "gimp-intl.h"
 
 
+/* the matting operations need some known pixels around the unknown
+ * band to sample foreground and background colors from
+ */
+#define UNKNOWN_MARGIN 16
+
+/* the unknown band is matted in tiles of this size, so that the
+ * computation can be canceled, and its progress shown, between tiles
+ */
+#define MATTE_TILE_SIZE 512
+
+#define PROGRESS_STEPS    1000
+#define PROGRESS_INTERVAL 100 /* ms */
+
+
+/* the state shared with the main thread while the matte is being
+ * computed asynchronously.  only @value is accessed by the worker, the
+ * rest belongs to the main thread, which frees the struct once the
+ * async has stopped.
+ */
+typedef struct
+{
+  GimpAsync         *async;
+  GimpProgress      *progress;
+  gint               value;
+  guint              timeout_id;
+} ForegroundExtractProgress;
+
+typedef struct
+{
+  GeglBuffer        *buffer;
+  GeglBuffer        *trimap;
+  gint               off_x;
+  gint               off_y;
+  GimpMattingEngine  engine;
+  gint               global_iterations;
+  gint               levin_levels;
+  gint               levin_active_levels;
+  gdouble            scale;
+  gboolean           tiled;
+
+  ForegroundExtractProgress *progress;
+} ForegroundExtractData;
+
+
+/*  local function prototypes  */
+
+static ForegroundExtractData *
+                    foreground_extract_data_new    (GimpDrawable          *drawable,
+                                                    GimpMattingEngine      engine,
+                                                    gint                   global_iterations,
+                                                    gint                   levin_levels,
+                                                    gint                   levin_active_levels,
+                                                    GeglBuffer            *trimap,
+                                                    gdouble                scale);
+static void         foreground_extract_data_free   (ForegroundExtractData *data);
+
+static gboolean     foreground_extract_progress_timeout
+                                                   (ForegroundExtractProgress *progress);
+static void         foreground_extract_progress_stopped
+                                                   (GimpAsync             *async,
+                                                    ForegroundExtractProgress *progress);
+static void         foreground_extract_set_progress
+                                                   (ForegroundExtractData *data,
+                                                    GimpProgress          *progress,
+                                                    gdouble                value);
+
+static gboolean     foreground_extract_get_unknown (GeglBuffer            *trimap,
+                                                    const GeglRectangle   *rect,
+                                                    GeglRectangle         *unknown);
+static gboolean     foreground_extract_matte       (ForegroundExtractData *data,
+                                                    const GeglRectangle   *rect,
+                                                    const GeglRectangle   *roi,
+                                                    gdouble                scale,
+                                                    GeglBuffer            *output,
+                                                    GimpAsync             *async,
+                                                    GimpProgress          *progress,
+                                                    gdouble                progress_start,
+                                                    gdouble                progress_end);
+static gboolean     foreground_extract_matte_tiled (ForegroundExtractData *data,
+                                                    const GeglRectangle   *rect,
+                                                    GeglBuffer            *output,
+                                                    GimpAsync             *async);
+static GeglBuffer * foreground_extract_run         (ForegroundExtractData *data,
+                                                    GimpAsync             *async,
+                                                    GimpProgress          *progress);
+static void         foreground_extract_async_func  (GimpAsync             *async,
+                                                    ForegroundExtractData *data);
+
+
 /*  public functions  */
 
 GeglBuffer *
@@ -47,16 +140,8 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
                                   GeglBuffer        *trimap,
                                   GimpProgress      *progress)
 {
-  GeglBuffer    *drawable_buffer;
-  GeglNode      *gegl;
-  GeglNode      *input_node;
-  GeglNode      *trimap_node;
-  GeglNode      *matting_node;
-  GeglNode      *output_node;
-  GeglBuffer    *buffer;
-  GeglProcessor *processor;
-  gdouble        value;
-  gint           off_x, off_y;
+  ForegroundExtractData *data;
+  GeglBuffer            *buffer;
 
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
@@ -65,86 +150,495 @@ gimp_drawable_foreground_extract (GimpDrawable      *drawable,
   progress = gimp_progress_start (progress, FALSE,
                                   _("Computing alpha of unknown pixels"));
 
-  drawable_buffer = gimp_drawable_get_buffer (drawable);
+  data = foreground_extract_data_new (drawable, engine,
+                                      global_iterations,
+                                      levin_levels, levin_active_levels,
+                                      trimap, 1.0);
+
+  buffer = foreground_extract_run (data, NULL, progress);
+
+  foreground_extract_data_free (data);
+
+  if (progress)
+    gimp_progress_end (progress);
+
+  return buffer;
+}
+
+/*  Computes the matte in a separate thread, returning the buffer as the
+ *  async's result.  If @scale is less than 1.0, the matte is computed
+ *  for the whole drawable at that scale and upsampled, which is much
+ *  quicker and good enough for previewing.  Otherwise, it is computed at
+ *  full resolution, but only around the trimap's unknown band, in tiles
+ *  which only see their own surroundings.  This is meant for previews:
+ *  the result can differ from gimp_drawable_foreground_extract(), which
+ *  always mattes the whole drawable at once.
+ *
+ *  @progress, if not NULL, is updated from the main thread while the
+ *  matte is being computed, and is no longer touched once the async is
+ *  canceled.
+ */
+GimpAsync *
+gimp_drawable_foreground_extract_async (GimpDrawable      *drawable,
+                                        GimpMattingEngine  engine,
+                                        gint               global_iterations,
+                                        gint               levin_levels,
+                                        gint               levin_active_levels,
+                                        GeglBuffer        *trimap,
+                                        gdouble            scale,
+                                        GimpProgress      *progress)
+{
+  ForegroundExtractData     *data;
+  ForegroundExtractProgress *extract_progress = NULL;
+  GimpAsync                 *async;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (trimap), NULL);
+  g_return_val_if_fail (scale > 0.0, NULL);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
+
+  data = foreground_extract_data_new (drawable, engine,
+                                      global_iterations,
+                                      levin_levels, levin_active_levels,
+                                      trimap, MIN (scale, 1.0));
+
+  data->tiled = TRUE;
+
+  if (progress)
+    {
+      extract_progress = g_slice_new0 (ForegroundExtractProgress);
+
+      data->progress = extract_progress;
+    }
+
+  async = gimp_parallel_run_async_full (
+    +1,
+    (GimpParallelRunAsyncFunc) foreground_extract_async_func,
+    data,
+    (GDestroyNotify) foreground_extract_data_free);
+
+  /*  'data' may already be freed at this point, but the progress struct
+   *  is only freed by the callback below
+   */
+  if (extract_progress)
+    {
+      extract_progress->async      = async;
+      extract_progress->progress   = g_object_ref (progress);
+      extract_progress->timeout_id =
+        g_timeout_add (PROGRESS_INTERVAL,
+                       (GSourceFunc) foreground_extract_progress_timeout,
+                       extract_progress);
+
+      gimp_async_add_callback (
+        async,
+        (GimpAsyncCallback) foreground_extract_progress_stopped,
+        extract_progress);
+    }
+
+  return async;
+}
+
+
+/*  private functions  */
+
+static ForegroundExtractData *
+foreground_extract_data_new (GimpDrawable      *drawable,
+                             GimpMattingEngine  engine,
+                             gint               global_iterations,
+                             gint               levin_levels,
+                             gint               levin_active_levels,
+                             GeglBuffer        *trimap,
+                             gdouble            scale)
+{
+  ForegroundExtractData *data = g_slice_new0 (ForegroundExtractData);
+
+  /*  work on copies, so that the drawable and the trimap can keep
+   *  changing while the matte is being computed
+   */
+  data->buffer = gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+  data->trimap = gegl_buffer_dup (trimap);
+
+  gimp_item_get_offset (GIMP_ITEM (drawable), &data->off_x, &data->off_y);
+
+  data->engine              = engine;
+  data->global_iterations   = global_iterations;
+  data->levin_levels        = levin_levels;
+  data->levin_active_levels = levin_active_levels;
+  data->scale               = scale;
+
+  return data;
+}
+
+static void
+foreground_extract_data_free (ForegroundExtractData *data)
+{
+  g_object_unref (data->buffer);
+  g_object_unref (data->trimap);
+
+  g_slice_free (ForegroundExtractData, data);
+}
+
+static gboolean
+foreground_extract_progress_timeout (ForegroundExtractProgress *progress)
+{
+  /*  the progress may have been ended, or reused, once the async was
+   *  canceled
+   */
+  if (! gimp_async_is_canceled (progress->async))
+    {
+      gimp_progress_set_value (progress->progress,
+                               (gdouble) g_atomic_int_get (&progress->value) /
+                               PROGRESS_STEPS);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+foreground_extract_progress_stopped (GimpAsync                 *async,
+                                     ForegroundExtractProgress *progress)
+{
+  g_source_remove (progress->timeout_id);
+
+  g_object_unref (progress->progress);
+
+  g_slice_free (ForegroundExtractProgress, progress);
+}
+
+static void
+foreground_extract_set_progress (ForegroundExtractData *data,
+                                 GimpProgress          *progress,
+                                 gdouble                value)
+{
+  if (progress)
+    gimp_progress_set_value (progress, value);
+  else if (data->progress)
+    g_atomic_int_set (&data->progress->value, ROUND (value * PROGRESS_STEPS));
+}
+
+/*  Finds the bounding box of the trimap pixels inside @rect which are
+ *  neither fully foreground nor fully background.
+ */
+static gboolean
+foreground_extract_get_unknown (GeglBuffer          *trimap,
+                                const GeglRectangle *rect,
+                                GeglRectangle       *unknown)
+{
+  GeglBufferIterator *iter;
+  gint                x1 = G_MAXINT;
+  gint                y1 = G_MAXINT;
+  gint                x2 = G_MININT;
+  gint                y2 = G_MININT;
+
+  iter = gegl_buffer_iterator_new (trimap, rect, 0, babl_format ("Y u8"),
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const guchar  *data = iter->items[0].data;
+      GeglRectangle *roi  = &iter->items[0].roi;
+      gint           x, y;
+
+      for (y = roi->y; y < roi->y + roi->height; y++)
+        {
+          for (x = roi->x; x < roi->x + roi->width; x++, data++)
+            {
+              if (*data != 0 && *data != 255)
+                {
+                  x1 = MIN (x1, x);
+                  y1 = MIN (y1, y);
+                  x2 = MAX (x2, x + 1);
+                  y2 = MAX (y2, y + 1);
+                }
+            }
+        }
+    }
+
+  if (x1 >= x2)
+    return FALSE;
+
+  unknown->x      = x1;
+  unknown->y      = y1;
+  unknown->width  = x2 - x1;
+  unknown->height = y2 - y1;
+
+  return TRUE;
+}
+
+/*  Computes the matte of the (image-space) area @roi into @output,
+ *  letting the matting operation see only the area @rect around it.
+ *  Returns FALSE if @async was canceled.
+ */
+static gboolean
+foreground_extract_matte (ForegroundExtractData *data,
+                          const GeglRectangle   *rect,
+                          const GeglRectangle   *roi,
+                          gdouble                scale,
+                          GeglBuffer            *output,
+                          GimpAsync             *async,
+                          GimpProgress          *progress,
+                          gdouble                progress_start,
+                          gdouble                progress_end)
+{
+  GeglNode      *gegl;
+  GeglNode      *input_node;
+  GeglNode      *trimap_node;
+  GeglNode      *matting_node;
+  GeglNode      *matte_node;
+  GeglNode      *output_node;
+  GeglNode      *crop;
+  GeglProcessor *processor;
+  gdouble        value;
+  gboolean       canceled = FALSE;
 
   gegl = gegl_node_new ();
 
   trimap_node = gegl_node_new_child (gegl,
                                      "operation", "gegl:buffer-source",
-                                     "buffer",    trimap,
+                                     "buffer",    data->trimap,
                                      NULL);
   input_node = gegl_node_new_child (gegl,
                                     "operation", "gegl:buffer-source",
-                                    "buffer",    drawable_buffer,
+                                    "buffer",    data->buffer,
                                     NULL);
   output_node = gegl_node_new_child (gegl,
-                                     "operation", "gegl:buffer-sink",
-                                     "buffer",    &buffer,
-                                     "format",    NULL,
+                                     "operation", "gegl:write-buffer",
+                                     "buffer",    output,
                                      NULL);
 
-  if (engine == GIMP_MATTING_ENGINE_GLOBAL)
+  if (data->engine == GIMP_MATTING_ENGINE_GLOBAL)
     {
       matting_node = gegl_node_new_child (gegl,
                                           "operation",  "gegl:matting-global",
-                                          "iterations", global_iterations,
+                                          "iterations", data->global_iterations,
                                           NULL);
     }
   else
     {
       matting_node = gegl_node_new_child (gegl,
                                           "operation",     "gegl:matting-levin",
-                                          "levels",        levin_levels,
-                                          "active_levels", levin_active_levels,
+                                          "levels",        data->levin_levels,
+                                          "active_levels", data->levin_active_levels,
                                           NULL);
     }
 
-  gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+  matte_node = matting_node;
 
-  if (off_x || off_y)
+  if (data->off_x || data->off_y)
     {
-      GeglNode *pre;
-      GeglNode *post;
-
-      pre = gegl_node_new_child (gegl,
-                                 "operation", "gegl:translate",
-                                 "x", -1.0 * off_x,
-                                 "y", -1.0 * off_y,
-                                 NULL);
-      post = gegl_node_new_child (gegl,
-                                  "operation", "gegl:translate",
-                                  "x", 1.0 * off_x,
-                                  "y", 1.0 * off_y,
-                                  NULL);
-
-      gegl_node_connect_to (trimap_node,   "output", pre, "input");
-      gegl_node_connect_to (pre,  "output", matting_node, "aux");
-      gegl_node_link_many (input_node, matting_node, post, output_node, NULL);
+      GeglNode *translate;
+
+      translate = gegl_node_new_child (gegl,
+                                       "operation", "gegl:translate",
+                                       "x", 1.0 * data->off_x,
+                                       "y", 1.0 * data->off_y,
+                                       NULL);
+
+      gegl_node_link (input_node, translate);
+      input_node = translate;
     }
-  else
+
+  /*  only let the matting operation see the area being computed  */
+  crop = gegl_node_new_child (gegl,
+                              "operation", "gegl:crop",
+                              "x",         (gdouble) rect->x,
+                              "y",         (gdouble) rect->y,
+                              "width",     (gdouble) rect->width,
+                              "height",    (gdouble) rect->height,
+                              NULL);
+  gegl_node_link (input_node, crop);
+  input_node = crop;
+
+  crop = gegl_node_new_child (gegl,
+                              "operation", "gegl:crop",
+                              "x",         (gdouble) rect->x,
+                              "y",         (gdouble) rect->y,
+                              "width",     (gdouble) rect->width,
+                              "height",    (gdouble) rect->height,
+                              NULL);
+  gegl_node_link (trimap_node, crop);
+  trimap_node = crop;
+
+  if (scale < 1.0)
     {
-      gegl_node_connect_to (input_node,   "output",
-                            matting_node, "input");
-      gegl_node_connect_to (trimap_node,  "output",
-                            matting_node, "aux");
-      gegl_node_connect_to (matting_node, "output",
-                            output_node,  "input");
+      GeglNode *input_scale;
+      GeglNode *trimap_scale;
+      GeglNode *matte_scale;
+
+      input_scale = gegl_node_new_child (gegl,
+                                         "operation", "gegl:scale-ratio",
+                                         "x",         scale,
+                                         "y",         scale,
+                                         "sampler",   GEGL_SAMPLER_LINEAR,
+                                         NULL);
+      /*  keep the trimap's classes intact  */
+      trimap_scale = gegl_node_new_child (gegl,
+                                          "operation", "gegl:scale-ratio",
+                                          "x",         scale,
+                                          "y",         scale,
+                                          "sampler",   GEGL_SAMPLER_NEAREST,
+                                          NULL);
+      matte_scale = gegl_node_new_child (gegl,
+                                         "operation", "gegl:scale-ratio",
+                                         "x",         1.0 / scale,
+                                         "y",         1.0 / scale,
+                                         "sampler",   GEGL_SAMPLER_LINEAR,
+                                         NULL);
+
+      gegl_node_link (input_node,   input_scale);
+      gegl_node_link (trimap_node,  trimap_scale);
+      gegl_node_link (matting_node, matte_scale);
+
+      input_node  = input_scale;
+      trimap_node = trimap_scale;
+      matte_node  = matte_scale;
     }
 
-  processor = gegl_node_new_processor (output_node, NULL);
+  gegl_node_connect_to (input_node,   "output",
+                        matting_node, "input");
+  gegl_node_connect_to (trimap_node,  "output",
+                        matting_node, "aux");
+  gegl_node_link (matte_node, output_node);
+
+  processor = gegl_node_new_processor (output_node, roi);
 
   while (gegl_processor_work (processor, &value))
     {
-      if (progress)
-        gimp_progress_set_value (progress, value);
-    }
+      if (async && gimp_async_is_canceled (async))
+        {
+          canceled = TRUE;
+          break;
+        }
 
-  if (progress)
-    gimp_progress_end (progress);
+      foreground_extract_set_progress (data, progress,
+                                       progress_start +
+                                       (progress_end - progress_start) * value);
+    }
 
   g_object_unref (processor);
 
   g_object_unref (gegl);
 
+  return ! canceled;
+}
+
+/*  Mattes the trimap's unknown band inside @rect, one tile at a time,
+ *  each tile seeing UNKNOWN_MARGIN pixels around it.  Returns FALSE if
+ *  @async was canceled.
+ */
+static gboolean
+foreground_extract_matte_tiled (ForegroundExtractData *data,
+                                const GeglRectangle   *rect,
+                                GeglBuffer            *output,
+                                GimpAsync             *async)
+{
+  GeglRectangle unknown;
+  gint          n_tiles_x;
+  gint          n_tiles_y;
+  gint          n_tiles;
+  gint          i = 0;
+  gint          x, y;
+
+  /*  pixels outside of the unknown band simply keep their trimap value,
+   *  only the band itself needs to be matted at full resolution
+   */
+  gimp_gegl_buffer_copy (data->trimap, rect, GEGL_ABYSS_NONE,
+                         output, NULL);
+
+  if (! foreground_extract_get_unknown (data->trimap, rect, &unknown))
+    return TRUE;
+
+  n_tiles_x = (unknown.width  + MATTE_TILE_SIZE - 1) / MATTE_TILE_SIZE;
+  n_tiles_y = (unknown.height + MATTE_TILE_SIZE - 1) / MATTE_TILE_SIZE;
+  n_tiles   = n_tiles_x * n_tiles_y;
+
+  for (y = unknown.y; y < unknown.y + unknown.height; y += MATTE_TILE_SIZE)
+    {
+      for (x = unknown.x; x < unknown.x + unknown.width; x += MATTE_TILE_SIZE)
+        {
+          GeglRectangle tile;
+          GeglRectangle tile_unknown;
+          GeglRectangle area;
+
+          if (async && gimp_async_is_canceled (async))
+            return FALSE;
+
+          gegl_rectangle_set (&tile,
+                              x, y,
+                              MIN (MATTE_TILE_SIZE,
+                                   unknown.x + unknown.width  - x),
+                              MIN (MATTE_TILE_SIZE,
+                                   unknown.y + unknown.height - y));
+
+          if (foreground_extract_get_unknown (data->trimap, &tile,
+                                              &tile_unknown))
+            {
+              gegl_rectangle_set (&area,
+                                  tile_unknown.x      - UNKNOWN_MARGIN,
+                                  tile_unknown.y      - UNKNOWN_MARGIN,
+                                  tile_unknown.width  + 2 * UNKNOWN_MARGIN,
+                                  tile_unknown.height + 2 * UNKNOWN_MARGIN);
+              gegl_rectangle_intersect (&area, &area, rect);
+
+              if (! foreground_extract_matte (data, &area, &tile_unknown,
+                                              1.0, output, async, NULL,
+                                              (gdouble) i       / n_tiles,
+                                              (gdouble) (i + 1) / n_tiles))
+                {
+                  return FALSE;
+                }
+            }
+
+          foreground_extract_set_progress (data, NULL,
+                                           (gdouble) ++i / n_tiles);
+        }
+    }
+
+  return TRUE;
+}
+
+static GeglBuffer *
+foreground_extract_run (ForegroundExtractData *data,
+                        GimpAsync             *async,
+                        GimpProgress          *progress)
+{
+  GeglBuffer    *buffer;
+  GeglRectangle  rect;
+  gboolean       success;
+
+  rect    = *gegl_buffer_get_extent (data->buffer);
+  rect.x += data->off_x;
+  rect.y += data->off_y;
+
+  buffer = gegl_buffer_new (&rect, babl_format ("Y float"));
+
+  if (data->tiled && data->scale >= 1.0)
+    {
+      success = foreground_extract_matte_tiled (data, &rect, buffer, async);
+    }
+  else
+    {
+      success = foreground_extract_matte (data, &rect, &rect, data->scale,
+                                          buffer, async, progress,
+                                          0.0, 1.0);
+    }
+
+  if (! success)
+    g_clear_object (&buffer);
+
   return buffer;
 }
+
+static void
+foreground_extract_async_func (GimpAsync             *async,
+                               ForegroundExtractData *data)
+{
+  GeglBuffer *buffer;
+
+  buffer = foreground_extract_run (data, async, NULL);
+
+  if (buffer)
+    gimp_async_finish_full (async, buffer, g_object_unref);
+  else
+    gimp_async_abort (async);
+}
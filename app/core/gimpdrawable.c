@@ -50,6 +50,7 @@
 #include "gimpmarshal.h"
 #include "gimppickable.h"
 #include "gimpprogress.h"
+#include "gimpsummedareatable.h"
 
 #include "gimp-log.h"
 
@@ -360,6 +361,9 @@ gimp_drawable_finalize (GObject *object)
   g_clear_object (&drawable->private->buffer_source_node);
   g_clear_object (&drawable->private->filter_stack);
 
+  g_clear_pointer (&drawable->private->average_table,
+                   gimp_summed_area_table_free);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -779,8 +783,12 @@ gimp_drawable_get_pixel_average (GimpPickable        *pickable,
 {
   GimpDrawable *drawable = GIMP_DRAWABLE (pickable);
 
-  return gimp_gegl_average_color (gimp_drawable_get_buffer (drawable),
-                                  rect, TRUE, GEGL_ABYSS_NONE, format, pixel);
+  if (! drawable->private->average_table)
+    drawable->private->average_table = gimp_summed_area_table_new ();
+
+  gimp_summed_area_table_get_average (drawable->private->average_table,
+                                      gimp_drawable_get_buffer (drawable),
+                                      rect, format, pixel);
 }
 
 static void
@@ -891,6 +899,9 @@ gimp_drawable_real_set_buffer (GimpDrawable *drawable,
   g_set_object (&drawable->private->buffer, buffer);
   g_clear_object (&drawable->private->format_profile);
 
+  if (drawable->private->average_table)
+    gimp_summed_area_table_invalidate (drawable->private->average_table, NULL);
+
   if (drawable->private->buffer_source_node)
     gegl_node_set (drawable->private->buffer_source_node,
                    "buffer", gimp_drawable_get_buffer (drawable),
@@ -1075,6 +1086,12 @@ gimp_drawable_update (GimpDrawable *drawable,
   if (height == -1)
     height = gimp_item_get_height (GIMP_ITEM (drawable));
 
+  if (drawable->private->average_table)
+    {
+      gimp_summed_area_table_invalidate (drawable->private->average_table,
+                                         GEGL_RECTANGLE (x, y, width, height));
+    }
+
   if (drawable->private->paint_count == 0)
     {
       g_signal_emit (drawable, gimp_drawable_signals[UPDATE], 0,
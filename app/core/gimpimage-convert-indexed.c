@@ -192,6 +192,16 @@
 #define G_SCALE 24              /*  scale G (a*) distances by this much  */
 #define B_SCALE 26              /*  and B (b*) by this much              */
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+/* partial RGB histograms are large, so only give each thread its own
+ * partial histogram when it has enough pixels to fill, and bound the
+ * number of partial histograms alive at once.
+ */
+#define HISTOGRAM_PIXELS_PER_THREAD (512 * 512)
+#define HISTOGRAM_MAX_THREADS       8
+
 
 typedef struct _Color Color;
 typedef struct _QuantizeObj QuantizeObj;
@@ -201,6 +211,11 @@ typedef void (* Pass2InitFunc) (QuantizeObj *quantize_obj);
 typedef void (* Pass2Func)     (QuantizeObj *quantize_obj,
                                 GimpLayer   *layer,
                                 GeglBuffer  *new_buffer);
+typedef void (* Pass2AreaFunc) (QuantizeObj         *quantize_obj,
+                                GimpLayer           *layer,
+                                GeglBuffer          *new_buffer,
+                                const GeglRectangle *area,
+                                gulong              *index_used_count);
 typedef void (* CleanupFunc)   (QuantizeObj *quantize_obj);
 
 typedef gulong ColorFreq;
@@ -483,6 +498,7 @@ struct _QuantizeObj
   Color         clin[256];                /* .. converted back to linear space */
   gulong        index_used_count[256];    /* how many times an index was used  */
   CFHistogram   histogram;                /* holds the histogram               */
+  gint         *inverse_cmap;             /* thread-safe inverse colormap cache */
 
   gboolean      want_dither_alpha;
   gint          error_freedom;            /* 0=much bleed, 1=controlled bleed */
@@ -515,6 +531,30 @@ typedef struct
 
 } box, *boxptr;
 
+typedef struct
+{
+  CFHistogram   histogram;
+  GeglBuffer   *buffer;
+  const Babl   *format;
+  gint          width;
+  gint          height;
+  gint          offsetx;
+  gint          offsety;
+  gint          col_limit;
+  gboolean      dither_alpha;
+  gint          track_colors;  /* accessed atomically */
+  GMutex        mutex;
+} HistogramData;
+
+typedef struct
+{
+  QuantizeObj   *quantobj;
+  GimpLayer     *layer;
+  GeglBuffer    *new_buffer;
+  Pass2AreaFunc  func;
+  GMutex         mutex;
+} Pass2Data;
+
 
 static void          zero_histogram_gray     (CFHistogram   histogram);
 static void          zero_histogram_rgb      (CFHistogram   histogram);
@@ -682,23 +722,23 @@ make_remap_table (const guchar  old_palette[],
   g_free (palentries);
 }
 
+typedef struct
+{
+  GeglBuffer   *buffer;
+  const guchar *remap_table;
+  gint          bpp;
+  gboolean      has_alpha;
+} RemapData;
+
 static void
-remap_indexed_layer (GimpLayer    *layer,
-                     const guchar *remap_table,
-                     gint          num_entries)
+remap_indexed_layer_area (const GeglRectangle *area,
+                          RemapData           *remap)
 {
   GeglBufferIterator *iter;
-  const Babl         *format;
-  gint                bpp;
-  gboolean            has_alpha;
-
-  format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+  const guchar       *remap_table = remap->remap_table;
+  gint                bpp         = remap->bpp;
 
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
-
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+  iter = gegl_buffer_iterator_new (remap->buffer, area, 0, NULL,
                                    GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE, 1);
 
   while (gegl_buffer_iterator_next (iter))
@@ -706,7 +746,7 @@ remap_indexed_layer (GimpLayer    *layer,
       guchar *data   = iter->items[0].data;
       gint    length = iter->length;
 
-      if (has_alpha)
+      if (remap->has_alpha)
         {
           while (length--)
             {
@@ -728,6 +768,28 @@ remap_indexed_layer (GimpLayer    *layer,
     }
 }
 
+static void
+remap_indexed_layer (GimpLayer    *layer,
+                     const guchar *remap_table,
+                     gint          num_entries)
+{
+  RemapData   remap;
+  const Babl *format;
+
+  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+  remap.buffer      = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  remap.remap_table = remap_table;
+  remap.bpp         = babl_format_get_bytes_per_pixel (format);
+  remap.has_alpha   = babl_format_has_alpha (format);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (remap.buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) remap_indexed_layer_area,
+    &remap);
+}
+
 static gint
 color_quicksort (const void *c1,
                  const void *c2)
@@ -1114,255 +1176,325 @@ zero_histogram_rgb (CFHistogram histogram)
 
 
 static void
-generate_histogram_gray (CFHistogram  histogram,
-                         GimpLayer   *layer,
-                         gboolean     dither_alpha)
+generate_histogram_gray_area (const GeglRectangle *area,
+                              HistogramData       *data)
 {
   GeglBufferIterator *iter;
-  const Babl         *format;
+  ColorFreq           histogram[256] = { 0, };
   gint                bpp;
   gboolean            has_alpha;
+  gint                i;
 
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-
-  g_return_if_fail (format == babl_format ("Y' u8") ||
-                    format == babl_format ("Y'A u8"));
+  bpp       = babl_format_get_bytes_per_pixel (data->format);
+  has_alpha = babl_format_has_alpha (data->format);
 
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
-
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+  iter = gegl_buffer_iterator_new (data->buffer, area, 0, data->format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
 
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *data   = iter->items[0].data;
+      const guchar *src    = iter->items[0].data;
       gint          length = iter->length;
 
       if (has_alpha)
         {
           while (length--)
             {
-              if (data[ALPHA_G] > 127)
-                histogram[*data]++;
+              if (src[ALPHA_G] > 127)
+                histogram[*src]++;
 
-              data += bpp;
+              src += bpp;
             }
         }
       else
         {
           while (length--)
             {
-              histogram[*data]++;
+              histogram[*src]++;
 
-              data += bpp;
+              src += bpp;
             }
         }
     }
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < 256; i++)
+    data->histogram[i] += histogram[i];
+
+  g_mutex_unlock (&data->mutex);
 }
 
+static void
+generate_histogram_gray (CFHistogram  histogram,
+                         GimpLayer   *layer,
+                         gboolean     dither_alpha)
+{
+  HistogramData data = { 0, };
 
+  data.format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+  g_return_if_fail (data.format == babl_format ("Y' u8") ||
+                    data.format == babl_format ("Y'A u8"));
+
+  data.histogram = histogram;
+  data.buffer    = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+
+  g_mutex_init (&data.mutex);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (data.buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) generate_histogram_gray_area,
+    &data);
+
+  g_mutex_clear (&data.mutex);
+}
+
+
+/* Adds the colors found by one part of the layer to the global table
+ * of found colors, switching to quantization if there are too many.
+ * Must be called with data->mutex held.
+ */
 static void
-generate_histogram_rgb (CFHistogram   histogram,
-                        GimpLayer    *layer,
-                        gint          col_limit,
-                        gboolean      dither_alpha,
-                        GimpProgress *progress)
+merge_found_cols (HistogramData *data,
+                  guchar         cols[][3],
+                  gint           n_cols)
+{
+  gint i, j;
+
+  for (i = 0; i < n_cols && ! needs_quantize; i++)
+    {
+      for (j = 0; j < num_found_cols; j++)
+        {
+          if (cols[i][0] == found_cols[j][0] &&
+              cols[i][1] == found_cols[j][1] &&
+              cols[i][2] == found_cols[j][2])
+            break;
+        }
+
+      if (j < num_found_cols)
+        continue;
+
+      if (num_found_cols == data->col_limit)
+        {
+          /* There are more colors in the image than were allowed.
+           * We switch to plain histogram calculation with a view to
+           * quantizing at a later stage.
+           */
+          needs_quantize = TRUE;
+          g_atomic_int_set (&data->track_colors, FALSE);
+        }
+      else
+        {
+          found_cols[num_found_cols][0] = cols[i][0];
+          found_cols[num_found_cols][1] = cols[i][1];
+          found_cols[num_found_cols][2] = cols[i][2];
+
+          num_found_cols++;
+        }
+    }
+}
+
+static void
+generate_histogram_rgb_rows (gint           offset,
+                             gint           size,
+                             HistogramData *data)
 {
   GeglBufferIterator *iter;
-  const Babl         *format;
   GeglRectangle      *roi;
+  CFHistogram         histogram;
   ColorFreq          *colfreq;
+  guchar              cols[MAXNUMCOLORS + 1][3];
+  gint                n_cols = 0;
   gint                nfc_iter;
   gint                row, col, coledge;
-  gint                offsetx, offsety;
-  glong               layer_size;
-  glong               total_size = 0;
-  gint                count      = 0;
   gint                bpp;
   gboolean            has_alpha;
+  gboolean            dither_alpha;
+  gboolean            track_colors;
 
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
-
-  g_return_if_fail (format == babl_format ("R'G'B' u8") ||
-                    format == babl_format ("R'G'B'A u8"));
-
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
-
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
-
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+  bpp          = babl_format_get_bytes_per_pixel (data->format);
+  has_alpha    = babl_format_has_alpha (data->format);
+  dither_alpha = data->dither_alpha;
 
-  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
+  /*  a single part writes straight into the shared histogram, while
+   *  concurrent parts fill their own partial histogram and merge it
+   *  when done
+   */
+  if (size == data->height)
+    histogram = data->histogram;
+  else
+    histogram = g_new0 (ColorFreq,
+                        HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS);
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+  iter = gegl_buffer_iterator_new (data->buffer,
+                                   GEGL_RECTANGLE (0, offset,
+                                                   data->width, size),
+                                   0, data->format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
   roi = &iter->items[0].roi;
 
-  if (progress)
-    gimp_progress_set_value (progress, 0.0);
-
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *data   = iter->items[0].data;
+      const guchar *src    = iter->items[0].data;
       gint          length = iter->length;
 
-      total_size += length;
+      /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
+      col     = roi->x + data->offsetx;
+      coledge = col + roi->width;
+      row     = roi->y + data->offsety;
 
-      /* g_printerr (" [%d,%d - %d,%d]", srcPR.x, src_roi->y, offsetx, offsety); */
+      /* another part may already have found too many colors */
+      track_colors = g_atomic_int_get (&data->track_colors);
 
-      if (needs_quantize)
+      while (length--)
         {
-          if (dither_alpha)
-            {
-              /* if alpha-dithering,
-                 we need to be deterministic w.r.t. offsets */
-
-              col = roi->x + offsetx;
-              coledge = col + roi->width;
-              row = roi->y + offsety;
+          gboolean transparent = FALSE;
 
-              while (length--)
+          if (has_alpha)
+            {
+              if (dither_alpha)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (has_alpha &&
-                      data[ALPHA] <
+                  if (src[ALPHA] <
                       DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
                     transparent = TRUE;
-
-                  if (! transparent)
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
-                    }
-
-                  col++;
-                  if (col == coledge)
-                    {
-                      col = roi->x + offsetx;
-                      row++;
-                    }
-
-                  data += bpp;
                 }
-            }
-          else
-            {
-              while (length--)
+              else
                 {
-                  if ((has_alpha && ((data[ALPHA] > 127)))
-                      || (!has_alpha))
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
-                    }
-
-                  data += bpp;
+                  if (src[ALPHA] <= 127)
+                    transparent = TRUE;
                 }
             }
-        }
-      else
-        {
-          /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
-          col = roi->x + offsetx;
-          coledge = col + roi->width;
-          row = roi->y + offsety;
 
-          while (length--)
+          if (! transparent)
             {
-              gboolean transparent = FALSE;
+              colfreq = HIST_RGB (histogram,
+                                  src[RED],
+                                  src[GREEN],
+                                  src[BLUE]);
+              (*colfreq)++;
 
-              if (has_alpha)
+              if (track_colors)
                 {
-                  if (dither_alpha)
+                  for (nfc_iter = 0; nfc_iter < n_cols; nfc_iter++)
                     {
-                      if (data[ALPHA] <
-                          DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
-                        transparent = TRUE;
+                      if ((src[RED]   == cols[nfc_iter][0]) &&
+                          (src[GREEN] == cols[nfc_iter][1]) &&
+                          (src[BLUE]  == cols[nfc_iter][2]))
+                        break;
                     }
-                  else
-                    {
-                      if (data[ALPHA] <= 127)
-                        transparent = TRUE;
-                    }
-                }
 
-              if (! transparent)
-                {
-                  colfreq = HIST_RGB (histogram,
-                                      data[RED],
-                                      data[GREEN],
-                                      data[BLUE]);
-                  (*colfreq)++;
-
-                  if (!needs_quantize)
+                  if (nfc_iter == n_cols)
                     {
-                      for (nfc_iter = 0;
-                           nfc_iter < num_found_cols;
-                           nfc_iter++)
-                        {
-                          if ((data[RED]   == found_cols[nfc_iter][0]) &&
-                              (data[GREEN] == found_cols[nfc_iter][1]) &&
-                              (data[BLUE]  == found_cols[nfc_iter][2]))
-                            goto already_found;
-                        }
-
-                      /* Color was not in the table of
-                       * existing colors
-                       */
-
-                      num_found_cols++;
-
-                      if (num_found_cols > col_limit)
+                      if (n_cols == data->col_limit)
                         {
-                          /* There are more colors in the image than
-                           *  were allowed.  We switch to plain
-                           *  histogram calculation with a view to
-                           *  quantizing at a later stage.
+                          /* This part alone has more colors than
+                           * were allowed, so the whole image needs
+                           * to be quantized.
                            */
-                          needs_quantize = TRUE;
-                          /* g_print ("\nmax colors exceeded - needs quantize.\n");*/
-                          goto already_found;
+                          g_atomic_int_set (&data->track_colors, FALSE);
+                          track_colors = FALSE;
                         }
                       else
                         {
                           /* Remember the new color we just found.
                            */
-                          found_cols[num_found_cols-1][0] = data[RED];
-                          found_cols[num_found_cols-1][1] = data[GREEN];
-                          found_cols[num_found_cols-1][2] = data[BLUE];
+                          cols[n_cols][0] = src[RED];
+                          cols[n_cols][1] = src[GREEN];
+                          cols[n_cols][2] = src[BLUE];
+
+                          n_cols++;
                         }
                     }
                 }
-            already_found:
-
-              col++;
-              if (col == coledge)
-                {
-                  col = roi->x + offsetx;
-                  row++;
-                }
+            }
 
-              data += bpp;
+          col++;
+          if (col == coledge)
+            {
+              col = roi->x + data->offsetx;
+              row++;
             }
+
+          src += bpp;
         }
+    }
+
+  g_mutex_lock (&data->mutex);
+
+  if (! g_atomic_int_get (&data->track_colors))
+    needs_quantize = TRUE;
+  else
+    merge_found_cols (data, cols, n_cols);
+
+  if (histogram != data->histogram)
+    {
+      ColorFreq *dest = data->histogram;
+      gint       i;
 
-      if (progress && (count % 16 == 0))
-        gimp_progress_set_value (progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
+      for (i = 0; i < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; i++)
+        dest[i] += histogram[i];
     }
 
+  g_mutex_unlock (&data->mutex);
+
+  if (histogram != data->histogram)
+    g_free (histogram);
+}
+
+static void
+generate_histogram_rgb (CFHistogram   histogram,
+                        GimpLayer    *layer,
+                        gint          col_limit,
+                        gboolean      dither_alpha,
+                        GimpProgress *progress)
+{
+  HistogramData data = { 0, };
+  gint          min_rows;
+
+  data.format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+  g_return_if_fail (data.format == babl_format ("R'G'B' u8") ||
+                    data.format == babl_format ("R'G'B'A u8"));
+
+  data.histogram    = histogram;
+  data.buffer       = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.width        = gimp_item_get_width  (GIMP_ITEM (layer));
+  data.height       = gimp_item_get_height (GIMP_ITEM (layer));
+  data.col_limit    = col_limit;
+  data.dither_alpha = dither_alpha;
+  data.track_colors = ! needs_quantize;
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offsetx, &data.offsety);
+
+  if (data.width < 1 || data.height < 1)
+    return;
+
+  /*  each part but the first needs a partial histogram, which costs
+   *  memory and merging time, so only split layers which are large
+   *  enough, and into a bounded number of parts
+   */
+  min_rows = MAX (HISTOGRAM_PIXELS_PER_THREAD / data.width,
+                  (data.height + HISTOGRAM_MAX_THREADS - 1) /
+                  HISTOGRAM_MAX_THREADS);
+  min_rows = MAX (min_rows, 1);
+
+  g_mutex_init (&data.mutex);
+
+  if (progress)
+    gimp_progress_set_value (progress, 0.0);
+
+  gegl_parallel_distribute_range (
+    data.height, min_rows,
+    (GeglParallelDistributeRangeFunc) generate_histogram_rgb_rows,
+    &data);
+
+  if (progress)
+    gimp_progress_set_value (progress, 1.0);
+
+  g_mutex_clear (&data.mutex);
+
 /*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
 }
 
@@ -2689,38 +2821,34 @@ fill_inverse_cmap_gray (QuantizeObj *quantobj,
 }
 
 
-/* Fill the inverse-colormap entries in the update box that contains
- * histogram cell R/G/B.  (Only that one cell MUST be filled, but we
- * can fill as many others as we wish.)
+/* Find the nearest colormap entries for all cells in the update box
+ * that contains histogram cell R/G/B, and convert R/G/B to the base
+ * cell of that box.
  */
 static void
-fill_inverse_cmap_rgb (QuantizeObj *quantobj,
-                       CFHistogram  histogram,
-                       gint         R,
-                       gint         G,
-                       gint         B)
+find_inverse_cmap_rgb_box (QuantizeObj *quantobj,
+                           gint        *R,
+                           gint        *G,
+                           gint        *B,
+                           gint        *bestcolor)
 {
-  gint  minR, minG, minB; /* lower left corner of update box */
-  gint  iR, iG, iB;
-  gint *cptr;           /* pointer into bestcolor[] array */
+  gint minR, minG, minB; /* lower left corner of update box */
   /* This array lists the candidate colormap indexes. */
-  gint  colorlist[MAXNUMCOLORS];
-  gint  numcolors;                /* number of candidate colors */
-  /* This array holds the actually closest colormap index for each cell. */
-  gint  bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
+  gint colorlist[MAXNUMCOLORS];
+  gint numcolors;                 /* number of candidate colors */
 
   /* Convert cell coordinates to update box id */
-  R >>= BOX_R_LOG;
-  G >>= BOX_G_LOG;
-  B >>= BOX_B_LOG;
+  *R >>= BOX_R_LOG;
+  *G >>= BOX_G_LOG;
+  *B >>= BOX_B_LOG;
 
   /* Compute true coordinates of update box's origin corner.
    * Actually we compute the coordinates of the center of the corner
    * histogram cell, which are the lower bounds of the volume we care about.
    */
-  minR = (R << BOX_R_SHIFT) + ((1 << R_SHIFT) >> 1);
-  minG = (G << BOX_G_SHIFT) + ((1 << G_SHIFT) >> 1);
-  minB = (B << BOX_B_SHIFT) + ((1 << B_SHIFT) >> 1);
+  minR = (*R << BOX_R_SHIFT) + ((1 << R_SHIFT) >> 1);
+  minG = (*G << BOX_G_SHIFT) + ((1 << G_SHIFT) >> 1);
+  minB = (*B << BOX_B_SHIFT) + ((1 << B_SHIFT) >> 1);
 
   /* Determine which colormap entries are close enough to be candidates
    * for the nearest entry to some cell in the update box.
@@ -2731,10 +2859,31 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
   find_best_colors (quantobj, minR, minG, minB, numcolors, colorlist,
                     bestcolor);
 
+  *R <<= BOX_R_LOG;             /* convert id back to base cell indexes */
+  *G <<= BOX_G_LOG;
+  *B <<= BOX_B_LOG;
+}
+
+
+/* Fill the inverse-colormap entries in the update box that contains
+ * histogram cell R/G/B.  (Only that one cell MUST be filled, but we
+ * can fill as many others as we wish.)
+ */
+static void
+fill_inverse_cmap_rgb (QuantizeObj *quantobj,
+                       CFHistogram  histogram,
+                       gint         R,
+                       gint         G,
+                       gint         B)
+{
+  gint  iR, iG, iB;
+  gint *cptr;           /* pointer into bestcolor[] array */
+  /* This array holds the actually closest colormap index for each cell. */
+  gint  bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
+
+  find_inverse_cmap_rgb_box (quantobj, &R, &G, &B, bestcolor);
+
   /* Save the best color numbers (plus 1) in the main cache array */
-  R <<= BOX_R_LOG;              /* convert id back to base cell indexes */
-  G <<= BOX_G_LOG;
-  B <<= BOX_B_LOG;
   cptr = bestcolor;
   for (iR = 0; iR < BOX_R_ELEMS; iR++)
     {
@@ -2749,6 +2898,51 @@ fill_inverse_cmap_rgb (QuantizeObj *quantobj,
 }
 
 
+/* Look up the colormap index nearest to histogram cell R/G/B in
+ * quantobj->inverse_cmap, filling its update box first if needed.
+ * Unlike fill_inverse_cmap_rgb(), this may be called from several
+ * threads at once: threads racing to fill the same box store the
+ * same values.
+ */
+static inline gint
+lookup_inverse_cmap_rgb (QuantizeObj *quantobj,
+                         gint         R,
+                         gint         G,
+                         gint         B)
+{
+  gint *cachep = &quantobj->inverse_cmap[REF_FUNC (R, G, B)];
+  gint  value  = g_atomic_int_get (cachep);
+
+  if (value == 0)
+    {
+      gint  iR, iG, iB;
+      gint *cptr;
+      gint  bestcolor[BOX_R_ELEMS * BOX_G_ELEMS * BOX_B_ELEMS] = { 0, };
+
+      find_inverse_cmap_rgb_box (quantobj, &R, &G, &B, bestcolor);
+
+      cptr = bestcolor;
+      for (iR = 0; iR < BOX_R_ELEMS; iR++)
+        {
+          for (iG = 0; iG < BOX_G_ELEMS; iG++)
+            {
+              for (iB = 0; iB < BOX_B_ELEMS; iB++)
+                {
+                  g_atomic_int_set (&quantobj->inverse_cmap[REF_FUNC (R + iR,
+                                                                      G + iG,
+                                                                      B + iB)],
+                                    (*cptr++) + 1);
+                }
+            }
+        }
+
+      value = g_atomic_int_get (cachep);
+    }
+
+  return value - 1;
+}
+
+
 /*  This is pass 1  */
 
 static void
@@ -2825,9 +3019,11 @@ custompal_pass1 (QuantizeObj *quantobj)
  */
 
 static void
-median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
-                                 GimpLayer   *layer,
-                                 GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_gray_area (QuantizeObj         *quantobj,
+                                      GimpLayer           *layer,
+                                      GeglBuffer          *new_buffer,
+                                      const GeglRectangle *area,
+                                      gulong              *index_used_count)
 {
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
@@ -2838,7 +3034,6 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
   gint                src_bpp;
   gint                dest_bpp;
   gint                has_alpha;
-  gulong             *index_used_count = quantobj->index_used_count;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
 
@@ -2853,12 +3048,12 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
   has_alpha = babl_format_has_alpha (src_format);
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -2877,11 +3072,6 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
               gint pixel = src[GRAY];
 
               cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
 
               if (has_alpha)
                 {
@@ -2925,9 +3115,11 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
 }
 
 static void
-median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
-                                    GimpLayer   *layer,
-                                    GeglBuffer  *new_buffer)
+median_cut_pass2_fixed_dither_gray_area (QuantizeObj         *quantobj,
+                                         GimpLayer           *layer,
+                                         GeglBuffer          *new_buffer,
+                                         const GeglRectangle *area,
+                                         gulong              *index_used_count)
 {
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
@@ -2944,7 +3136,6 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
   gint                err2;
   Color              *color1;
   Color              *color2;
-  gulong             *index_used_count = quantobj->index_used_count;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
 
@@ -2959,12 +3150,12 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
   has_alpha = babl_format_has_alpha (src_format);
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -2988,11 +3179,6 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
               pixel = src[GRAY];
 
               cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
 
               pixval1 = *cachep - 1;
               color1 = &quantobj->cmap[pixval1];
@@ -3007,11 +3193,6 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
                       const gint R = CLAMP0255 (RV);
 
                       cachep = &histogram[R];
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_gray (quantobj, histogram, R);
 
                       pixval2 = *cachep - 1;
                       RV += re;
@@ -3093,13 +3274,13 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
 }
 
 static void
-median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
-                                GimpLayer   *layer,
-                                GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_rgb_area (QuantizeObj         *quantobj,
+                                     GimpLayer           *layer,
+                                     GeglBuffer          *new_buffer,
+                                     const GeglRectangle *area,
+                                     gulong              *index_used_count)
 {
   GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
   const Babl         *src_format;
   const Babl         *dest_format;
   GeglRectangle      *src_roi;
@@ -3113,10 +3294,6 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
   gint                alpha_pix        = ALPHA;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
 
   gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
 
@@ -3138,25 +3315,20 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
     }
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
@@ -3196,15 +3368,10 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
               rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
                           &R, &G, &B);
 
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
               /* Now emit the colormap index for this cell, barfbarf */
-              index_used_count[dest[INDEXED] = *cachep - 1]++;
+              index_used_count[dest[INDEXED] =
+                               lookup_inverse_cmap_rgb (quantobj,
+                                                        R, G, B)]++;
 
             next_pixel:
 
@@ -3212,21 +3379,17 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
               dest += dest_bpp;
             }
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (gdouble) total_size / (gdouble) layer_size);
     }
 }
 
 static void
-median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
-                                   GimpLayer   *layer,
-                                   GeglBuffer  *new_buffer)
+median_cut_pass2_fixed_dither_rgb_area (QuantizeObj         *quantobj,
+                                        GimpLayer           *layer,
+                                        GeglBuffer          *new_buffer,
+                                        const GeglRectangle *area,
+                                        gulong              *index_used_count)
 {
   GeglBufferIterator *iter;
-  CFHistogram         histogram = quantobj->histogram;
-  ColorFreq          *cachep;
   const Babl         *src_format;
   const Babl         *dest_format;
   GeglRectangle      *src_roi;
@@ -3246,10 +3409,6 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
   gint                alpha_pix        = ALPHA;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
-  gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
 
   gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
 
@@ -3271,25 +3430,20 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
     }
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
@@ -3330,13 +3484,6 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
               rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
                           &R, &G, &B);
 
-              cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
               /* We now try to find a color which, when mixed in some
                * fashion with the closest match, yields something
                * closer to the desired color.  We do this by
@@ -3346,7 +3493,7 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                * intended color to determine their relative
                * probabilities of being chosen.
                */
-              pixval1 = *cachep - 1;
+              pixval1 = lookup_inverse_cmap_rgb (quantobj, R, G, B);
               color1 = &quantobj->cmap[pixval1];
 
               if (quantobj->actual_number_of_colors > 2)
@@ -3365,14 +3512,7 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                                   (CLAMP0255(BV)),
                                   &R, &G, &B);
 
-                      cachep = HIST_LIN (histogram, R, G, B);
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
-
-                      pixval2 = *cachep - 1;
+                      pixval2 = lookup_inverse_cmap_rgb (quantobj, R, G, B);
                       RV += re;  GV += ge;  BV += be;
                     }
                   while ((pixval1 == pixval2) &&
@@ -3444,13 +3584,121 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
               dest += dest_bpp;
             }
         }
+    }
+}
 
-      if (quantobj->progress && (count % 16 == 0))
-        gimp_progress_set_value (quantobj->progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
+static void
+median_cut_pass2_area (const GeglRectangle *area,
+                       Pass2Data           *data)
+{
+  gulong index_used_count[256] = { 0, };
+  gint   i;
+
+  data->func (data->quantobj, data->layer, data->new_buffer,
+              area, index_used_count);
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < 256; i++)
+    data->quantobj->index_used_count[i] += index_used_count[i];
+
+  g_mutex_unlock (&data->mutex);
+}
+
+/* Runs a pass2 function which has no inter-pixel dependencies, i.e.
+ * anything but error diffusion, over the layer tile-parallel.
+ */
+static void
+median_cut_pass2_parallel (QuantizeObj   *quantobj,
+                           GimpLayer     *layer,
+                           GeglBuffer    *new_buffer,
+                           Pass2AreaFunc  func)
+{
+  Pass2Data data;
+
+  data.quantobj   = quantobj;
+  data.layer      = layer;
+  data.new_buffer = new_buffer;
+  data.func       = func;
+
+  g_mutex_init (&data.mutex);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (new_buffer), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) median_cut_pass2_area,
+    &data);
+
+  g_mutex_clear (&data.mutex);
+}
+
+/* The gray inverse colormap is tiny, so fill all of it up front,
+ * leaving it read-only while the layer is mapped in parallel.
+ */
+static void
+fill_inverse_cmap_gray_all (QuantizeObj *quantobj)
+{
+  gint pixel;
+
+  for (pixel = 0; pixel < 256; pixel++)
+    {
+      if (quantobj->histogram[pixel] == 0)
+        fill_inverse_cmap_gray (quantobj, quantobj->histogram, pixel);
     }
 }
 
+static void
+median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
+                                 GimpLayer   *layer,
+                                 GeglBuffer  *new_buffer)
+{
+  fill_inverse_cmap_gray_all (quantobj);
+
+  median_cut_pass2_parallel (quantobj, layer, new_buffer,
+                             median_cut_pass2_no_dither_gray_area);
+}
+
+static void
+median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
+                                    GimpLayer   *layer,
+                                    GeglBuffer  *new_buffer)
+{
+  fill_inverse_cmap_gray_all (quantobj);
+
+  median_cut_pass2_parallel (quantobj, layer, new_buffer,
+                             median_cut_pass2_fixed_dither_gray_area);
+}
+
+static void
+median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
+                                GimpLayer   *layer,
+                                GeglBuffer  *new_buffer)
+{
+  if (! quantobj->inverse_cmap)
+    quantobj->inverse_cmap = g_new0 (gint,
+                                     HIST_R_ELEMS *
+                                     HIST_G_ELEMS *
+                                     HIST_B_ELEMS);
+
+  median_cut_pass2_parallel (quantobj, layer, new_buffer,
+                             median_cut_pass2_no_dither_rgb_area);
+}
+
+static void
+median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
+                                   GimpLayer   *layer,
+                                   GeglBuffer  *new_buffer)
+{
+  if (! quantobj->inverse_cmap)
+    quantobj->inverse_cmap = g_new0 (gint,
+                                     HIST_R_ELEMS *
+                                     HIST_G_ELEMS *
+                                     HIST_B_ELEMS);
+
+  median_cut_pass2_parallel (quantobj, layer, new_buffer,
+                             median_cut_pass2_fixed_dither_rgb_area);
+}
+
 static void
 median_cut_pass2_nodestruct_dither_rgb (QuantizeObj *quantobj,
                                         GimpLayer   *layer,
@@ -4295,6 +4543,7 @@ static void
 delete_median_cut (QuantizeObj *quantobj)
 {
   g_free (quantobj->histogram);
+  g_free (quantobj->inverse_cmap);
   g_free (quantobj);
 }
 
@@ -4343,6 +4592,8 @@ initialize_median_cut (GimpImageBaseType       type,
   /* Initialize the data structures */
   quantobj = g_new (QuantizeObj, 1);
 
+  quantobj->inverse_cmap = NULL;
+
   if (type == GIMP_GRAY && palette_type == GIMP_CONVERT_PALETTE_GENERATE)
     quantobj->histogram = g_new (ColorFreq, 256);
   else
@@ -530,14 +530,19 @@ gimp_image_undo_free_space (GimpImage *image)
 #ifdef DEBUG_IMAGE_UNDO
   g_printerr ("undo_steps: %d    undo_bytes: %ld\n",
               gimp_container_get_n_children (container),
-              (glong) gimp_object_get_memsize (GIMP_OBJECT (container), NULL));
+              (glong) gimp_object_get_memsize (GIMP_OBJECT (private->undo_stack),
+                                               NULL));
 #endif
 
   /*  keep at least min_undo_levels undo steps  */
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
 
-  while ((gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size) ||
+  /*  the stack keeps a running total of its undos' sizes, so this
+   *  doesn't walk the whole history
+   */
+  while ((gimp_object_get_memsize (GIMP_OBJECT (private->undo_stack),
+                                   NULL) > undo_size) ||
          (gimp_container_get_n_children (container) > max_undo_levels))
     {
       GimpUndo *freed = gimp_undo_stack_free_bottom (private->undo_stack,
@@ -546,7 +551,7 @@ gimp_image_undo_free_space (GimpImage *image)
 #ifdef DEBUG_IMAGE_UNDO
       g_printerr ("freed one step: undo_steps: %d    undo_bytes: %ld\n",
                   gimp_container_get_n_children (container),
-                  (glong) gimp_object_get_memsize (GIMP_OBJECT (container),
+                  (glong) gimp_object_get_memsize (GIMP_OBJECT (private->undo_stack),
                                                    NULL));
 #endif
 
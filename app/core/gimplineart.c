@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
@@ -45,6 +47,11 @@
 
 #include "gimp-intl.h"
 
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
 enum
 {
   COMPUTING_START,
@@ -77,6 +84,12 @@ struct _GimpLineArtPrivate
   GeglBuffer   *closed;
   gfloat       *distmap;
 
+  /* The binarized strokes and closed line art of the last complete
+   * computation, reused as long as the strokes don't change.
+   */
+  GeglBuffer   *cached_strokes;
+  GeglBuffer   *cached_closed;
+
   /* Used in the closing step. */
   gboolean      select_transparent;
   gdouble       threshold;
@@ -92,6 +105,9 @@ typedef struct
 {
   GeglBuffer  *buffer;
 
+  GeglBuffer  *cached_strokes;
+  GeglBuffer  *cached_closed;
+
   gboolean     select_transparent;
   gdouble      threshold;
   gint         spline_max_len;
@@ -100,6 +116,7 @@ typedef struct
 
 typedef struct
 {
+  GeglBuffer *strokes;
   GeglBuffer *closed;
   gfloat     *distmap;
 } LineArtResult;
@@ -143,6 +160,17 @@ typedef struct _Edgel
   guint     next, previous;
 } Edgel;
 
+typedef struct
+{
+  GArray       *set;
+  const gfloat *weights;
+  gint          mask_size;
+  gfloat       *normals;
+  gint          width;
+  gfloat       *smoothed_curvatures;
+  GimpAsync    *async;
+} EdgelSetData;
+
 
 static void            gimp_line_art_finalize                  (GObject               *object);
 static void            gimp_line_art_set_property              (GObject                *object,
@@ -156,6 +184,7 @@ static void            gimp_line_art_get_property              (GObject
 
 /* Functions for asynchronous computation. */
 
+static void            gimp_line_art_reset                     (GimpLineArt            *line_art);
 static void            gimp_line_art_compute                   (GimpLineArt            *line_art);
 static void            gimp_line_art_compute_cb                (GimpAsync              *async,
                                                                 GimpLineArt            *line_art);
@@ -167,7 +196,8 @@ static void            gimp_line_art_prepare_async_func        (GimpAsync
 static LineArtData   * line_art_data_new                       (GeglBuffer             *buffer,
                                                                 GimpLineArt            *line_art);
 static void            line_art_data_free                      (LineArtData            *data);
-static LineArtResult * line_art_result_new                     (GeglBuffer             *line_art,
+static LineArtResult * line_art_result_new                     (GeglBuffer             *strokes,
+                                                                GeglBuffer             *line_art,
                                                                 gfloat                 *distmap);
 static void            line_art_result_free                    (LineArtResult          *result);
 
@@ -178,9 +208,19 @@ static void            gimp_line_art_input_invalidate_preview  (GimpViewable
 
 /* All actual computation functions. */
 
-static GeglBuffer    * gimp_line_art_close                     (GeglBuffer             *buffer,
+static GeglBuffer    * gimp_line_art_binarize                  (GeglBuffer             *buffer,
                                                                 gboolean                select_transparent,
                                                                 gdouble                 stroke_threshold,
+                                                                GimpAsync              *async);
+static gboolean        gimp_line_art_strokes_changed           (GeglBuffer             *strokes,
+                                                                GeglBuffer             *cached_strokes,
+                                                                GimpAsync              *async);
+static GeglBuffer    * gimp_line_art_close_default             (GeglBuffer             *strokes,
+                                                                LineArtData            *data,
+                                                                GimpAsync              *async);
+static gfloat        * gimp_line_art_compute_distmap           (GeglBuffer             *closed);
+
+static GeglBuffer    * gimp_line_art_close                     (GeglBuffer             *binarized,
                                                                 gint                    spline_max_length,
                                                                 gint                    segment_max_length,
                                                                 gint                    minimal_lineart_area,
@@ -193,7 +233,6 @@ static GeglBuffer    * gimp_line_art_close                     (GeglBuffer
                                                                 gint                    created_regions_significant_area,
                                                                 gint                    created_regions_minimum_area,
                                                                 gboolean                small_segments_from_spline_sources,
-                                                                gfloat                **lineart_distmap,
                                                                 GimpAsync              *async);
 
 static void            gimp_lineart_denoise                    (GeglBuffer             *buffer,
@@ -398,6 +437,7 @@ gimp_line_art_set_property (GObject      *object,
       if (line_art->priv->select_transparent != g_value_get_boolean (value))
         {
           line_art->priv->select_transparent = g_value_get_boolean (value);
+          gimp_line_art_reset (line_art);
           gimp_line_art_compute (line_art);
         }
       break;
@@ -408,6 +448,7 @@ gimp_line_art_set_property (GObject      *object,
       if (line_art->priv->threshold != g_value_get_double (value))
         {
           line_art->priv->threshold = g_value_get_double (value);
+          gimp_line_art_reset (line_art);
           gimp_line_art_compute (line_art);
         }
       break;
@@ -417,6 +458,7 @@ gimp_line_art_set_property (GObject      *object,
           line_art->priv->spline_max_len = g_value_get_int (value);
           if (line_art->priv->max_len_bound)
             line_art->priv->segment_max_len = line_art->priv->spline_max_len;
+          gimp_line_art_reset (line_art);
           gimp_line_art_compute (line_art);
         }
       break;
@@ -426,6 +468,7 @@ gimp_line_art_set_property (GObject      *object,
           line_art->priv->segment_max_len = g_value_get_int (value);
           if (line_art->priv->max_len_bound)
             line_art->priv->spline_max_len = line_art->priv->segment_max_len;
+          gimp_line_art_reset (line_art);
           gimp_line_art_compute (line_art);
         }
       break;
@@ -497,6 +540,7 @@ gimp_line_art_set_input (GimpLineArt  *line_art,
 
       line_art->priv->input = pickable;
 
+      gimp_line_art_reset (line_art);
       gimp_line_art_compute (line_art);
 
       if (pickable)
@@ -563,6 +607,17 @@ gimp_line_art_get (GimpLineArt  *line_art,
 
 /* Functions for asynchronous computation. */
 
+/* Drops the cached result of the last computation, so that the next
+ * one starts from scratch.  Must be called whenever the input or any
+ * closure parameter changes.
+ */
+static void
+gimp_line_art_reset (GimpLineArt *line_art)
+{
+  g_clear_object (&line_art->priv->cached_strokes);
+  g_clear_object (&line_art->priv->cached_closed);
+}
+
 static void
 gimp_line_art_compute (GimpLineArt *line_art)
 {
@@ -631,6 +686,9 @@ gimp_line_art_compute_cb (GimpAsync   *async,
       line_art->priv->closed  = g_object_ref (result->closed);
       line_art->priv->distmap = result->distmap;
       result->distmap  = NULL;
+
+      g_set_object (&line_art->priv->cached_strokes, result->strokes);
+      g_set_object (&line_art->priv->cached_closed,  result->closed);
       g_signal_emit (line_art, gimp_line_art_signals[COMPUTING_END], 0);
     }
 
@@ -667,6 +725,7 @@ static void
 gimp_line_art_prepare_async_func (GimpAsync   *async,
                                   LineArtData *data)
 {
+  GeglBuffer *strokes = NULL;
   GeglBuffer *closed  = NULL;
   gfloat     *distmap = NULL;
   gboolean    has_alpha;
@@ -725,42 +784,51 @@ gimp_line_art_prepare_async_func (GimpAsync   *async,
    */
   GIMP_TIMER_START();
 
-  closed = gimp_line_art_close (data->buffer,
-                                select_transparent,
-                                data->threshold,
-                                data->spline_max_len,
-                                data->segment_max_len,
-                                /*minimal_lineart_area,*/
-                                5,
-                                /*normal_estimate_mask_size,*/
-                                5,
-                                /*end_point_rate,*/
-                                0.85,
-                                /*spline_max_angle,*/
-                                90.0,
-                                /*end_point_connectivity,*/
-                                2,
-                                /*spline_roundness,*/
-                                1.0,
-                                /*allow_self_intersections,*/
-                                TRUE,
-                                /*created_regions_significant_area,*/
-                                4,
-                                /*created_regions_minimum_area,*/
-                                100,
-                                /*small_segments_from_spline_sources,*/
-                                TRUE,
-                                &distmap,
-                                async);
+  strokes = gimp_line_art_binarize (data->buffer, select_transparent,
+                                    data->threshold, async);
+
+  if (gimp_async_is_stopped (async))
+    {
+      g_clear_object (&strokes);
+      line_art_data_free (data);
+
+      return;
+    }
+
+  /* The closure is not local: which splines and segments are kept
+   * depends on the regions they create, and on the ones kept before
+   * them, anywhere in the image.  The cached result is therefore only
+   * reused when the strokes didn't change at all.
+   */
+  if (data->cached_strokes && data->cached_closed &&
+      gegl_rectangle_equal (gegl_buffer_get_extent (strokes),
+                            gegl_buffer_get_extent (data->cached_strokes)) &&
+      ! gimp_line_art_strokes_changed (strokes, data->cached_strokes, async) &&
+      ! gimp_async_is_stopped (async))
+    {
+      closed = g_object_ref (data->cached_closed);
+    }
+
+  if (! closed && ! gimp_async_is_stopped (async))
+    closed = gimp_line_art_close_default (strokes, data, async);
+
+  if (closed && ! gimp_async_is_stopped (async))
+    distmap = gimp_line_art_compute_distmap (closed);
 
   GIMP_TIMER_END("close line-art");
 
   if (! gimp_async_is_stopped (async))
     {
       gimp_async_finish_full (async,
-                              line_art_result_new (closed, distmap),
+                              line_art_result_new (strokes, closed, distmap),
                               (GDestroyNotify) line_art_result_free);
     }
+  else
+    {
+      g_clear_object (&closed);
+    }
+
+  g_object_unref (strokes);
 
   line_art_data_free (data);
 }
@@ -772,6 +840,12 @@ line_art_data_new (GeglBuffer  *buffer,
   LineArtData *data = g_slice_new (LineArtData);
 
   data->buffer             = g_object_ref (buffer);
+  data->cached_strokes     = line_art->priv->cached_strokes ?
+                             g_object_ref (line_art->priv->cached_strokes) :
+                             NULL;
+  data->cached_closed      = line_art->priv->cached_closed ?
+                             g_object_ref (line_art->priv->cached_closed) :
+                             NULL;
   data->select_transparent = line_art->priv->select_transparent;
   data->threshold          = line_art->priv->threshold;
   data->spline_max_len     = line_art->priv->spline_max_len;
@@ -784,17 +858,21 @@ static void
 line_art_data_free (LineArtData *data)
 {
   g_object_unref (data->buffer);
+  g_clear_object (&data->cached_strokes);
+  g_clear_object (&data->cached_closed);
 
   g_slice_free (LineArtData, data);
 }
 
 static LineArtResult *
-line_art_result_new (GeglBuffer *closed,
+line_art_result_new (GeglBuffer *strokes,
+                     GeglBuffer *closed,
                      gfloat     *distmap)
 {
   LineArtResult *data;
 
   data = g_slice_new (LineArtResult);
+  data->strokes = g_object_ref (strokes);
   data->closed  = closed;
   data->distmap = distmap;
 
@@ -804,6 +882,7 @@ line_art_result_new (GeglBuffer *closed,
 static void
 line_art_result_free (LineArtResult *data)
 {
+  g_object_unref (data->strokes);
   g_object_unref (data->closed);
   g_clear_pointer (&data->distmap, g_free);
 
@@ -835,13 +914,343 @@ gimp_line_art_input_invalidate_preview (GimpViewable *viewable,
 
 /* All actual computation functions. */
 
+typedef struct
+{
+  GeglBuffer *buffer;
+  gboolean    select_transparent;
+  guchar      threshold;
+  gint        max_value;
+  GimpAsync  *async;
+} LineArtBinarizeData;
+
+static void
+gimp_line_art_max_value_area (const GeglRectangle *area,
+                              LineArtBinarizeData *data)
+{
+  GeglBufferIterator *gi;
+  gint                max_value = 0;
+  gint                old_max;
+
+  gi = gegl_buffer_iterator_new (data->buffer, area, 0, NULL,
+                                 GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
+  while (gegl_buffer_iterator_next (gi))
+    {
+      guchar *p = (guchar*) gi->items[0].data;
+      gint    k;
+
+      if (gimp_async_is_canceled (data->async))
+        {
+          gegl_buffer_iterator_stop (gi);
+
+          return;
+        }
+
+      for (k = 0; k < gi->length; k++)
+        {
+          if (*p > max_value)
+            max_value = *p;
+          p++;
+        }
+    }
+
+  do
+    {
+      old_max = g_atomic_int_get (&data->max_value);
+    }
+  while (max_value > old_max &&
+         ! g_atomic_int_compare_and_exchange (&data->max_value,
+                                              old_max, max_value));
+}
+
+static void
+gimp_line_art_threshold_area (const GeglRectangle *area,
+                              LineArtBinarizeData *data)
+{
+  GeglBufferIterator *gi;
+  const guchar        max_value = data->max_value;
+
+  gi = gegl_buffer_iterator_new (data->buffer, area, 0, NULL,
+                                 GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE, 1);
+  while (gegl_buffer_iterator_next (gi))
+    {
+      guchar *p = (guchar*) gi->items[0].data;
+      gint    k;
+
+      if (gimp_async_is_canceled (data->async))
+        {
+          gegl_buffer_iterator_stop (gi);
+
+          return;
+        }
+
+      for (k = 0; k < gi->length; k++)
+        {
+          if (! data->select_transparent)
+            /* Negate the value. */
+            *p = max_value - *p;
+          /* Apply a threshold. */
+          if (*p > data->threshold)
+            *p = 1;
+          else
+            *p = 0;
+          p++;
+        }
+    }
+}
+
 /**
- * gimp_line_art_close:
+ * gimp_line_art_binarize:
  * @buffer: the input #GeglBuffer.
  * @select_transparent: whether we binarize the alpha channel or the
  *                      luminosity.
  * @stroke_threshold: [0-1] threshold value for detecting stroke pixels
  *                    (higher values will detect more stroke pixels).
+ * @async: the #GimpAsync associated with the computation
+ *
+ * Creates a binarized version of the strokes of @buffer, detected either
+ * with luminosity (light means background) or alpha values depending on
+ * @select_transparent.
+ *
+ * Returns: a new #GeglBuffer of format "Y' u8" where 1 is stroke and 0
+ *          is background.
+ */
+static GeglBuffer *
+gimp_line_art_binarize (GeglBuffer *buffer,
+                        gboolean    select_transparent,
+                        gdouble     stroke_threshold,
+                        GimpAsync  *async)
+{
+  const Babl          *gray_format;
+  GeglBuffer          *strokes;
+  LineArtBinarizeData  data;
+
+  if (select_transparent)
+    /* Keep alpha channel as gray levels */
+    gray_format = babl_format ("A u8");
+  else
+    /* Keep luminance */
+    gray_format = babl_format ("Y' u8");
+
+  /* Transform the line art from any format to gray. */
+  strokes = gegl_buffer_new (gegl_buffer_get_extent (buffer),
+                             gray_format);
+  gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE, strokes, NULL);
+  gegl_buffer_set_format (strokes, babl_format ("Y' u8"));
+
+  data.buffer             = strokes;
+  data.select_transparent = select_transparent;
+  data.threshold          = (guchar) (255.0f * (1.0f - stroke_threshold));
+  data.max_value          = 0;
+  data.async              = async;
+
+  if (! select_transparent)
+    {
+      /* Compute the biggest value */
+      gegl_parallel_distribute_area (
+        gegl_buffer_get_extent (strokes), PIXELS_PER_THREAD,
+        GEGL_SPLIT_STRATEGY_AUTO,
+        (GeglParallelDistributeAreaFunc) gimp_line_art_max_value_area,
+        &data);
+
+      if (gimp_async_is_canceled (async))
+        {
+          gimp_async_abort (async);
+
+          return strokes;
+        }
+    }
+
+  /* Make the image binary: 1 is stroke, 0 background */
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (strokes), PIXELS_PER_THREAD,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) gimp_line_art_threshold_area,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    gimp_async_abort (async);
+
+  return strokes;
+}
+
+typedef struct
+{
+  GeglBuffer *strokes;
+  GeglBuffer *cached_strokes;
+  gint        changed;
+  GimpAsync  *async;
+} LineArtCompareData;
+
+static void
+gimp_line_art_strokes_changed_func (const GeglRectangle *area,
+                                    LineArtCompareData  *data)
+{
+  GeglBufferIterator *gi;
+
+  gi = gegl_buffer_iterator_new (data->strokes, area, 0, NULL,
+                                 GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
+  gegl_buffer_iterator_add (gi, data->cached_strokes, area, 0, NULL,
+                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (gi))
+    {
+      if (g_atomic_int_get (&data->changed) ||
+          gimp_async_is_canceled (data->async))
+        {
+          gegl_buffer_iterator_stop (gi);
+
+          return;
+        }
+
+      if (memcmp (gi->items[0].data, gi->items[1].data, gi->length))
+        {
+          g_atomic_int_set (&data->changed, TRUE);
+
+          gegl_buffer_iterator_stop (gi);
+
+          return;
+        }
+    }
+}
+
+/* Returns whether @strokes differ from @cached_strokes, comparing them
+ * tile by tile.
+ */
+static gboolean
+gimp_line_art_strokes_changed (GeglBuffer *strokes,
+                               GeglBuffer *cached_strokes,
+                               GimpAsync  *async)
+{
+  LineArtCompareData data;
+  gint               tile_width;
+  gint               tile_height;
+
+  data.strokes        = strokes;
+  data.cached_strokes = cached_strokes;
+  data.changed        = FALSE;
+  data.async          = async;
+
+  g_object_get (strokes,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  gegl_parallel_distribute_area (
+    gegl_buffer_get_extent (strokes), tile_width * tile_height,
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) gimp_line_art_strokes_changed_func,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_async_abort (async);
+
+      return FALSE;
+    }
+
+  return data.changed;
+}
+
+static GeglBuffer *
+gimp_line_art_close_default (GeglBuffer  *strokes,
+                             LineArtData *data,
+                             GimpAsync   *async)
+{
+  return gimp_line_art_close (strokes,
+                              data->spline_max_len,
+                              data->segment_max_len,
+                              /*minimal_lineart_area,*/
+                              5,
+                              /*normal_estimate_mask_size,*/
+                              5,
+                              /*end_point_rate,*/
+                              0.85,
+                              /*spline_max_angle,*/
+                              90.0,
+                              /*end_point_connectivity,*/
+                              2,
+                              /*spline_roundness,*/
+                              1.0,
+                              /*allow_self_intersections,*/
+                              TRUE,
+                              /*created_regions_significant_area,*/
+                              4,
+                              /*created_regions_minimum_area,*/
+                              100,
+                              /*small_segments_from_spline_sources,*/
+                              TRUE,
+                              async);
+}
+
+/* Computes the distance map of the closed line art pixels, which is
+ * needed for flooding.
+ */
+static gfloat *
+gimp_line_art_compute_distmap (GeglBuffer *closed)
+{
+  GeglNode *graph;
+  GeglNode *input;
+  GeglNode *op;
+  gfloat   *distmap;
+
+  distmap = g_new (gfloat, gegl_buffer_get_width (closed) *
+                           gegl_buffer_get_height (closed));
+
+  graph = gegl_node_new ();
+  input = gegl_node_new_child (graph,
+                               "operation", "gegl:buffer-source",
+                               "buffer", closed,
+                               NULL);
+  op  = gegl_node_new_child (graph,
+                             "operation", "gegl:distance-transform",
+                             "metric",    GEGL_DISTANCE_METRIC_EUCLIDEAN,
+                             "normalize", FALSE,
+                             NULL);
+  gegl_node_connect_to (input, "output",
+                        op, "input");
+  gegl_node_blit (op, 1.0, gegl_buffer_get_extent (closed),
+                  NULL, distmap,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+  g_object_unref (graph);
+
+  return distmap;
+}
+
+typedef struct
+{
+  gfloat    *curvatures;
+  gfloat    *smoothed_curvatures;
+  gfloat    *radii;
+  gint       width;
+  gfloat     threshold;
+  gfloat     clamped_threshold;
+  GimpAsync *async;
+} LineArtEndPointsData;
+
+static void
+gimp_line_art_end_points_range (gint                  offset,
+                                gint                  size,
+                                LineArtEndPointsData *data)
+{
+  gint i;
+
+  if (gimp_async_is_canceled (data->async))
+    return;
+
+  for (i = offset * data->width; i < (offset + size) * data->width; i++)
+    {
+      if (data->smoothed_curvatures[i] >= (data->threshold / MAX (1.0f, data->radii[i])) ||
+          data->curvatures[i] >= data->clamped_threshold)
+        data->curvatures[i] = 1.0;
+      else
+        data->curvatures[i] = 0.0;
+    }
+}
+
+/**
+ * gimp_line_art_close:
+ * @binarized: the binarized strokes, as returned by
+ *             gimp_line_art_binarize().
  * @spline_max_length: the maximum length for creating splines between
  *                     end points.
  * @segment_max_length: the maximum length for creating segments
@@ -861,12 +1270,9 @@ gimp_line_art_input_invalidate_preview (GimpViewable *viewable,
  * @created_regions_significant_area:
  * @created_regions_minimum_area:
  * @small_segments_from_spline_sources:
- * @closed_distmap: a distance map of the closed line art pixels.
  * @async: the #GimpAsync associated with the computation
  *
- * Creates a binarized version of the strokes of @buffer, detected either
- * with luminosity (light means background) or alpha values depending on
- * @select_transparent. This binary version of the strokes will have closed
+ * Creates a version of the binarized @strokes which will have closed
  * regions allowing adequate selection of "nearly closed regions".
  * This algorithm is meant for digital painting (and in particular on the
  * sketch-only step), and therefore will likely produce unexpected results on
@@ -878,14 +1284,10 @@ gimp_line_art_input_invalidate_preview (GimpViewable *viewable,
  * https://hal.archives-ouvertes.fr/hal-01891876
  *
  * Returns: a new #GeglBuffer of format "Y u8" representing the
- *          binarized @line_art. If @lineart_distmap is not #NULL, a
- *          newly allocated float buffer is returned, which can be used
- *          for overflowing created masks later.
+ *          binarized @line_art.
  */
 static GeglBuffer *
-gimp_line_art_close (GeglBuffer  *buffer,
-                     gboolean     select_transparent,
-                     gdouble      stroke_threshold,
+gimp_line_art_close (GeglBuffer  *binarized,
                      gint         spline_max_length,
                      gint         segment_max_length,
                      gint         minimal_lineart_area,
@@ -898,89 +1300,16 @@ gimp_line_art_close (GeglBuffer  *buffer,
                      gint         created_regions_significant_area,
                      gint         created_regions_minimum_area,
                      gboolean     small_segments_from_spline_sources,
-                     gfloat     **closed_distmap,
                      GimpAsync   *async)
 {
-  const Babl         *gray_format;
-  GeglBufferIterator *gi;
-  GeglBuffer         *closed  = NULL;
-  GeglBuffer         *strokes = NULL;
-  guchar              max_value = 0;
-  gint                width  = gegl_buffer_get_width (buffer);
-  gint                height = gegl_buffer_get_height (buffer);
-  gint                i;
-
-  if (select_transparent)
-    /* Keep alpha channel as gray levels */
-    gray_format = babl_format ("A u8");
-  else
-    /* Keep luminance */
-    gray_format = babl_format ("Y' u8");
-
-  /* Transform the line art from any format to gray. */
-  strokes = gegl_buffer_new (gegl_buffer_get_extent (buffer),
-                             gray_format);
-  gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE, strokes, NULL);
-  gegl_buffer_set_format (strokes, babl_format ("Y' u8"));
-
-  if (! select_transparent)
-    {
-      /* Compute the biggest value */
-      gi = gegl_buffer_iterator_new (strokes, NULL, 0, NULL,
-                                     GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
-      while (gegl_buffer_iterator_next (gi))
-        {
-          guchar *data = (guchar*) gi->items[0].data;
-          gint    k;
-
-          if (gimp_async_is_canceled (async))
-            {
-              gegl_buffer_iterator_stop (gi);
-
-              gimp_async_abort (async);
-
-              goto end1;
-            }
-
-          for (k = 0; k < gi->length; k++)
-            {
-              if (*data > max_value)
-                max_value = *data;
-              data++;
-            }
-        }
-    }
-
-  /* Make the image binary: 1 is stroke, 0 background */
-  gi = gegl_buffer_iterator_new (strokes, NULL, 0, NULL,
-                                 GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE, 1);
-  while (gegl_buffer_iterator_next (gi))
-    {
-      guchar *data = (guchar*) gi->items[0].data;
-      gint    k;
-
-      if (gimp_async_is_canceled (async))
-        {
-          gegl_buffer_iterator_stop (gi);
-
-          gimp_async_abort (async);
-
-          goto end1;
-        }
+  GeglBuffer *closed  = NULL;
+  GeglBuffer *strokes = NULL;
+  gint        width   = gegl_buffer_get_width (binarized);
+  gint        height  = gegl_buffer_get_height (binarized);
+  gint        i;
 
-      for (k = 0; k < gi->length; k++)
-        {
-          if (! select_transparent)
-            /* Negate the value. */
-            *data = max_value - *data;
-          /* Apply a threshold. */
-          if (*data > (guchar) (255.0f * (1.0f - stroke_threshold)))
-            *data = 1;
-          else
-            *data = 0;
-          data++;
-        }
-    }
+  /* Denoising modifies the strokes in place. */
+  strokes = gegl_buffer_dup (binarized);
 
   /* Denoise (remove small connected components) */
   gimp_lineart_denoise (strokes, minimal_lineart_area, async);
@@ -991,16 +1320,17 @@ gimp_line_art_close (GeglBuffer  *buffer,
 
   if (spline_max_length > 0 || segment_max_length > 0)
     {
-      GArray     *keypoints           = NULL;
-      GHashTable *visited             = NULL;
-      gfloat     *radii               = NULL;
-      gfloat     *normals             = NULL;
-      gfloat     *curvatures          = NULL;
-      gfloat     *smoothed_curvatures = NULL;
-      gfloat      threshold;
-      gfloat      clamped_threshold;
-      GList      *fill_pixels         = NULL;
-      GList      *iter;
+      GArray               *keypoints           = NULL;
+      GHashTable           *visited             = NULL;
+      gfloat               *radii               = NULL;
+      gfloat               *normals             = NULL;
+      gfloat               *curvatures          = NULL;
+      gfloat               *smoothed_curvatures = NULL;
+      gfloat                threshold;
+      gfloat                clamped_threshold;
+      GList                *fill_pixels         = NULL;
+      GList                *iter;
+      LineArtEndPointsData  end_points;
 
       normals             = g_new0 (gfloat, width * height * 2);
       curvatures          = g_new0 (gfloat, width * height);
@@ -1019,25 +1349,25 @@ gimp_line_art_close (GeglBuffer  *buffer,
         goto end2;
       threshold = 1.0f - end_point_rate;
       clamped_threshold = MAX (0.25f, threshold);
-      for (i = 0; i < width; i++)
-        {
-          gint j;
 
-          if (gimp_async_is_canceled (async))
-            {
-              gimp_async_abort (async);
+      end_points.curvatures          = curvatures;
+      end_points.smoothed_curvatures = smoothed_curvatures;
+      end_points.radii               = radii;
+      end_points.width               = width;
+      end_points.threshold           = threshold;
+      end_points.clamped_threshold   = clamped_threshold;
+      end_points.async               = async;
 
-              goto end2;
-            }
+      gegl_parallel_distribute_range (
+        height, PIXELS_PER_THREAD / width,
+        (GeglParallelDistributeRangeFunc) gimp_line_art_end_points_range,
+        &end_points);
 
-          for (j = 0; j < height; j++)
-            {
-              if (smoothed_curvatures[i + j * width] >= (threshold / MAX (1.0f, radii[i + j * width])) ||
-                  curvatures[i + j * width] >= clamped_threshold)
-                curvatures[i + j * width] = 1.0;
-              else
-                curvatures[i + j * width] = 0.0;
-            }
+      if (gimp_async_is_canceled (async))
+        {
+          gimp_async_abort (async);
+
+          goto end2;
         }
       g_clear_pointer (&radii, g_free);
 
@@ -1252,33 +1582,6 @@ gimp_line_art_close (GeglBuffer  *buffer,
       g_clear_object (&strokes);
     }
 
-  if (closed_distmap)
-    {
-      GeglNode   *graph;
-      GeglNode   *input;
-      GeglNode   *op;
-
-      /* Flooding needs a distance map for closed line art. */
-      *closed_distmap = g_new (gfloat, width * height);
-
-      graph = gegl_node_new ();
-      input = gegl_node_new_child (graph,
-                                   "operation", "gegl:buffer-source",
-                                   "buffer", closed,
-                                   NULL);
-      op  = gegl_node_new_child (graph,
-                                 "operation", "gegl:distance-transform",
-                                 "metric",    GEGL_DISTANCE_METRIC_EUCLIDEAN,
-                                 "normalize", FALSE,
-                                 NULL);
-      gegl_node_connect_to (input, "output",
-                            op, "input");
-      gegl_node_blit (op, 1.0, gegl_buffer_get_extent (closed),
-                      NULL, *closed_distmap,
-                      GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
-      g_object_unref (graph);
-    }
-
  end1:
   g_clear_object (&strokes);
 
@@ -1500,6 +1803,29 @@ gimp_lineart_denoise (GeglBuffer *buffer,
   g_free (visited);
 }
 
+static void
+gimp_lineart_normalize_normals_range (gint          offset,
+                                      gint          size,
+                                      EdgelSetData *data)
+{
+  gfloat *normals = data->normals;
+  gint    width   = data->width;
+
+  if (gimp_async_is_canceled (data->async))
+    return;
+
+  for (int y = offset; y < offset + size; ++y)
+    {
+      for (int x = 0; x < width; ++x)
+        {
+          const float _angle = atan2f (normals[(x + y * width) * 2 + 1],
+                                       normals[(x + y * width) * 2]);
+          normals[(x + y * width) * 2] = cosf (_angle);
+          normals[(x + y * width) * 2 + 1] = sinf (_angle);
+        }
+    }
+}
+
 static void
 gimp_lineart_compute_normals_curvatures (GeglBuffer *mask,
                                          gfloat     *normals,
@@ -1508,11 +1834,12 @@ gimp_lineart_compute_normals_curvatures (GeglBuffer *mask,
                                          int         normal_estimate_mask_size,
                                          GimpAsync  *async)
 {
-  gfloat  *edgels_curvatures  = NULL;
-  gfloat  *smoothed_curvature;
-  GArray  *es                 = NULL;
-  Edgel  **e;
-  gint     width              = gegl_buffer_get_width (mask);
+  gfloat       *edgels_curvatures  = NULL;
+  gfloat       *smoothed_curvature;
+  GArray       *es                 = NULL;
+  Edgel       **e;
+  gint          width              = gegl_buffer_get_width (mask);
+  EdgelSetData  data;
 
   es = gimp_edgelset_new (mask, async);
   if (gimp_async_is_stopped (async))
@@ -1546,22 +1873,21 @@ gimp_lineart_compute_normals_curvatures (GeglBuffer *mask,
                                                    curvatures[(*e)->x + (*e)->y * width]);
       e++;
     }
-  for (int y = 0; y < gegl_buffer_get_height (mask); ++y)
-    {
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
 
-          goto end;
-        }
+  data.normals = normals;
+  data.width   = width;
+  data.async   = async;
 
-      for (int x = 0; x < gegl_buffer_get_width (mask); ++x)
-        {
-          const float _angle = atan2f (normals[(x + y * width) * 2 + 1],
-                                       normals[(x + y * width) * 2]);
-          normals[(x + y * width) * 2] = cosf (_angle);
-          normals[(x + y * width) * 2 + 1] = sinf (_angle);
-        }
+  gegl_parallel_distribute_range (
+    gegl_buffer_get_height (mask), PIXELS_PER_THREAD / width,
+    (GeglParallelDistributeRangeFunc) gimp_lineart_normalize_normals_range,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_async_abort (async);
+
+      goto end;
     }
 
   /* Smooth curvatures on edgels, then take maximum on each pixel. */
@@ -1590,53 +1916,72 @@ gimp_lineart_compute_normals_curvatures (GeglBuffer *mask,
     g_array_free (es, TRUE);
 }
 
-static gfloat *
-gimp_lineart_get_smooth_curvatures (GArray    *edgelset,
-                                    GimpAsync *async)
+static void
+gimp_lineart_get_smooth_curvatures_range (gint          offset,
+                                          gint          size,
+                                          EdgelSetData *data)
 {
-  Edgel  **e;
-  gfloat  *smoothed_curvatures = g_new0 (gfloat, edgelset->len);
-  gfloat   weights[9];
-  gfloat   smoothed_curvature;
-  gfloat   weights_sum;
-  gint     idx = 0;
+  GArray *edgelset = data->set;
+  gfloat  smoothed_curvature;
+  gfloat  weights_sum;
+  gint    idx;
 
-  weights[0] = 1.0f;
-  for (int i = 1; i <= 8; ++i)
-    weights[i] = expf (-(i * i) / 30.0f);
+  if (gimp_async_is_canceled (data->async))
+    return;
 
-  e = (Edgel **) edgelset->data;
-  while (*e)
+  for (idx = offset; idx < offset + size; idx++)
     {
-      Edgel *edgel_before = g_array_index (edgelset, Edgel*, (*e)->previous);
-      Edgel *edgel_after  = g_array_index (edgelset, Edgel*, (*e)->next);
+      Edgel *e            = g_array_index (edgelset, Edgel*, idx);
+      Edgel *edgel_before = g_array_index (edgelset, Edgel*, e->previous);
+      Edgel *edgel_after  = g_array_index (edgelset, Edgel*, e->next);
       int    n = 5;
       int    i = 1;
 
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
-
-          g_free (smoothed_curvatures);
-
-          return NULL;
-        }
-
-      smoothed_curvature = (*e)->curvature;
-      weights_sum = weights[0];
+      smoothed_curvature = e->curvature;
+      weights_sum = data->weights[0];
       while (n-- && (edgel_after != edgel_before))
         {
-          smoothed_curvature += weights[i] * edgel_before->curvature;
-          smoothed_curvature += weights[i] * edgel_after->curvature;
+          smoothed_curvature += data->weights[i] * edgel_before->curvature;
+          smoothed_curvature += data->weights[i] * edgel_after->curvature;
           edgel_before = g_array_index (edgelset, Edgel*, edgel_before->previous);
           edgel_after  = g_array_index (edgelset, Edgel*, edgel_after->next);
-          weights_sum += 2 * weights[i];
+          weights_sum += 2 * data->weights[i];
           i++;
         }
       smoothed_curvature /= weights_sum;
-      smoothed_curvatures[idx++] = smoothed_curvature;
+      data->smoothed_curvatures[idx] = smoothed_curvature;
+    }
+}
 
-      e++;
+static gfloat *
+gimp_lineart_get_smooth_curvatures (GArray    *edgelset,
+                                    GimpAsync *async)
+{
+  gfloat       *smoothed_curvatures = g_new0 (gfloat, edgelset->len);
+  gfloat        weights[9];
+  EdgelSetData  data;
+
+  weights[0] = 1.0f;
+  for (int i = 1; i <= 8; ++i)
+    weights[i] = expf (-(i * i) / 30.0f);
+
+  data.set                 = edgelset;
+  data.weights             = weights;
+  data.smoothed_curvatures = smoothed_curvatures;
+  data.async               = async;
+
+  gegl_parallel_distribute_range (
+    edgelset->len, PIXELS_PER_THREAD / 11,
+    (GeglParallelDistributeRangeFunc) gimp_lineart_get_smooth_curvatures_range,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_async_abort (async);
+
+      g_free (smoothed_curvatures);
+
+      return NULL;
     }
 
   return smoothed_curvatures;
@@ -2742,47 +3087,35 @@ gimp_edgelset_init_normals (GArray *set)
 }
 
 static void
-gimp_edgelset_smooth_normals (GArray    *set,
-                              int        mask_size,
-                              GimpAsync *async)
+gimp_edgelset_smooth_normals_range (gint          offset,
+                                    gint          size,
+                                    EdgelSetData *data)
 {
-  const gfloat sigma = mask_size * 0.775;
-  const gfloat den   = 2 * sigma * sigma;
-  gfloat       weights[65];
+  GArray      *set = data->set;
   GimpVector2  smoothed_normal;
   gint         i;
 
-  gimp_assert (mask_size <= 65);
-
-  weights[0] = 1.0f;
-  for (int i = 1; i <= mask_size; ++i)
-    weights[i] = expf (-(i * i) / den);
-
-  for (i = 0; i < set->len; i++)
+  for (i = offset; i < offset + size; i++)
     {
       Edgel *it           = g_array_index (set, Edgel*, i);
       Edgel *edgel_before = g_array_index (set, Edgel*, it->previous);
       Edgel *edgel_after  = g_array_index (set, Edgel*, it->next);
-      int    n = mask_size;
-      int    i = 1;
+      int    n = data->mask_size;
+      int    j = 1;
 
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
-
-          return;
-        }
+      if (gimp_async_is_canceled (data->async))
+        return;
 
       smoothed_normal = Direction2Normal[it->direction];
       while (n-- && (edgel_after != edgel_before))
         {
           smoothed_normal = gimp_vector2_add_val (smoothed_normal,
-                                                  gimp_vector2_mul_val (Direction2Normal[edgel_before->direction], weights[i]));
+                                                  gimp_vector2_mul_val (Direction2Normal[edgel_before->direction], data->weights[j]));
           smoothed_normal = gimp_vector2_add_val (smoothed_normal,
-                                                  gimp_vector2_mul_val (Direction2Normal[edgel_after->direction], weights[i]));
+                                                  gimp_vector2_mul_val (Direction2Normal[edgel_after->direction], data->weights[j]));
           edgel_before = g_array_index (set, Edgel *, edgel_before->previous);
           edgel_after  = g_array_index (set, Edgel *, edgel_after->next);
-          ++i;
+          ++j;
         }
       gimp_vector2_normalize (&smoothed_normal);
       it->x_normal = smoothed_normal.x;
@@ -2791,12 +3124,50 @@ gimp_edgelset_smooth_normals (GArray    *set,
 }
 
 static void
-gimp_edgelset_compute_curvature (GArray    *set,
-                                 GimpAsync *async)
+gimp_edgelset_smooth_normals (GArray    *set,
+                              int        mask_size,
+                              GimpAsync *async)
 {
-  gint i;
+  const gfloat sigma = mask_size * 0.775;
+  const gfloat den   = 2 * sigma * sigma;
+  gfloat       weights[65];
+  EdgelSetData data;
 
-  for (i = 0; i < set->len; i++)
+  gimp_assert (mask_size <= 65);
+
+  weights[0] = 1.0f;
+  for (int i = 1; i <= mask_size; ++i)
+    weights[i] = expf (-(i * i) / den);
+
+  data.set       = set;
+  data.weights   = weights;
+  data.mask_size = mask_size;
+  data.async     = async;
+
+  /* Each edgel only reads the directions of its neighbors, and only
+   * writes its own normal, so edgels can be processed in any order.
+   */
+  gegl_parallel_distribute_range (
+    set->len, PIXELS_PER_THREAD / (2 * mask_size + 1),
+    (GeglParallelDistributeRangeFunc) gimp_edgelset_smooth_normals_range,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    gimp_async_abort (async);
+}
+
+static void
+gimp_edgelset_compute_curvature_range (gint          offset,
+                                       gint          size,
+                                       EdgelSetData *data)
+{
+  GArray *set = data->set;
+  gint    i;
+
+  if (gimp_async_is_canceled (data->async))
+    return;
+
+  for (i = offset; i < offset + size; i++)
     {
       Edgel       *it       = g_array_index (set, Edgel*, i);
       Edgel       *previous = g_array_index (set, Edgel *, it->previous);
@@ -2809,14 +3180,25 @@ gimp_edgelset_compute_curvature (GArray    *set,
       const float  crossp   = n_prev.x * n_next.y - n_prev.y * n_next.x;
 
       it->curvature = (crossp > 0.0f) ? c : -c;
+    }
+}
 
-      if (gimp_async_is_canceled (async))
-        {
-          gimp_async_abort (async);
+static void
+gimp_edgelset_compute_curvature (GArray    *set,
+                                 GimpAsync *async)
+{
+  EdgelSetData data;
 
-          return;
-        }
-    }
+  data.set   = set;
+  data.async = async;
+
+  gegl_parallel_distribute_range (
+    set->len, PIXELS_PER_THREAD,
+    (GeglParallelDistributeRangeFunc) gimp_edgelset_compute_curvature_range,
+    &data);
+
+  if (gimp_async_is_canceled (async))
+    gimp_async_abort (async);
 }
 
 static void
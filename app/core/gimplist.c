@@ -31,6 +31,18 @@
 #include "gimplist.h"
 
 
+typedef struct _GimpListEntry GimpListEntry;
+
+struct _GimpListEntry
+{
+  GList *link;   /*  the object's link in the queue                 */
+  gchar *name;   /*  the name the object is indexed under, or NULL  */
+  gint   index;  /*  the object's position, if list->index_valid,
+                  *  relative to list->index_offset
+                  */
+};
+
+
 enum
 {
   PROP_0,
@@ -73,6 +85,28 @@ static GimpObject * gimp_list_get_child_by_index (GimpContainer *container,
 static gint         gimp_list_get_child_index    (GimpContainer *container,
                                                   GimpObject    *object);
 
+static GimpListEntry *
+                    gimp_list_entry_new          (GimpList      *list,
+                                                  GimpObject    *object,
+                                                  GList         *link);
+static void         gimp_list_entry_free         (GimpListEntry *entry);
+
+static void         gimp_list_index_name         (GimpList      *list,
+                                                  GimpObject    *object,
+                                                  GimpListEntry *entry);
+static void         gimp_list_unindex_name       (GimpList      *list,
+                                                  GimpObject    *object,
+                                                  GimpListEntry *entry);
+static void         gimp_list_link_index         (GimpList      *list,
+                                                  GimpListEntry *entry);
+static void         gimp_list_unlink_index       (GimpList      *list,
+                                                  GimpListEntry *entry);
+static void         gimp_list_update_index       (GimpList      *list);
+
+static gint         gimp_list_split_name         (gchar         *name);
+static gboolean     gimp_list_name_taken         (GimpList      *list,
+                                                  GimpObject    *object,
+                                                  const gchar   *name);
 static void         gimp_list_uniquefy_name      (GimpList      *gimp_list,
                                                   GimpObject    *object);
 static void         gimp_list_object_renamed     (GimpObject    *object,
@@ -135,6 +169,17 @@ gimp_list_init (GimpList *list)
   list->unique_names = FALSE;
   list->sort_func    = NULL;
   list->append       = FALSE;
+
+  list->entries      = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL,
+                                              (GDestroyNotify) gimp_list_entry_free);
+  list->names        = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free,
+                                              (GDestroyNotify) g_slist_free);
+  list->unique_exts  = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
+  list->index_valid  = TRUE;
+  list->index_offset = 0;
 }
 
 static void
@@ -148,6 +193,10 @@ gimp_list_finalize (GObject *object)
       list->queue = NULL;
     }
 
+  g_clear_pointer (&list->entries,     g_hash_table_unref);
+  g_clear_pointer (&list->names,       g_hash_table_unref);
+  g_clear_pointer (&list->unique_exts, g_hash_table_unref);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -222,6 +271,11 @@ gimp_list_get_memsize (GimpObject *object,
       memsize += gimp_g_queue_get_memsize (list->queue, 0);
     }
 
+  memsize += gimp_g_hash_table_get_memsize (list->entries,
+                                            sizeof (GimpListEntry));
+  memsize += gimp_g_hash_table_get_memsize (list->names, 0);
+  memsize += gimp_g_hash_table_get_memsize (list->unique_exts, 0);
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -240,30 +294,57 @@ static void
 gimp_list_add (GimpContainer *container,
                GimpObject    *object)
 {
-  GimpList *list = GIMP_LIST (container);
+  GimpList      *list = GIMP_LIST (container);
+  GimpListEntry *entry;
+  GList         *link;
 
   if (list->unique_names)
     gimp_list_uniquefy_name (list, object);
 
-  if (list->unique_names || list->sort_func)
-    g_signal_connect (object, "name-changed",
-                      G_CALLBACK (gimp_list_object_renamed),
-                      list);
+  g_signal_connect (object, "name-changed",
+                    G_CALLBACK (gimp_list_object_renamed),
+                    list);
 
   if (list->sort_func)
     {
-      g_queue_insert_sorted (list->queue, object, gimp_list_sort_func,
-                             list->sort_func);
+      GList *sibling = list->queue->head;
+
+      /*  same as g_queue_insert_sorted(), but we need the new link  */
+      while (sibling && list->sort_func (sibling->data, object) < 0)
+        sibling = g_list_next (sibling);
+
+      if (sibling)
+        {
+          g_queue_insert_before (list->queue, sibling, object);
+
+          link = sibling->prev;
+        }
+      else
+        {
+          g_queue_push_tail (list->queue, object);
+
+          link = list->queue->tail;
+        }
     }
   else if (list->append)
     {
       g_queue_push_tail (list->queue, object);
+
+      link = list->queue->tail;
     }
   else
     {
       g_queue_push_head (list->queue, object);
+
+      link = list->queue->head;
     }
 
+  entry = gimp_list_entry_new (list, object, link);
+
+  g_hash_table_insert (list->entries, object, entry);
+
+  gimp_list_link_index (list, entry);
+
   GIMP_CONTAINER_CLASS (parent_class)->add (container, object);
 }
 
@@ -271,14 +352,21 @@ static void
 gimp_list_remove (GimpContainer *container,
                   GimpObject    *object)
 {
-  GimpList *list = GIMP_LIST (container);
+  GimpList      *list = GIMP_LIST (container);
+  GimpListEntry *entry;
+
+  g_signal_handlers_disconnect_by_func (object,
+                                        gimp_list_object_renamed,
+                                        list);
+
+  entry = g_hash_table_lookup (list->entries, object);
 
-  if (list->unique_names || list->sort_func)
-    g_signal_handlers_disconnect_by_func (object,
-                                          gimp_list_object_renamed,
-                                          list);
+  gimp_list_unlink_index (list, entry);
 
-  g_queue_remove (list->queue, object);
+  gimp_list_unindex_name (list, object, entry);
+
+  g_queue_delete_link (list->queue, entry->link);
+  g_hash_table_remove (list->entries, object);
 
   GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
 }
@@ -288,14 +376,19 @@ gimp_list_reorder (GimpContainer *container,
                    GimpObject    *object,
                    gint           new_index)
 {
-  GimpList *list = GIMP_LIST (container);
+  GimpList      *list  = GIMP_LIST (container);
+  GimpListEntry *entry = g_hash_table_lookup (list->entries, object);
 
-  g_queue_remove (list->queue, object);
+  gimp_list_unlink_index (list, entry);
+
+  g_queue_unlink (list->queue, entry->link);
 
   if (new_index == gimp_container_get_n_children (container) - 1)
-    g_queue_push_tail (list->queue, object);
+    g_queue_push_tail_link (list->queue, entry->link);
   else
-    g_queue_push_nth (list->queue, object, new_index);
+    g_queue_push_nth_link (list->queue, new_index, entry->link);
+
+  gimp_list_link_index (list, entry);
 }
 
 static void
@@ -303,8 +396,9 @@ gimp_list_clear (GimpContainer *container)
 {
   GimpList *list = GIMP_LIST (container);
 
-  while (g_queue_peek_head (list->queue))
-    gimp_container_remove (container, g_queue_peek_head (list->queue));
+  /*  remove from the tail, so that the indices stay valid  */
+  while (g_queue_peek_tail (list->queue))
+    gimp_container_remove (container, g_queue_peek_tail (list->queue));
 }
 
 static gboolean
@@ -313,7 +407,7 @@ gimp_list_have (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
-  return g_queue_find (list->queue, object) ? TRUE : FALSE;
+  return g_hash_table_contains (list->entries, object);
 }
 
 static void
@@ -331,13 +425,23 @@ gimp_list_get_child_by_name (GimpContainer *container,
                              const gchar   *name)
 {
   GimpList *list = GIMP_LIST (container);
+  GSList   *objects;
   GList    *glist;
 
+  objects = g_hash_table_lookup (list->names, name);
+
+  if (! objects)
+    return NULL;
+
+  if (! objects->next)
+    return objects->data;
+
+  /*  more than one child has the name, return the first one  */
   for (glist = list->queue->head; glist; glist = g_list_next (glist))
     {
       GimpObject *object = glist->data;
 
-      if (! strcmp (gimp_object_get_name (object), name))
+      if (! g_strcmp0 (gimp_object_get_name (object), name))
         return object;
     }
 
@@ -357,9 +461,17 @@ static gint
 gimp_list_get_child_index (GimpContainer *container,
                            GimpObject    *object)
 {
-  GimpList *list = GIMP_LIST (container);
+  GimpList      *list = GIMP_LIST (container);
+  GimpListEntry *entry;
+
+  entry = g_hash_table_lookup (list->entries, object);
+
+  if (! entry)
+    return -1;
 
-  return g_queue_index (list->queue, (gpointer) object);
+  gimp_list_update_index (list);
+
+  return entry->index + list->index_offset;
 }
 
 /**
@@ -445,6 +557,7 @@ gimp_list_reverse (GimpList *list)
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       g_queue_reverse (list->queue);
+      list->index_valid = FALSE;
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -509,6 +622,7 @@ gimp_list_sort (GimpList     *list,
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       g_queue_sort (list->queue, gimp_list_sort_func, sort_func);
+      list->index_valid = FALSE;
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -530,58 +644,262 @@ gimp_list_sort_by_name (GimpList *list)
 
 /*  private functions  */
 
+static GimpListEntry *
+gimp_list_entry_new (GimpList   *list,
+                     GimpObject *object,
+                     GList      *link)
+{
+  GimpListEntry *entry = g_slice_new0 (GimpListEntry);
+
+  entry->link = link;
+
+  gimp_list_index_name (list, object, entry);
+
+  return entry;
+}
+
 static void
-gimp_list_uniquefy_name (GimpList   *gimp_list,
-                         GimpObject *object)
+gimp_list_entry_free (GimpListEntry *entry)
 {
-  gchar *name = (gchar *) gimp_object_get_name (object);
-  GList *list;
+  g_free (entry->name);
+
+  g_slice_free (GimpListEntry, entry);
+}
+
+static void
+gimp_list_index_name (GimpList      *list,
+                      GimpObject    *object,
+                      GimpListEntry *entry)
+{
+  const gchar *name    = gimp_object_get_name (object);
+  gchar       *key;
+  GSList      *objects = NULL;
 
   if (! name)
     return;
 
-  for (list = gimp_list->queue->head; list; list = g_list_next (list))
-    {
-      GimpObject  *object2 = list->data;
-      const gchar *name2   = gimp_object_get_name (object2);
+  entry->name = g_strdup (name);
 
-      if (object != object2 &&
-          name2             &&
-          ! strcmp (name, name2))
-        break;
+  if (g_hash_table_lookup_extended (list->names, name,
+                                    (gpointer *) &key, (gpointer *) &objects))
+    {
+      g_hash_table_steal (list->names, key);
     }
-
-  if (list)
+  else
     {
-      gchar *ext;
-      gchar *new_name   = NULL;
-      gint   unique_ext = 0;
+      key = g_strdup (name);
+    }
 
-      name = g_strdup (name);
+  g_hash_table_insert (list->names, key, g_slist_prepend (objects, object));
+}
 
-      ext = strrchr (name, '#');
+static void
+gimp_list_unindex_name (GimpList      *list,
+                        GimpObject    *object,
+                        GimpListEntry *entry)
+{
+  gchar  *key;
+  GSList *objects;
 
-      if (ext)
-        {
-          gchar ext_str[8];
+  if (! entry->name)
+    return;
 
-          unique_ext = atoi (ext + 1);
+  if (g_hash_table_lookup_extended (list->names, entry->name,
+                                    (gpointer *) &key, (gpointer *) &objects))
+    {
+      g_hash_table_steal (list->names, key);
 
-          g_snprintf (ext_str, sizeof (ext_str), "%d", unique_ext);
+      objects = g_slist_remove (objects, object);
 
-          /*  check if the extension really is of the form "#<n>"  */
-          if (! strcmp (ext_str, ext + 1))
-            {
-              if (ext > name && *(ext - 1) == ' ')
-                ext--;
+      if (objects)
+        g_hash_table_insert (list->names, key, objects);
+      else
+        g_free (key);
+    }
 
-              *ext = '\0';
+  if (list->unique_names)
+    {
+      gint ext;
+      gint n_exts;
+
+      /*  the name's extension is free now, make sure
+       *  gimp_list_uniquefy_name() doesn't skip it
+       */
+      ext    = gimp_list_split_name (entry->name);
+      n_exts = GPOINTER_TO_INT (g_hash_table_lookup (list->unique_exts,
+                                                     entry->name));
+
+      if (ext > 0 && ext <= n_exts)
+        {
+          if (ext > 1)
+            {
+              g_hash_table_insert (list->unique_exts,
+                                   g_strdup (entry->name),
+                                   GINT_TO_POINTER (ext - 1));
             }
           else
             {
-              unique_ext = 0;
+              g_hash_table_remove (list->unique_exts, entry->name);
             }
         }
+    }
+
+  g_clear_pointer (&entry->name, g_free);
+}
+
+/*  updates the indices after @entry's link was inserted into the queue.
+ *  inserting at either end doesn't shift the other children relative to
+ *  each other, so only the offset needs to change
+ */
+static void
+gimp_list_link_index (GimpList      *list,
+                      GimpListEntry *entry)
+{
+  if (! list->index_valid)
+    return;
+
+  if (entry->link == list->queue->head)
+    {
+      list->index_offset++;
+
+      entry->index = -list->index_offset;
+    }
+  else if (entry->link == list->queue->tail)
+    {
+      entry->index = (gint) g_queue_get_length (list->queue) - 1 -
+                     list->index_offset;
+    }
+  else
+    {
+      list->index_valid = FALSE;
+    }
+}
+
+/*  updates the indices before @entry's link is removed from the queue  */
+static void
+gimp_list_unlink_index (GimpList      *list,
+                        GimpListEntry *entry)
+{
+  if (! list->index_valid)
+    return;
+
+  if (entry->link == list->queue->tail)
+    {
+      /*  nothing to do  */
+    }
+  else if (entry->link == list->queue->head)
+    {
+      list->index_offset--;
+    }
+  else
+    {
+      list->index_valid = FALSE;
+    }
+}
+
+static void
+gimp_list_update_index (GimpList *list)
+{
+  GList *glist;
+  gint   index;
+
+  if (list->index_valid)
+    return;
+
+  for (glist = list->queue->head, index = 0;
+       glist;
+       glist = g_list_next (glist), index++)
+    {
+      GimpListEntry *entry = g_hash_table_lookup (list->entries, glist->data);
+
+      entry->index = index;
+    }
+
+  list->index_valid  = TRUE;
+  list->index_offset = 0;
+}
+
+/*  strips a "#<n>" extension, and the space before it, from @name, and
+ *  returns <n>, or 0 if @name has no such extension
+ */
+static gint
+gimp_list_split_name (gchar *name)
+{
+  gchar *ext;
+  gint   unique_ext = 0;
+
+  ext = strrchr (name, '#');
+
+  if (ext)
+    {
+      gchar ext_str[8];
+
+      unique_ext = atoi (ext + 1);
+
+      g_snprintf (ext_str, sizeof (ext_str), "%d", unique_ext);
+
+      /*  check if the extension really is of the form "#<n>"  */
+      if (! strcmp (ext_str, ext + 1))
+        {
+          if (ext > name && *(ext - 1) == ' ')
+            ext--;
+
+          *ext = '\0';
+        }
+      else
+        {
+          unique_ext = 0;
+        }
+    }
+
+  return unique_ext;
+}
+
+static gboolean
+gimp_list_name_taken (GimpList    *list,
+                      GimpObject  *object,
+                      const gchar *name)
+{
+  GSList *objects;
+
+  for (objects = g_hash_table_lookup (list->names, name);
+       objects;
+       objects = g_slist_next (objects))
+    {
+      if (objects->data != object)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gimp_list_uniquefy_name (GimpList   *gimp_list,
+                         GimpObject *object)
+{
+  gchar *name = (gchar *) gimp_object_get_name (object);
+
+  if (! name)
+    return;
+
+  if (gimp_list_name_taken (gimp_list, object, name))
+    {
+      gchar *new_name = NULL;
+      gint   unique_ext;
+      gint   n_exts;
+      gint   start_ext;
+
+      name = g_strdup (name);
+
+      unique_ext = gimp_list_split_name (name);
+
+      /*  "<name> #1" to "<name> #<n_exts>" are known to be taken, don't
+       *  try them again
+       */
+      n_exts = GPOINTER_TO_INT (g_hash_table_lookup (gimp_list->unique_exts,
+                                                     name));
+
+      start_ext = unique_ext = MAX (unique_ext, n_exts);
 
       do
         {
@@ -590,21 +908,18 @@ gimp_list_uniquefy_name (GimpList   *gimp_list,
           g_free (new_name);
 
           new_name = g_strdup_printf ("%s #%d", name, unique_ext);
-
-          for (list = gimp_list->queue->head; list; list = g_list_next (list))
-            {
-              GimpObject  *object2 = list->data;
-              const gchar *name2   = gimp_object_get_name (object2);
-
-              if (object != object2 &&
-                  name2             &&
-                  ! strcmp (new_name, name2))
-                break;
-            }
         }
-      while (list);
+      while (gimp_list_name_taken (gimp_list, object, new_name));
 
-      g_free (name);
+      if (start_ext == n_exts)
+        {
+          g_hash_table_insert (gimp_list->unique_exts,
+                               name, GINT_TO_POINTER (unique_ext));
+        }
+      else
+        {
+          g_free (name);
+        }
 
       gimp_object_take_name (object, new_name);
     }
@@ -614,6 +929,10 @@ static void
 gimp_list_object_renamed (GimpObject *object,
                           GimpList   *list)
 {
+  GimpListEntry *entry = g_hash_table_lookup (list->entries, object);
+
+  gimp_list_unindex_name (list, object, entry);
+
   if (list->unique_names)
     {
       g_signal_handlers_block_by_func (object,
@@ -627,13 +946,15 @@ gimp_list_object_renamed (GimpObject *object,
                                          list);
     }
 
+  gimp_list_index_name (list, object, entry);
+
   if (list->sort_func)
     {
       GList *glist;
       gint   old_index;
       gint   new_index = 0;
 
-      old_index = g_queue_index (list->queue, object);
+      old_index = gimp_list_get_child_index (GIMP_CONTAINER (list), object);
 
       for (glist = list->queue->head; glist; glist = g_list_next (glist))
         {
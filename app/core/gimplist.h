@@ -43,6 +43,12 @@ struct _GimpList
   gboolean       unique_names;
   GCompareFunc   sort_func;
   gboolean       append;
+
+  GHashTable    *entries;       /*  object -> its link and indexed name  */
+  GHashTable    *names;         /*  name -> GSList of objects            */
+  GHashTable    *unique_exts;   /*  base name -> "#<n>" exts in use      */
+  gboolean       index_valid;   /*  whether the entries' indices are set */
+  gint           index_offset;  /*  added to the entries' indices        */
 };
 
 struct _GimpListClass
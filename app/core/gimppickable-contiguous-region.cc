@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -46,6 +47,17 @@ extern "C"
 #define PIXELS_PER_THREAD \
   (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
 
+/* seed fills which select fewer pixels than this (or than a fraction of
+ * the image) are done by the serial scanline fill, which only touches
+ * the region itself; larger ones switch to the parallel fill, which
+ * scans the whole image.
+ */
+#define SERIAL_FILL_MIN_PIXELS (1 << 20)
+#define SERIAL_FILL_FRACTION   64
+
+/* height of the row bands the parallel fill labels independently */
+#define BAND_HEIGHT 64
+
 
 typedef struct
 {
@@ -54,6 +66,21 @@ typedef struct
   gint   level;
 } BorderPixel;
 
+typedef struct
+{
+  gint   x1;
+  gint   x2;
+} Run;
+
+typedef struct
+{
+  gint    y;
+  gint    height;
+  GArray *runs;      /* the band's runs of nonzero pixels, row by row  */
+  gint   *row_runs;  /* index of each row's first run, plus the total  */
+  gint    offset;    /* index of the band's first run among all runs   */
+} Band;
+
 
 /*  local function prototypes  */
 
@@ -100,7 +127,22 @@ static gboolean find_contiguous_segment   (const gfloat        *col,
                                            gint                *start,
                                            gint                *end,
                                            gfloat              *row);
-static void     find_contiguous_region    (GeglBuffer          *src_buffer,
+static gboolean find_contiguous_region    (GeglBuffer          *src_buffer,
+                                           GeglBuffer          *mask_buffer,
+                                           const Babl          *format,
+                                           gint                 n_components,
+                                           gboolean             has_alpha,
+                                           gboolean             select_transparent,
+                                           GimpSelectCriterion  select_criterion,
+                                           gboolean             antialias,
+                                           gfloat               threshold,
+                                           gboolean             diagonal_neighbors,
+                                           gint                 x,
+                                           gint                 y,
+                                           const gfloat        *col,
+                                           gint64               max_pixels);
+static void     find_contiguous_region_parallel
+                                          (GeglBuffer          *src_buffer,
                                            GeglBuffer          *mask_buffer,
                                            const Babl          *format,
                                            gint                 n_components,
@@ -173,13 +215,33 @@ gimp_pickable_contiguous_region_by_seed (GimpPickable        *pickable,
   if (x >= extent.x && x < (extent.x + extent.width) &&
       y >= extent.y && y < (extent.y + extent.height))
     {
+      gint64 max_pixels;
+
       GIMP_TIMER_START();
 
-      find_contiguous_region (src_buffer, mask_buffer,
-                              format, n_components, has_alpha,
-                              select_transparent, select_criterion,
-                              antialias, threshold, diagonal_neighbors,
-                              x, y, start_col);
+      max_pixels = MAX ((gint64) extent.width * extent.height /
+                        SERIAL_FILL_FRACTION,
+                        SERIAL_FILL_MIN_PIXELS);
+
+      /*  try the serial fill first, which is fastest for small regions,
+       *  and fall back to the parallel fill once the region turns out
+       *  to be large.  the pixels the serial fill has already selected
+       *  are selected by the parallel fill too, with the same values.
+       */
+      if (! find_contiguous_region (src_buffer, mask_buffer,
+                                    format, n_components, has_alpha,
+                                    select_transparent, select_criterion,
+                                    antialias, threshold, diagonal_neighbors,
+                                    x, y, start_col, max_pixels))
+        {
+          find_contiguous_region_parallel (src_buffer, mask_buffer,
+                                           format, n_components, has_alpha,
+                                           select_transparent,
+                                           select_criterion,
+                                           antialias, threshold,
+                                           diagonal_neighbors,
+                                           x, y, start_col);
+        }
 
       GIMP_TIMER_END("foo");
     }
@@ -351,56 +413,64 @@ gimp_pickable_contiguous_region_by_line_art (GimpPickable *pickable,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x - 1, y - 1, &col);
+                                    x - 1, y - 1, &col,
+                                    G_MAXINT64);
           if (x - 1 >= extent.x && x - 1 < extent.x + extent.width &&
               y >= extent.y && y < (extent.y + extent.height))
             find_contiguous_region (src_buffer, mask_buffer,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x - 1, y, &col);
+                                    x - 1, y, &col,
+                                    G_MAXINT64);
           if (x - 1 >= extent.x && x - 1 < extent.x + extent.width &&
               y + 1 >= extent.y && y + 1 < (extent.y + extent.height))
             find_contiguous_region (src_buffer, mask_buffer,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x - 1, y + 1, &col);
+                                    x - 1, y + 1, &col,
+                                    G_MAXINT64);
           if (x >= extent.x && x < extent.x + extent.width &&
               y - 1 >= extent.y && y - 1 < (extent.y + extent.height))
             find_contiguous_region (src_buffer, mask_buffer,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x, y - 1, &col);
+                                    x, y - 1, &col,
+                                    G_MAXINT64);
           if (x >= extent.x && x < extent.x + extent.width &&
               y + 1 >= extent.y && y + 1 < (extent.y + extent.height))
             find_contiguous_region (src_buffer, mask_buffer,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x, y + 1, &col);
+                                    x, y + 1, &col,
+                                    G_MAXINT64);
           if (x + 1 >= extent.x && x + 1 < extent.x + extent.width &&
               y - 1 >= extent.y && y - 1 < (extent.y + extent.height))
             find_contiguous_region (src_buffer, mask_buffer,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x + 1, y - 1, &col);
+                                    x + 1, y - 1, &col,
+                                    G_MAXINT64);
           if (x + 1 >= extent.x && x + 1 < extent.x + extent.width &&
               y >= extent.y && y < (extent.y + extent.height))
             find_contiguous_region (src_buffer, mask_buffer,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x + 1, y, &col);
+                                    x + 1, y, &col,
+                                    G_MAXINT64);
           if (x + 1 >= extent.x && x + 1 < extent.x + extent.width &&
               y + 1 >= extent.y && y + 1 < (extent.y + extent.height))
             find_contiguous_region (src_buffer, mask_buffer,
                                     format, 1, FALSE,
                                     FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                                     FALSE, 0.0, FALSE,
-                                    x + 1, y + 1, &col);
+                                    x + 1, y + 1, &col,
+                                    G_MAXINT64);
           filled = TRUE;
         }
     }
@@ -413,7 +483,8 @@ gimp_pickable_contiguous_region_by_line_art (GimpPickable *pickable,
                               format, 1, FALSE,
                               FALSE, GIMP_SELECT_CRITERION_COMPOSITE,
                               FALSE, 0.0, FALSE,
-                              x, y, &col);
+                              x, y, &col,
+                              G_MAXINT64);
       filled = TRUE;
     }
 
@@ -987,7 +1058,10 @@ find_contiguous_segment (const gfloat        *col,
   return TRUE;
 }
 
-static void
+/* Returns FALSE, leaving the region partially filled, if more than
+ * max_pixels pixels would be selected.
+ */
+static gboolean
 find_contiguous_region (GeglBuffer          *src_buffer,
                         GeglBuffer          *mask_buffer,
                         const Babl          *format,
@@ -1000,7 +1074,8 @@ find_contiguous_region (GeglBuffer          *src_buffer,
                         gboolean             diagonal_neighbors,
                         gint                 x,
                         gint                 y,
-                        const gfloat        *col)
+                        const gfloat        *col,
+                        gint64               max_pixels)
 {
   const Babl  *mask_format = babl_format ("Y float");
   GeglSampler *src_sampler;
@@ -1008,7 +1083,8 @@ find_contiguous_region (GeglBuffer          *src_buffer,
   gint         start, end;
   gint         new_start, new_end;
   GQueue      *segment_queue;
-  gfloat      *row = NULL;
+  gfloat      *row      = NULL;
+  gint64       n_pixels = 0;
 
 #ifdef FETCH_ROW
   row = g_new (gfloat, gegl_buffer_get_width (src_buffer) * n_components);
@@ -1058,6 +1134,11 @@ find_contiguous_region (GeglBuffer          *src_buffer,
                                          row))
             continue;
 
+          n_pixels += new_end - new_start - 1;
+
+          if (n_pixels > max_pixels)
+            break;
+
           /* We can skip directly to `new_end + 1` on the next iteration, since
            * we've just selected all pixels in the range `[x, new_end)`, and
            * the pixel at `new_end` is above threshold.  (Note that we assume
@@ -1091,7 +1172,7 @@ find_contiguous_region (GeglBuffer          *src_buffer,
 
         }
     }
-  while (! g_queue_is_empty (segment_queue));
+  while (n_pixels <= max_pixels && ! g_queue_is_empty (segment_queue));
 
   g_queue_free (segment_queue);
 
@@ -1100,6 +1181,347 @@ find_contiguous_region (GeglBuffer          *src_buffer,
 #ifdef FETCH_ROW
   g_free (row);
 #endif
+
+  return n_pixels <= max_pixels;
+}
+
+static inline gint
+run_find (const gint *parent,
+          gint        i)
+{
+  while (parent[i] != i)
+    i = parent[i];
+
+  return i;
+}
+
+static inline gint
+run_find_compress (gint *parent,
+                   gint  i)
+{
+  while (parent[i] != i)
+    {
+      parent[i] = parent[parent[i]];
+      i         = parent[i];
+    }
+
+  return i;
+}
+
+static inline void
+run_union (gint *parent,
+           gint  i,
+           gint  j)
+{
+  i = run_find_compress (parent, i);
+  j = run_find_compress (parent, j);
+
+  if (i < j)
+    parent[j] = i;
+  else if (j < i)
+    parent[i] = j;
+}
+
+/* Unites the runs of two adjacent rows which touch each other.  Runs
+ * are given by their index among all runs.
+ */
+static void
+union_adjacent_rows (gint      *parent,
+                     const Run *runs1,
+                     gint       first1,
+                     gint       n_runs1,
+                     const Run *runs2,
+                     gint       first2,
+                     gint       n_runs2,
+                     gboolean   diagonal_neighbors)
+{
+  /*  with diagonal neighbors, runs which only touch at a corner are
+   *  connected too
+   */
+  gint reach = diagonal_neighbors ? 1 : 0;
+  gint i     = 0;
+  gint j     = 0;
+
+  while (i < n_runs1 && j < n_runs2)
+    {
+      const Run *run1 = &runs1[i];
+      const Run *run2 = &runs2[j];
+
+      if (run1->x1 < run2->x2 + reach &&
+          run2->x1 < run1->x2 + reach)
+        {
+          run_union (parent, first1 + i, first2 + j);
+        }
+
+      if (run1->x2 < run2->x2)
+        i++;
+      else
+        j++;
+    }
+}
+
+/* Selects the same region as find_contiguous_region(), by labeling the
+ * connected runs of selectable pixels of every band of rows in parallel,
+ * joining the labels across bands, and then filling the runs connected
+ * to the seed in parallel.
+ */
+static void
+find_contiguous_region_parallel (GeglBuffer          *src_buffer,
+                                 GeglBuffer          *mask_buffer,
+                                 const Babl          *format,
+                                 gint                 n_components,
+                                 gboolean             has_alpha,
+                                 gboolean             select_transparent,
+                                 GimpSelectCriterion  select_criterion,
+                                 gboolean             antialias,
+                                 gfloat               threshold,
+                                 gboolean             diagonal_neighbors,
+                                 gint                 x,
+                                 gint                 y,
+                                 const gfloat        *col)
+{
+  const Babl *mask_format = babl_format ("Y float");
+  gint        width       = gegl_buffer_get_width  (src_buffer);
+  gint        height      = gegl_buffer_get_height (src_buffer);
+  gint        n_bands     = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+  Band       *bands;
+  gint       *parent;
+  gint        n_runs      = 0;
+  gint        seed_root   = -1;
+  gint        i;
+
+  bands = g_new0 (Band, n_bands);
+
+  /*  find the runs of selectable pixels of each band, and label the
+   *  runs which are connected within the band
+   */
+  gegl_parallel_distribute_range (
+    n_bands, 1,
+    [=] (gint offset, gint size)
+    {
+      gfloat *src_row = g_new (gfloat, width * n_components);
+      gint    b;
+
+      for (b = offset; b < offset + size; b++)
+        {
+          Band *band = &bands[b];
+          gint  row;
+
+          band->y        = b * BAND_HEIGHT;
+          band->height   = MIN (BAND_HEIGHT, height - band->y);
+          band->runs     = g_array_new (FALSE, FALSE, sizeof (Run));
+          band->row_runs = g_new (gint, band->height + 1);
+
+          for (row = 0; row < band->height; row++)
+            {
+              const gfloat *s = src_row;
+              gint          x1 = -1;
+              gint          x;
+
+              band->row_runs[row] = band->runs->len;
+
+              gegl_buffer_get (src_buffer,
+                               GEGL_RECTANGLE (0, band->y + row, width, 1),
+                               1.0, format, src_row,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+              for (x = 0; x < width; x++, s += n_components)
+                {
+                  gfloat diff = pixel_difference (col, s, antialias, threshold,
+                                                  n_components, has_alpha,
+                                                  select_transparent,
+                                                  select_criterion);
+
+                  if (diff != 0.0 && x1 < 0)
+                    {
+                      x1 = x;
+                    }
+                  else if (diff == 0.0 && x1 >= 0)
+                    {
+                      Run run = { x1, x };
+
+                      g_array_append_val (band->runs, run);
+
+                      x1 = -1;
+                    }
+                }
+
+              if (x1 >= 0)
+                {
+                  Run run = { x1, width };
+
+                  g_array_append_val (band->runs, run);
+                }
+            }
+
+          band->row_runs[band->height] = band->runs->len;
+        }
+
+      g_free (src_row);
+    });
+
+  for (i = 0; i < n_bands; i++)
+    {
+      bands[i].offset  = n_runs;
+      n_runs          += bands[i].runs->len;
+    }
+
+  parent = g_new (gint, MAX (n_runs, 1));
+
+  gegl_parallel_distribute_range (
+    n_bands, 1,
+    [=] (gint offset, gint size)
+    {
+      gint b;
+
+      for (b = offset; b < offset + size; b++)
+        {
+          const Band *band = &bands[b];
+          const Run  *runs = (const Run *) band->runs->data;
+          gint        row;
+          gint        r;
+
+          for (r = 0; r < (gint) band->runs->len; r++)
+            parent[band->offset + r] = band->offset + r;
+
+          for (row = 1; row < band->height; row++)
+            {
+              gint first1 = band->row_runs[row - 1];
+              gint first2 = band->row_runs[row];
+              gint end2   = band->row_runs[row + 1];
+
+              union_adjacent_rows (parent,
+                                   runs + first1, band->offset + first1,
+                                   first2 - first1,
+                                   runs + first2, band->offset + first2,
+                                   end2 - first2,
+                                   diagonal_neighbors);
+            }
+        }
+    });
+
+  /*  join the labels across band boundaries  */
+  for (i = 1; i < n_bands; i++)
+    {
+      const Band *band1  = &bands[i - 1];
+      const Band *band2  = &bands[i];
+      gint        first1 = band1->row_runs[band1->height - 1];
+      gint        end1   = band1->row_runs[band1->height];
+      gint        end2   = band2->row_runs[1];
+
+      union_adjacent_rows (parent,
+                           (const Run *) band1->runs->data + first1,
+                           band1->offset + first1, end1 - first1,
+                           (const Run *) band2->runs->data,
+                           band2->offset, end2,
+                           diagonal_neighbors);
+    }
+
+  /*  find the seed's run  */
+  {
+    const Band *band = &bands[y / BAND_HEIGHT];
+    const Run  *runs = (const Run *) band->runs->data;
+    gint        row  = y - band->y;
+    gint        r;
+
+    for (r = band->row_runs[row]; r < band->row_runs[row + 1]; r++)
+      {
+        if (x >= runs[r].x1 && x < runs[r].x2)
+          {
+            seed_root = run_find_compress (parent, band->offset + r);
+            break;
+          }
+      }
+  }
+
+  /*  fill the runs connected to the seed  */
+  if (seed_root >= 0)
+    {
+      gegl_parallel_distribute_range (
+        n_bands, 1,
+        [=] (gint offset, gint size)
+        {
+          gfloat *src_row  = g_new (gfloat, width * n_components);
+          gfloat *mask_row = g_new (gfloat, width);
+          gint    b;
+
+          for (b = offset; b < offset + size; b++)
+            {
+              const Band *band = &bands[b];
+              const Run  *runs = (const Run *) band->runs->data;
+              gint        row;
+
+              for (row = 0; row < band->height; row++)
+                {
+                  gint x1 = width;
+                  gint x2 = 0;
+                  gint r;
+
+                  for (r = band->row_runs[row];
+                       r < band->row_runs[row + 1];
+                       r++)
+                    {
+                      if (run_find (parent, band->offset + r) == seed_root)
+                        {
+                          x1 = MIN (x1, runs[r].x1);
+                          x2 = MAX (x2, runs[r].x2);
+                        }
+                    }
+
+                  if (x1 >= x2)
+                    continue;
+
+                  gegl_buffer_get (src_buffer,
+                                   GEGL_RECTANGLE (x1, band->y + row,
+                                                   x2 - x1, 1),
+                                   1.0, format, src_row,
+                                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+                  memset (mask_row, 0, (x2 - x1) * sizeof (gfloat));
+
+                  for (r = band->row_runs[row];
+                       r < band->row_runs[row + 1];
+                       r++)
+                    {
+                      gint x;
+
+                      if (runs[r].x2 <= x1 || runs[r].x1 >= x2 ||
+                          run_find (parent, band->offset + r) != seed_root)
+                        continue;
+
+                      for (x = runs[r].x1; x < runs[r].x2; x++)
+                        {
+                          mask_row[x - x1] =
+                            pixel_difference (col,
+                                              src_row + (x - x1) * n_components,
+                                              antialias, threshold,
+                                              n_components, has_alpha,
+                                              select_transparent,
+                                              select_criterion);
+                        }
+                    }
+
+                  gegl_buffer_set (mask_buffer,
+                                   GEGL_RECTANGLE (x1, band->y + row,
+                                                   x2 - x1, 1),
+                                   0, mask_format, mask_row,
+                                   GEGL_AUTO_ROWSTRIDE);
+                }
+            }
+
+          g_free (src_row);
+          g_free (mask_row);
+        });
+    }
+
+  for (i = 0; i < n_bands; i++)
+    {
+      g_array_free (bands[i].runs, TRUE);
+      g_free (bands[i].row_runs);
+    }
+
+  g_free (bands);
+  g_free (parent);
 }
 
 static void
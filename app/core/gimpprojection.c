@@ -41,6 +41,7 @@
 #include "gimppickable.h"
 #include "gimpprojectable.h"
 #include "gimpprojection.h"
+#include "gimpsummedareatable.h"
 #include "gimptilehandlerprojectable.h"
 
 #include "gimp-log.h"
@@ -71,6 +72,7 @@ struct _GimpProjectionPrivate
 
   GeglBuffer                *buffer;
   GimpTileHandlerValidate   *validate_handler;
+  GimpSummedAreaTable       *average_table;
 
   gint                       priority;
 
@@ -235,6 +237,8 @@ gimp_projection_finalize (GObject *object)
 
   gimp_projection_free_buffer (proj);
 
+  g_clear_pointer (&proj->priv->average_table, gimp_summed_area_table_free);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -422,10 +426,14 @@ gimp_projection_get_pixel_average (GimpPickable        *pickable,
                                    const Babl          *format,
                                    gpointer             pixel)
 {
-  GeglBuffer *buffer = gimp_projection_get_buffer (pickable);
+  GimpProjection *proj   = GIMP_PROJECTION (pickable);
+  GeglBuffer     *buffer = gimp_projection_get_buffer (pickable);
 
-  return gimp_gegl_average_color (buffer, rect, TRUE, GEGL_ABYSS_NONE, format,
-                                  pixel);
+  if (! proj->priv->average_table)
+    proj->priv->average_table = gimp_summed_area_table_new ();
+
+  gimp_summed_area_table_get_average (proj->priv->average_table,
+                                      buffer, rect, format, pixel);
 }
 
 static void
@@ -595,6 +603,9 @@ gimp_projection_free_buffer (GimpProjection  *proj)
 
   g_clear_pointer (&proj->priv->update_region, cairo_region_destroy);
 
+  if (proj->priv->average_table)
+    gimp_summed_area_table_invalidate (proj->priv->average_table, NULL);
+
   if (proj->priv->buffer)
     {
       gimp_tile_handler_validate_unassign (proj->priv->validate_handler,
@@ -890,6 +901,12 @@ gimp_projection_paint_area (GimpProjection *proj,
                                 0, 0, width, height,
                                 &x, &y, &w, &h))
     {
+      if (proj->priv->average_table)
+        {
+          gimp_summed_area_table_invalidate (proj->priv->average_table,
+                                             GEGL_RECTANGLE (x, y, w, h));
+        }
+
       if (now)
         {
           gimp_tile_handler_validate_validate (
@@ -110,6 +110,12 @@ static gboolean   gimp_selection_boundary      (GimpChannel         *channel,
                                                 gint                 y1,
                                                 gint                 x2,
                                                 gint                 y2);
+static gboolean   gimp_selection_get_boundary_bounds
+                                               (GimpSelection       *selection,
+                                                gint                *x1,
+                                                gint                *y1,
+                                                gint                *x2,
+                                                gint                *y2);
 static gboolean   gimp_selection_is_empty      (GimpChannel         *channel);
 static void       gimp_selection_feather       (GimpChannel         *channel,
                                                 gdouble              radius_x,
@@ -418,11 +424,52 @@ gimp_selection_boundary (GimpChannel         *channel,
                          gint                 unused3,
                          gint                 unused4)
 {
-  GimpImage    *image = gimp_item_get_image (GIMP_ITEM (channel));
+  GimpImage *image = gimp_item_get_image (GIMP_ITEM (channel));
+  GimpLayer *layer;
+  gint       x1, y1;
+  gint       x2, y2;
+  gboolean   retval;
+
+  if (! gimp_selection_get_boundary_bounds (GIMP_SELECTION (channel),
+                                            &x1, &y1, &x2, &y2))
+    {
+      *segs_in      = NULL;
+      *segs_out     = NULL;
+      *num_segs_in  = 0;
+      *num_segs_out = 0;
+
+      return FALSE;
+    }
+
+  retval = GIMP_CHANNEL_CLASS (parent_class)->boundary (channel,
+                                                        segs_in, segs_out,
+                                                        num_segs_in,
+                                                        num_segs_out,
+                                                        x1, y1, x2, y2);
+
+  if ((layer = gimp_image_get_floating_selection (image)))
+    {
+      /*  Find the floating selection boundary  */
+      *segs_in = floating_sel_boundary (layer, num_segs_in);
+
+      return TRUE;
+    }
+
+  return retval;
+}
+
+static gboolean
+gimp_selection_get_boundary_bounds (GimpSelection *selection,
+                                    gint          *x1,
+                                    gint          *y1,
+                                    gint          *x2,
+                                    gint          *y2)
+{
+  GimpImage    *image = gimp_item_get_image (GIMP_ITEM (selection));
   GimpDrawable *drawable;
   GimpLayer    *layer;
 
-  if ((layer = gimp_image_get_floating_selection (image)))
+  if (gimp_image_get_floating_selection (image))
     {
       /*  If there is a floating selection, then
        *  we need to do some slightly different boundaries.
@@ -432,15 +479,10 @@ gimp_selection_boundary (GimpChannel         *channel,
        *  the floating selection.  The outside boundary (doesn't move,
        *  is black/gray) is defined as the normal selection mask
        */
-
-      /*  Find the selection mask boundary  */
-      GIMP_CHANNEL_CLASS (parent_class)->boundary (channel,
-                                                   segs_in, segs_out,
-                                                   num_segs_in, num_segs_out,
-                                                   0, 0, 0, 0);
-
-      /*  Find the floating selection boundary  */
-      *segs_in = floating_sel_boundary (layer, num_segs_in);
+      *x1 = 0;
+      *y1 = 0;
+      *x2 = 0;
+      *y2 = 0;
 
       return TRUE;
     }
@@ -448,46 +490,32 @@ gimp_selection_boundary (GimpChannel         *channel,
            GIMP_IS_CHANNEL (drawable))
     {
       /*  Otherwise, return the boundary...if a channel is active  */
+      *x1 = 0;
+      *y1 = 0;
+      *x2 = gimp_image_get_width  (image);
+      *y2 = gimp_image_get_height (image);
 
-      return GIMP_CHANNEL_CLASS (parent_class)->boundary (channel,
-                                                          segs_in, segs_out,
-                                                          num_segs_in,
-                                                          num_segs_out,
-                                                          0, 0,
-                                                          gimp_image_get_width  (image),
-                                                          gimp_image_get_height (image));
+      return TRUE;
     }
   else if ((layer = gimp_image_get_active_layer (image)))
     {
       /*  If a layer is active, we return multiple boundaries based
        *  on the extents
        */
-
-      gint x1, y1;
-      gint x2, y2;
       gint offset_x;
       gint offset_y;
 
       gimp_item_get_offset (GIMP_ITEM (layer), &offset_x, &offset_y);
 
-      x1 = CLAMP (offset_x, 0, gimp_image_get_width  (image));
-      y1 = CLAMP (offset_y, 0, gimp_image_get_height (image));
-      x2 = CLAMP (offset_x + gimp_item_get_width (GIMP_ITEM (layer)),
-                  0, gimp_image_get_width (image));
-      y2 = CLAMP (offset_y + gimp_item_get_height (GIMP_ITEM (layer)),
-                  0, gimp_image_get_height (image));
-
-      return GIMP_CHANNEL_CLASS (parent_class)->boundary (channel,
-                                                          segs_in, segs_out,
-                                                          num_segs_in,
-                                                          num_segs_out,
-                                                          x1, y1, x2, y2);
-    }
+      *x1 = CLAMP (offset_x, 0, gimp_image_get_width  (image));
+      *y1 = CLAMP (offset_y, 0, gimp_image_get_height (image));
+      *x2 = CLAMP (offset_x + gimp_item_get_width (GIMP_ITEM (layer)),
+                   0, gimp_image_get_width (image));
+      *y2 = CLAMP (offset_y + gimp_item_get_height (GIMP_ITEM (layer)),
+                   0, gimp_image_get_height (image));
 
-  *segs_in      = NULL;
-  *segs_out     = NULL;
-  *num_segs_in  = 0;
-  *num_segs_out = 0;
+      return TRUE;
+    }
 
   return FALSE;
 }
@@ -640,6 +668,24 @@ gimp_selection_resume (GimpSelection *selection)
   return selection->suspend_count;
 }
 
+/*  Starts computing the selection's boundary in a separate thread,
+ *  see gimp_channel_boundary_async().
+ */
+GimpAsync *
+gimp_selection_boundary_async (GimpSelection *selection)
+{
+  gint x1, y1;
+  gint x2, y2;
+
+  g_return_val_if_fail (GIMP_IS_SELECTION (selection), NULL);
+
+  if (! gimp_selection_get_boundary_bounds (selection, &x1, &y1, &x2, &y2))
+    return NULL;
+
+  return gimp_channel_boundary_async (GIMP_CHANNEL (selection),
+                                      x1, y1, x2, y2);
+}
+
 GeglBuffer *
 gimp_selection_extract (GimpSelection *selection,
                         GimpPickable  *pickable,
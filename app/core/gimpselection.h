@@ -54,6 +54,9 @@ GimpChannel * gimp_selection_new      (GimpImage     *image,
 gint          gimp_selection_suspend  (GimpSelection *selection);
 gint          gimp_selection_resume   (GimpSelection *selection);
 
+GimpAsync   * gimp_selection_boundary_async
+                                      (GimpSelection *selection);
+
 GeglBuffer  * gimp_selection_extract  (GimpSelection *selection,
                                        GimpPickable  *pickable,
                                        GimpContext   *context,
@@ -0,0 +1,405 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpsummedareatable.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* A cache of summed-area tables (integral images) of a buffer, used for
+ * averaging arbitrary rectangles of the buffer in time proportional to
+ * the number of blocks the rectangle touches, rather than to its area.
+ *
+ * The buffer is divided into BLOCK_SIZE x BLOCK_SIZE blocks, each of
+ * which gets its own table when it's first needed.  Owners of the
+ * buffer must invalidate the changed areas.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "core-types.h"
+
+#include "gegl/gimp-gegl-loops.h"
+
+#include "gimpsummedareatable.h"
+
+
+/*  the size of the blocks, in pixels  */
+#define BLOCK_SIZE   64
+
+/*  the maximal number of blocks kept in the cache  */
+#define MAX_BLOCKS   128
+
+/*  the maximal number of blocks in each direction  */
+#define MAX_INDEX    (1 << 16)
+
+/*  smaller areas are averaged directly  */
+#define MIN_AREA     (BLOCK_SIZE * BLOCK_SIZE)
+
+
+typedef struct
+{
+  GList          link;
+  guint          key;
+  GeglRectangle  rect;
+
+  /*  (rect.width + 1) x (rect.height + 1) premultiplied RGBA sums, where
+   *  each entry is the sum of the pixels above and to the left of it
+   */
+  gfloat        *sat;
+} Block;
+
+typedef struct
+{
+  GeglBuffer     *buffer;
+  const Babl     *format;
+  Block         **blocks;
+} ComputeData;
+
+struct _GimpSummedAreaTable
+{
+  GeglBuffer     *buffer;
+  GeglRectangle   extent;
+  const Babl     *buffer_format;
+  const Babl     *sat_format;
+
+  GHashTable     *blocks;
+  GQueue          lru;        /*  most recently used blocks first  */
+};
+
+
+/*  local function prototypes  */
+
+static void   gimp_summed_area_table_block_free    (Block               *block);
+static void   gimp_summed_area_table_compute_range (gsize                offset,
+                                                    gsize                size,
+                                                    const ComputeData   *data);
+static void   gimp_summed_area_table_set_buffer    (GimpSummedAreaTable *table,
+                                                    GeglBuffer          *buffer);
+
+
+/*  public functions  */
+
+GimpSummedAreaTable *
+gimp_summed_area_table_new (void)
+{
+  GimpSummedAreaTable *table = g_slice_new0 (GimpSummedAreaTable);
+
+  table->blocks = g_hash_table_new_full (
+    g_direct_hash, g_direct_equal,
+    NULL, (GDestroyNotify) gimp_summed_area_table_block_free);
+
+  g_queue_init (&table->lru);
+
+  return table;
+}
+
+void
+gimp_summed_area_table_free (GimpSummedAreaTable *table)
+{
+  g_return_if_fail (table != NULL);
+
+  gimp_summed_area_table_invalidate (table, NULL);
+
+  g_hash_table_unref (table->blocks);
+
+  g_slice_free (GimpSummedAreaTable, table);
+}
+
+void
+gimp_summed_area_table_invalidate (GimpSummedAreaTable *table,
+                                   const GeglRectangle *rect)
+{
+  GHashTableIter iter;
+  Block         *block;
+
+  g_return_if_fail (table != NULL);
+
+  if (! rect)
+    {
+      g_hash_table_remove_all (table->blocks);
+      g_queue_init (&table->lru);
+
+      g_clear_object (&table->buffer);
+
+      return;
+    }
+
+  g_hash_table_iter_init (&iter, table->blocks);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &block))
+    {
+      if (gegl_rectangle_intersect (NULL, &block->rect, rect))
+        {
+          g_queue_unlink (&table->lru, &block->link);
+
+          g_hash_table_iter_remove (&iter);
+        }
+    }
+}
+
+void
+gimp_summed_area_table_get_average (GimpSummedAreaTable *table,
+                                    GeglBuffer          *buffer,
+                                    const GeglRectangle *rect,
+                                    const Babl          *format,
+                                    gpointer             pixel)
+{
+  const GeglRectangle *extent;
+  GeglRectangle        roi;
+  GPtrArray           *used;
+  GPtrArray           *missing;
+  Block               *block;
+  gdouble              average[4] = {};
+  gint                 bx0, by0;
+  gint                 bx1, by1;
+  gint                 bx,  by;
+  guint                i;
+  gint                 c;
+
+  g_return_if_fail (table != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (rect != NULL);
+  g_return_if_fail (pixel != NULL);
+
+  if (! format)
+    format = gegl_buffer_get_format (buffer);
+
+  extent = gegl_buffer_get_extent (buffer);
+
+  gegl_rectangle_intersect (&roi, rect, extent);
+
+  if ((gint64) roi.width * roi.height < MIN_AREA ||
+      extent->width  > (gint64) BLOCK_SIZE * MAX_INDEX ||
+      extent->height > (gint64) BLOCK_SIZE * MAX_INDEX)
+    {
+      gimp_gegl_average_color (buffer, rect, TRUE, GEGL_ABYSS_NONE,
+                               format, pixel);
+
+      return;
+    }
+
+  bx0 = (roi.x                  - extent->x) / BLOCK_SIZE;
+  by0 = (roi.y                  - extent->y) / BLOCK_SIZE;
+  bx1 = (roi.x + roi.width  - 1 - extent->x) / BLOCK_SIZE;
+  by1 = (roi.y + roi.height - 1 - extent->y) / BLOCK_SIZE;
+
+  /*  don't build more tables than the cache can hold, the memory used
+   *  by averaging directly doesn't depend on the area
+   */
+  if ((gint64) (bx1 - bx0 + 1) * (by1 - by0 + 1) > MAX_BLOCKS)
+    {
+      gimp_gegl_average_color (buffer, rect, TRUE, GEGL_ABYSS_NONE,
+                               format, pixel);
+
+      return;
+    }
+
+  gimp_summed_area_table_set_buffer (table, buffer);
+
+  used    = g_ptr_array_sized_new ((bx1 - bx0 + 1) * (by1 - by0 + 1));
+  missing = g_ptr_array_new ();
+
+  for (by = by0; by <= by1; by++)
+    {
+      for (bx = bx0; bx <= bx1; bx++)
+        {
+          guint key = ((guint) by << 16) | (guint) bx;
+
+          block = g_hash_table_lookup (table->blocks, GUINT_TO_POINTER (key));
+
+          if (block)
+            {
+              g_queue_unlink (&table->lru, &block->link);
+            }
+          else
+            {
+              block = g_slice_new0 (Block);
+
+              block->link.data = block;
+              block->key       = key;
+              block->rect      = *GEGL_RECTANGLE (extent->x + bx * BLOCK_SIZE,
+                                                  extent->y + by * BLOCK_SIZE,
+                                                  BLOCK_SIZE, BLOCK_SIZE);
+
+              gegl_rectangle_intersect (&block->rect, &block->rect, extent);
+
+              g_hash_table_insert (table->blocks,
+                                   GUINT_TO_POINTER (key), block);
+
+              g_ptr_array_add (missing, block);
+            }
+
+          g_queue_push_head_link (&table->lru, &block->link);
+
+          g_ptr_array_add (used, block);
+        }
+    }
+
+  if (missing->len > 0)
+    {
+      ComputeData data;
+
+      data.buffer = buffer;
+      data.format = table->sat_format;
+      data.blocks = (Block **) missing->pdata;
+
+      gegl_parallel_distribute_range (
+        missing->len, 1,
+        (GeglParallelDistributeRangeFunc) gimp_summed_area_table_compute_range,
+        &data);
+    }
+
+  for (i = 0; i < used->len; i++)
+    {
+      GeglRectangle  sub;
+      const gfloat  *sat;
+      gint           stride;
+      gint           x0, y0;
+      gint           x1, y1;
+
+      block = used->pdata[i];
+
+      gegl_rectangle_intersect (&sub, &block->rect, &roi);
+
+      x0 = sub.x - block->rect.x;
+      y0 = sub.y - block->rect.y;
+      x1 = x0 + sub.width;
+      y1 = y0 + sub.height;
+
+      sat    = block->sat;
+      stride = 4 * (block->rect.width + 1);
+
+      for (c = 0; c < 4; c++)
+        {
+          average[c] += (gdouble) sat[y1 * stride + 4 * x1 + c] -
+                        (gdouble) sat[y0 * stride + 4 * x1 + c] -
+                        (gdouble) sat[y1 * stride + 4 * x0 + c] +
+                        (gdouble) sat[y0 * stride + 4 * x0 + c];
+        }
+    }
+
+  g_ptr_array_free (missing, TRUE);
+  g_ptr_array_free (used,    TRUE);
+
+  while (table->lru.length > MAX_BLOCKS)
+    {
+      block = g_queue_peek_tail (&table->lru);
+
+      g_queue_unlink (&table->lru, &block->link);
+
+      g_hash_table_remove (table->blocks, GUINT_TO_POINTER (block->key));
+    }
+
+  for (c = 0; c < 4; c++)
+    average[c] /= (gdouble) roi.width * roi.height;
+
+  babl_process (babl_fish (babl_format_with_space (
+                             "RaGaBaA double",
+                             babl_format_get_space (table->sat_format)),
+                           format),
+                average, pixel, 1);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_summed_area_table_block_free (Block *block)
+{
+  g_free (block->sat);
+
+  g_slice_free (Block, block);
+}
+
+static void
+gimp_summed_area_table_compute_range (gsize              offset,
+                                      gsize              size,
+                                      const ComputeData *data)
+{
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      Block        *block  = data->blocks[i];
+      gint          width  = block->rect.width;
+      gint          height = block->rect.height;
+      gint          stride = 4 * (width + 1);
+      gfloat       *pixels;
+      const gfloat *p;
+      gint          x;
+      gint          y;
+      gint          c;
+
+      pixels = g_new (gfloat, 4 * width * height);
+
+      gegl_buffer_get (data->buffer, &block->rect, 1.0,
+                       data->format, pixels,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      /*  the first row and column are all zeros  */
+      block->sat = g_new0 (gfloat, stride * (height + 1));
+
+      p = pixels;
+
+      for (y = 0; y < height; y++)
+        {
+          const gfloat *prev   = block->sat + y       * stride;
+          gfloat       *cur    = block->sat + (y + 1) * stride;
+          gfloat        row[4] = {};
+
+          for (x = 0; x < width; x++)
+            {
+              for (c = 0; c < 4; c++)
+                {
+                  row[c] += p[c];
+
+                  cur[4 * (x + 1) + c] = prev[4 * (x + 1) + c] + row[c];
+                }
+
+              p += 4;
+            }
+        }
+
+      g_free (pixels);
+    }
+}
+
+static void
+gimp_summed_area_table_set_buffer (GimpSummedAreaTable *table,
+                                   GeglBuffer          *buffer)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer);
+  const Babl          *format = gegl_buffer_get_format (buffer);
+
+  /*  we keep a reference to the buffer, so that a different buffer
+   *  can't end up at the same address
+   */
+  if (buffer == table->buffer                      &&
+      gegl_rectangle_equal (extent, &table->extent) &&
+      format == table->buffer_format)
+    {
+      return;
+    }
+
+  gimp_summed_area_table_invalidate (table, NULL);
+
+  table->buffer        = g_object_ref (buffer);
+  table->extent        = *extent;
+  table->buffer_format = format;
+  table->sat_format    = babl_format_with_space ("RaGaBaA float",
+                                                 babl_format_get_space (format));
+}
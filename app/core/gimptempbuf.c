@@ -34,6 +34,19 @@
 
 #define LOCK_DATA_ALIGNMENT 16
 
+/*  the data of temp bufs is allocated in power-of-two size classes,
+ *  between 2^POOL_MIN_CLASS and 2^POOL_MAX_CLASS bytes, and released
+ *  blocks are kept for reuse, as long as the total size of the kept
+ *  blocks fits in the pool size.  each thread keeps up to
+ *  POOL_N_THREAD_BLOCKS blocks of each class for itself, the rest are
+ *  shared.  the pool size comes from GimpGeglConfig, and until it's
+ *  set, nothing is kept.
+ */
+#define POOL_MIN_CLASS       8  /* 256 bytes */
+#define POOL_MAX_CLASS       24 /* 16 MiB    */
+#define POOL_N_CLASSES       (POOL_MAX_CLASS - POOL_MIN_CLASS + 1)
+#define POOL_N_THREAD_BLOCKS 2
+
 
 struct _GimpTempBuf
 {
@@ -42,6 +55,7 @@ struct _GimpTempBuf
   gint        height;
   const Babl *format;
   guchar     *data;
+  gsize       data_alloc_size;
 };
 
 typedef struct
@@ -52,10 +66,54 @@ typedef struct
 
 G_STATIC_ASSERT (sizeof (LockData) <= LOCK_DATA_ALIGNMENT);
 
+typedef struct _PoolBlock PoolBlock;
+
+struct _PoolBlock
+{
+  PoolBlock *next;
+};
+
+typedef struct
+{
+  PoolBlock *blocks[POOL_N_CLASSES];
+  gint       n_blocks[POOL_N_CLASSES];
+
+  /*  the pool generation the blocks were kept in  */
+  gint       generation;
+} ThreadPool;
+
+
+/*  local function prototypes  */
+
+static gint         gimp_temp_buf_get_pool_class   (gsize       size);
+static guchar     * gimp_temp_buf_data_alloc       (gsize       size,
+                                                    gsize      *alloc_size);
+static void         gimp_temp_buf_data_free        (guchar     *data,
+                                                    gsize       alloc_size);
+
+static ThreadPool * gimp_temp_buf_get_thread_pool  (gboolean    create);
+static void         gimp_temp_buf_thread_pool_trim (ThreadPool *thread_pool);
+static void         gimp_temp_buf_thread_pool_free (ThreadPool *thread_pool);
+
 
 /*  local variables  */
 
-static guintptr gimp_temp_buf_total_memsize = 0;
+static guintptr   gimp_temp_buf_total_memsize = 0;
+
+static guintptr   gimp_temp_buf_pool_memsize  = 0;
+static guintptr   gimp_temp_buf_pool_size     = 0;
+
+/*  changing the pool size starts a new generation, the blocks the
+ *  threads kept in earlier generations are released the next time they
+ *  use the pool
+ */
+static gint       gimp_temp_buf_pool_generation = 0;
+
+static GMutex     gimp_temp_buf_pool_mutex;
+static PoolBlock *gimp_temp_buf_pool[POOL_N_CLASSES];
+
+static GPrivate   gimp_temp_buf_thread_pool =
+  G_PRIVATE_INIT ((GDestroyNotify) gimp_temp_buf_thread_pool_free);
 
 
 /*  public functions  */
@@ -81,7 +139,8 @@ gimp_temp_buf_new (gint        width,
   temp->width     = width;
   temp->height    = height;
   temp->format    = format;
-  temp->data      = gegl_malloc ((gsize) width * height * bpp);
+  temp->data      = gimp_temp_buf_data_alloc ((gsize) width * height * bpp,
+                                              &temp->data_alloc_size);
 
   g_atomic_pointer_add (&gimp_temp_buf_total_memsize,
                         +gimp_temp_buf_get_memsize (temp));
@@ -175,7 +234,7 @@ gimp_temp_buf_unref (const GimpTempBuf *buf)
 
 
       if (buf->data)
-        gegl_free (buf->data);
+        gimp_temp_buf_data_free (buf->data, buf->data_alloc_size);
 
       g_slice_free (GimpTempBuf, (GimpTempBuf *) buf);
     }
@@ -441,10 +500,253 @@ gimp_gegl_buffer_get_temp_buf (GeglBuffer *buffer)
 }
 
 
+/*  public functions (pool)  */
+
+void
+gimp_temp_buf_set_pool_size (guint64 size)
+{
+  PoolBlock *blocks = NULL;
+  gint       i;
+
+  size = MIN (size, G_MAXSIZE);
+
+  g_mutex_lock (&gimp_temp_buf_pool_mutex);
+
+  g_atomic_pointer_set (&gimp_temp_buf_pool_size, size);
+
+  g_atomic_int_inc (&gimp_temp_buf_pool_generation);
+
+  /*  release shared blocks, starting from the largest classes, until the
+   *  pool fits in the new size
+   */
+  for (i = POOL_N_CLASSES - 1;
+       i >= 0 && g_atomic_pointer_get (&gimp_temp_buf_pool_memsize) > size;
+       i--)
+    {
+      while (gimp_temp_buf_pool[i] &&
+             g_atomic_pointer_get (&gimp_temp_buf_pool_memsize) > size)
+        {
+          PoolBlock *block = gimp_temp_buf_pool[i];
+
+          gimp_temp_buf_pool[i] = block->next;
+
+          block->next = blocks;
+          blocks      = block;
+
+          g_atomic_pointer_add (&gimp_temp_buf_pool_memsize,
+                                -((gssize) 1 << (i + POOL_MIN_CLASS)));
+        }
+    }
+
+  g_mutex_unlock (&gimp_temp_buf_pool_mutex);
+
+  while (blocks)
+    {
+      PoolBlock *block = blocks;
+
+      blocks = block->next;
+
+      gegl_free (block);
+    }
+
+  /*  release the calling thread's own blocks right away  */
+  gimp_temp_buf_get_thread_pool (FALSE);
+}
+
+
 /*  public functions (stats)  */
 
 guint64
 gimp_temp_buf_get_total_memsize (void)
 {
-  return gimp_temp_buf_total_memsize;
+  return gimp_temp_buf_total_memsize +
+         gimp_temp_buf_pool_memsize;
+}
+
+guint64
+gimp_temp_buf_get_pool_memsize (void)
+{
+  return gimp_temp_buf_pool_memsize;
+}
+
+
+/*  private functions  */
+
+static gint
+gimp_temp_buf_get_pool_class (gsize size)
+{
+  if (size <= ((gsize) 1 << POOL_MIN_CLASS))
+    return 0;
+  else if (size > ((gsize) 1 << POOL_MAX_CLASS))
+    return -1;
+
+  return g_bit_storage (size - 1) - POOL_MIN_CLASS;
+}
+
+static guchar *
+gimp_temp_buf_data_alloc (gsize  size,
+                          gsize *alloc_size)
+{
+  ThreadPool *thread_pool;
+  PoolBlock  *block = NULL;
+  gint        pool_class;
+
+  pool_class = gimp_temp_buf_get_pool_class (size);
+
+  if (pool_class < 0)
+    {
+      *alloc_size = size;
+
+      return gegl_malloc (size);
+    }
+
+  *alloc_size = (gsize) 1 << (pool_class + POOL_MIN_CLASS);
+
+  thread_pool = gimp_temp_buf_get_thread_pool (FALSE);
+
+  if (thread_pool && thread_pool->n_blocks[pool_class] > 0)
+    {
+      block = thread_pool->blocks[pool_class];
+
+      thread_pool->blocks[pool_class] = block->next;
+      thread_pool->n_blocks[pool_class]--;
+    }
+  else if (g_atomic_pointer_get (&gimp_temp_buf_pool[pool_class]))
+    {
+      g_mutex_lock (&gimp_temp_buf_pool_mutex);
+
+      block = gimp_temp_buf_pool[pool_class];
+
+      if (block)
+        gimp_temp_buf_pool[pool_class] = block->next;
+
+      g_mutex_unlock (&gimp_temp_buf_pool_mutex);
+    }
+
+  if (block)
+    {
+      g_atomic_pointer_add (&gimp_temp_buf_pool_memsize,
+                            -(gssize) *alloc_size);
+
+      return (guchar *) block;
+    }
+
+  return gegl_malloc (*alloc_size);
+}
+
+static void
+gimp_temp_buf_data_free (guchar *data,
+                         gsize   alloc_size)
+{
+  ThreadPool *thread_pool;
+  PoolBlock  *block = (PoolBlock *) data;
+  gint        pool_class;
+  guintptr    pool_memsize;
+
+  pool_class = gimp_temp_buf_get_pool_class (alloc_size);
+
+  if (pool_class < 0)
+    {
+      gegl_free (data);
+
+      return;
+    }
+
+  /*  reserve room for the block in the pool, or free it if there's none  */
+  do
+    {
+      pool_memsize = g_atomic_pointer_get (&gimp_temp_buf_pool_memsize);
+
+      if (pool_memsize + alloc_size >
+          g_atomic_pointer_get (&gimp_temp_buf_pool_size))
+        {
+          gegl_free (data);
+
+          return;
+        }
+    }
+  while (! g_atomic_pointer_compare_and_exchange (&gimp_temp_buf_pool_memsize,
+                                                  pool_memsize,
+                                                  pool_memsize + alloc_size));
+
+  thread_pool = gimp_temp_buf_get_thread_pool (TRUE);
+
+  if (thread_pool->n_blocks[pool_class] < POOL_N_THREAD_BLOCKS)
+    {
+      block->next = thread_pool->blocks[pool_class];
+
+      thread_pool->blocks[pool_class] = block;
+      thread_pool->n_blocks[pool_class]++;
+    }
+  else
+    {
+      g_mutex_lock (&gimp_temp_buf_pool_mutex);
+
+      block->next = gimp_temp_buf_pool[pool_class];
+
+      gimp_temp_buf_pool[pool_class] = block;
+
+      g_mutex_unlock (&gimp_temp_buf_pool_mutex);
+    }
+}
+
+static ThreadPool *
+gimp_temp_buf_get_thread_pool (gboolean create)
+{
+  ThreadPool *thread_pool;
+  gint        generation;
+
+  thread_pool = g_private_get (&gimp_temp_buf_thread_pool);
+  generation  = g_atomic_int_get (&gimp_temp_buf_pool_generation);
+
+  if (thread_pool)
+    {
+      if (thread_pool->generation != generation)
+        {
+          gimp_temp_buf_thread_pool_trim (thread_pool);
+
+          thread_pool->generation = generation;
+        }
+    }
+  else if (create)
+    {
+      thread_pool = g_slice_new0 (ThreadPool);
+
+      thread_pool->generation = generation;
+
+      g_private_set (&gimp_temp_buf_thread_pool, thread_pool);
+    }
+
+  return thread_pool;
+}
+
+static void
+gimp_temp_buf_thread_pool_trim (ThreadPool *thread_pool)
+{
+  gint i;
+
+  for (i = 0; i < POOL_N_CLASSES; i++)
+    {
+      while (thread_pool->blocks[i])
+        {
+          PoolBlock *block = thread_pool->blocks[i];
+
+          thread_pool->blocks[i] = block->next;
+
+          gegl_free (block);
+
+          g_atomic_pointer_add (&gimp_temp_buf_pool_memsize,
+                                -((gssize) 1 << (i + POOL_MIN_CLASS)));
+        }
+
+      thread_pool->n_blocks[i] = 0;
+    }
+}
+
+static void
+gimp_temp_buf_thread_pool_free (ThreadPool *thread_pool)
+{
+  gimp_temp_buf_thread_pool_trim (thread_pool);
+
+  g_slice_free (ThreadPool, thread_pool);
 }
@@ -59,9 +59,15 @@ GdkPixbuf   * gimp_temp_buf_create_pixbuf     (const GimpTempBuf *temp_buf) G_GN
 GimpTempBuf * gimp_gegl_buffer_get_temp_buf   (GeglBuffer        *buffer);
 
 
+/*  pool  */
+
+void          gimp_temp_buf_set_pool_size     (guint64            size);
+
+
 /*  stats  */
 
 guint64       gimp_temp_buf_get_total_memsize (void);
+guint64       gimp_temp_buf_get_pool_memsize  (void);
 
 
 #endif  /*  __GIMP_TEMP_BUF_H__  */
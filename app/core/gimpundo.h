@@ -61,6 +61,9 @@ struct _GimpUndo
 
   GimpTempBuf      *preview;
   guint             preview_idle_id;
+
+  gint64            memsize;        /* size, as last measured by the stack */
+  gint64            gui_size;       /* GUI size, likewise                  */
 };
 
 struct _GimpUndoClass
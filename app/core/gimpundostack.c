@@ -22,7 +22,9 @@
 
 #include "core-types.h"
 
+#include "gimp-memsize.h"
 #include "gimpimage.h"
+#include "gimpimage-undo.h"
 #include "gimplist.h"
 #include "gimpundo.h"
 #include "gimpundostack.h"
@@ -39,12 +41,24 @@ static void    gimp_undo_stack_pop         (GimpUndo            *undo,
 static void    gimp_undo_stack_free        (GimpUndo            *undo,
                                             GimpUndoMode         undo_mode);
 
+static void    gimp_undo_stack_add_memsize (GimpUndoStack       *stack,
+                                            gint64               memsize,
+                                            gint64               gui_size);
+static void    gimp_undo_stack_measure     (GimpUndoStack       *stack,
+                                            GimpUndo            *undo);
+static void    gimp_undo_stack_forget      (GimpUndoStack       *stack,
+                                            GimpUndo            *undo);
+
 
 G_DEFINE_TYPE (GimpUndoStack, gimp_undo_stack, GIMP_TYPE_UNDO)
 
 #define parent_class gimp_undo_stack_parent_class
 
 
+/*  the total size of the undo and redo stacks of all images  */
+static volatile guintptr gimp_undo_stack_total_memsize = 0;
+
+
 static void
 gimp_undo_stack_class_init (GimpUndoStackClass *klass)
 {
@@ -71,6 +85,12 @@ gimp_undo_stack_finalize (GObject *object)
 {
   GimpUndoStack *stack = GIMP_UNDO_STACK (object);
 
+  if (stack->counted_memsize)
+    {
+      g_atomic_pointer_add (&gimp_undo_stack_total_memsize,
+                            -stack->counted_memsize);
+    }
+
   g_clear_object (&stack->undos);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -81,9 +101,21 @@ gimp_undo_stack_get_memsize (GimpObject *object,
                              gint64     *gui_size)
 {
   GimpUndoStack *stack   = GIMP_UNDO_STACK (object);
+  GimpUndo      *undo;
   gint64         memsize = 0;
 
-  memsize += gimp_object_get_memsize (GIMP_OBJECT (stack->undos), gui_size);
+  /*  the undos' sizes are recorded when they are pushed, but the top
+   *  undo may still change, re-measure it
+   */
+  undo = gimp_undo_stack_peek (stack);
+
+  if (undo)
+    gimp_undo_stack_measure (stack, undo);
+
+  memsize   += gimp_g_object_get_memsize (G_OBJECT (stack->undos)) +
+               gimp_g_queue_get_memsize (GIMP_LIST (stack->undos)->queue, 0) +
+               stack->memsize;
+  *gui_size += stack->gui_size;
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -120,6 +152,8 @@ gimp_undo_stack_free (GimpUndo     *undo,
     {
       GimpUndo *child = list->data;
 
+      gimp_undo_stack_forget (stack, child);
+
       gimp_undo_free (child, undo_mode);
       g_object_unref (child);
     }
@@ -141,10 +175,20 @@ void
 gimp_undo_stack_push_undo (GimpUndoStack *stack,
                            GimpUndo      *undo)
 {
+  GimpUndo *top;
+
   g_return_if_fail (GIMP_IS_UNDO_STACK (stack));
   g_return_if_fail (GIMP_IS_UNDO (undo));
 
+  /*  the previous top undo is final now, update its size  */
+  top = gimp_undo_stack_peek (stack);
+
+  if (top)
+    gimp_undo_stack_measure (stack, top);
+
   gimp_container_add (stack->undos, GIMP_OBJECT (undo));
+
+  gimp_undo_stack_measure (stack, undo);
 }
 
 GimpUndo *
@@ -161,6 +205,8 @@ gimp_undo_stack_pop_undo (GimpUndoStack       *stack,
 
   if (undo)
     {
+      gimp_undo_stack_forget (stack, undo);
+
       gimp_container_remove (stack->undos, GIMP_OBJECT (undo));
       gimp_undo_pop (undo, undo_mode, accum);
 
@@ -182,6 +228,8 @@ gimp_undo_stack_free_bottom (GimpUndoStack *stack,
 
   if (undo)
     {
+      gimp_undo_stack_forget (stack, undo);
+
       gimp_container_remove (stack->undos, GIMP_OBJECT (undo));
       gimp_undo_free (undo, undo_mode);
 
@@ -206,3 +254,71 @@ gimp_undo_stack_get_depth (GimpUndoStack *stack)
 
   return gimp_container_get_n_children (stack->undos);
 }
+
+/**
+ * gimp_undo_stack_get_total_memsize:
+ *
+ * Returns the total size of the undo and redo stacks of all images.
+ * Unlike most functions in this file, this one may be called from
+ * any thread.
+ *
+ * Return value: the total size of all undo histories.
+ **/
+guint64
+gimp_undo_stack_get_total_memsize (void)
+{
+  return (guintptr) g_atomic_pointer_get (&gimp_undo_stack_total_memsize);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_undo_stack_add_memsize (GimpUndoStack *stack,
+                             gint64         memsize,
+                             gint64         gui_size)
+{
+  GimpImage *image = GIMP_UNDO (stack)->image;
+
+  stack->memsize  += memsize;
+  stack->gui_size += gui_size;
+
+  /*  only count the image's own stacks in the global total, group
+   *  stacks are included in the size of the groups
+   */
+  if (stack->counted_memsize ||
+      (image && (stack == gimp_image_get_undo_stack (image) ||
+                 stack == gimp_image_get_redo_stack (image))))
+    {
+      stack->counted_memsize += memsize;
+
+      g_atomic_pointer_add (&gimp_undo_stack_total_memsize, memsize);
+    }
+}
+
+static void
+gimp_undo_stack_measure (GimpUndoStack *stack,
+                         GimpUndo      *undo)
+{
+  gint64 memsize;
+  gint64 gui_size = 0;
+
+  memsize = gimp_object_get_memsize (GIMP_OBJECT (undo), &gui_size);
+
+  gimp_undo_stack_add_memsize (stack,
+                               memsize  - undo->memsize,
+                               gui_size - undo->gui_size);
+
+  undo->memsize  = memsize;
+  undo->gui_size = gui_size;
+}
+
+static void
+gimp_undo_stack_forget (GimpUndoStack *stack,
+                        GimpUndo      *undo)
+{
+  gimp_undo_stack_add_memsize (stack, -undo->memsize, -undo->gui_size);
+
+  undo->memsize  = 0;
+  undo->gui_size = 0;
+}
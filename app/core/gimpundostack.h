@@ -37,6 +37,10 @@ struct _GimpUndoStack
   GimpUndo       parent_instance;
 
   GimpContainer *undos;
+
+  gint64         memsize;         /*  total size of the undos            */
+  gint64         gui_size;        /*  total GUI size of the undos        */
+  gint64         counted_memsize; /*  part of memsize in the global total */
 };
 
 struct _GimpUndoStackClass
@@ -60,5 +64,8 @@ GimpUndo      * gimp_undo_stack_free_bottom (GimpUndoStack       *stack,
 GimpUndo      * gimp_undo_stack_peek        (GimpUndoStack       *stack);
 gint            gimp_undo_stack_get_depth   (GimpUndoStack       *stack);
 
+guint64         gimp_undo_stack_get_total_memsize
+                                            (void);
+
 
 #endif /* __GIMP_UNDO_STACK_H__ */
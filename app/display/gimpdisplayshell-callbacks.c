@@ -128,7 +128,8 @@ gimp_display_shell_canvas_tick (GtkWidget     *widget,
                                 GdkFrameClock *frame_clock,
                                 TickClosure   *tick)
 {
-  GimpDisplayShell *shell = tick->shell;
+  GimpDisplayShell *shell   = tick->shell;
+  gboolean          rescale = FALSE;
   GtkAllocation     allocation;
 
   gtk_widget_get_allocation (widget, &allocation);
@@ -159,10 +160,14 @@ gimp_display_shell_canvas_tick (GtkWidget     *widget,
           offset_x = UNSCALEX (shell, shell->offset_x);
           offset_y = UNSCALEX (shell, shell->offset_y);
 
+          gimp_display_shell_render_save_level (shell);
+
           gimp_zoom_model_zoom (shell->zoom, GIMP_ZOOM_TO, scale);
 
           shell->offset_x = SCALEX (shell, offset_x);
           shell->offset_y = SCALEY (shell, offset_y);
+
+          rescale = TRUE;
         }
 
       /* When we size-allocate due to resize of the top level window,
@@ -211,6 +216,11 @@ gimp_display_shell_canvas_tick (GtkWidget     *widget,
         }
 
       gimp_display_shell_scroll_clamp_and_update (shell);
+
+      /*  refill the render cache for the new scale and offsets  */
+      if (rescale)
+        gimp_display_shell_render_rescale (shell);
+
       gimp_display_shell_scaled (shell);
 
       shell->size_allocate_from_configure_event = FALSE;
@@ -251,11 +261,14 @@ gimp_display_shell_canvas_size_allocate (GtkWidget        *widget,
   if (shell->disp_width  != allocation->width ||
       shell->disp_height != allocation->height)
     {
+      /*  keep the render cache's content across the size change  */
+      gimp_display_shell_render_save_level (shell);
       g_clear_pointer (&shell->render_cache, cairo_surface_destroy);
-      gimp_display_shell_render_invalidate_full (shell);
 
       shell->disp_width  = allocation->width;
       shell->disp_height = allocation->height;
+
+      gimp_display_shell_render_rescale (shell);
     }
 
   gtk_widget_add_tick_callback (widget,
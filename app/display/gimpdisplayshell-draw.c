@@ -35,6 +35,7 @@
 #include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
 #include "gimpdisplayshell-draw.h"
+#include "gimpdisplayshell-expose.h"
 #include "gimpdisplayshell-render.h"
 
 
@@ -137,6 +138,7 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
   gdouble chunk_width;
   gdouble chunk_height;
   gdouble scale = 1.0;
+  gint64  start_time;
   gint    n_rows;
   gint    n_cols;
   gint    r, c;
@@ -145,6 +147,8 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
   g_return_if_fail (gimp_display_get_image (shell->display));
   g_return_if_fail (cr != NULL);
 
+  start_time = g_get_monotonic_time ();
+
   /*  display the image in RENDER_BUF_WIDTH x RENDER_BUF_HEIGHT
    *  maximally-sized image-space chunks.  adjust the screen-space
    *  chunk size as necessary, to accommodate for the display
@@ -202,13 +206,31 @@ gimp_display_shell_draw_image (GimpDisplayShell *shell,
           if (! gimp_display_shell_render_is_valid (shell,
                                                     x1, y1, x2 - x1, y2 - y1))
             {
-              /* render image to the render cache */
-              gimp_display_shell_render (shell, cr,
-                                         x1, y1, x2 - x1, y2 - y1,
-                                         scale);
-
-              gimp_display_shell_render_validate_area (shell,
-                                                       x1, y1, x2 - x1, y2 - y1);
+              if (g_get_monotonic_time () - start_time >=
+                  GIMP_DISPLAY_RENDER_INTERIM_TIME &&
+                  gimp_display_shell_render_is_interim (shell,
+                                                        x1, y1,
+                                                        x2 - x1, y2 - y1))
+                {
+                  /* we're out of time, and the render cache has a
+                   * rescaled rendering of the chunk from a previous zoom
+                   * level.  show it for now, and render the chunk on the
+                   * next redraw.
+                   */
+                  gimp_display_shell_expose_area (shell,
+                                                  x1, y1, x2 - x1, y2 - y1);
+                }
+              else
+                {
+                  /* render image to the render cache */
+                  gimp_display_shell_render (shell, cr,
+                                             x1, y1, x2 - x1, y2 - y1,
+                                             scale);
+
+                  gimp_display_shell_render_validate_area (shell,
+                                                           x1, y1,
+                                                           x2 - x1, y2 - y1);
+                }
             }
 
           /* render from the render cache to screen */
@@ -40,12 +40,49 @@
 #include "gimpdisplayshell-render.h"
 
 
+#define SCALE_EPSILON 0.0001
+
+#define SCALE_EQUALS(a,b) (fabs ((a) - (b)) < SCALE_EPSILON)
+
+
+/*  the render cache of a previous zoom level  */
+typedef struct
+{
+  cairo_surface_t *surface;
+  cairo_region_t  *valid;
+  cairo_region_t  *interim;
+  gdouble          scale_x;
+  gdouble          scale_y;
+  gint             offset_x;
+  gint             offset_y;
+} RenderLevel;
+
+
+/*  local function prototypes  */
+
+static void             gimp_display_shell_render_level_free       (RenderLevel          *level);
+static void             gimp_display_shell_render_clear_levels     (GimpDisplayShell     *shell);
+
+static cairo_region_t * gimp_display_shell_render_transform_region (const cairo_region_t *region,
+                                                                    gdouble               scale_x,
+                                                                    gdouble               scale_y,
+                                                                    gdouble               offset_x,
+                                                                    gdouble               offset_y,
+                                                                    gint                  width,
+                                                                    gint                  height);
+
+
+/*  public functions  */
+
 void
 gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell)
 {
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
 
-  g_clear_pointer (&shell->render_cache_valid, cairo_region_destroy);
+  g_clear_pointer (&shell->render_cache_valid,   cairo_region_destroy);
+  g_clear_pointer (&shell->render_cache_interim, cairo_region_destroy);
+
+  gimp_display_shell_render_clear_levels (shell);
 }
 
 void
@@ -67,7 +104,15 @@ gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
       rect.height = height;
 
       cairo_region_subtract_rectangle (shell->render_cache_valid, &rect);
+
+      if (shell->render_cache_interim)
+        cairo_region_subtract_rectangle (shell->render_cache_interim, &rect);
     }
+
+  /*  the image changed, none of the previous zoom levels is up to date
+   *  anymore
+   */
+  gimp_display_shell_render_clear_levels (shell);
 }
 
 void
@@ -118,6 +163,215 @@ gimp_display_shell_render_is_valid (GimpDisplayShell *shell,
   return FALSE;
 }
 
+gboolean
+gimp_display_shell_render_is_interim (GimpDisplayShell *shell,
+                                      gint              x,
+                                      gint              y,
+                                      gint              width,
+                                      gint              height)
+{
+  if (shell->render_cache_interim)
+    {
+      cairo_rectangle_int_t  rect;
+      cairo_region_overlap_t overlap;
+
+      rect.x      = x;
+      rect.y      = y;
+      rect.width  = width;
+      rect.height = height;
+
+      overlap = cairo_region_contains_rectangle (shell->render_cache_interim,
+                                                 &rect);
+
+      return (overlap == CAIRO_REGION_OVERLAP_IN);
+    }
+
+  return FALSE;
+}
+
+/**
+ * gimp_display_shell_render_save_level:
+ * @shell: the #GimpDisplayShell
+ *
+ * Moves the render cache to the list of recent zoom levels, before the
+ * display scale changes.  gimp_display_shell_render_rescale() uses the
+ * saved levels to fill the render cache after the change, instead of
+ * starting from an empty cache.
+ **/
+void
+gimp_display_shell_render_save_level (GimpDisplayShell *shell)
+{
+  RenderLevel *level;
+  GList       *last;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (! shell->render_cache || shell->rotate_transform)
+    return;
+
+  if (! shell->render_cache_valid)
+    shell->render_cache_valid = cairo_region_create ();
+
+  if (! shell->render_cache_interim)
+    shell->render_cache_interim = cairo_region_create ();
+
+  if (cairo_region_is_empty (shell->render_cache_valid) &&
+      cairo_region_is_empty (shell->render_cache_interim))
+    {
+      return;
+    }
+
+  level = g_slice_new (RenderLevel);
+
+  level->surface  = shell->render_cache;
+  level->valid    = shell->render_cache_valid;
+  level->interim  = shell->render_cache_interim;
+  level->scale_x  = shell->scale_x;
+  level->scale_y  = shell->scale_y;
+  level->offset_x = shell->offset_x;
+  level->offset_y = shell->offset_y;
+
+  shell->render_cache         = NULL;
+  shell->render_cache_valid   = NULL;
+  shell->render_cache_interim = NULL;
+
+  shell->render_cache_levels = g_list_prepend (shell->render_cache_levels,
+                                               level);
+
+  if (g_list_length (shell->render_cache_levels) >
+      GIMP_DISPLAY_RENDER_MAX_CACHE_LEVELS)
+    {
+      last = g_list_last (shell->render_cache_levels);
+
+      gimp_display_shell_render_level_free (last->data);
+
+      shell->render_cache_levels =
+        g_list_delete_link (shell->render_cache_levels, last);
+    }
+}
+
+/**
+ * gimp_display_shell_render_rescale:
+ * @shell: the #GimpDisplayShell
+ *
+ * Fills the render cache after a change of the display scale.  If one
+ * of the recent zoom levels has the current scale, its content is
+ * still valid and is simply moved into place.  Otherwise, the content
+ * of the most recent level is scaled to the current scale, and used as
+ * an interim rendering, which gimp_display_shell_draw_image() refines
+ * progressively.
+ **/
+void
+gimp_display_shell_render_rescale (GimpDisplayShell *shell)
+{
+  RenderLevel *level = NULL;
+  GList       *list;
+  cairo_t     *cr;
+  gboolean     exact = FALSE;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  g_clear_pointer (&shell->render_cache_valid,   cairo_region_destroy);
+  g_clear_pointer (&shell->render_cache_interim, cairo_region_destroy);
+
+  if (shell->rotate_transform)
+    {
+      gimp_display_shell_render_clear_levels (shell);
+
+      return;
+    }
+
+  if (! shell->render_cache_levels)
+    return;
+
+  for (list = shell->render_cache_levels; list; list = g_list_next (list))
+    {
+      RenderLevel *l = list->data;
+
+      if (SCALE_EQUALS (l->scale_x, shell->scale_x) &&
+          SCALE_EQUALS (l->scale_y, shell->scale_y))
+        {
+          level = l;
+          exact = TRUE;
+
+          break;
+        }
+    }
+
+  if (! level)
+    level = shell->render_cache_levels->data;
+
+  if (! shell->render_cache)
+    {
+      shell->render_cache =
+        cairo_surface_create_similar_image (level->surface,
+                                            CAIRO_FORMAT_ARGB32,
+                                            shell->disp_width,
+                                            shell->disp_height);
+    }
+
+  cr = cairo_create (shell->render_cache);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+
+  if (exact)
+    {
+      gint dx = level->offset_x - shell->offset_x;
+      gint dy = level->offset_y - shell->offset_y;
+
+      cairo_set_source_surface (cr, level->surface, dx, dy);
+      cairo_paint (cr);
+
+      shell->render_cache_valid =
+        gimp_display_shell_render_transform_region (level->valid,
+                                                    1.0, 1.0, dx, dy,
+                                                    shell->disp_width,
+                                                    shell->disp_height);
+      shell->render_cache_interim =
+        gimp_display_shell_render_transform_region (level->interim,
+                                                    1.0, 1.0, dx, dy,
+                                                    shell->disp_width,
+                                                    shell->disp_height);
+
+      /*  the level is the render cache now  */
+      shell->render_cache_levels = g_list_remove (shell->render_cache_levels,
+                                                  level);
+
+      gimp_display_shell_render_level_free (level);
+    }
+  else
+    {
+      gdouble         ratio_x = shell->scale_x / level->scale_x;
+      gdouble         ratio_y = shell->scale_y / level->scale_y;
+      cairo_region_t *region;
+
+      /*  map the level's screen space to the current screen space  */
+      cairo_translate (cr, -shell->offset_x, -shell->offset_y);
+      cairo_scale (cr, ratio_x, ratio_y);
+      cairo_translate (cr, level->offset_x, level->offset_y);
+
+      cairo_set_source_surface (cr, level->surface, 0, 0);
+      cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_BILINEAR);
+      cairo_paint (cr);
+
+      region = cairo_region_copy (level->valid);
+      cairo_region_union (region, level->interim);
+
+      shell->render_cache_valid   = cairo_region_create ();
+      shell->render_cache_interim =
+        gimp_display_shell_render_transform_region (
+          region,
+          ratio_x, ratio_y,
+          level->offset_x * ratio_x - shell->offset_x,
+          level->offset_y * ratio_y - shell->offset_y,
+          shell->disp_width,
+          shell->disp_height);
+
+      cairo_region_destroy (region);
+    }
+
+  cairo_destroy (cr);
+}
+
 void
 gimp_display_shell_render (GimpDisplayShell *shell,
                            cairo_t          *cr,
@@ -485,3 +739,78 @@ gimp_display_shell_render (GimpDisplayShell *shell,
 
   cairo_destroy (my_cr);
 }
+
+
+/*  private functions  */
+
+static void
+gimp_display_shell_render_level_free (RenderLevel *level)
+{
+  cairo_surface_destroy (level->surface);
+  cairo_region_destroy (level->valid);
+  cairo_region_destroy (level->interim);
+
+  g_slice_free (RenderLevel, level);
+}
+
+static void
+gimp_display_shell_render_clear_levels (GimpDisplayShell *shell)
+{
+  g_list_free_full (shell->render_cache_levels,
+                    (GDestroyNotify) gimp_display_shell_render_level_free);
+
+  shell->render_cache_levels = NULL;
+}
+
+/*  maps @region through the given scale and offset, keeping only the
+ *  pixels that are fully covered by the result, and clips it to the
+ *  display
+ */
+static cairo_region_t *
+gimp_display_shell_render_transform_region (const cairo_region_t *region,
+                                            gdouble               scale_x,
+                                            gdouble               scale_y,
+                                            gdouble               offset_x,
+                                            gdouble               offset_y,
+                                            gint                  width,
+                                            gint                  height)
+{
+  cairo_region_t        *result = cairo_region_create ();
+  cairo_rectangle_int_t  rect;
+  gint                   n_rects;
+  gint                   i;
+
+  n_rects = cairo_region_num_rectangles (region);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      gint x1, y1;
+      gint x2, y2;
+
+      cairo_region_get_rectangle (region, i, &rect);
+
+      x1 = ceil  (rect.x                 * scale_x + offset_x - SCALE_EPSILON);
+      y1 = ceil  (rect.y                 * scale_y + offset_y - SCALE_EPSILON);
+      x2 = floor ((rect.x + rect.width)  * scale_x + offset_x + SCALE_EPSILON);
+      y2 = floor ((rect.y + rect.height) * scale_y + offset_y + SCALE_EPSILON);
+
+      if (x2 > x1 && y2 > y1)
+        {
+          rect.x      = x1;
+          rect.y      = y1;
+          rect.width  = x2 - x1;
+          rect.height = y2 - y1;
+
+          cairo_region_union_rectangle (result, &rect);
+        }
+    }
+
+  rect.x      = 0;
+  rect.y      = 0;
+  rect.width  = width;
+  rect.height = height;
+
+  cairo_region_intersect_rectangle (result, &rect);
+
+  return result;
+}
@@ -22,6 +22,15 @@
 #define GIMP_DISPLAY_RENDER_ENABLE_SCALING 1
 #define GIMP_DISPLAY_RENDER_MAX_SCALE      4.0
 
+/*  the number of previous zoom levels whose render cache is kept  */
+#define GIMP_DISPLAY_RENDER_MAX_CACHE_LEVELS 3
+
+/*  the time, in microseconds, gimp_display_shell_draw_image() spends
+ *  rendering chunks that have an interim rendering, before deferring
+ *  the rest to the next redraw
+ */
+#define GIMP_DISPLAY_RENDER_INTERIM_TIME     15000
+
 
 void     gimp_display_shell_render_invalidate_full (GimpDisplayShell *shell);
 void     gimp_display_shell_render_invalidate_area (GimpDisplayShell *shell,
@@ -42,6 +51,15 @@ gboolean gimp_display_shell_render_is_valid        (GimpDisplayShell *shell,
                                                     gint              width,
                                                     gint              height);
 
+gboolean gimp_display_shell_render_is_interim      (GimpDisplayShell *shell,
+                                                    gint              x,
+                                                    gint              y,
+                                                    gint              width,
+                                                    gint              height);
+
+void     gimp_display_shell_render_save_level      (GimpDisplayShell *shell);
+void     gimp_display_shell_render_rescale         (GimpDisplayShell *shell);
+
 void     gimp_display_shell_render                 (GimpDisplayShell *shell,
                                                     cairo_t          *cr,
                                                     gint              x,
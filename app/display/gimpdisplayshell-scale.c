@@ -199,6 +199,8 @@ gimp_display_shell_scale_set_dot_for_dot (GimpDisplayShell *shell,
       /* freeze the active tool */
       gimp_display_shell_pause (shell);
 
+      gimp_display_shell_render_save_level (shell);
+
       shell->dot_for_dot = dot_for_dot;
 
       gimp_display_shell_scale_update (shell);
@@ -382,6 +384,8 @@ gimp_display_shell_scale (GimpDisplayShell *shell,
       /* If the window is resized on zoom, simply do the zoom and get
        * things rolling
        */
+      gimp_display_shell_render_save_level (shell);
+
       gimp_zoom_model_zoom (shell->zoom, GIMP_ZOOM_TO, new_scale);
 
       gimp_display_shell_scale_resize (shell, TRUE, FALSE);
@@ -625,6 +629,8 @@ gimp_display_shell_scale_by_values (GimpDisplayShell *shell,
   /* freeze the active tool */
   gimp_display_shell_pause (shell);
 
+  gimp_display_shell_render_save_level (shell);
+
   gimp_zoom_model_zoom (shell->zoom, GIMP_ZOOM_TO, scale);
 
   shell->offset_x = offset_x;
@@ -695,6 +701,11 @@ gimp_display_shell_scale_shrink_wrap (GimpDisplayShell *shell,
  * visible to the user. If @resize_window is %TRUE then the display window is
  * resized to accommodate the display image as per
  * gimp_display_shell_shrink_wrap().
+ *
+ * The render cache is refilled from the caches of recent zoom levels,
+ * as saved by gimp_display_shell_render_save_level(), so the display
+ * shows a scaled version of the previous rendering until the new one
+ * is complete.
  **/
 void
 gimp_display_shell_scale_resize (GimpDisplayShell *shell,
@@ -720,7 +731,7 @@ gimp_display_shell_scale_resize (GimpDisplayShell *shell,
   gimp_display_shell_scaled (shell);
 
   gimp_display_shell_expose_full (shell);
-  gimp_display_shell_render_invalidate_full (shell);
+  gimp_display_shell_render_rescale (shell);
 
   /* re-enable the active tool */
   gimp_display_shell_resume (shell);
@@ -136,6 +136,21 @@ gimp_display_shell_scroll (GimpDisplayShell *shell,
 
           cairo_region_intersect_rectangle (shell->render_cache_valid, &rect);
         }
+
+      if (shell->render_cache_interim)
+        {
+          cairo_rectangle_int_t rect;
+
+          cairo_region_translate (shell->render_cache_interim,
+                                  -x_offset, -y_offset);
+
+          rect.x      = 0;
+          rect.y      = 0;
+          rect.width  = shell->disp_width;
+          rect.height = shell->disp_height;
+
+          cairo_region_intersect_rectangle (shell->render_cache_interim, &rect);
+        }
     }
 
   /* re-enable the active tool */
@@ -26,9 +26,11 @@
 
 #include "core/gimp.h"
 #include "core/gimp-cairo.h"
+#include "core/gimpasync.h"
 #include "core/gimpboundary.h"
 #include "core/gimpchannel.h"
 #include "core/gimpimage.h"
+#include "core/gimpselection.h"
 
 #include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
@@ -55,6 +57,7 @@ struct _Selection
   gboolean          show_selection;   /*  is the selection visible?         */
   guint             timeout;          /*  timer for successive draws        */
   cairo_pattern_t  *segs_in_mask;     /*  cache for rendered segments       */
+  GimpAsync        *async;            /*  boundary being computed           */
 };
 
 
@@ -76,6 +79,11 @@ static void      selection_zoom_segs      (Selection          *selection,
 static void      selection_generate_segs  (Selection          *selection);
 static void      selection_free_segs      (Selection          *selection);
 
+static gboolean  selection_boundary_async (Selection          *selection);
+static void      selection_boundary_async_callback
+                                          (GimpAsync          *async,
+                                           Selection          *selection);
+
 static gboolean  selection_start_timeout  (Selection          *selection);
 static gboolean  selection_timeout        (Selection          *selection);
 
@@ -125,6 +133,16 @@ gimp_display_shell_selection_free (GimpDisplayShell *shell)
 
   selection_stop (selection);
 
+  if (selection->async)
+    {
+      gimp_async_remove_callback (
+        selection->async,
+        (GimpAsyncCallback) selection_boundary_async_callback,
+        selection);
+
+      g_clear_object (&selection->async);
+    }
+
   g_signal_handlers_disconnect_by_func (shell,
                                         selection_window_state_event,
                                         selection);
@@ -406,6 +424,48 @@ selection_free_segs (Selection *selection)
   g_clear_pointer (&selection->segs_in_mask, cairo_pattern_destroy);
 }
 
+/*  If the selection's boundary is not known, starts computing it in the
+ *  background, and returns TRUE; the ants are started once it's ready.
+ */
+static gboolean
+selection_boundary_async (Selection *selection)
+{
+  GimpImage *image = gimp_display_get_image (selection->shell->display);
+  GimpAsync *async;
+
+  if (selection->async)
+    return TRUE;
+
+  async = gimp_selection_boundary_async (
+    GIMP_SELECTION (gimp_image_get_mask (image)));
+
+  if (! async)
+    return FALSE;
+
+  selection->async = g_object_ref (async);
+
+  gimp_async_add_callback_for_object (
+    async,
+    (GimpAsyncCallback) selection_boundary_async_callback,
+    selection,
+    selection->shell);
+
+  return TRUE;
+}
+
+static void
+selection_boundary_async_callback (GimpAsync *async,
+                                   Selection *selection)
+{
+  g_clear_object (&selection->async);
+
+  /*  if the computation was canceled because the mask changed, this
+   *  starts computing the new boundary
+   */
+  if (gimp_display_get_image (selection->shell->display))
+    selection_start (selection);
+}
+
 static gboolean
 selection_start_timeout (Selection *selection)
 {
@@ -415,6 +475,9 @@ selection_start_timeout (Selection *selection)
   if (! gimp_display_get_image (selection->shell->display))
     return FALSE;
 
+  if (selection_boundary_async (selection))
+    return FALSE;
+
   selection_generate_segs (selection);
 
   selection->index = 0;
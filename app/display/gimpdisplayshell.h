@@ -168,6 +168,8 @@ struct _GimpDisplayShell
 
   cairo_surface_t   *render_cache;
   cairo_region_t    *render_cache_valid;
+  cairo_region_t    *render_cache_interim; /*  rescaled, not yet rendered */
+  GList             *render_cache_levels;  /*  caches of recent zoom levels */
 
   gint               render_buf_width;
   gint               render_buf_height;
@@ -33,6 +33,7 @@
 
 #include "core/gimp.h"
 #include "core/gimp-parallel.h"
+#include "core/gimptempbuf.h"
 
 #include "gimp-babl.h"
 #include "gimp-gegl.h"
@@ -43,6 +44,8 @@
 static void  gimp_gegl_notify_swap_path       (GimpGeglConfig *config);
 static void  gimp_gegl_notify_temp_path       (GimpGeglConfig *config);
 static void  gimp_gegl_notify_tile_cache_size (GimpGeglConfig *config);
+static void  gimp_gegl_notify_temp_buf_pool_size
+                                              (GimpGeglConfig *config);
 static void  gimp_gegl_notify_num_processors  (GimpGeglConfig *config);
 static void  gimp_gegl_notify_use_opencl      (GimpGeglConfig *config);
 
@@ -68,6 +71,8 @@ gimp_gegl_init (Gimp *gimp)
                 "use-opencl",      config->use_opencl,
                 NULL);
 
+  gimp_temp_buf_set_pool_size (config->temp_buf_pool_size);
+
   gimp_parallel_init (gimp);
 
   g_signal_connect (config, "notify::swap-path",
@@ -82,6 +87,9 @@ gimp_gegl_init (Gimp *gimp)
   g_signal_connect (config, "notify::tile-cache-size",
                     G_CALLBACK (gimp_gegl_notify_tile_cache_size),
                     NULL);
+  g_signal_connect (config, "notify::temp-buf-pool-size",
+                    G_CALLBACK (gimp_gegl_notify_temp_buf_pool_size),
+                    NULL);
   g_signal_connect (config, "notify::num-processors",
                     G_CALLBACK (gimp_gegl_notify_num_processors),
                     NULL);
@@ -141,6 +149,12 @@ gimp_gegl_notify_tile_cache_size (GimpGeglConfig *config)
                 NULL);
 }
 
+static void
+gimp_gegl_notify_temp_buf_pool_size (GimpGeglConfig *config)
+{
+  gimp_temp_buf_set_pool_size (config->temp_buf_pool_size);
+}
+
 static void
 gimp_gegl_notify_num_processors (GimpGeglConfig *config)
 {
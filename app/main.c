@@ -121,6 +121,7 @@ static const gchar        *user_gimprc       = NULL;
 static const gchar        *session_name      = NULL;
 static const gchar        *batch_interpreter = NULL;
 static const gchar       **batch_commands    = NULL;
+static gint                batch_jobs        = 1;
 static const gchar       **filenames         = NULL;
 static gboolean            as_new            = FALSE;
 static gboolean            no_interface      = FALSE;
@@ -232,6 +233,12 @@ static const GOptionEntry main_entries[] =
     G_OPTION_ARG_STRING, &batch_interpreter,
     N_("The procedure to process batch commands with"), "<proc>"
   },
+  {
+    "batch-jobs", 0, 0,
+    G_OPTION_ARG_INT, &batch_jobs,
+    N_("Number of batch commands to run concurrently "
+       "(0 for one per processor)"), "<n>"
+  },
   {
     "console-messages", 'c', 0,
     G_OPTION_ARG_NONE, &console_messages,
@@ -535,6 +542,7 @@ main (int    argc,
            session_name,
            batch_interpreter,
            batch_commands,
+           batch_jobs,
            as_new,
            no_interface,
            no_data,
@@ -0,0 +1,642 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-operation-distance.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* A separable distance transform for the elliptical structuring
+ * element used by gimp:grow, gimp:shrink and gimp:border, running in
+ * time independent of the radius.
+ *
+ * The ellipse contains the offset (i, j) iff
+ *
+ *   (|i| - 1/2)^2 / rx^2 + (|j| - 1/2)^2 / ry^2 < 1
+ *
+ * where a zero offset counts as 0 instead of -1/2.  this is the
+ * element the sliding-window implementations use.  multiplying by
+ * 4 rx^2 ry^2 gives an integer distance, which is a sum of a
+ * vertical term and a horizontal term, each convex in its offset:
+ * a first pass finds the vertical distance to the nearest feature
+ * in each column, and a second pass takes the lower envelope of the
+ * horizontal terms along each row.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "operations-types.h"
+
+#include "gimp-operation-distance.h"
+
+
+#define MIN_COLUMNS_PER_THREAD 64
+#define MIN_ROWS_PER_THREAD    16
+
+
+typedef struct
+{
+  guint16                      *features;
+  gint                          width;
+  gint                          height;
+  gint                          radius_x;
+  gint                          radius_y;
+  gboolean                      outside_is_feature;
+  GimpOperationDistanceRowFunc  func;
+  gpointer                      user_data;
+} TransformData;
+
+typedef struct
+{
+  gint   *v;     /* positions of the envelope's parabolas  */
+  gint64 *f;     /* their vertical distances               */
+  gint   *z;     /* the first pixel each parabola is lowest */
+  gint    k;     /* index of the last parabola             */
+  gint    width;
+  gint64  ry2;
+} Envelope;
+
+typedef struct
+{
+  const gfloat *src;
+  gfloat       *dest;
+  guint16      *features;
+  gint          width;
+  gint64        radius;
+  gfloat        level;
+  gboolean      erode;
+} MorphologyData;
+
+
+/*  local function prototypes  */
+
+static inline gint64   horizontal_distance       (gint64          ry2,
+                                                  gint            i);
+static inline gint64   vertical_distance         (gint64          rx2,
+                                                  gint            j);
+
+static gint            envelope_intersect        (const Envelope *env,
+                                                  gint            p,
+                                                  gint64          fp,
+                                                  gint            q,
+                                                  gint64          fq);
+static void            envelope_push             (Envelope       *env,
+                                                  gint            q,
+                                                  gint64          fq);
+
+static void            distance_transform_columns (gsize          offset,
+                                                   gsize          size,
+                                                   TransformData *data);
+static void            distance_transform_rows    (gsize          offset,
+                                                   gsize          size,
+                                                   TransformData *data);
+
+static gint            distance_get_levels        (const gfloat  *src,
+                                                   gsize          n_pixels,
+                                                   gfloat        *levels,
+                                                   gint           max_levels);
+static void            distance_morphology_features
+                                                  (gsize          offset,
+                                                   gsize          size,
+                                                   MorphologyData *data);
+static void            distance_morphology_row    (gint           y,
+                                                   const gint64  *dist,
+                                                   gint           width,
+                                                   MorphologyData *data);
+static gboolean        distance_morphology        (GeglBuffer          *input,
+                                                   GeglBuffer          *output,
+                                                   const GeglRectangle *roi,
+                                                   const Babl          *format,
+                                                   gint                 radius_x,
+                                                   gint                 radius_y,
+                                                   gboolean             erode,
+                                                   gboolean             outside_is_feature);
+
+
+/*  public functions  */
+
+gint64
+gimp_operation_distance_get_radius (gint radius_x,
+                                    gint radius_y)
+{
+  return 4 * (gint64) radius_x * radius_x * (gint64) radius_y * radius_y;
+}
+
+/*  @features holds 0 for feature pixels, and any other value for the
+ *  rest, and is used as scratch space.  @func is called for each row
+ *  with the distance of the row's pixels to the nearest feature, or
+ *  G_MAXINT64 if there is none nearby.
+ */
+void
+gimp_operation_distance_transform (guint16                      *features,
+                                   gint                          width,
+                                   gint                          height,
+                                   gint                          radius_x,
+                                   gint                          radius_y,
+                                   gboolean                      outside_is_feature,
+                                   GimpOperationDistanceRowFunc  func,
+                                   gpointer                      user_data)
+{
+  TransformData data;
+
+  g_return_if_fail (features != NULL);
+  g_return_if_fail (radius_x > 0 && radius_y > 0);
+  g_return_if_fail (radius_y < G_MAXUINT16);
+  g_return_if_fail (func != NULL);
+
+  if (width < 1 || height < 1)
+    return;
+
+  data.features           = features;
+  data.width              = width;
+  data.height             = height;
+  data.radius_x           = radius_x;
+  data.radius_y           = radius_y;
+  data.outside_is_feature = outside_is_feature;
+  data.func               = func;
+  data.user_data          = user_data;
+
+  gegl_parallel_distribute_range (
+    width, MIN_COLUMNS_PER_THREAD,
+    (GeglParallelDistributeRangeFunc) distance_transform_columns,
+    &data);
+
+  gegl_parallel_distribute_range (
+    height, MIN_ROWS_PER_THREAD,
+    (GeglParallelDistributeRangeFunc) distance_transform_rows,
+    &data);
+}
+
+/*  Replaces the sliding-window maximum of gimp:grow, returning FALSE,
+ *  without touching @output, when the input has too many different
+ *  values for that to pay off at this radius.
+ */
+gboolean
+gimp_operation_distance_grow (GeglBuffer          *input,
+                              GeglBuffer          *output,
+                              const GeglRectangle *roi,
+                              const Babl          *format,
+                              gint                 radius_x,
+                              gint                 radius_y)
+{
+  return distance_morphology (input, output, roi, format,
+                              radius_x, radius_y,
+                              FALSE, FALSE);
+}
+
+/*  Same as gimp_operation_distance_grow(), for gimp:shrink.  */
+gboolean
+gimp_operation_distance_shrink (GeglBuffer          *input,
+                                GeglBuffer          *output,
+                                const GeglRectangle *roi,
+                                const Babl          *format,
+                                gint                 radius_x,
+                                gint                 radius_y,
+                                gboolean             edge_lock)
+{
+  return distance_morphology (input, output, roi, format,
+                              radius_x, radius_y,
+                              TRUE, ! edge_lock);
+}
+
+
+/*  private functions  */
+
+static inline gint64
+horizontal_distance (gint64 ry2,
+                     gint   i)
+{
+  gint64 a;
+
+  if (i == 0)
+    return 0;
+
+  a = 2 * ABS (i) - 1;
+
+  return ry2 * a * a;
+}
+
+static inline gint64
+vertical_distance (gint64 rx2,
+                   gint   j)
+{
+  gint64 b;
+
+  if (j == 0)
+    return 0;
+
+  b = 2 * j - 1;
+
+  return rx2 * b * b;
+}
+
+/*  returns the first pixel in [0, width] at which the parabola at @q is
+ *  not above the one at @p, for @p < @q.  since the horizontal distance
+ *  is convex, the difference of the two is monotonic.
+ */
+static gint
+envelope_intersect (const Envelope *env,
+                    gint            p,
+                    gint64          fp,
+                    gint            q,
+                    gint64          fq)
+{
+  gint lo = 0;
+  gint hi = env->width;
+
+  while (lo < hi)
+    {
+      gint mid = (lo + hi) / 2;
+
+      if (fq + horizontal_distance (env->ry2, mid - q) <=
+          fp + horizontal_distance (env->ry2, mid - p))
+        {
+          hi = mid;
+        }
+      else
+        {
+          lo = mid + 1;
+        }
+    }
+
+  return lo;
+}
+
+static void
+envelope_push (Envelope *env,
+               gint      q,
+               gint64    fq)
+{
+  gint s = 0;
+
+  while (env->k >= 0)
+    {
+      s = envelope_intersect (env,
+                              env->v[env->k], env->f[env->k],
+                              q, fq);
+
+      if (s > env->z[env->k])
+        break;
+
+      env->k--;
+    }
+
+  if (env->k < 0)
+    {
+      s = 0;
+    }
+  else if (s >= env->width)
+    {
+      /*  never the lowest inside the row  */
+      return;
+    }
+
+  env->k++;
+
+  env->v[env->k] = q;
+  env->f[env->k] = fq;
+  env->z[env->k] = s;
+}
+
+static void
+distance_transform_columns (gsize          offset,
+                            gsize          size,
+                            TransformData *data)
+{
+  const gint  far  = data->radius_y + 1;
+  const gint  edge = data->outside_is_feature ? 0 : far;
+  gint        x1   = offset;
+  gint        x2   = offset + size;
+  gint        x, y;
+
+  /*  distance to the nearest feature above  */
+  for (y = 0; y < data->height; y++)
+    {
+      guint16       *row   = data->features + (gsize) y * data->width;
+      const guint16 *above = row - data->width;
+
+      for (x = x1; x < x2; x++)
+        {
+          if (row[x])
+            {
+              gint d = (y > 0 ? above[x] : edge) + 1;
+
+              row[x] = MIN (d, far);
+            }
+        }
+    }
+
+  /*  ...or below  */
+  for (y = data->height - 1; y >= 0; y--)
+    {
+      guint16       *row   = data->features + (gsize) y * data->width;
+      const guint16 *below = row + data->width;
+
+      for (x = x1; x < x2; x++)
+        {
+          gint d = (y < data->height - 1 ? below[x] : edge) + 1;
+
+          if (d < row[x])
+            row[x] = d;
+        }
+    }
+}
+
+static void
+distance_transform_rows (gsize          offset,
+                         gsize          size,
+                         TransformData *data)
+{
+  const gint64  rx2 = (gint64) data->radius_x * data->radius_x;
+  Envelope      env;
+  gint64       *dist;
+  gint          y;
+
+  env.v     = g_new (gint,   data->width + 2);
+  env.f     = g_new (gint64, data->width + 2);
+  env.z     = g_new (gint,   data->width + 2);
+  env.width = data->width;
+  env.ry2   = (gint64) data->radius_y * data->radius_y;
+
+  dist = g_new (gint64, data->width);
+
+  for (y = offset; y < (gint) (offset + size); y++)
+    {
+      const guint16 *row = data->features + (gsize) y * data->width;
+      gint           x;
+
+      env.k = -1;
+
+      if (data->outside_is_feature)
+        envelope_push (&env, -1, 0);
+
+      for (x = 0; x < data->width; x++)
+        {
+          if (row[x] <= data->radius_y)
+            envelope_push (&env, x, vertical_distance (rx2, row[x]));
+        }
+
+      if (data->outside_is_feature)
+        envelope_push (&env, data->width, 0);
+
+      if (env.k < 0)
+        {
+          for (x = 0; x < data->width; x++)
+            dist[x] = G_MAXINT64;
+        }
+      else
+        {
+          gint k = 0;
+
+          for (x = 0; x < data->width; x++)
+            {
+              while (k < env.k && env.z[k + 1] <= x)
+                k++;
+
+              dist[x] = env.f[k] + horizontal_distance (env.ry2, x - env.v[k]);
+            }
+        }
+
+      data->func (y, dist, data->width, data->user_data);
+    }
+
+  g_free (dist);
+
+  g_free (env.v);
+  g_free (env.f);
+  g_free (env.z);
+}
+
+/*  collects the different values of @src into @levels, in ascending
+ *  order, returning their number, or -1 if there are more than
+ *  @max_levels.
+ */
+static gint
+distance_get_levels (const gfloat *src,
+                     gsize         n_pixels,
+                     gfloat       *levels,
+                     gint          max_levels)
+{
+  gfloat last;
+  gint   n_levels = 0;
+  gsize  i;
+
+  if (n_pixels == 0 || max_levels < 1)
+    return n_pixels == 0 ? 0 : -1;
+
+  last = src[0];
+  levels[n_levels++] = last;
+
+  for (i = 1; i < n_pixels; i++)
+    {
+      gfloat value = src[i];
+      gint   j;
+
+      /*  masks mostly consist of runs of the same value  */
+      if (value == last)
+        continue;
+
+      last = value;
+
+      for (j = 0; j < n_levels && levels[j] < value; j++);
+
+      if (j < n_levels && levels[j] == value)
+        continue;
+
+      if (n_levels == max_levels)
+        return -1;
+
+      memmove (levels + j + 1, levels + j,
+               (n_levels - j) * sizeof (gfloat));
+
+      levels[j] = value;
+      n_levels++;
+    }
+
+  return n_levels;
+}
+
+static void
+distance_morphology_features (gsize           offset,
+                              gsize           size,
+                              MorphologyData *data)
+{
+  const gfloat *src      = data->src      + offset;
+  guint16      *features = data->features + offset;
+  gsize         i;
+
+  if (data->erode)
+    {
+      for (i = 0; i < size; i++)
+        features[i] = src[i] < data->level ? 0 : 1;
+    }
+  else
+    {
+      for (i = 0; i < size; i++)
+        features[i] = src[i] >= data->level ? 0 : 1;
+    }
+}
+
+static void
+distance_morphology_row (gint            y,
+                         const gint64   *dist,
+                         gint            width,
+                         MorphologyData *data)
+{
+  gfloat *dest = data->dest + (gsize) y * width;
+  gint    x;
+
+  for (x = 0; x < width; x++)
+    {
+      /*  growing, the pixel is at least @level if it's near a pixel
+       *  of at least @level; shrinking, if it's near no pixel below
+       *  @level
+       */
+      if ((dist[x] < data->radius) != data->erode)
+        dest[x] = MAX (dest[x], data->level);
+    }
+}
+
+/*  the structuring element is flat, so the maximum (minimum) over it
+ *  is at least t iff there is (isn't) a pixel of at least (below) t
+ *  inside it.  that's one distance transform per value in the input,
+ *  which is fine for the mostly binary masks we get.
+ */
+static gboolean
+distance_morphology (GeglBuffer          *input,
+                     GeglBuffer          *output,
+                     const GeglRectangle *roi,
+                     const Babl          *format,
+                     gint                 radius_x,
+                     gint                 radius_y,
+                     gboolean             erode,
+                     gboolean             outside_is_feature)
+{
+  MorphologyData  data;
+  gfloat         *src;
+  gfloat         *dest;
+  guint16        *features;
+  gfloat         *levels;
+  gsize           n_pixels;
+  gint            max_passes;
+  gint            n_levels;
+  gint            first;
+  gint            i;
+  gsize           j;
+
+  /*  the transform's own preconditions, checked here so that the
+   *  caller falls back to the sliding window instead
+   */
+  if (radius_x < 1 || radius_y < 1 || radius_y >= G_MAXUINT16)
+    return FALSE;
+
+  max_passes = (radius_x + radius_y) / GIMP_OPERATION_DISTANCE_PASS_COST;
+
+  if (max_passes < 1 || roi->width < 1 || roi->height < 1)
+    return FALSE;
+
+  n_pixels = (gsize) roi->width * roi->height;
+
+  src = g_try_new (gfloat, n_pixels);
+
+  if (! src)
+    return FALSE;
+
+  gegl_buffer_get (input, roi, 1.0, format, src,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  /*  one level more than passes, for the lowest one, plus room for
+   *  the outside's zero
+   */
+  levels = g_new (gfloat, max_passes + 2);
+
+  n_levels = distance_get_levels (src, n_pixels, levels, max_passes + 1);
+
+  if (n_levels > 0 && erode && outside_is_feature && levels[0] > 0.0)
+    {
+      memmove (levels + 1, levels, n_levels * sizeof (gfloat));
+
+      levels[0] = 0.0;
+      n_levels++;
+    }
+
+  /*  the lowest level needs no pass: everything is at least the
+   *  lowest value when shrinking, and at least zero when growing
+   */
+  if (erode || (n_levels > 0 && levels[0] <= 0.0))
+    first = 1;
+  else
+    first = 0;
+
+  if (n_levels < 0 || n_levels - first > max_passes)
+    {
+      g_free (levels);
+      g_free (src);
+
+      return FALSE;
+    }
+
+  dest     = g_try_new (gfloat,  n_pixels);
+  features = g_try_new (guint16, n_pixels);
+
+  if (! dest || ! features)
+    {
+      g_free (features);
+      g_free (dest);
+      g_free (levels);
+      g_free (src);
+
+      return FALSE;
+    }
+
+  for (j = 0; j < n_pixels; j++)
+    dest[j] = erode ? levels[0] : 0.0;
+
+  data.src      = src;
+  data.dest     = dest;
+  data.features = features;
+  data.width    = roi->width;
+  data.radius   = gimp_operation_distance_get_radius (radius_x, radius_y);
+  data.erode    = erode;
+
+  for (i = first; i < n_levels; i++)
+    {
+      data.level = levels[i];
+
+      gegl_parallel_distribute_range (
+        n_pixels, 64 * 64,
+        (GeglParallelDistributeRangeFunc) distance_morphology_features,
+        &data);
+
+      gimp_operation_distance_transform (
+        features, roi->width, roi->height,
+        radius_x, radius_y,
+        outside_is_feature,
+        (GimpOperationDistanceRowFunc) distance_morphology_row,
+        &data);
+    }
+
+  gegl_buffer_set (output, roi, 0, format, dest, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (features);
+  g_free (dest);
+  g_free (levels);
+  g_free (src);
+
+  return TRUE;
+}
@@ -0,0 +1,72 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-operation-distance.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_OPERATION_DISTANCE_H__
+#define __GIMP_OPERATION_DISTANCE_H__
+
+
+/* the cost of a distance transform pass, relative to the per-pixel,
+ * per-radius-unit cost of the sliding-window grow/shrink/border
+ * implementations.  the distance transform is used when
+ *
+ *   n_passes * GIMP_OPERATION_DISTANCE_PASS_COST <= radius_x + radius_y
+ */
+#define GIMP_OPERATION_DISTANCE_PASS_COST 16
+
+
+/* called for each row of a distance transform, in an unspecified
+ * order and possibly concurrently.  @dist holds, for each pixel of
+ * row @y, the distance to the nearest feature pixel, scaled so that
+ * pixels inside the structuring ellipse have a distance less than
+ * gimp_operation_distance_get_radius().
+ */
+typedef void (* GimpOperationDistanceRowFunc) (gint          y,
+                                               const gint64 *dist,
+                                               gint          width,
+                                               gpointer      user_data);
+
+
+gint64     gimp_operation_distance_get_radius (gint                          radius_x,
+                                               gint                          radius_y);
+
+void       gimp_operation_distance_transform  (guint16                      *features,
+                                               gint                          width,
+                                               gint                          height,
+                                               gint                          radius_x,
+                                               gint                          radius_y,
+                                               gboolean                      outside_is_feature,
+                                               GimpOperationDistanceRowFunc  func,
+                                               gpointer                      user_data);
+
+gboolean   gimp_operation_distance_grow       (GeglBuffer                   *input,
+                                               GeglBuffer                   *output,
+                                               const GeglRectangle          *roi,
+                                               const Babl                   *format,
+                                               gint                          radius_x,
+                                               gint                          radius_y);
+gboolean   gimp_operation_distance_shrink     (GeglBuffer                   *input,
+                                               GeglBuffer                   *output,
+                                               const GeglRectangle          *roi,
+                                               const Babl                   *format,
+                                               gint                          radius_x,
+                                               gint                          radius_y,
+                                               gboolean                      edge_lock);
+
+
+#endif /* __GIMP_OPERATION_DISTANCE_H__ */
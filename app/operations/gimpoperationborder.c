@@ -29,6 +29,7 @@
 
 #include "operations-types.h"
 
+#include "gimp-operation-distance.h"
 #include "gimpoperationborder.h"
 
 
@@ -42,6 +43,27 @@ enum
 };
 
 
+typedef void (* TransitionFunc) (gint          y,
+                                 const gfloat *transition,
+                                 gpointer      user_data);
+
+typedef struct
+{
+  GeglBuffer          *output;
+  const GeglRectangle *roi;
+  const Babl          *format;
+} TransitionOutputData;
+
+typedef struct
+{
+  guint16 *features;
+  gfloat  *out;
+  gint     width;
+  gint64   radius;
+  gboolean feather;
+} BorderDistanceData;
+
+
 static void     gimp_operation_border_get_property (GObject      *object,
                                                     guint         property_id,
                                                     GValue       *value,
@@ -328,6 +350,196 @@ compute_transition (gfloat    *transition,
     }
 }
 
+/* Calls `func' with the transitions of each row of `roi', top to bottom. */
+static void
+compute_transitions (GeglBuffer          *input,
+                     const GeglRectangle *roi,
+                     const Babl          *format,
+                     gboolean             edge_lock,
+                     TransitionFunc       func,
+                     gpointer             user_data)
+{
+  gfloat *transition;
+  gfloat *source[3];
+  gint    i;
+  gint    y;
+
+  for (i = 0; i < 3; i++)
+    source[i] = g_new (gfloat, roi->width);
+
+  transition = g_new (gfloat, roi->width);
+
+  /* With `edge_lock', initialize row above image as
+   * selected, otherwise, initialize as unselected.
+   */
+  if (edge_lock)
+    {
+      for (i = 0; i < roi->width; i++)
+        source[0][i] = 1.0;
+    }
+  else
+    {
+      memset (source[0], 0, roi->width * sizeof (gfloat));
+    }
+
+  gegl_buffer_get (input,
+                   GEGL_RECTANGLE (roi->x, roi->y + 0,
+                                   roi->width, 1),
+                   1.0, format, source[1],
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  if (roi->height > 1)
+    gegl_buffer_get (input,
+                     GEGL_RECTANGLE (roi->x, roi->y + 1,
+                                     roi->width, 1),
+                     1.0, format, source[2],
+                     GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  else
+    memcpy (source[2], source[1], roi->width * sizeof (gfloat));
+
+  compute_transition (transition, source, roi->width, edge_lock);
+  func (0, transition, user_data);
+
+  for (y = 1; y < roi->height; y++)
+    {
+      rotate_pointers (source, 3);
+
+      if (y + 1 < roi->height)
+        {
+          gegl_buffer_get (input,
+                           GEGL_RECTANGLE (roi->x, roi->y + y + 1,
+                                           roi->width, 1),
+                           1.0, format, source[2],
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+        }
+      else
+        {
+          /* Depending on `edge_lock', set the row below the
+           * image as either selected or non-selected.
+           */
+          if (edge_lock)
+            {
+              for (i = 0; i < roi->width; i++)
+                source[2][i] = 1.0;
+            }
+          else
+            {
+              memset (source[2], 0, roi->width * sizeof (gfloat));
+            }
+        }
+
+      compute_transition (transition, source, roi->width, edge_lock);
+      func (y, transition, user_data);
+    }
+
+  for (i = 0; i < 3; i++)
+    g_free (source[i]);
+
+  g_free (transition);
+}
+
+static void
+transition_output_row (gint                  y,
+                       const gfloat         *transition,
+                       TransitionOutputData *data)
+{
+  gegl_buffer_set (data->output,
+                   GEGL_RECTANGLE (data->roi->x, data->roi->y + y,
+                                   data->roi->width, 1),
+                   0, data->format, transition,
+                   GEGL_AUTO_ROWSTRIDE);
+}
+
+static void
+border_distance_features_row (gint                y,
+                              const gfloat       *transition,
+                              BorderDistanceData *data)
+{
+  /* the features are the transitional pixels */
+  guint16 *features = data->features + (gsize) y * data->width;
+  gint     x;
+
+  for (x = 0; x < data->width; x++)
+    features[x] = transition[x] ? 0 : 1;
+}
+
+static void
+border_distance_row (gint                y,
+                     const gint64       *dist,
+                     gint                width,
+                     BorderDistanceData *data)
+{
+  gfloat *out = data->out + (gsize) y * width;
+  gint    x;
+
+  for (x = 0; x < width; x++)
+    {
+      if (dist[x] < data->radius)
+        {
+          if (data->feather)
+            out[x] = 1.0 - sqrt ((gdouble) dist[x] / data->radius);
+          else
+            out[x] = 1.0;
+        }
+      else
+        {
+          out[x] = 0.0;
+        }
+    }
+}
+
+/* The border is the set of pixels within the ellipse around some
+ * transitional pixel, with the feathered density falling off with the
+ * distance to the nearest one, which is exactly what a distance
+ * transform of the transitional pixels gives, in time independent of
+ * the radius.
+ */
+static gboolean
+gimp_operation_border_process_distance (GimpOperationBorder *self,
+                                        GeglBuffer          *input,
+                                        GeglBuffer          *output,
+                                        const GeglRectangle *roi,
+                                        const Babl          *input_format,
+                                        const Babl          *output_format)
+{
+  BorderDistanceData  data;
+  gsize               n_pixels = (gsize) roi->width * roi->height;
+
+  data.features = g_try_new (guint16, n_pixels);
+  data.out      = g_try_new (gfloat,  n_pixels);
+  data.width    = roi->width;
+  data.radius   = gimp_operation_distance_get_radius (self->radius_x,
+                                                      self->radius_y);
+  data.feather  = self->feather;
+
+  if (! data.features || ! data.out)
+    {
+      g_free (data.features);
+      g_free (data.out);
+
+      return FALSE;
+    }
+
+  compute_transitions (input, roi, input_format, self->edge_lock,
+                       (TransitionFunc) border_distance_features_row,
+                       &data);
+
+  gimp_operation_distance_transform (
+    data.features, roi->width, roi->height,
+    self->radius_x, self->radius_y,
+    FALSE,
+    (GimpOperationDistanceRowFunc) border_distance_row,
+    &data);
+
+  gegl_buffer_set (output, roi, 0, output_format, data.out,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data.features);
+  g_free (data.out);
+
+  return TRUE;
+}
+
 static gboolean
 gimp_operation_border_process (GeglOperation       *operation,
                                GeglBuffer          *input,
@@ -368,94 +580,28 @@ gimp_operation_border_process (GeglOperation       *operation,
   /* optimize this case specifically */
   if (self->radius_x == 1 && self->radius_y == 1)
     {
-      gfloat *transition;
-      gfloat *source[3];
+      TransitionOutputData data;
 
-      for (i = 0; i < 3; i++)
-        source[i] = g_new (gfloat, roi->width);
+      data.output = output;
+      data.roi    = roi;
+      data.format = output_format;
 
-      transition = g_new (gfloat, roi->width);
-
-      /* With `self->edge_lock', initialize row above image as
-       * selected, otherwise, initialize as unselected.
-       */
-      if (self->edge_lock)
-        {
-          for (i = 0; i < roi->width; i++)
-            source[0][i] = 1.0;
-        }
-      else
-        {
-          memset (source[0], 0, roi->width * sizeof (gfloat));
-        }
-
-      gegl_buffer_get (input,
-                       GEGL_RECTANGLE (roi->x, roi->y + 0,
-                                       roi->width, 1),
-                       1.0, input_format, source[1],
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-      if (roi->height > 1)
-        gegl_buffer_get (input,
-                         GEGL_RECTANGLE (roi->x, roi->y + 1,
-                                         roi->width, 1),
-                         1.0, input_format, source[2],
-                         GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-      else
-        memcpy (source[2], source[1], roi->width * sizeof (gfloat));
-
-      compute_transition (transition, source, roi->width, self->edge_lock);
-      gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y,
-                                       roi->width, 1),
-                       0, output_format, transition,
-                       GEGL_AUTO_ROWSTRIDE);
-
-      for (y = 1; y < roi->height; y++)
-        {
-          rotate_pointers (source, 3);
-
-          if (y + 1 < roi->height)
-            {
-              gegl_buffer_get (input,
-                               GEGL_RECTANGLE (roi->x, roi->y + y + 1,
-                                               roi->width, 1),
-                               1.0, input_format, source[2],
-                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-            }
-          else
-            {
-              /* Depending on `self->edge_lock', set the row below the
-               * image as either selected or non-selected.
-               */
-              if (self->edge_lock)
-                {
-                  for (i = 0; i < roi->width; i++)
-                    source[2][i] = 1.0;
-                }
-              else
-                {
-                  memset (source[2], 0, roi->width * sizeof (gfloat));
-                }
-            }
-
-          compute_transition (transition, source, roi->width, self->edge_lock);
-          gegl_buffer_set (output,
-                           GEGL_RECTANGLE (roi->x, roi->y + y,
-                                           roi->width, 1),
-                           0, output_format, transition,
-                           GEGL_AUTO_ROWSTRIDE);
-        }
-
-      for (i = 0; i < 3; i++)
-        g_free (source[i]);
-
-      g_free (transition);
+      compute_transitions (input, roi, input_format, self->edge_lock,
+                           (TransitionFunc) transition_output_row,
+                           &data);
 
       /* Finished handling the radius = 1 special case, return here. */
       return TRUE;
     }
 
+  /* for large radii, a distance transform is quicker */
+  if (self->radius_x + self->radius_y >= GIMP_OPERATION_DISTANCE_PASS_COST &&
+      gimp_operation_border_process_distance (self, input, output, roi,
+                                              input_format, output_format))
+    {
+      return TRUE;
+    }
+
   max = g_new (gint16, roi->width + 2 * self->radius_x);
 
   for (i = 0; i < (roi->width + 2 * self->radius_x); i++)
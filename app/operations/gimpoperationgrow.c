@@ -29,6 +29,7 @@
 
 #include "operations-types.h"
 
+#include "gimp-operation-distance.h"
 #include "gimpoperationgrow.h"
 
 
@@ -247,6 +248,14 @@ gimp_operation_grow_process (GeglOperation       *operation,
   gint16             last_index;
   gfloat            *buffer;
 
+  /* for large radii, a distance transform is quicker */
+  if (self->radius_x + self->radius_y >= GIMP_OPERATION_DISTANCE_PASS_COST &&
+      gimp_operation_distance_grow (input, output, roi, input_format,
+                                    self->radius_x, self->radius_y))
+    {
+      return TRUE;
+    }
+
   max = g_new (gfloat *, roi->width + 2 * self->radius_x);
   buf = g_new (gfloat *, self->radius_y + 1);
 
@@ -293,6 +302,10 @@ gimp_operation_grow_process (GeglOperation       *operation,
                      1.0, input_format, buf[i + 1],
                      GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
+  /* the region may be shorter than the radius */
+  for (; i < self->radius_y; i++)
+    memset (buf[i + 1], 0, roi->width * sizeof (gfloat));
+
   for (x = 0; x < roi->width; x++) /* set up max for top of image */
     {
       max[x][0] = 0.0;       /* buf[0][x] is always 0 */
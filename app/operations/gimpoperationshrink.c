@@ -29,6 +29,7 @@
 
 #include "operations-types.h"
 
+#include "gimp-operation-distance.h"
 #include "gimpoperationshrink.h"
 
 
@@ -269,6 +270,15 @@ gimp_operation_shrink_process (GeglOperation       *operation,
   gfloat              *buffer;
   gint                 buffer_size;
 
+  /* for large radii, a distance transform is quicker */
+  if (self->radius_x + self->radius_y >= GIMP_OPERATION_DISTANCE_PASS_COST &&
+      gimp_operation_distance_shrink (input, output, roi, input_format,
+                                      self->radius_x, self->radius_y,
+                                      self->edge_lock))
+    {
+      return TRUE;
+    }
+
   max = g_new (gfloat *, roi->width + 2 * self->radius_x);
   buf = g_new (gfloat *, self->radius_y + 1);
 
@@ -336,6 +346,15 @@ gimp_operation_shrink_process (GeglOperation       *operation,
                      1.0, input_format, buf[i + 1],
                      GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
+  /* the region may be shorter than the radius */
+  for (; i < self->radius_y; i++)
+    {
+      if (self->edge_lock)
+        memcpy (buf[i + 1], buf[i], roi->width * sizeof (gfloat));
+      else
+        memset (buf[i + 1], 0, roi->width * sizeof (gfloat));
+    }
+
   if (self->edge_lock)
     memcpy (buf[0], buf[1], roi->width * sizeof (gfloat));
   else
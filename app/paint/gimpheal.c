@@ -57,9 +57,9 @@
  * but subtract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation
+ * for small masks, and multigrid V-cycles, using the same Gauss-Seidel
+ * iteration as smoother, for larger ones.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -273,11 +273,12 @@ gimp_heal_add (GeglBuffer          *first_buffer,
 
 #if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
 static float
-gimp_heal_laplace_iteration_sse (gfloat *pixels,
-                                 gfloat *Adiag,
-                                 gint   *Aidx,
-                                 gfloat  w,
-                                 gint    nmask)
+gimp_heal_laplace_iteration_sse (gfloat       *pixels,
+                                 const gfloat *rhs,
+                                 gfloat       *Adiag,
+                                 gint         *Aidx,
+                                 gfloat        w,
+                                 gint          nmask)
 {
   typedef float v4sf __attribute__((vector_size(16)));
   gint i;
@@ -286,14 +287,29 @@ gimp_heal_laplace_iteration_sse (gfloat *pixels,
   union { v4sf v; float f[4]; } erru;
 
 #define Xv(j) (*(v4sf*)&pixels[Aidx[i * 5 + j]])
+#define Bv()  (*(const v4sf*)&rhs[Aidx[i * 5]])
 
-  for (i = 0; i < nmask; i++)
+  if (rhs)
     {
-      v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
-      v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4));
+      for (i = 0; i < nmask; i++)
+        {
+          v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
+          v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4) + Bv());
 
-      Xv(0) -= diff;
-      err += diff * diff;
+          Xv(0) -= diff;
+          err += diff * diff;
+        }
+    }
+  else
+    {
+      for (i = 0; i < nmask; i++)
+        {
+          v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
+          v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4));
+
+          Xv(0) -= diff;
+          err += diff * diff;
+        }
     }
 
   erru.v = err;
@@ -303,21 +319,25 @@ gimp_heal_laplace_iteration_sse (gfloat *pixels,
 #endif
 
 /* Perform one iteration of Gauss-Seidel, and return the sum squared residual.
+ * If rhs is not NULL, it holds the right-hand side of the equations, in the
+ * same layout as pixels.
  */
 static float
-gimp_heal_laplace_iteration (gfloat *pixels,
-                             gfloat *Adiag,
-                             gint   *Aidx,
-                             gfloat  w,
-                             gint    nmask,
-                             gint    depth)
+gimp_heal_laplace_iteration (gfloat       *pixels,
+                             const gfloat *rhs,
+                             gfloat       *Adiag,
+                             gint         *Aidx,
+                             gfloat        w,
+                             gint          nmask,
+                             gint          depth)
 {
   gint   i, k;
   gfloat err = 0;
 
 #if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
   if (depth == 4)
-    return gimp_heal_laplace_iteration_sse (pixels, Adiag, Aidx, w, nmask);
+    return gimp_heal_laplace_iteration_sse (pixels, rhs, Adiag, Aidx,
+                                            w, nmask);
 #endif
 
   for (i = 0; i < nmask; i++)
@@ -335,7 +355,8 @@ gimp_heal_laplace_iteration (gfloat *pixels,
                          w * (pixels[j1 + k] +
                               pixels[j2 + k] +
                               pixels[j3 + k] +
-                              pixels[j4 + k]));
+                              pixels[j4 + k] +
+                              (rhs ? rhs[j0 + k] : 0.0f)));
 
           pixels[j0 + k] -= diff;
           err += diff * diff;
@@ -345,26 +366,126 @@ gimp_heal_laplace_iteration (gfloat *pixels,
   return err;
 }
 
-/* Solve the laplace equation for pixels and store the result in-place.
+/* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
+#define EPSILON  (0.1/255)
+#define MAX_ITER 500
+
+/* Levels with at least this many masked pixels are solved by multigrid
+ * cycles, instead of by plain over-relaxation.
  */
+#define MIN_MULTIGRID_SIZE 1024
+#define MAX_CYCLES         50
+#define N_SMOOTH           2
+
+/* Minimum number of cells per thread, for each half of an iteration. */
+#define MIN_PARALLEL_SUB_SIZE 4096
+
+typedef struct _HealLevel HealLevel;
+
+struct _HealLevel
+{
+  gint       width;
+  gint       height;
+  gint       depth;
+  guchar    *mask;
+  gfloat    *pixels;
+  gfloat    *rhs;
+  gfloat    *Adiag;
+  gint      *Aidx;
+  gint       nmask;
+  gint       nred;
+  gfloat     w;
+
+  HealLevel *coarse;
+};
+
+typedef struct
+{
+  HealLevel *level;
+  gint       first;
+  GMutex     mutex;
+  gfloat     err;
+} HealIterationData;
+
 static void
-gimp_heal_laplace_loop (gfloat *pixels,
-                        gint    height,
-                        gint    depth,
-                        gint    width,
-                        guchar *mask)
+gimp_heal_laplace_iteration_range (gsize              offset,
+                                   gsize              size,
+                                   HealIterationData *data)
 {
-  /* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
-#define EPSILON  (0.1/255)
-#define MAX_ITER 500
+  HealLevel *level = data->level;
+  gint       first = data->first + offset;
+  gfloat     err;
+
+  err = gimp_heal_laplace_iteration (level->pixels, level->rhs,
+                                     level->Adiag + first,
+                                     level->Aidx + first * 5,
+                                     level->w, size, level->depth);
+
+  g_mutex_lock (&data->mutex);
+  data->err += err;
+  g_mutex_unlock (&data->mutex);
+}
+
+/* Perform up to n_iter iterations of Gauss-Seidel with successive
+ * over-relaxation, stopping once converged, and return the sum squared
+ * residual of the last iteration.  Red cells only depend on black cells
+ * and vice versa, so each half of an iteration is distributed across
+ * threads.
+ */
+static gfloat
+gimp_heal_laplace_relax (HealLevel *level,
+                         gint       n_iter)
+{
+  HealIterationData data;
+  gint              iter;
 
-  gint    i, j, iter, parity, nmask, zero;
-  gfloat *Adiag;
-  gint   *Aidx;
-  gfloat  w;
+  data.level = level;
+  data.err   = 0.0f;
 
-  Adiag = g_new (gfloat, width * height);
-  Aidx  = g_new (gint, 5 * width * height);
+  g_mutex_init (&data.mutex);
+
+  for (iter = 0; iter < n_iter; iter++)
+    {
+      data.err = 0.0f;
+
+      data.first = 0;
+      gegl_parallel_distribute_range (
+        level->nred, MIN_PARALLEL_SUB_SIZE,
+        (GeglParallelDistributeRangeFunc) gimp_heal_laplace_iteration_range,
+        &data);
+
+      data.first = level->nred;
+      gegl_parallel_distribute_range (
+        level->nmask - level->nred, MIN_PARALLEL_SUB_SIZE,
+        (GeglParallelDistributeRangeFunc) gimp_heal_laplace_iteration_range,
+        &data);
+
+      if (data.err < EPSILON * EPSILON * level->w * level->w)
+        break;
+    }
+
+  g_mutex_clear (&data.mutex);
+
+  return data.err;
+}
+
+static HealLevel *
+gimp_heal_level_new (gfloat *pixels,
+                     gint    height,
+                     gint    depth,
+                     gint    width,
+                     guchar *mask)
+{
+  HealLevel *level = g_slice_new0 (HealLevel);
+  gint       i, j, parity, nmask, zero;
+
+  level->width  = width;
+  level->height = height;
+  level->depth  = depth;
+  level->mask   = mask;
+  level->pixels = pixels;
+  level->Adiag  = g_new (gfloat, width * height);
+  level->Aidx   = g_new (gint, 5 * width * height);
 
   /* All off-diagonal elements of A are either -1 or 0. We could store it as a
    * general-purpose sparse matrix, but that adds some unnecessary overhead to
@@ -381,48 +502,286 @@ gimp_heal_laplace_loop (gfloat *pixels,
    */
   nmask = 0;
   for (parity = 0; parity < 2; parity++)
-    for (i = 0; i < height; i++)
-      for (j = (i&1)^parity; j < width; j+=2)
-        if (mask[j + i * width])
-          {
+    {
+      for (i = 0; i < height; i++)
+        for (j = (i&1)^parity; j < width; j+=2)
+          if (mask[j + i * width])
+            {
 #define A_NEIGHBOR(o,di,dj) \
-            if ((dj<0 && j==0) || (dj>0 && j==width-1) || (di<0 && i==0) || (di>0 && i==height-1)) \
-              Aidx[o + nmask * 5] = zero; \
-            else                                               \
-              Aidx[o + nmask * 5] = ((i + di) * width + (j + dj)) * depth;
-
-            /* Omit Dirichlet conditions for any neighbors off the
-             * edge of the canvas.
-             */
-            Adiag[nmask] = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
-            A_NEIGHBOR (0,  0,  0);
-            A_NEIGHBOR (1,  0,  1);
-            A_NEIGHBOR (2,  1,  0);
-            A_NEIGHBOR (3,  0, -1);
-            A_NEIGHBOR (4, -1,  0);
-            nmask++;
+              if ((dj<0 && j==0) || (dj>0 && j==width-1) || (di<0 && i==0) || (di>0 && i==height-1)) \
+                level->Aidx[o + nmask * 5] = zero; \
+              else                                               \
+                level->Aidx[o + nmask * 5] = ((i + di) * width + (j + dj)) * depth;
+
+              /* Omit Dirichlet conditions for any neighbors off the
+               * edge of the canvas.
+               */
+              level->Adiag[nmask] = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
+              A_NEIGHBOR (0,  0,  0);
+              A_NEIGHBOR (1,  0,  1);
+              A_NEIGHBOR (2,  1,  0);
+              A_NEIGHBOR (3,  0, -1);
+              A_NEIGHBOR (4, -1,  0);
+              nmask++;
+            }
+
+      if (parity == 0)
+        level->nred = nmask;
+    }
+
+  level->nmask = nmask;
+
+  if (nmask >= MIN_MULTIGRID_SIZE && width > 1 && height > 1)
+    {
+      gint    coarse_width  = (width  + 1) / 2;
+      gint    coarse_height = (height + 1) / 2;
+      gint    coarse_nmask  = 0;
+      guchar *coarse_mask;
+
+      /* A coarse pixel is only unknown if all of its fine pixels are
+       * unknown.  Letting the coarse problem extend past the boundary
+       * of the fine one makes the cycles diverge.
+       */
+      coarse_mask = g_new (guchar, coarse_width * coarse_height);
+
+      for (i = 0; i < coarse_height; i++)
+        for (j = 0; j < coarse_width; j++)
+          {
+            gboolean unknown = TRUE;
+            gint     fi, fj;
+
+            for (fi = 2 * i; fi < MIN (2 * i + 2, height); fi++)
+              for (fj = 2 * j; fj < MIN (2 * j + 2, width); fj++)
+                unknown &= (mask[fj + fi * width] != 0);
+
+            coarse_mask[j + i * coarse_width] = unknown;
+            coarse_nmask += unknown;
           }
 
-  /* Empirically optimal over-relaxation factor. (Benchmarked on
-   * round brushes, at least. I don't know whether aspect ratio
-   * affects it.)
-   */
-  w = 2.0 - 1.0 / (0.1575 * sqrt (nmask) + 0.8);
-  w *= 0.25;
+      if (coarse_nmask > 0)
+        {
+          gfloat *coarse_pixels;
+
+          coarse_pixels = gegl_malloc (sizeof (gfloat) * depth *
+                                       (coarse_width * coarse_height + 1));
+
+          level->coarse = gimp_heal_level_new (coarse_pixels,
+                                               coarse_height, depth,
+                                               coarse_width, coarse_mask);
+
+          level->coarse->rhs = gegl_malloc (sizeof (gfloat) * depth *
+                                            coarse_width * coarse_height);
+        }
+      else
+        {
+          g_free (coarse_mask);
+        }
+    }
+
+  if (level->coarse)
+    {
+      /* Plain Gauss-Seidel is a good smoother for the multigrid cycles,
+       * over-relaxation would only slow down the high frequencies.
+       */
+      level->w = 0.25;
+    }
+  else
+    {
+      /* Empirically optimal over-relaxation factor. (Benchmarked on
+       * round brushes, at least. I don't know whether aspect ratio
+       * affects it.)
+       */
+      level->w = 2.0 - 1.0 / (0.1575 * sqrt (nmask) + 0.8);
+      level->w *= 0.25;
+    }
+
   for (i = 0; i < nmask; i++)
-    Adiag[i] *= w;
+    level->Adiag[i] *= level->w;
+
+  return level;
+}
 
-  /* Gauss-Seidel with successive over-relaxation */
-  for (iter = 0; iter < MAX_ITER; iter++)
+static void
+gimp_heal_level_free (HealLevel *level)
+{
+  if (level->coarse)
     {
-      gfloat err = gimp_heal_laplace_iteration (pixels, Adiag, Aidx,
-                                                w, nmask, depth);
-      if (err < EPSILON * EPSILON * w * w)
-        break;
+      HealLevel *coarse = level->coarse;
+
+      gegl_free (coarse->pixels);
+      gegl_free (coarse->rhs);
+      g_free (coarse->mask);
+
+      gimp_heal_level_free (coarse);
+    }
+
+  g_free (level->Adiag);
+  g_free (level->Aidx);
+
+  g_slice_free (HealLevel, level);
+}
+
+/* Compute the residual of the unknown pixels in rows [offset,
+ * offset + size) of the coarse level, and sum it into the coarse
+ * right-hand side.  Doubling the grid spacing multiplies the 5-point
+ * Laplacian by 4, which the sum of the 4 fine pixels accounts for.
+ */
+static void
+gimp_heal_laplace_restrict (gsize      offset,
+                            gsize      size,
+                            HealLevel *level)
+{
+  HealLevel    *coarse = level->coarse;
+  gint          width  = level->width;
+  gint          height = level->height;
+  gint          depth  = level->depth;
+  const gfloat *zero   = level->pixels + depth * width * height;
+  gint          ci, cj, k;
+
+  for (ci = offset; ci < offset + size; ci++)
+    for (cj = 0; cj < coarse->width; cj++)
+      {
+        gfloat *r = coarse->rhs + (ci * coarse->width + cj) * depth;
+        gint    i, j;
+
+        for (k = 0; k < depth; k++)
+          r[k] = 0.0f;
+
+        for (i = 2 * ci; i < MIN (2 * ci + 2, height); i++)
+          for (j = 2 * cj; j < MIN (2 * cj + 2, width); j++)
+            if (level->mask[j + i * width])
+              {
+                gint          o = (i * width + j) * depth;
+                const gfloat *p = level->pixels + o;
+                const gfloat *b = level->rhs ? level->rhs + o : zero;
+                const gfloat *n1, *n2, *n3, *n4;
+                gfloat        a;
+
+                n1 = j < width - 1  ? p + depth         : zero;
+                n2 = i < height - 1 ? p + width * depth : zero;
+                n3 = j > 0          ? p - depth         : zero;
+                n4 = i > 0          ? p - width * depth : zero;
+                a  = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
+
+                for (k = 0; k < depth; k++)
+                  r[k] += b[k] + n1[k] + n2[k] + n3[k] + n4[k] - a * p[k];
+              }
+      }
+}
+
+/* Add the bilinearly interpolated coarse correction to the unknown
+ * pixels in rows [offset, offset + size).  The center of fine pixel i
+ * lies at (i - 0.5) / 2 in coarse pixel coordinates, so the weights
+ * are always 3/4 and 1/4.
+ */
+static void
+gimp_heal_laplace_prolong (gsize      offset,
+                           gsize      size,
+                           HealLevel *level)
+{
+  HealLevel *coarse = level->coarse;
+  gint       depth  = level->depth;
+  gint       i, j, k;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      gint   y0 = MAX ((i - 1) >> 1, 0);
+      gint   y1 = MIN ((i + 1) >> 1, coarse->height - 1);
+      gfloat ty = (i & 1) ? 0.25f : 0.75f;
+
+      for (j = 0; j < level->width; j++)
+        if (level->mask[j + i * level->width])
+          {
+            gint          x0  = MAX ((j - 1) >> 1, 0);
+            gint          x1  = MIN ((j + 1) >> 1, coarse->width - 1);
+            gfloat        tx  = (j & 1) ? 0.25f : 0.75f;
+            const gfloat *c00 = coarse->pixels + (y0 * coarse->width + x0) * depth;
+            const gfloat *c01 = coarse->pixels + (y0 * coarse->width + x1) * depth;
+            const gfloat *c10 = coarse->pixels + (y1 * coarse->width + x0) * depth;
+            const gfloat *c11 = coarse->pixels + (y1 * coarse->width + x1) * depth;
+            gfloat       *p   = level->pixels + (i * level->width + j) * depth;
+
+            for (k = 0; k < depth; k++)
+              {
+                gfloat top    = c00[k] + tx * (c01[k] - c00[k]);
+                gfloat bottom = c10[k] + tx * (c11[k] - c10[k]);
+
+                p[k] += top + ty * (bottom - top);
+              }
+          }
+    }
+}
+
+/* Perform one multigrid V-cycle, and return the sum squared residual of
+ * the last iteration.  The coarsest level is solved directly.
+ */
+static gfloat
+gimp_heal_laplace_cycle (HealLevel *level)
+{
+  HealLevel *coarse = level->coarse;
+  gint       min_rows;
+
+  if (! coarse)
+    return gimp_heal_laplace_relax (level, MAX_ITER);
+
+  gimp_heal_laplace_relax (level, N_SMOOTH);
+
+  min_rows = MAX (MIN_PARALLEL_SUB_SIZE / level->width, 1);
+
+  gegl_parallel_distribute_range (
+    coarse->height, (min_rows + 1) / 2,
+    (GeglParallelDistributeRangeFunc) gimp_heal_laplace_restrict,
+    level);
+
+  memset (coarse->pixels, 0,
+          sizeof (gfloat) * coarse->depth *
+          (coarse->width * coarse->height + 1));
+
+  gimp_heal_laplace_cycle (coarse);
+
+  gegl_parallel_distribute_range (
+    level->height, min_rows,
+    (GeglParallelDistributeRangeFunc) gimp_heal_laplace_prolong,
+    level);
+
+  return gimp_heal_laplace_relax (level, N_SMOOTH);
+}
+
+/* Solve the laplace equation for pixels and store the result in-place.
+ */
+static void
+gimp_heal_laplace_loop (gfloat *pixels,
+                        gint    height,
+                        gint    depth,
+                        gint    width,
+                        guchar *mask)
+{
+  HealLevel *level;
+
+  level = gimp_heal_level_new (pixels, height, depth, width, mask);
+
+  if (level->coarse)
+    {
+      gint cycle;
+
+      /* Multigrid cycles, each of which reduces the residual by a
+       * constant factor, regardless of the brush size.
+       */
+      for (cycle = 0; cycle < MAX_CYCLES; cycle++)
+        {
+          gfloat err = gimp_heal_laplace_cycle (level);
+
+          if (err < EPSILON * EPSILON * level->w * level->w)
+            break;
+        }
+    }
+  else
+    {
+      /* Gauss-Seidel with successive over-relaxation */
+      gimp_heal_laplace_relax (level, MAX_ITER);
     }
 
-  g_free (Adiag);
-  g_free (Aidx);
+  gimp_heal_level_free (level);
 }
 
 /* Original Algorithm Design:
@@ -274,6 +274,13 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
     }
 
   n_strokes = gimp_symmetry_get_size (sym);
+
+  /*  The strokes don't depend on each other's pixels, let the paint core
+   *  perform their pastes concurrently where they don't overlap
+   */
+  if (n_strokes > 1)
+    gimp_paint_core_defer_pastes (paint_core);
+
   for (i = 0; i < n_strokes; i++)
     {
       GimpLayerMode             paint_mode;
@@ -396,4 +403,6 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
                                     force,
                                     paint_appl_mode);
     }
+
+  gimp_paint_core_flush_pastes (paint_core);
 }
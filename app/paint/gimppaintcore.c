@@ -67,6 +67,16 @@ enum
 };
 
 
+typedef struct
+{
+  GimpPaintCoreLoopsParams     params;
+  GimpPaintCoreLoopsAlgorithm  algorithms;
+  GimpDrawable                *drawable;
+  GeglRectangle                rect;
+  gint                         wave;
+} GimpPaintCorePaste;
+
+
 /*  local function prototypes  */
 
 static void      gimp_paint_core_finalize            (GObject          *object);
@@ -118,6 +128,11 @@ static GimpUndo* gimp_paint_core_real_push_undo      (GimpPaintCore    *core,
                                                       GimpImage        *image,
                                                       const gchar      *undo_desc);
 
+static void      gimp_paint_core_paste_clear         (GimpPaintCorePaste  *paste);
+static void      gimp_paint_core_process_pastes      (gsize                offset,
+                                                      gsize                size,
+                                                      GimpPaintCorePaste **pastes);
+
 
 G_DEFINE_TYPE (GimpPaintCore, gimp_paint_core, GIMP_TYPE_OBJECT)
 
@@ -171,6 +186,8 @@ gimp_paint_core_finalize (GObject *object)
       core->stroke_buffer = NULL;
     }
 
+  g_clear_pointer (&core->deferred_pastes, g_array_unref);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -922,7 +939,32 @@ gimp_paint_core_paste (GimpPaintCore            *core,
           algorithms |= GIMP_PAINT_CORE_LOOPS_ALGORITHM_MASK_COMPONENTS;
         }
 
-      gimp_paint_core_loops_process (&params, algorithms);
+      if (core->deferred_pastes)
+        {
+          GimpPaintCorePaste paste;
+
+          /*  The paint buffer and the paint mask are reused for the next
+           *  dab, keep copies of them until the paste is performed
+           */
+          params.paint_buf = gimp_temp_buf_copy (params.paint_buf);
+
+          if (params.paint_mask)
+            params.paint_mask = gimp_temp_buf_copy (params.paint_mask);
+
+          paste.params     = params;
+          paste.algorithms = algorithms;
+          paste.drawable   = drawable;
+          paste.rect       = *GEGL_RECTANGLE (core->paint_buffer_x,
+                                              core->paint_buffer_y,
+                                              width, height);
+          paste.wave       = 0;
+
+          g_array_append_val (core->deferred_pastes, paste);
+        }
+      else
+        {
+          gimp_paint_core_loops_process (&params, algorithms);
+        }
     }
 
   /*  Update the undo extents  */
@@ -931,11 +973,14 @@ gimp_paint_core_paste (GimpPaintCore            *core,
   core->x2 = MAX (core->x2, core->paint_buffer_x + width);
   core->y2 = MAX (core->y2, core->paint_buffer_y + height);
 
-  /*  Update the drawable  */
-  gimp_drawable_update (drawable,
-                        core->paint_buffer_x,
-                        core->paint_buffer_y,
-                        width, height);
+  /*  Update the drawable, deferred pastes do it when they are flushed  */
+  if (! core->deferred_pastes)
+    {
+      gimp_drawable_update (drawable,
+                            core->paint_buffer_x,
+                            core->paint_buffer_y,
+                            width, height);
+    }
 }
 
 /* This works similarly to gimp_paint_core_paste. However, instead of
@@ -1132,6 +1177,109 @@ gimp_paint_core_replace (GimpPaintCore            *core,
                         width, height);
 }
 
+/* Start collecting the pastes, instead of performing them right away,
+ * until gimp_paint_core_flush_pastes() is called.  Used by tools painting
+ * several dabs at once, such as for symmetry, which don't read back the
+ * pixels painted by one dab before pasting the next one.
+ */
+void
+gimp_paint_core_defer_pastes (GimpPaintCore *core)
+{
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+  g_return_if_fail (core->deferred_pastes == NULL);
+
+  /*  The applicator can't be used concurrently  */
+  if (core->applicator)
+    return;
+
+  core->deferred_pastes = g_array_new (FALSE, FALSE,
+                                       sizeof (GimpPaintCorePaste));
+
+  g_array_set_clear_func (core->deferred_pastes,
+                          (GDestroyNotify) gimp_paint_core_paste_clear);
+}
+
+/* Perform the pastes collected since gimp_paint_core_defer_pastes().
+ * Pastes which don't overlap any earlier paste are performed
+ * concurrently, while overlapping pastes are performed in their original
+ * order, so the result is the same as painting the dabs one by one.
+ */
+void
+gimp_paint_core_flush_pastes (GimpPaintCore *core)
+{
+  GArray              *pastes;
+  GimpPaintCorePaste **wave_pastes;
+  gint                 n_waves = 0;
+  gint                 wave;
+  gint                 i, j;
+
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+
+  if (! core->deferred_pastes)
+    return;
+
+  pastes = core->deferred_pastes;
+  core->deferred_pastes = NULL;
+
+  /*  Put each paste in the wave following the last wave containing an
+   *  earlier paste it overlaps
+   */
+  for (i = 0; i < pastes->len; i++)
+    {
+      GimpPaintCorePaste *paste = &g_array_index (pastes,
+                                                  GimpPaintCorePaste, i);
+
+      for (j = 0; j < i; j++)
+        {
+          GimpPaintCorePaste *prev = &g_array_index (pastes,
+                                                     GimpPaintCorePaste, j);
+
+          if (prev->wave >= paste->wave &&
+              gegl_rectangle_intersect (NULL, &prev->rect, &paste->rect))
+            {
+              paste->wave = prev->wave + 1;
+            }
+        }
+
+      n_waves = MAX (n_waves, paste->wave + 1);
+    }
+
+  wave_pastes = g_new (GimpPaintCorePaste *, pastes->len);
+
+  for (wave = 0; wave < n_waves; wave++)
+    {
+      gint n_wave_pastes = 0;
+
+      for (i = 0; i < pastes->len; i++)
+        {
+          GimpPaintCorePaste *paste = &g_array_index (pastes,
+                                                      GimpPaintCorePaste, i);
+
+          if (paste->wave == wave)
+            wave_pastes[n_wave_pastes++] = paste;
+        }
+
+      gegl_parallel_distribute_range (
+        n_wave_pastes, 1,
+        (GeglParallelDistributeRangeFunc) gimp_paint_core_process_pastes,
+        wave_pastes);
+    }
+
+  g_free (wave_pastes);
+
+  for (i = 0; i < pastes->len; i++)
+    {
+      GimpPaintCorePaste *paste = &g_array_index (pastes,
+                                                  GimpPaintCorePaste, i);
+
+      gimp_drawable_update (paste->drawable,
+                            paste->rect.x,     paste->rect.y,
+                            paste->rect.width, paste->rect.height);
+    }
+
+  g_array_unref (pastes);
+}
+
 /**
  * Smooth and store coords in the stroke buffer
  */
@@ -1198,3 +1346,26 @@ gimp_paint_core_smooth_coords (GimpPaintCore    *core,
         }
     }
 }
+
+
+/*  private functions  */
+
+static void
+gimp_paint_core_paste_clear (GimpPaintCorePaste *paste)
+{
+  gimp_temp_buf_unref (paste->params.paint_buf);
+
+  if (paste->params.paint_mask)
+    gimp_temp_buf_unref ((GimpTempBuf *) paste->params.paint_mask);
+}
+
+static void
+gimp_paint_core_process_pastes (gsize                offset,
+                                gsize                size,
+                                GimpPaintCorePaste **pastes)
+{
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    gimp_paint_core_loops_process (&pastes[i]->params, pastes[i]->algorithms);
+}
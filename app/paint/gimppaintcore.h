@@ -69,6 +69,8 @@ struct _GimpPaintCore
   GimpApplicator *applicator;
 
   GArray      *stroke_buffer;
+
+  GArray      *deferred_pastes;   /*  pastes waiting to be performed      */
 };
 
 struct _GimpPaintCoreClass
@@ -198,6 +200,9 @@ void      gimp_paint_core_replace           (GimpPaintCore            *core,
                                              gdouble                   image_opacity,
                                              GimpPaintApplicationMode  mode);
 
+void      gimp_paint_core_defer_pastes      (GimpPaintCore            *core);
+void      gimp_paint_core_flush_pastes      (GimpPaintCore            *core);
+
 void      gimp_paint_core_smooth_coords             (GimpPaintCore    *core,
                                                      GimpPaintOptions *paint_options,
                                                      GimpCoords       *coords);
@@ -30,10 +30,14 @@
 #include "core/gimp.h"
 #include "core/gimp-memsize.h"
 #include "core/gimpchannel.h"
+#include "core/gimpimage.h"
 #include "core/gimplayer.h"
 #include "core/gimpparamspecs.h"
+#include "core/gimppickable.h"
 #include "core/gimpprogress.h"
 
+#include "text/gimptextlayer.h"
+
 #include "vectors/gimpvectors.h"
 
 #include "gimppdbcontext.h"
@@ -69,6 +73,8 @@ static void        gimp_procedure_real_execute_async    (GimpProcedure   *proced
                                                          GimpObject      *display);
 
 static void          gimp_procedure_free_strings        (GimpProcedure   *procedure);
+static void          gimp_procedure_flush_args          (Gimp            *gimp,
+                                                         GimpValueArray  *args);
 static gboolean      gimp_procedure_validate_args       (GimpProcedure   *procedure,
                                                          GParamSpec     **param_specs,
                                                          gint             n_param_specs,
@@ -427,6 +433,8 @@ gimp_procedure_execute (GimpProcedure   *procedure,
   if (progress)
     g_object_ref (progress);
 
+  gimp_procedure_flush_args (gimp, args);
+
   /*  call the procedure  */
   return_vals = GIMP_PROCEDURE_GET_CLASS (procedure)->execute (procedure,
                                                                gimp,
@@ -518,6 +526,8 @@ gimp_procedure_execute_async (GimpProcedure  *procedure,
       if (progress)
         g_object_ref (progress);
 
+      gimp_procedure_flush_args (gimp, args);
+
       GIMP_PROCEDURE_GET_CLASS (procedure)->execute_async (procedure, gimp,
                                                            context, progress,
                                                            args, display);
@@ -727,6 +737,52 @@ gimp_procedure_free_strings (GimpProcedure *procedure)
   procedure->static_strings = FALSE;
 }
 
+/*  brings the drawables passed to a procedure up to date, in case their
+ *  pixels are still being rendered, like those of a text layer that is
+ *  being edited.  procedures taking a whole image (merging, flattening,
+ *  exporting) get all of its text layers flushed.
+ */
+static void
+gimp_procedure_flush_args (Gimp           *gimp,
+                           GimpValueArray *args)
+{
+  gint i;
+
+  for (i = 0; i < gimp_value_array_length (args); i++)
+    {
+      GValue       *value    = gimp_value_array_index (args, i);
+      GimpDrawable *drawable = NULL;
+
+      if (GIMP_VALUE_HOLDS_DRAWABLE_ID (value))
+        drawable = gimp_value_get_drawable (value, gimp);
+      else if (GIMP_VALUE_HOLDS_LAYER_ID (value))
+        drawable = GIMP_DRAWABLE (gimp_value_get_layer (value, gimp));
+
+      if (drawable)
+        {
+          gimp_pickable_flush (GIMP_PICKABLE (drawable));
+        }
+      else if (GIMP_VALUE_HOLDS_IMAGE_ID (value))
+        {
+          GimpImage *image = gimp_value_get_image (value, gimp);
+
+          if (image)
+            {
+              GList *layers = gimp_image_get_layer_list (image);
+              GList *list;
+
+              for (list = layers; list; list = g_list_next (list))
+                {
+                  if (GIMP_IS_TEXT_LAYER (list->data))
+                    gimp_pickable_flush (GIMP_PICKABLE (list->data));
+                }
+
+              g_list_free (layers);
+            }
+        }
+    }
+}
+
 static gboolean
 gimp_procedure_validate_args (GimpProcedure  *procedure,
                               GParamSpec    **param_specs,
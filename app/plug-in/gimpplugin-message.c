@@ -36,6 +36,7 @@
 #include "core/gimp.h"
 #include "core/gimpdrawable.h"
 #include "core/gimpdrawable-shadow.h"
+#include "core/gimppickable.h"
 
 #include "pdb/gimp-pdb-compat.h"
 #include "pdb/gimppdb.h"
@@ -385,6 +386,9 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
     }
   else
     {
+      /*  the plug-in may read drawables it wasn't passed  */
+      gimp_pickable_flush (GIMP_PICKABLE (drawable));
+
       buffer = gimp_drawable_get_buffer (drawable);
     }
 
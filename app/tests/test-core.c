@@ -0,0 +1,966 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 2009 Martin Nordholts
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "widgets/widgets-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "widgets/gimpuimanager.h"
+
+#include "core/gimp.h"
+#include "core/gimpcontext.h"
+#include "core/gimpdrawable-foreground-extract.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimplayer-new.h"
+#include "core/gimplineart.h"
+#include "core/gimppickable.h"
+#include "core/gimptempbuf.h"
+
+#include "file/file-open.h"
+#include "file/file-save.h"
+
+#include "gegl/gimp-gegl-apply-operation.h"
+
+#include "operations/gimp-operation-distance.h"
+#include "operations/gimplevelsconfig.h"
+
+#include "plug-in/gimppluginmanager-file.h"
+
+#include "text/gimptext.h"
+#include "text/gimptextlayer.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define GIMP_TEST_IMAGE_SIZE 100
+
+#define ADD_IMAGE_TEST(function) \
+  g_test_add ("/gimp-core/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              gimp_test_image_setup, \
+              function, \
+              gimp_test_image_teardown);
+
+#define ADD_TEST(function) \
+  g_test_add ("/gimp-core/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              NULL, \
+              function, \
+              NULL);
+
+
+typedef struct
+{
+  GimpImage *image;
+} GimpTestFixture;
+
+
+static void gimp_test_image_setup    (GimpTestFixture *fixture,
+                                      gconstpointer    data);
+static void gimp_test_image_teardown (GimpTestFixture *fixture,
+                                      gconstpointer    data);
+
+
+/**
+ * gimp_test_image_setup:
+ * @fixture:
+ * @data:
+ *
+ * Test fixture setup for a single image.
+ **/
+static void
+gimp_test_image_setup (GimpTestFixture *fixture,
+                       gconstpointer    data)
+{
+  Gimp *gimp = GIMP (data);
+
+  fixture->image = gimp_image_new (gimp,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_RGB,
+                                   GIMP_PRECISION_FLOAT_LINEAR);
+}
+
+/**
+ * gimp_test_image_teardown:
+ * @fixture:
+ * @data:
+ *
+ * Test fixture teardown for a single image.
+ **/
+static void
+gimp_test_image_teardown (GimpTestFixture *fixture,
+                          gconstpointer    data)
+{
+  g_object_unref (fixture->image);
+}
+
+/**
+ * rotate_non_overlapping:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can add a layer
+ * and call gimp_item_rotate with center at (0, -10)
+ * without triggering a failed assertion .
+ **/
+static void
+rotate_non_overlapping (GimpTestFixture *fixture,
+                        gconstpointer    data)
+{
+  Gimp        *gimp    = GIMP (data);
+  GimpImage   *image   = fixture->image;
+  GimpLayer   *layer;
+  GimpContext *context = gimp_context_new (gimp, "Test", NULL /*template*/);
+  gboolean     result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  gimp_item_rotate (GIMP_ITEM (layer), context, GIMP_ROTATE_90, 0., -10., TRUE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+  g_object_unref (context);
+}
+
+/**
+ * add_layer:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can add a layer.
+ **/
+static void
+add_layer (GimpTestFixture *fixture,
+           gconstpointer    data)
+{
+  GimpImage *image = fixture->image;
+  GimpLayer *layer;
+  gboolean   result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+}
+
+/**
+ * remove_layer:
+ * @fixture:
+ * @data:
+ *
+ * Super basic test that makes sure we can remove a layer.
+ **/
+static void
+remove_layer (GimpTestFixture *fixture,
+              gconstpointer    data)
+{
+  GimpImage *image = fixture->image;
+  GimpLayer *layer;
+  gboolean   result;
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  g_assert_cmpint (GIMP_IS_LAYER (layer), ==, TRUE);
+
+  result = gimp_image_add_layer (image,
+                                 layer,
+                                 GIMP_IMAGE_ACTIVE_PARENT,
+                                 0,
+                                 FALSE);
+
+  g_assert_cmpint (result, ==, TRUE);
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 1);
+
+  gimp_image_remove_layer (image,
+                           layer,
+                           FALSE,
+                           NULL);
+
+  g_assert_cmpint (gimp_image_get_n_layers (image), ==, 0);
+}
+
+/**
+ * white_graypoint_in_red_levels:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure the levels algorithm can handle when the graypoint is
+ * white. It's easy to get a divide by zero problem when trying to
+ * calculate what gamma will give a white graypoint.
+ **/
+static void
+white_graypoint_in_red_levels (GimpTestFixture *fixture,
+                               gconstpointer    data)
+{
+  GimpRGB              black   = { 0, 0, 0, 0 };
+  GimpRGB              gray    = { 1, 1, 1, 1 };
+  GimpRGB              white   = { 1, 1, 1, 1 };
+  GimpHistogramChannel channel = GIMP_HISTOGRAM_RED;
+  GimpLevelsConfig    *config;
+
+  config = g_object_new (GIMP_TYPE_LEVELS_CONFIG, NULL);
+
+  gimp_levels_config_adjust_by_colors (config,
+                                       channel,
+                                       &black,
+                                       &gray,
+                                       &white);
+
+  /* Make sure we didn't end up with an invalid gamma value */
+  g_object_set (config,
+                "gamma", config->gamma[channel],
+                NULL);
+}
+
+/**
+ * foreground_extract_whole_drawable:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure gimp_drawable_foreground_extract(), which the PDB uses,
+ * still mattes the whole drawable at once, like a plain matting graph.
+ **/
+static void
+foreground_extract_whole_drawable (GimpTestFixture *fixture,
+                                   gconstpointer    data)
+{
+  GimpImage     *image = fixture->image;
+  GimpLayer     *layer;
+  GeglBuffer    *trimap;
+  GeglBuffer    *matte;
+  GeglBuffer    *reference = NULL;
+  GeglNode      *gegl;
+  GeglNode      *input_node;
+  GeglNode      *trimap_node;
+  GeglNode      *matting_node;
+  GeglNode      *output_node;
+  GeglRectangle  rect = { 0, 0, GIMP_TEST_IMAGE_SIZE, GIMP_TEST_IMAGE_SIZE };
+  guchar        *pixels;
+  gfloat        *mask;
+  gfloat        *result;
+  gfloat        *expected;
+  gint           x, y;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image,
+                        layer,
+                        GIMP_IMAGE_ACTIVE_PARENT,
+                        0,
+                        FALSE);
+
+  /* a red disc on a blue background, with an unknown band along its
+   * edge, and only a small part of the drawable unknown
+   */
+  pixels = g_new (guchar, 4 * rect.width * rect.height);
+  mask   = g_new (gfloat, rect.width * rect.height);
+
+  for (y = 0; y < rect.height; y++)
+    {
+      for (x = 0; x < rect.width; x++)
+        {
+          gint    i = y * rect.width + x;
+          gdouble d = hypot (x - 30, y - 30);
+
+          pixels[4 * i + 0] = d < 15 ? 255 : (x * 7) % 64;
+          pixels[4 * i + 1] = (x * y) % 32;
+          pixels[4 * i + 2] = d < 15 ? (y * 5) % 64 : 255;
+          pixels[4 * i + 3] = 255;
+
+          if (d < 12)
+            mask[i] = 1.0;
+          else if (d < 18)
+            mask[i] = 0.5;
+          else
+            mask[i] = 0.0;
+        }
+    }
+
+  gegl_buffer_set (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)), &rect, 0,
+                   babl_format ("R'G'B'A u8"), pixels, GEGL_AUTO_ROWSTRIDE);
+
+  trimap = gegl_buffer_new (&rect, babl_format ("Y float"));
+  gegl_buffer_set (trimap, &rect, 0, babl_format ("Y float"),
+                   mask, GEGL_AUTO_ROWSTRIDE);
+
+  matte = gimp_drawable_foreground_extract (GIMP_DRAWABLE (layer),
+                                            GIMP_MATTING_ENGINE_LEVIN,
+                                            0, 2, 2,
+                                            trimap, NULL);
+
+  gegl = gegl_node_new ();
+
+  input_node = gegl_node_new_child (gegl,
+                                    "operation", "gegl:buffer-source",
+                                    "buffer",    gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                                    NULL);
+  trimap_node = gegl_node_new_child (gegl,
+                                     "operation", "gegl:buffer-source",
+                                     "buffer",    trimap,
+                                     NULL);
+  matting_node = gegl_node_new_child (gegl,
+                                      "operation",     "gegl:matting-levin",
+                                      "levels",        2,
+                                      "active_levels", 2,
+                                      NULL);
+  output_node = gegl_node_new_child (gegl,
+                                     "operation", "gegl:buffer-sink",
+                                     "buffer",    &reference,
+                                     "format",    NULL,
+                                     NULL);
+
+  gegl_node_connect_to (input_node,   "output",
+                        matting_node, "input");
+  gegl_node_connect_to (trimap_node,  "output",
+                        matting_node, "aux");
+  gegl_node_link (matting_node, output_node);
+
+  gegl_node_process (output_node);
+
+  g_object_unref (gegl);
+
+  g_assert (matte != NULL);
+  g_assert (reference != NULL);
+  g_assert_cmpint (gegl_buffer_get_width  (matte), ==, rect.width);
+  g_assert_cmpint (gegl_buffer_get_height (matte), ==, rect.height);
+
+  result   = g_new (gfloat, rect.width * rect.height);
+  expected = g_new (gfloat, rect.width * rect.height);
+
+  gegl_buffer_get (matte, &rect, 1.0, babl_format ("Y float"),
+                   result, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (reference, &rect, 1.0, babl_format ("Y float"),
+                   expected, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (x = 0; x < rect.width * rect.height; x++)
+    g_assert_cmpfloat (fabs (result[x] - expected[x]), <, 1e-4);
+
+  g_free (expected);
+  g_free (result);
+  g_free (mask);
+  g_free (pixels);
+
+  g_object_unref (reference);
+  g_object_unref (matte);
+  g_object_unref (trimap);
+}
+
+/*  the grow/shrink structuring element, with the edges treated the
+ *  way gimp:grow and gimp:shrink document it: outside pixels are 0,
+ *  except when shrinking with edge lock, where they are ignored
+ */
+static void
+morphology_reference (const gfloat *src,
+                      gfloat       *dest,
+                      gint          width,
+                      gint          height,
+                      gint          radius_x,
+                      gint          radius_y,
+                      gboolean      erode,
+                      gboolean      edge_lock)
+{
+  gint64 rx2    = (gint64) radius_x * radius_x;
+  gint64 ry2    = (gint64) radius_y * radius_y;
+  gint64 radius = 4 * rx2 * ry2;
+  gint   x, y;
+  gint   i, j;
+
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          gfloat value = erode ? 1.0 : 0.0;
+
+          for (j = -radius_y; j <= radius_y; j++)
+            {
+              for (i = -radius_x; i <= radius_x; i++)
+                {
+                  gint64 a = i ? 2 * ABS (i) - 1 : 0;
+                  gint64 b = j ? 2 * ABS (j) - 1 : 0;
+                  gfloat v;
+
+                  if (a * a * ry2 + b * b * rx2 >= radius)
+                    continue;
+
+                  if (x + i < 0 || x + i >= width ||
+                      y + j < 0 || y + j >= height)
+                    {
+                      if (erode && edge_lock)
+                        continue;
+
+                      v = 0.0;
+                    }
+                  else
+                    {
+                      v = src[(y + j) * width + x + i];
+                    }
+
+                  value = erode ? MIN (value, v) : MAX (value, v);
+                }
+            }
+
+          dest[y * width + x] = value;
+        }
+    }
+}
+
+static void
+morphology_compare (const gchar *operation,
+                    gint         width,
+                    gint         height,
+                    gint         n_levels,
+                    gint         radius_x,
+                    gint         radius_y,
+                    gboolean     edge_lock)
+{
+  GeglRectangle  rect     = { 0, 0, width, height };
+  GeglBuffer    *input;
+  GeglBuffer    *output;
+  GeglNode      *node;
+  GRand         *rand;
+  gboolean       erode    = ! strcmp (operation, "gimp:shrink");
+  gfloat        *src;
+  gfloat        *result;
+  gfloat        *expected;
+  gint           i;
+
+  src      = g_new (gfloat, width * height);
+  result   = g_new (gfloat, width * height);
+  expected = g_new (gfloat, width * height);
+
+  /*  blobs of a few different values, mostly of the background  */
+  rand = g_rand_new_with_seed (radius_x * 1000 + radius_y);
+
+  for (i = 0; i < width * height; i++)
+    {
+      if (i > 0 && g_rand_int_range (rand, 0, 4))
+        src[i] = src[i - 1];
+      else if (g_rand_int_range (rand, 0, 3))
+        src[i] = erode ? 1.0 : 0.0;
+      else if (erode)
+        src[i] = (gfloat) g_rand_int_range (rand, 0, n_levels - 1) / (n_levels - 1);
+      else
+        src[i] = (gfloat) g_rand_int_range (rand, 1, n_levels) / (n_levels - 1);
+    }
+
+  g_rand_free (rand);
+
+  input  = gegl_buffer_new (&rect, babl_format ("Y float"));
+  output = gegl_buffer_new (&rect, babl_format ("Y float"));
+
+  gegl_buffer_set (input, &rect, 0, babl_format ("Y float"),
+                   src, GEGL_AUTO_ROWSTRIDE);
+
+  if (erode)
+    {
+      node = gegl_node_new_child (NULL,
+                                  "operation", operation,
+                                  "radius-x",  radius_x,
+                                  "radius-y",  radius_y,
+                                  "edge-lock", edge_lock,
+                                  NULL);
+    }
+  else
+    {
+      node = gegl_node_new_child (NULL,
+                                  "operation", operation,
+                                  "radius-x",  radius_x,
+                                  "radius-y",  radius_y,
+                                  NULL);
+    }
+
+  gimp_gegl_apply_operation (input, NULL, NULL, node, output, NULL, FALSE);
+
+  g_object_unref (node);
+
+  gegl_buffer_get (output, &rect, 1.0, babl_format ("Y float"),
+                   result, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  morphology_reference (src, expected, width, height,
+                        radius_x, radius_y, erode, edge_lock);
+
+  for (i = 0; i < width * height; i++)
+    g_assert_cmpfloat (result[i], ==, expected[i]);
+
+  g_object_unref (output);
+  g_object_unref (input);
+
+  g_free (expected);
+  g_free (result);
+  g_free (src);
+}
+
+/**
+ * grow_shrink_distance_transform:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure gimp:grow and gimp:shrink give the same result on both
+ * sides of the radius from which they use a distance transform
+ * instead of a sliding window, including at the region's edges, with
+ * and without edge lock, and for regions shorter than the radius.
+ **/
+static void
+grow_shrink_distance_transform (GimpTestFixture *fixture,
+                                gconstpointer    data)
+{
+  const gint cost = GIMP_OPERATION_DISTANCE_PASS_COST;
+  gint       edge_lock;
+
+  /*  one distance transform pass per level, excluding the lowest one  */
+  morphology_compare ("gimp:grow", 67, 45, 2, cost / 2, cost / 2 - 1, FALSE);
+  morphology_compare ("gimp:grow", 67, 45, 2, cost / 2, cost / 2,     FALSE);
+  morphology_compare ("gimp:grow", 67, 45, 3, cost,     cost,         FALSE);
+  morphology_compare ("gimp:grow", 67, 5,  2, cost / 2, cost / 2 - 1, FALSE);
+  morphology_compare ("gimp:grow", 67, 5,  2, cost / 2, cost / 2,     FALSE);
+
+  for (edge_lock = FALSE; edge_lock <= TRUE; edge_lock++)
+    {
+      morphology_compare ("gimp:shrink", 67, 45, 2,
+                          cost / 2, cost / 2 - 1, edge_lock);
+      morphology_compare ("gimp:shrink", 67, 45, 2,
+                          cost / 2, cost / 2,     edge_lock);
+      morphology_compare ("gimp:shrink", 67, 45, 3,
+                          cost,     cost,         edge_lock);
+      morphology_compare ("gimp:shrink", 67, 5,  2,
+                          cost / 2, cost / 2 - 1, edge_lock);
+      morphology_compare ("gimp:shrink", 67, 5,  2,
+                          cost / 2, cost / 2,     edge_lock);
+    }
+}
+
+static void
+line_art_draw (GimpLayer *layer,
+               gint       x,
+               gint       y,
+               gint       width,
+               gint       height)
+{
+  GeglColor *black = gegl_color_new ("black");
+
+  gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                         GEGL_RECTANGLE (x, y, width, height), black);
+
+  g_object_unref (black);
+
+  gimp_viewable_invalidate_preview (GIMP_VIEWABLE (layer));
+}
+
+static guchar *
+line_art_get_closed (GimpLineArt *line_art)
+{
+  GeglBuffer *closed;
+  guchar     *pixels;
+
+  /*  let the line art notice the changed input  */
+  while (g_main_context_pending (NULL))
+    g_main_context_iteration (NULL, FALSE);
+
+  closed = gimp_line_art_get (line_art, NULL);
+
+  g_assert (closed != NULL);
+
+  pixels = g_new (guchar, gegl_buffer_get_width (closed) *
+                          gegl_buffer_get_height (closed));
+
+  gegl_buffer_get (closed, NULL, 1.0, babl_format ("Y u8"), pixels,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  return pixels;
+}
+
+/**
+ * line_art_recompute:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure a line art which is recomputed after its input changed
+ * gives the same closure as one computed from scratch.
+ **/
+static void
+line_art_recompute (GimpTestFixture *fixture,
+                    gconstpointer    data)
+{
+  GimpImage   *image = fixture->image;
+  GimpLayer   *layer;
+  GimpLineArt *line_art;
+  GimpLineArt *reference;
+  GeglColor   *white;
+  guchar      *result;
+  guchar      *expected;
+  gint         i;
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE,
+                          GIMP_TEST_IMAGE_SIZE,
+                          babl_format ("R'G'B'A u8"),
+                          "Test Layer",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (image,
+                        layer,
+                        GIMP_IMAGE_ACTIVE_PARENT,
+                        0,
+                        FALSE);
+
+  white = gegl_color_new ("white");
+  gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                         NULL, white);
+  g_object_unref (white);
+
+  /*  two boxes with gaps, far enough apart for a change to one of them
+   *  to be local
+   */
+  line_art_draw (layer, 10, 10, 30,  2);
+  line_art_draw (layer, 10, 10,  2, 30);
+  line_art_draw (layer, 10, 38, 30,  2);
+  line_art_draw (layer, 38, 10,  2, 12);
+  line_art_draw (layer, 38, 28,  2, 12);
+
+  line_art_draw (layer, 60, 60, 30,  2);
+  line_art_draw (layer, 60, 60,  2, 30);
+  line_art_draw (layer, 60, 88, 30,  2);
+  line_art_draw (layer, 88, 60,  2, 30);
+
+  line_art = gimp_line_art_new ();
+  gimp_line_art_set_input (line_art, GIMP_PICKABLE (layer));
+
+  g_free (line_art_get_closed (line_art));
+
+  /*  an unchanged input, then a small change  */
+  for (i = 0; i < 2; i++)
+    {
+      if (i == 1)
+        line_art_draw (layer, 74, 70, 3, 3);
+      else
+        gimp_viewable_invalidate_preview (GIMP_VIEWABLE (layer));
+
+      result = line_art_get_closed (line_art);
+
+      reference = gimp_line_art_new ();
+      gimp_line_art_set_input (reference, GIMP_PICKABLE (layer));
+
+      expected = line_art_get_closed (reference);
+
+      g_assert (memcmp (result, expected,
+                        GIMP_TEST_IMAGE_SIZE * GIMP_TEST_IMAGE_SIZE) == 0);
+
+      g_free (expected);
+      g_free (result);
+
+      g_object_unref (reference);
+    }
+
+  g_object_unref (line_art);
+}
+
+/**
+ * text_layer_flush_before_save:
+ * @fixture:
+ * @data:
+ *
+ * Changes the text of a text layer while it's rendered asynchronously,
+ * like while the text tool edits it, and saves the image right away.
+ * The saved layer must have the new text's pixels, not those of the
+ * render that was still pending.
+ **/
+static void
+text_layer_flush_before_save (GimpTestFixture *fixture,
+                              gconstpointer    data)
+{
+  Gimp                *gimp  = GIMP (data);
+  GimpImage           *image = fixture->image;
+  GimpImage           *loaded_image;
+  GimpLayer           *layer;
+  GimpLayer           *loaded_layer;
+  GimpText            *text;
+  GimpPlugInProcedure *proc;
+  GimpPDBStatusType    status;
+  GFile               *file;
+  gchar               *filename;
+  gint                 file_handle;
+  gint                 width;
+  gint                 height;
+  gfloat              *expected;
+  gfloat              *result;
+
+  text = g_object_new (GIMP_TYPE_TEXT,
+                       "text",      "a",
+                       "font-size", 20.0,
+                       NULL);
+
+  layer = gimp_text_layer_new (image, text);
+  g_object_unref (text);
+
+  g_assert (layer != NULL);
+
+  gimp_image_add_layer (image,
+                        layer,
+                        GIMP_IMAGE_ACTIVE_PARENT,
+                        0,
+                        FALSE /*push_undo*/);
+
+  gimp_text_layer_begin_async_render (GIMP_TEXT_LAYER (layer));
+
+  gimp_text_layer_set (GIMP_TEXT_LAYER (layer), NULL,
+                       "text", "a much longer text",
+                       NULL);
+
+  file_handle = g_file_open_tmp ("gimp-test-XXXXXX.xcf", &filename, NULL);
+  g_assert (file_handle != -1);
+  close (file_handle);
+  file = g_file_new_for_path (filename);
+  g_free (filename);
+
+  proc = gimp_plug_in_manager_file_procedure_find (gimp->plug_in_manager,
+                                                   GIMP_FILE_PROCEDURE_GROUP_SAVE,
+                                                   file,
+                                                   NULL /*error*/);
+  file_save (gimp,
+             image,
+             NULL /*progress*/,
+             file,
+             proc,
+             GIMP_RUN_NONINTERACTIVE,
+             FALSE /*change_saved_state*/,
+             FALSE /*export_backward*/,
+             FALSE /*export_forward*/,
+             NULL /*error*/);
+
+  /*  brings the layer up to date, whether or not saving did  */
+  gimp_text_layer_end_async_render (GIMP_TEXT_LAYER (layer));
+
+  proc = gimp_plug_in_manager_file_procedure_find (gimp->plug_in_manager,
+                                                   GIMP_FILE_PROCEDURE_GROUP_OPEN,
+                                                   file,
+                                                   NULL /*error*/);
+  loaded_image = file_open_image (gimp,
+                                  gimp_get_user_context (gimp),
+                                  NULL /*progress*/,
+                                  file,
+                                  file,
+                                  FALSE /*as_new*/,
+                                  proc,
+                                  GIMP_RUN_NONINTERACTIVE,
+                                  &status,
+                                  NULL /*mime_type*/,
+                                  NULL /*error*/);
+
+  g_file_delete (file, NULL, NULL);
+  g_object_unref (file);
+
+  g_assert (loaded_image != NULL);
+
+  loaded_layer = gimp_image_get_layer_iter (loaded_image)->data;
+
+  width  = gimp_item_get_width  (GIMP_ITEM (layer));
+  height = gimp_item_get_height (GIMP_ITEM (layer));
+
+  g_assert_cmpint (gimp_item_get_width  (GIMP_ITEM (loaded_layer)), ==, width);
+  g_assert_cmpint (gimp_item_get_height (GIMP_ITEM (loaded_layer)), ==, height);
+
+  expected = g_new (gfloat, width * height * 4);
+  result   = g_new (gfloat, width * height * 4);
+
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                   GEGL_RECTANGLE (0, 0, width, height), 1.0,
+                   babl_format ("RGBA float"), expected,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (gimp_drawable_get_buffer (GIMP_DRAWABLE (loaded_layer)),
+                   GEGL_RECTANGLE (0, 0, width, height), 1.0,
+                   babl_format ("RGBA float"), result,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert (memcmp (result, expected,
+                    width * height * 4 * sizeof (gfloat)) == 0);
+
+  g_free (expected);
+  g_free (result);
+
+  g_object_unref (loaded_image);
+}
+
+/*  a temp buf whose data is exactly one 64 KiB pool block  */
+#define POOL_TEST_BUF_SIZE 64
+#define POOL_TEST_BLOCK    (POOL_TEST_BUF_SIZE * POOL_TEST_BUF_SIZE * 16)
+
+static gpointer
+temp_buf_pool_empty_thread (gpointer data)
+{
+  gimp_temp_buf_set_pool_size (0);
+
+  return NULL;
+}
+
+static void
+temp_buf_pool_alloc (gint n)
+{
+  GimpTempBuf **bufs = g_new (GimpTempBuf *, n);
+  gint          i;
+
+  for (i = 0; i < n; i++)
+    {
+      bufs[i] = gimp_temp_buf_new (POOL_TEST_BUF_SIZE, POOL_TEST_BUF_SIZE,
+                                   babl_format ("RGBA float"));
+    }
+
+  for (i = 0; i < n; i++)
+    gimp_temp_buf_unref (bufs[i]);
+
+  g_free (bufs);
+}
+
+/**
+ * temp_buf_pool_shrink:
+ * @fixture:
+ * @data:
+ *
+ * Makes sure that lowering the temp buf pool size from another thread
+ * releases the blocks the main thread kept for itself the next time
+ * it uses the pool, instead of reusing them.
+ **/
+static void
+temp_buf_pool_shrink (GimpTestFixture *fixture,
+                      gconstpointer    data)
+{
+  Gimp           *gimp   = GIMP (data);
+  GimpGeglConfig *config = GIMP_GEGL_CONFIG (gimp->config);
+  GThread        *thread;
+  guint64         memsize;
+
+  /*  keep two blocks in the main thread's own pool  */
+  gimp_temp_buf_set_pool_size (config->temp_buf_pool_size);
+
+  temp_buf_pool_alloc (2);
+
+  g_assert_cmpuint (gimp_temp_buf_get_pool_memsize (), >=,
+                    2 * POOL_TEST_BLOCK);
+
+  thread = g_thread_new ("temp-buf-pool", temp_buf_pool_empty_thread, NULL);
+  g_thread_join (thread);
+
+  memsize = gimp_temp_buf_get_pool_memsize ();
+
+  g_assert_cmpuint (memsize, >=, 2 * POOL_TEST_BLOCK);
+
+  /*  both blocks are released, not one of them reused  */
+  temp_buf_pool_alloc (1);
+
+  g_assert_cmpuint (gimp_temp_buf_get_pool_memsize (), <=,
+                    memsize - 2 * POOL_TEST_BLOCK);
+
+  gimp_temp_buf_set_pool_size (config->temp_buf_pool_size);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_IMAGE_TEST (add_layer);
+  ADD_IMAGE_TEST (remove_layer);
+  ADD_IMAGE_TEST (rotate_non_overlapping);
+  ADD_TEST (white_graypoint_in_red_levels);
+  ADD_IMAGE_TEST (foreground_extract_whole_drawable);
+  ADD_TEST (grow_shrink_distance_transform);
+  ADD_IMAGE_TEST (line_art_recompute);
+  ADD_IMAGE_TEST (text_layer_flush_before_save);
+  ADD_TEST (temp_buf_pool_shrink);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -26,6 +26,7 @@
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <pango/pangocairo.h>
+#include <fontconfig/fontconfig.h>
 
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
@@ -38,7 +39,9 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimp-utils.h"
+#include "core/gimpasync.h"
 #include "core/gimpcontext.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpdatafactory.h"
@@ -48,6 +51,8 @@
 #include "core/gimpimage-undo-push.h"
 #include "core/gimpitemtree.h"
 #include "core/gimpparasitelist.h"
+#include "core/gimppickable.h"
+#include "core/gimpwaitable.h"
 
 #include "gimptext.h"
 #include "gimptextlayer.h"
@@ -68,9 +73,45 @@ enum
 
 struct _GimpTextLayerPrivate
 {
-  GimpTextDirection base_dir;
+  GimpTextDirection  base_dir;
+
+  gint               async_render;  /*  render text changes asynchronously  */
+  GimpAsync         *render_async;  /*  the render in progress              */
+  gboolean           render_queued; /*  the text changed during the render  */
+
+  /*  while rendering asynchronously, the layer's own font map, and the
+   *  fontconfig configuration and the resolution it was created for,
+   *  and its line cache.  they are used by one render at a time, so
+   *  that their caches can be kept between the renders of an editing
+   *  session, and are dropped when it ends
+   */
+  PangoFontMap      *font_map;
+  FcConfig          *font_config;
+  gdouble            font_res;
+
+  GimpTextLineCache *line_cache;
 };
 
+typedef struct
+{
+  GimpTextLayer      *layer;
+  GimpText           *text;
+  gdouble             xres;
+  gdouble             yres;
+  const Babl         *format;
+  GimpColorTransform *transform;
+  PangoFontMap       *font_map;
+  GimpTextLineCache  *line_cache;
+
+  GError             *error;
+  gint                width;
+  gint                height;
+  GeglBuffer         *buffer;
+  gboolean            too_big;
+} RenderData;
+
+static void       gimp_pickable_iface_init       (GimpPickableInterface *iface);
+
 static void       gimp_text_layer_finalize       (GObject           *object);
 static void       gimp_text_layer_get_property   (GObject           *object,
                                                   guint              property_id,
@@ -115,13 +156,38 @@ static void       gimp_text_layer_convert_type   (GimpLayer         *layer,
                                                   gboolean           push_undo,
                                                   GimpProgress      *progress);
 
+static void       gimp_text_layer_flush          (GimpPickable      *pickable);
+
 static void       gimp_text_layer_text_changed   (GimpTextLayer     *layer);
+static void       gimp_text_layer_update_offset  (GimpTextLayer     *layer,
+                                                  GimpText          *text,
+                                                  gint               old_width);
 static gboolean   gimp_text_layer_render         (GimpTextLayer     *layer);
-static void       gimp_text_layer_render_layout  (GimpTextLayer     *layer,
-                                                  GimpTextLayout    *layout);
-
-
-G_DEFINE_TYPE_WITH_PRIVATE (GimpTextLayer, gimp_text_layer, GIMP_TYPE_LAYER)
+static void       gimp_text_layer_render_async   (GimpTextLayer     *layer);
+static void       gimp_text_layer_flush_render   (GimpTextLayer     *layer);
+
+static gboolean   gimp_text_layer_render_check_fonts
+                                                 (GimpTextLayer     *layer);
+static void       gimp_text_layer_update_font_map
+                                                 (GimpTextLayer     *layer);
+static RenderData * gimp_text_layer_render_data_new
+                                                 (GimpTextLayer     *layer,
+                                                  gboolean           copy_text);
+static void       gimp_text_layer_render_data_free
+                                                 (RenderData        *data);
+static void       gimp_text_layer_render_run     (GimpAsync         *async,
+                                                  RenderData        *data);
+static gboolean   gimp_text_layer_render_finish  (GimpTextLayer     *layer,
+                                                  RenderData        *data);
+static void       gimp_text_layer_render_async_callback
+                                                 (GimpAsync         *async,
+                                                  RenderData        *data);
+
+
+G_DEFINE_TYPE_WITH_CODE (GimpTextLayer, gimp_text_layer, GIMP_TYPE_LAYER,
+                         G_ADD_PRIVATE (GimpTextLayer)
+                         G_IMPLEMENT_INTERFACE (GIMP_TYPE_PICKABLE,
+                                                gimp_pickable_iface_init))
 
 #define parent_class gimp_text_layer_parent_class
 
@@ -187,6 +253,12 @@ gimp_text_layer_class_init (GimpTextLayerClass *klass)
                             GIMP_PARAM_STATIC_STRINGS);
 }
 
+static void
+gimp_pickable_iface_init (GimpPickableInterface *iface)
+{
+  iface->flush = gimp_text_layer_flush;
+}
+
 static void
 gimp_text_layer_init (GimpTextLayer *layer)
 {
@@ -201,6 +273,9 @@ gimp_text_layer_finalize (GObject *object)
   GimpTextLayer *layer = GIMP_TEXT_LAYER (object);
 
   g_clear_object (&layer->text);
+  g_clear_object (&layer->private->font_map);
+
+  g_clear_pointer (&layer->private->line_cache, gimp_text_line_cache_free);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -279,6 +354,8 @@ gimp_text_layer_duplicate (GimpItem *item,
 
   g_return_val_if_fail (g_type_is_a (new_type, GIMP_TYPE_DRAWABLE), NULL);
 
+  gimp_text_layer_flush_render (GIMP_TEXT_LAYER (item));
+
   new_item = GIMP_ITEM_CLASS (parent_class)->duplicate (item, new_type);
 
   if (GIMP_IS_TEXT_LAYER (new_item))
@@ -334,6 +411,9 @@ gimp_text_layer_set_buffer (GimpDrawable *drawable,
   GimpTextLayer *layer = GIMP_TEXT_LAYER (drawable);
   GimpImage     *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  if (push_undo)
+    gimp_text_layer_flush_render (layer);
+
   if (push_undo && ! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE_MOD,
                                  undo_desc);
@@ -365,6 +445,8 @@ gimp_text_layer_push_undo (GimpDrawable *drawable,
   GimpTextLayer *layer = GIMP_TEXT_LAYER (drawable);
   GimpImage     *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  gimp_text_layer_flush_render (layer);
+
   if (! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE, undo_desc);
 
@@ -396,6 +478,8 @@ gimp_text_layer_convert_type (GimpLayer         *layer,
   GimpTextLayer *text_layer = GIMP_TEXT_LAYER (layer);
   GimpImage     *image      = gimp_item_get_image (GIMP_ITEM (text_layer));
 
+  gimp_text_layer_flush_render (text_layer);
+
   if (! text_layer->text   ||
       text_layer->modified ||
       layer_dither_type != GEGL_DITHER_NONE)
@@ -478,6 +562,8 @@ gimp_text_layer_set_text (GimpTextLayer *layer,
   if (layer->text == text)
     return;
 
+  gimp_text_layer_flush_render (layer);
+
   if (layer->text)
     {
       g_signal_handlers_disconnect_by_func (layer->text,
@@ -555,6 +641,8 @@ gimp_text_layer_set (GimpTextLayer *layer,
 
   va_end (var_args);
 
+  gimp_text_layer_flush_render (layer);
+
   g_object_set (layer, "modified", FALSE, NULL);
 
   g_object_thaw_notify (G_OBJECT (layer));
@@ -585,6 +673,66 @@ gimp_text_layer_discard (GimpTextLayer *layer)
   gimp_text_layer_set_text (layer, NULL);
 }
 
+/**
+ * gimp_text_layer_begin_async_render:
+ * @layer: a #GimpTextLayer
+ *
+ * Until the matching gimp_text_layer_end_async_render(), changes to
+ * the text of @layer are rendered in the background.  While a render
+ * is in progress, further changes are coalesced into a single render
+ * of the latest text.  This is meant for interactive editing, where
+ * the layer's pixels may lag behind its text for a moment.
+ */
+void
+gimp_text_layer_begin_async_render (GimpTextLayer *layer)
+{
+  GimpTextLayerPrivate *private;
+
+  g_return_if_fail (GIMP_IS_TEXT_LAYER (layer));
+
+  private = layer->private;
+
+  if (private->async_render++ == 0)
+    {
+      gimp_text_layer_update_font_map (layer);
+
+      private->line_cache = gimp_text_line_cache_new ();
+    }
+}
+
+/**
+ * gimp_text_layer_end_async_render:
+ * @layer: a #GimpTextLayer
+ *
+ * Ends asynchronous rendering, started with
+ * gimp_text_layer_begin_async_render().  When the last one ends, the
+ * layer is brought up to date with its text, and the caches kept for
+ * asynchronous rendering are dropped.
+ */
+void
+gimp_text_layer_end_async_render (GimpTextLayer *layer)
+{
+  GimpTextLayerPrivate *private;
+
+  g_return_if_fail (GIMP_IS_TEXT_LAYER (layer));
+  g_return_if_fail (layer->private->async_render > 0);
+
+  private = layer->private;
+
+  private->async_render--;
+
+  if (private->async_render == 0)
+    {
+      /*  no render uses the caches once this returns  */
+      gimp_text_layer_flush_render (layer);
+
+      g_clear_object (&private->font_map);
+      private->font_config = NULL;
+
+      g_clear_pointer (&private->line_cache, gimp_text_line_cache_free);
+    }
+}
+
 gboolean
 gimp_item_is_text_layer (GimpItem *item)
 {
@@ -605,6 +753,12 @@ gimp_text_layer_get_format (GimpTextLayer *layer)
   return gimp_drawable_get_format (GIMP_DRAWABLE (layer));
 }
 
+static void
+gimp_text_layer_flush (GimpPickable *pickable)
+{
+  gimp_text_layer_flush_render (GIMP_TEXT_LAYER (pickable));
+}
+
 static void
 gimp_text_layer_text_changed (GimpTextLayer *layer)
 {
@@ -621,16 +775,35 @@ gimp_text_layer_text_changed (GimpTextLayer *layer)
       layer->text_parasite = NULL;
     }
 
-  if (layer->text->box_mode == GIMP_TEXT_BOX_DYNAMIC)
+  if (layer->private->async_render > 0)
+    {
+      gimp_text_layer_render_async (layer);
+    }
+  else
+    {
+      gint old_width = gimp_item_get_width (GIMP_ITEM (layer));
+
+      gimp_text_layer_render (layer);
+
+      gimp_text_layer_update_offset (layer, layer->text, old_width);
+    }
+}
+
+/*  keeps the layer anchored at its right edge if the text is laid out
+ *  from right to left, after rendering @text
+ */
+static void
+gimp_text_layer_update_offset (GimpTextLayer *layer,
+                               GimpText      *text,
+                               gint           old_width)
+{
+  if (text->box_mode == GIMP_TEXT_BOX_DYNAMIC)
     {
-      gint                old_width;
       gint                new_width;
       GimpItem           *item         = GIMP_ITEM (layer);
       GimpTextDirection   old_base_dir = layer->private->base_dir;
-      GimpTextDirection   new_base_dir = layer->text->base_dir;
+      GimpTextDirection   new_base_dir = text->base_dir;
 
-      old_width = gimp_item_get_width (item);
-      gimp_text_layer_render (layer);
       new_width = gimp_item_get_width (item);
 
       if (old_base_dir != new_base_dir)
@@ -681,32 +854,103 @@ gimp_text_layer_text_changed (GimpTextLayer *layer)
             gimp_item_translate (item, old_width - new_width, 0, FALSE);
         }
     }
-  else
-    gimp_text_layer_render (layer);
 
-  layer->private->base_dir = layer->text->base_dir;
+  layer->private->base_dir = text->base_dir;
 }
 
 static gboolean
 gimp_text_layer_render (GimpTextLayer *layer)
 {
-  GimpDrawable   *drawable;
-  GimpItem       *item;
-  GimpImage      *image;
-  GimpContainer  *container;
-  GimpTextLayout *layout;
-  gdouble         xres;
-  gdouble         yres;
-  gint            width;
-  gint            height;
-  GError         *error = NULL;
+  GimpTextLayerPrivate *private = layer->private;
+  RenderData           *data;
+  gboolean              success;
 
   if (! layer->text)
     return FALSE;
 
-  drawable  = GIMP_DRAWABLE (layer);
-  item      = GIMP_ITEM (layer);
-  image     = gimp_item_get_image (item);
+  if (! gimp_text_layer_render_check_fonts (layer))
+    return FALSE;
+
+  /*  a synchronous render supersedes any asynchronous one  */
+  private->render_queued = FALSE;
+
+  if (private->render_async)
+    gimp_async_cancel_and_wait (private->render_async);
+
+  data = gimp_text_layer_render_data_new (layer, FALSE);
+
+  gimp_text_layer_render_run (NULL, data);
+
+  success = gimp_text_layer_render_finish (layer, data);
+
+  gimp_text_layer_render_data_free (data);
+
+  return success;
+}
+
+static void
+gimp_text_layer_render_async (GimpTextLayer *layer)
+{
+  GimpTextLayerPrivate *private = layer->private;
+  RenderData           *data;
+
+  if (private->render_async)
+    {
+      private->render_queued = TRUE;
+
+      return;
+    }
+
+  if (! gimp_text_layer_render_check_fonts (layer))
+    return;
+
+  /*  waiting for the fonts may have let another render start  */
+  if (private->render_async)
+    {
+      private->render_queued = TRUE;
+
+      return;
+    }
+
+  data = gimp_text_layer_render_data_new (layer, TRUE);
+
+  private->render_async = gimp_parallel_run_async (
+    (GimpParallelRunAsyncFunc) gimp_text_layer_render_run,
+    data);
+
+  gimp_async_add_callback (
+    private->render_async,
+    (GimpAsyncCallback) gimp_text_layer_render_async_callback,
+    data);
+}
+
+/*  brings the layer's pixels up to date with its text  */
+static void
+gimp_text_layer_flush_render (GimpTextLayer *layer)
+{
+  GimpTextLayerPrivate *private = layer->private;
+
+  if (private->render_queued)
+    {
+      gint old_width = gimp_item_get_width (GIMP_ITEM (layer));
+
+      gimp_text_layer_render (layer);
+
+      if (layer->text)
+        gimp_text_layer_update_offset (layer, layer->text, old_width);
+    }
+  else if (private->render_async)
+    {
+      gimp_waitable_wait (GIMP_WAITABLE (private->render_async));
+    }
+}
+
+static gboolean
+gimp_text_layer_render_check_fonts (GimpTextLayer *layer)
+{
+  GimpImage     *image     = gimp_item_get_image (GIMP_ITEM (layer));
+  GimpContainer *container;
+
   container = gimp_data_factory_get_container (image->gimp->font_factory);
 
   gimp_data_factory_data_wait (image->gimp->font_factory);
@@ -719,57 +963,250 @@ gimp_text_layer_render (GimpTextLayer *layer)
       return FALSE;
     }
 
+  return TRUE;
+}
+
+/*  (re)creates the layer's font map if it's missing or stale  */
+static void
+gimp_text_layer_update_font_map (GimpTextLayer *layer)
+{
+  GimpTextLayerPrivate *private = layer->private;
+  GimpImage            *image   = gimp_item_get_image (GIMP_ITEM (layer));
+  gdouble               xres;
+  gdouble               yres;
+
   gimp_image_get_resolution (image, &xres, &yres);
 
-  layout = gimp_text_layout_new (layer->text, xres, yres, &error);
-  if (error)
+  /*  the font map is replaced when the fonts are reloaded  */
+  if (! private->font_map                          ||
+      private->font_config != FcConfigGetCurrent () ||
+      private->font_res    != yres)
     {
-      gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR, error->message);
-      g_error_free (error);
+      g_clear_object (&private->font_map);
+
+      private->font_map    = gimp_text_font_map_new (yres);
+      private->font_config = FcConfigGetCurrent ();
+      private->font_res    = yres;
     }
+}
 
-  g_object_freeze_notify (G_OBJECT (drawable));
+/*  collects everything needed for rendering the layer's text.  while
+ *  rendering asynchronously, this must only be called while no other
+ *  render is in progress, since the layer's font map and line cache
+ *  are handed over to the render.
+ */
+static RenderData *
+gimp_text_layer_render_data_new (GimpTextLayer *layer,
+                                 gboolean       copy_text)
+{
+  GimpTextLayerPrivate *private = layer->private;
+  GimpImage            *image   = gimp_item_get_image (GIMP_ITEM (layer));
+  GimpColorTransform   *transform;
+  RenderData           *data;
+
+  data = g_slice_new0 (RenderData);
+
+  data->layer = g_object_ref (layer);
+
+  /*  an asynchronous render gets a copy of the text, which may change
+   *  while it runs
+   */
+  if (copy_text)
+    data->text = gimp_config_duplicate (GIMP_CONFIG (layer->text));
+  else
+    data->text = g_object_ref (layer->text);
+
+  gimp_image_get_resolution (image, &data->xres, &data->yres);
+
+  data->format = gimp_text_layer_get_format (layer);
+
+  transform = gimp_image_get_color_transform_from_srgb_u8 (image);
+
+  if (transform)
+    data->transform = g_object_ref (transform);
+
+  /*  outside of asynchronous rendering, nothing is kept between
+   *  renders
+   */
+  if (private->async_render > 0)
+    {
+      gimp_text_layer_update_font_map (layer);
+
+      data->font_map   = g_object_ref (private->font_map);
+      data->line_cache = private->line_cache;
+    }
+  else
+    {
+      data->font_map   = gimp_text_font_map_new (data->yres);
+      data->line_cache = NULL;
+    }
+
+  return data;
+}
+
+static void
+gimp_text_layer_render_data_free (RenderData *data)
+{
+  g_clear_object (&data->text);
+  g_clear_object (&data->transform);
+  g_clear_object (&data->font_map);
+  g_clear_object (&data->buffer);
+  g_clear_error (&data->error);
+
+  g_object_unref (data->layer);
+
+  g_slice_free (RenderData, data);
+}
+
+/*  lays out and rasterizes the text.  this doesn't touch the layer, and
+ *  may run on any thread.  @async is NULL for synchronous renders.
+ */
+static void
+gimp_text_layer_render_run (GimpAsync  *async,
+                            RenderData *data)
+{
+  GimpTextLayout  *layout;
+  GeglBuffer      *buffer;
+  cairo_t         *cr;
+  cairo_surface_t *surface;
+  cairo_status_t   status;
+
+  layout = gimp_text_layout_new (data->text, data->font_map,
+                                 data->xres, data->yres, &data->error);
+
+  if (! gimp_text_layout_get_size (layout, &data->width, &data->height))
+    {
+      g_object_unref (layout);
+
+      if (async)
+        gimp_async_finish (async, NULL);
+
+      return;
+    }
+
+  if (async && gimp_async_is_canceled (async))
+    {
+      g_object_unref (layout);
+
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  data->buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                  data->width, data->height),
+                                  data->format);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        data->width, data->height);
+  status = cairo_surface_status (surface);
+
+  if (status != CAIRO_STATUS_SUCCESS)
+    {
+      data->too_big = TRUE;
+
+      cairo_surface_destroy (surface);
+      g_object_unref (layout);
+
+      if (async)
+        gimp_async_finish (async, NULL);
+
+      return;
+    }
+
+  cr = cairo_create (surface);
+
+  if (data->line_cache)
+    gimp_text_layout_render_cached (layout, cr, data->text->base_dir,
+                                    data->line_cache);
+  else
+    gimp_text_layout_render (layout, cr, data->text->base_dir, FALSE);
+
+  cairo_destroy (cr);
+
+  g_object_unref (layout);
 
-  if (gimp_text_layout_get_size (layout, &width, &height) &&
-      (width  != gimp_item_get_width  (item) ||
-       height != gimp_item_get_height (item) ||
-       gimp_text_layer_get_format (layer) !=
-       gimp_drawable_get_format (drawable)))
+  cairo_surface_flush (surface);
+
+  buffer = gimp_cairo_surface_create_buffer (surface);
+
+  if (data->transform)
     {
-      GeglBuffer *new_buffer;
+      gimp_color_transform_process_buffer (data->transform,
+                                           buffer,
+                                           NULL,
+                                           data->buffer,
+                                           NULL);
+    }
+  else
+    {
+      gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE,
+                             data->buffer, NULL);
+    }
+
+  g_object_unref (buffer);
+  cairo_surface_destroy (surface);
 
-      new_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
-                                    gimp_text_layer_get_format (layer));
-      gimp_drawable_set_buffer (drawable, FALSE, NULL, new_buffer);
-      g_object_unref (new_buffer);
+  if (async)
+    gimp_async_finish (async, NULL);
+}
 
-      if (gimp_layer_get_mask (GIMP_LAYER (layer)))
+/*  puts the rendered text into the layer  */
+static gboolean
+gimp_text_layer_render_finish (GimpTextLayer *layer,
+                               RenderData    *data)
+{
+  GimpDrawable *drawable = GIMP_DRAWABLE (layer);
+  GimpItem     *item     = GIMP_ITEM (layer);
+  GimpImage    *image    = gimp_item_get_image (item);
+
+  if (data->error)
+    gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR,
+                          data->error->message);
+
+  g_object_freeze_notify (G_OBJECT (drawable));
+
+  if (data->buffer)
+    {
+      if (data->width  != gimp_item_get_width  (item) ||
+          data->height != gimp_item_get_height (item) ||
+          data->format != gimp_drawable_get_format (drawable))
         {
-          GimpLayerMask *mask = gimp_layer_get_mask (GIMP_LAYER (layer));
+          gimp_drawable_set_buffer (drawable, FALSE, NULL, data->buffer);
+
+          if (gimp_layer_get_mask (GIMP_LAYER (layer)))
+            {
+              GimpLayerMask *mask = gimp_layer_get_mask (GIMP_LAYER (layer));
 
-          static GimpContext *unused_eek = NULL;
+              static GimpContext *unused_eek = NULL;
 
-          if (! unused_eek)
-            unused_eek = gimp_context_new (image->gimp, "eek", NULL);
+              if (! unused_eek)
+                unused_eek = gimp_context_new (image->gimp, "eek", NULL);
 
-          gimp_item_resize (GIMP_ITEM (mask),
-                            unused_eek, GIMP_FILL_TRANSPARENT,
-                            width, height, 0, 0);
+              gimp_item_resize (GIMP_ITEM (mask),
+                                unused_eek, GIMP_FILL_TRANSPARENT,
+                                data->width, data->height, 0, 0);
+            }
+        }
+      else
+        {
+          gimp_gegl_buffer_copy (data->buffer, NULL, GEGL_ABYSS_NONE,
+                                 gimp_drawable_get_buffer (drawable), NULL);
         }
     }
 
   if (layer->auto_rename)
     {
-      GimpItem *item = GIMP_ITEM (layer);
+      GimpText *text = data->text;
       gchar    *name = NULL;
 
-      if (layer->text->text)
+      if (text->text)
         {
-          name = gimp_utf8_strtrim (layer->text->text, 30);
+          name = gimp_utf8_strtrim (text->text, 30);
         }
-      else if (layer->text->markup)
+      else if (text->markup)
         {
-          gchar *tmp = gimp_markup_extract_text (layer->text->markup);
+          gchar *tmp = gimp_markup_extract_text (text->markup);
           name = gimp_utf8_strtrim (tmp, 30);
           g_free (tmp);
         }
@@ -792,76 +1229,57 @@ gimp_text_layer_render (GimpTextLayer *layer)
         }
     }
 
-  if (width > 0 && height > 0)
-    gimp_text_layer_render_layout (layer, layout);
+  if (data->buffer)
+    {
+      if (data->too_big)
+        gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR,
+                              _("Your text cannot be rendered. It is likely too big. "
+                                "Please make it shorter or use a smaller font."));
 
-  g_object_unref (layout);
+      gimp_drawable_update (drawable, 0, 0, data->width, data->height);
+    }
 
   g_object_thaw_notify (G_OBJECT (drawable));
 
-  return (width > 0 && height > 0);
+  return (data->buffer != NULL);
 }
 
 static void
-gimp_text_layer_render_layout (GimpTextLayer  *layer,
-                               GimpTextLayout *layout)
+gimp_text_layer_render_async_callback (GimpAsync  *async,
+                                       RenderData *data)
 {
-  GimpDrawable       *drawable = GIMP_DRAWABLE (layer);
-  GimpItem           *item     = GIMP_ITEM (layer);
-  GimpImage          *image    = gimp_item_get_image (item);
-  GeglBuffer         *buffer;
-  GimpColorTransform *transform;
-  cairo_t            *cr;
-  cairo_surface_t    *surface;
-  gint                width;
-  gint                height;
-  cairo_status_t      status;
-
-  g_return_if_fail (gimp_drawable_has_alpha (drawable));
+  GimpTextLayer        *layer   = data->layer;
+  GimpTextLayerPrivate *private = layer->private;
 
-  width  = gimp_item_get_width  (item);
-  height = gimp_item_get_height (item);
+  if (private->render_async == async)
+    private->render_async = NULL;
 
-  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
-  status = cairo_surface_status (surface);
-
-  if (status != CAIRO_STATUS_SUCCESS)
+  /*  the result is stale if it was superseded by a synchronous render,
+   *  or if the layer stopped being a text layer, or was removed, while
+   *  it was rendered
+   */
+  if (gimp_async_is_finished (async)   &&
+      ! gimp_async_is_canceled (async) &&
+      layer->text                      &&
+      ! layer->modified                &&
+      gimp_item_is_attached (GIMP_ITEM (layer)))
     {
-      GimpImage *image = gimp_item_get_image (item);
-
-      gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR,
-                            _("Your text cannot be rendered. It is likely too big. "
-                              "Please make it shorter or use a smaller font."));
-      cairo_surface_destroy (surface);
-      return;
-    }
-
-  cr = cairo_create (surface);
-  gimp_text_layout_render (layout, cr, layer->text->base_dir, FALSE);
-  cairo_destroy (cr);
+      gint old_width = gimp_item_get_width (GIMP_ITEM (layer));
 
-  cairo_surface_flush (surface);
-
-  buffer = gimp_cairo_surface_create_buffer (surface);
+      gimp_text_layer_render_finish (layer, data);
 
-  transform = gimp_image_get_color_transform_from_srgb_u8 (image);
+      gimp_text_layer_update_offset (layer, data->text, old_width);
 
-  if (transform)
-    {
-      gimp_color_transform_process_buffer (transform,
-                                           buffer,
-                                           NULL,
-                                           gimp_drawable_get_buffer (drawable),
-                                           NULL);
+      gimp_image_flush (gimp_item_get_image (GIMP_ITEM (layer)));
     }
-  else
+
+  if (private->render_queued)
     {
-      gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE,
-                             gimp_drawable_get_buffer (drawable), NULL);
-    }
+      private->render_queued = FALSE;
 
-  g_object_unref (buffer);
-  cairo_surface_destroy (surface);
+      if (layer->text && ! layer->modified)
+        gimp_text_layer_render_async (layer);
+    }
 
-  gimp_drawable_update (drawable, 0, 0, width, height);
+  gimp_text_layer_render_data_free (data);
 }
@@ -72,6 +72,11 @@ void        gimp_text_layer_set         (GimpTextLayer *layer,
                                          const gchar   *first_property_name,
                                          ...) G_GNUC_NULL_TERMINATED;
 
+void        gimp_text_layer_begin_async_render
+                                        (GimpTextLayer *layer);
+void        gimp_text_layer_end_async_render
+                                        (GimpTextLayer *layer);
+
 gboolean    gimp_item_is_text_layer     (GimpItem      *item);
 
 
@@ -20,14 +20,51 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <pango/pangocairo.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "text-types.h"
 
 #include "gimptextlayout.h"
 #include "gimptextlayout-render.h"
 
 
+/*  the pixels added around each line's extents, for glyphs that
+ *  exceed them
+ */
+#define LINE_PADDING 2
+
+
+/*  the rasters of the lines of the last layout rendered with a cache,
+ *  keyed by everything that affects them, so that the lines that
+ *  didn't change don't need to be rendered again
+ */
+struct _GimpTextLineCache
+{
+  GHashTable *lines;
+};
+
+typedef struct
+{
+  cairo_surface_t *surface;
+  gint             x;        /*  the surface's offset from the line's  */
+  gint             y;        /*  origin, in pixels                     */
+} CachedLine;
+
+
+static void         gimp_text_line_cache_free_line (CachedLine      *line);
+static GBytes     * gimp_text_line_cache_key       (PangoLayoutLine *line,
+                                                    gulong           options,
+                                                    gint             frac_x,
+                                                    gint             frac_y);
+static CachedLine * gimp_text_line_cache_render    (PangoLayoutLine *line,
+                                                    gint             frac_x,
+                                                    gint             frac_y);
+
+
 void
 gimp_text_layout_render (GimpTextLayout    *layout,
                          cairo_t           *cr,
@@ -75,3 +112,313 @@ gimp_text_layout_render (GimpTextLayout    *layout,
 
   cairo_restore (cr);
 }
+
+/*  same as gimp_text_layout_render(), but the lines are drawn from, and
+ *  added to, @cache.  lines that aren't part of @layout are dropped from
+ *  the cache.
+ */
+void
+gimp_text_layout_render_cached (GimpTextLayout    *layout,
+                                cairo_t           *cr,
+                                GimpTextDirection  base_dir,
+                                GimpTextLineCache *cache)
+{
+  PangoLayout                *pango_layout;
+  PangoLayoutIter            *iter;
+  const cairo_font_options_t *font_options;
+  GHashTable                 *lines;
+  cairo_matrix_t              trafo;
+  cairo_matrix_t              matrix;
+  gulong                      options;
+  gint                        x, y;
+
+  g_return_if_fail (GIMP_IS_TEXT_LAYOUT (layout));
+  g_return_if_fail (cr != NULL);
+  g_return_if_fail (cache != NULL);
+
+  gimp_text_layout_get_transform (layout, &trafo);
+  cairo_get_matrix (cr, &matrix);
+
+  /*  lines can only be reused if they are drawn unrotated and
+   *  unscaled, at whole-pixel offsets
+   */
+  if (base_dir != GIMP_TEXT_DIRECTION_LTR &&
+      base_dir != GIMP_TEXT_DIRECTION_RTL)
+    {
+      gimp_text_layout_render (layout, cr, base_dir, FALSE);
+      return;
+    }
+
+  if (trafo.xx  != 1.0 || trafo.xy  != 0.0 ||
+      trafo.yx  != 0.0 || trafo.yy  != 1.0 ||
+      matrix.xx != 1.0 || matrix.xy != 0.0 ||
+      matrix.yx != 0.0 || matrix.yy != 1.0 ||
+      matrix.x0 != floor (matrix.x0)       ||
+      matrix.y0 != floor (matrix.y0))
+    {
+      gimp_text_layout_render (layout, cr, base_dir, FALSE);
+      return;
+    }
+
+  gimp_text_layout_get_offsets (layout, &x, &y);
+
+  pango_layout = gimp_text_layout_get_pango_layout (layout);
+
+  font_options = pango_cairo_context_get_font_options (
+    pango_layout_get_context (pango_layout));
+
+  options = font_options ? cairo_font_options_hash (font_options) : 0;
+
+  lines = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+                                 (GDestroyNotify) g_bytes_unref,
+                                 (GDestroyNotify) gimp_text_line_cache_free_line);
+
+  iter = pango_layout_get_iter (pango_layout);
+
+  do
+    {
+      PangoLayoutLine *line = pango_layout_iter_get_line_readonly (iter);
+      PangoRectangle   logical;
+      CachedLine      *cached;
+      GBytes          *key;
+      gint             origin_x;
+      gint             origin_y;
+      gint             frac_x;
+      gint             frac_y;
+
+      pango_layout_iter_get_line_extents (iter, NULL, &logical);
+
+      /*  the line's origin, in pango units.  its raster only depends on
+       *  the fractional part of it
+       */
+      origin_x = x * PANGO_SCALE + logical.x;
+      origin_y = y * PANGO_SCALE + pango_layout_iter_get_baseline (iter);
+
+      frac_x = origin_x - PANGO_PIXELS_FLOOR (origin_x) * PANGO_SCALE;
+      frac_y = origin_y - PANGO_PIXELS_FLOOR (origin_y) * PANGO_SCALE;
+
+      key = gimp_text_line_cache_key (line, options, frac_x, frac_y);
+
+      if (! key)
+        {
+          /*  the line has attributes we don't know how to compare  */
+          cairo_save (cr);
+          cairo_move_to (cr,
+                         (gdouble) origin_x / PANGO_SCALE,
+                         (gdouble) origin_y / PANGO_SCALE);
+          pango_cairo_show_layout_line (cr, line);
+          cairo_restore (cr);
+
+          continue;
+        }
+
+      cached = g_hash_table_lookup (lines, key);
+
+      if (! cached)
+        {
+          CachedLine *old = g_hash_table_lookup (cache->lines, key);
+
+          if (old)
+            {
+              cached = g_slice_dup (CachedLine, old);
+
+              cairo_surface_reference (cached->surface);
+            }
+          else
+            {
+              cached = gimp_text_line_cache_render (line, frac_x, frac_y);
+            }
+
+          g_hash_table_insert (lines, g_bytes_ref (key), cached);
+        }
+
+      g_bytes_unref (key);
+
+      cairo_set_source_surface (cr, cached->surface,
+                                PANGO_PIXELS_FLOOR (origin_x) + cached->x,
+                                PANGO_PIXELS_FLOOR (origin_y) + cached->y);
+      cairo_paint (cr);
+    }
+  while (pango_layout_iter_next_line (iter));
+
+  pango_layout_iter_free (iter);
+
+  g_hash_table_unref (cache->lines);
+  cache->lines = lines;
+}
+
+GimpTextLineCache *
+gimp_text_line_cache_new (void)
+{
+  GimpTextLineCache *cache = g_slice_new (GimpTextLineCache);
+
+  cache->lines = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+                                        (GDestroyNotify) g_bytes_unref,
+                                        (GDestroyNotify) gimp_text_line_cache_free_line);
+
+  return cache;
+}
+
+void
+gimp_text_line_cache_free (GimpTextLineCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_hash_table_unref (cache->lines);
+
+  g_slice_free (GimpTextLineCache, cache);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_text_line_cache_free_line (CachedLine *line)
+{
+  cairo_surface_destroy (line->surface);
+
+  g_slice_free (CachedLine, line);
+}
+
+/*  returns a key identifying the raster of @line, drawn at the given
+ *  fractional offsets, or NULL if the line can't be cached
+ */
+static GBytes *
+gimp_text_line_cache_key (PangoLayoutLine *line,
+                          gulong           options,
+                          gint             frac_x,
+                          gint             frac_y)
+{
+  GByteArray *key = g_byte_array_new ();
+  GSList     *runs;
+  gint        header[3];
+
+  header[0] = frac_x;
+  header[1] = frac_y;
+  header[2] = line->resolved_dir;
+
+  g_byte_array_append (key, (const guint8 *) &options, sizeof (options));
+  g_byte_array_append (key, (const guint8 *) header,   sizeof (header));
+
+  for (runs = line->runs; runs; runs = g_slist_next (runs))
+    {
+      PangoGlyphItem       *run  = runs->data;
+      PangoItem            *item = run->item;
+      PangoFontDescription *desc;
+      gchar                *font;
+      GSList               *attrs;
+      gint                  analysis[2];
+      gint                  i;
+
+      /*  the font is described rather than compared, because each
+       *  layout may have fonts of its own
+       */
+      desc = pango_font_describe_with_absolute_size (item->analysis.font);
+      font = pango_font_description_to_string (desc);
+
+      g_byte_array_append (key, (const guint8 *) font, strlen (font) + 1);
+
+      g_free (font);
+      pango_font_description_free (desc);
+
+      analysis[0] = item->analysis.level;
+      analysis[1] = item->analysis.gravity;
+
+      g_byte_array_append (key, (const guint8 *) analysis, sizeof (analysis));
+
+      for (attrs = item->analysis.extra_attrs; attrs; attrs = g_slist_next (attrs))
+        {
+          PangoAttribute *attr = attrs->data;
+          gint            value[4];
+
+          value[0] = attr->klass->type;
+
+          switch (attr->klass->type)
+            {
+            case PANGO_ATTR_FOREGROUND:
+            case PANGO_ATTR_BACKGROUND:
+            case PANGO_ATTR_UNDERLINE_COLOR:
+            case PANGO_ATTR_STRIKETHROUGH_COLOR:
+              value[1] = ((PangoAttrColor *) attr)->color.red;
+              value[2] = ((PangoAttrColor *) attr)->color.green;
+              value[3] = ((PangoAttrColor *) attr)->color.blue;
+              break;
+
+            case PANGO_ATTR_UNDERLINE:
+            case PANGO_ATTR_STRIKETHROUGH:
+            case PANGO_ATTR_RISE:
+            case PANGO_ATTR_LETTER_SPACING:
+            case PANGO_ATTR_FOREGROUND_ALPHA:
+            case PANGO_ATTR_BACKGROUND_ALPHA:
+              value[1] = ((PangoAttrInt *) attr)->value;
+              value[2] = 0;
+              value[3] = 0;
+              break;
+
+            default:
+              g_byte_array_free (key, TRUE);
+
+              return NULL;
+            }
+
+          g_byte_array_append (key, (const guint8 *) value, sizeof (value));
+        }
+
+      for (i = 0; i < run->glyphs->num_glyphs; i++)
+        {
+          const PangoGlyphInfo *glyph = &run->glyphs->glyphs[i];
+          gint                  info[4];
+
+          info[0] = glyph->glyph;
+          info[1] = glyph->geometry.width;
+          info[2] = glyph->geometry.x_offset;
+          info[3] = glyph->geometry.y_offset;
+
+          g_byte_array_append (key, (const guint8 *) info, sizeof (info));
+        }
+    }
+
+  return g_byte_array_free_to_bytes (key);
+}
+
+static CachedLine *
+gimp_text_line_cache_render (PangoLayoutLine *line,
+                             gint             frac_x,
+                             gint             frac_y)
+{
+  CachedLine     *cached = g_slice_new (CachedLine);
+  PangoRectangle  ink;
+  PangoRectangle  logical;
+  cairo_t        *cr;
+  gint            x1, y1;
+  gint            x2, y2;
+
+  pango_layout_line_get_extents (line, &ink, &logical);
+
+  x1 = PANGO_PIXELS_FLOOR (frac_x + MIN (ink.x, logical.x)) - LINE_PADDING;
+  y1 = PANGO_PIXELS_FLOOR (frac_y + MIN (ink.y, logical.y)) - LINE_PADDING;
+  x2 = PANGO_PIXELS_CEIL  (frac_x + MAX (ink.x + ink.width,
+                                         logical.x + logical.width)) +
+       LINE_PADDING;
+  y2 = PANGO_PIXELS_CEIL  (frac_y + MAX (ink.y + ink.height,
+                                         logical.y + logical.height)) +
+       LINE_PADDING;
+
+  cached->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                x2 - x1, y2 - y1);
+  cached->x       = x1;
+  cached->y       = y1;
+
+  cr = cairo_create (cached->surface);
+
+  cairo_move_to (cr,
+                 (gdouble) frac_x / PANGO_SCALE - x1,
+                 (gdouble) frac_y / PANGO_SCALE - y1);
+  pango_cairo_show_layout_line (cr, line);
+
+  cairo_destroy (cr);
+
+  cairo_surface_flush (cached->surface);
+
+  return cached;
+}
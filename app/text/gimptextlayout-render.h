@@ -22,10 +22,17 @@
 #define __GIMP_TEXT_LAYOUT_RENDER_H__
 
 
-void  gimp_text_layout_render (GimpTextLayout    *layout,
-                               cairo_t           *cr,
-                               GimpTextDirection  base_dir,
-                               gboolean           path);
+void  gimp_text_layout_render        (GimpTextLayout    *layout,
+                                      cairo_t           *cr,
+                                      GimpTextDirection  base_dir,
+                                      gboolean           path);
+void  gimp_text_layout_render_cached (GimpTextLayout    *layout,
+                                      cairo_t           *cr,
+                                      GimpTextDirection  base_dir,
+                                      GimpTextLineCache *cache);
+
+GimpTextLineCache * gimp_text_line_cache_new  (void);
+void                gimp_text_line_cache_free (GimpTextLineCache *cache);
 
 
 #endif /* __GIMP_TEXT_LAYOUT_RENDER_H__ */
@@ -58,6 +58,7 @@ static void           gimp_text_layout_set_markup (GimpTextLayout *layout,
                                                    GError        **error);
 
 static PangoContext * gimp_text_get_pango_context (GimpText       *text,
+                                                   PangoFontMap   *fontmap,
                                                    gdouble         xres,
                                                    gdouble         yres);
 
@@ -103,10 +104,11 @@ gimp_text_layout_finalize (GObject *object)
 
 
 GimpTextLayout *
-gimp_text_layout_new (GimpText  *text,
-                      gdouble    xres,
-                      gdouble    yres,
-                      GError   **error)
+gimp_text_layout_new (GimpText      *text,
+                      PangoFontMap  *fontmap,
+                      gdouble        xres,
+                      gdouble        yres,
+                      GError       **error)
 {
   GimpTextLayout       *layout;
   PangoContext         *context;
@@ -115,6 +117,8 @@ gimp_text_layout_new (GimpText  *text,
   gint                  size;
 
   g_return_val_if_fail (GIMP_IS_TEXT (text), NULL);
+  g_return_val_if_fail (fontmap == NULL || PANGO_IS_CAIRO_FONT_MAP (fontmap),
+                        NULL);
 
   font_desc = pango_font_description_from_string (text->font);
   g_return_val_if_fail (font_desc != NULL, NULL);
@@ -125,7 +129,7 @@ gimp_text_layout_new (GimpText  *text,
 
   pango_font_description_set_size (font_desc, MAX (1, size));
 
-  context = gimp_text_get_pango_context (text, xres, yres);
+  context = gimp_text_get_pango_context (text, fontmap, xres, yres);
 
   layout = g_object_new (GIMP_TYPE_TEXT_LAYOUT, NULL);
 
@@ -219,6 +223,24 @@ gimp_text_layout_new (GimpText  *text,
   return layout;
 }
 
+/*  layouts created for the same font map share its font and glyph
+ *  caches, so a font map must only be used by one thread at a time
+ */
+PangoFontMap *
+gimp_text_font_map_new (gdouble yres)
+{
+  PangoFontMap *fontmap;
+
+  fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
+  if (! fontmap)
+    g_error ("You are using a Pango that has been built against a cairo "
+             "that lacks the Freetype font backend");
+
+  pango_cairo_font_map_set_resolution (PANGO_CAIRO_FONT_MAP (fontmap), yres);
+
+  return fontmap;
+}
+
 gboolean
 gimp_text_layout_get_size (GimpTextLayout *layout,
                            gint           *width,
@@ -727,20 +749,18 @@ gimp_text_get_font_options (GimpText *text)
 }
 
 static PangoContext *
-gimp_text_get_pango_context (GimpText *text,
-                             gdouble   xres,
-                             gdouble   yres)
+gimp_text_get_pango_context (GimpText     *text,
+                             PangoFontMap *fontmap,
+                             gdouble       xres,
+                             gdouble       yres)
 {
   PangoContext         *context;
-  PangoFontMap         *fontmap;
   cairo_font_options_t *options;
 
-  fontmap = pango_cairo_font_map_new_for_font_type (CAIRO_FONT_TYPE_FT);
-  if (! fontmap)
-    g_error ("You are using a Pango that has been built against a cairo "
-             "that lacks the Freetype font backend");
-
-  pango_cairo_font_map_set_resolution (PANGO_CAIRO_FONT_MAP (fontmap), yres);
+  if (fontmap)
+    g_object_ref (fontmap);
+  else
+    fontmap = gimp_text_font_map_new (yres);
 
   context = pango_font_map_create_context (fontmap);
   g_object_unref (fontmap);
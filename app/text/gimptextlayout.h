@@ -38,9 +38,12 @@ struct _GimpTextLayoutClass
 GType            gimp_text_layout_get_type             (void) G_GNUC_CONST;
 
 GimpTextLayout * gimp_text_layout_new                  (GimpText       *text,
+                                                        PangoFontMap   *fontmap,
                                                         gdouble         xres,
                                                         gdouble         yres,
                                                         GError        **error);
+PangoFontMap   * gimp_text_font_map_new                (gdouble         yres);
+
 gboolean         gimp_text_layout_get_size             (GimpTextLayout *layout,
                                                         gint           *width,
                                                         gint           *height);
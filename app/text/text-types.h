@@ -26,13 +26,14 @@
 #include "text/text-enums.h"
 
 
-typedef struct _GimpFont        GimpFont;
-typedef struct _GimpFontFactory GimpFontFactory;
-typedef struct _GimpFontList    GimpFontList;
-typedef struct _GimpText        GimpText;
-typedef struct _GimpTextLayer   GimpTextLayer;
-typedef struct _GimpTextLayout  GimpTextLayout;
-typedef struct _GimpTextUndo    GimpTextUndo;
+typedef struct _GimpFont          GimpFont;
+typedef struct _GimpFontFactory   GimpFontFactory;
+typedef struct _GimpFontList      GimpFontList;
+typedef struct _GimpText          GimpText;
+typedef struct _GimpTextLayer     GimpTextLayer;
+typedef struct _GimpTextLayout    GimpTextLayout;
+typedef struct _GimpTextLineCache GimpTextLineCache;
+typedef struct _GimpTextUndo      GimpTextUndo;
 
 
 #endif /* __TEXT_TYPES_H__ */
@@ -39,6 +39,8 @@
 #include "gegl/gimp-gegl-mask.h"
 
 #include "core/gimp.h"
+#include "core/gimpasync.h"
+#include "core/gimpcancelable.h"
 #include "core/gimpchannel-select.h"
 #include "core/gimpdrawable-foreground-extract.h"
 #include "core/gimperror.h"
@@ -64,6 +66,10 @@
 #include "gimp-intl.h"
 
 
+/*  the size of the coarse matte computed before the full-resolution one  */
+#define COARSE_PREVIEW_SIZE 512
+
+
 #define FAR_OUTSIDE -10000
 
 
@@ -152,6 +158,13 @@ static void   gimp_foreground_select_tool_commit         (GimpForegroundSelectTo
 static void   gimp_foreground_select_tool_set_trimap     (GimpForegroundSelectTool *fg_select);
 static void   gimp_foreground_select_tool_set_preview    (GimpForegroundSelectTool *fg_select);
 static void   gimp_foreground_select_tool_preview        (GimpForegroundSelectTool *fg_select);
+static void   gimp_foreground_select_tool_preview_async  (GimpForegroundSelectTool *fg_select,
+                                                          gdouble                   scale);
+static void   gimp_foreground_select_tool_preview_cb     (GimpAsync                *async,
+                                                          GimpForegroundSelectTool *fg_select);
+static void   gimp_foreground_select_tool_abort_preview  (GimpForegroundSelectTool *fg_select);
+static gboolean
+              gimp_foreground_select_tool_is_previewing  (GimpForegroundSelectTool *fg_select);
 
 static void   gimp_foreground_select_tool_stroke_paint   (GimpForegroundSelectTool *fg_select);
 static void   gimp_foreground_select_tool_cancel_paint   (GimpForegroundSelectTool *fg_select);
@@ -450,7 +463,7 @@ gimp_foreground_select_tool_button_release (GimpTool              *tool,
         {
           gimp_foreground_select_tool_stroke_paint (fg_select);
 
-          if (fg_select->state == MATTING_STATE_PREVIEW_MASK)
+          if (gimp_foreground_select_tool_is_previewing (fg_select))
             gimp_foreground_select_tool_preview (fg_select);
           else
             gimp_foreground_select_tool_set_trimap (fg_select);
@@ -742,7 +755,7 @@ gimp_foreground_select_tool_undo (GimpTool    *tool,
   fg_select->undo_stack = g_list_remove (fg_select->undo_stack, undo);
   fg_select->redo_stack = g_list_prepend (fg_select->redo_stack, undo);
 
-  if (fg_select->state == MATTING_STATE_PREVIEW_MASK)
+  if (gimp_foreground_select_tool_is_previewing (fg_select))
     gimp_foreground_select_tool_preview (fg_select);
   else
     gimp_foreground_select_tool_set_trimap (fg_select);
@@ -762,7 +775,7 @@ gimp_foreground_select_tool_redo (GimpTool    *tool,
   fg_select->redo_stack = g_list_remove (fg_select->redo_stack, undo);
   fg_select->undo_stack = g_list_prepend (fg_select->undo_stack, undo);
 
-  if (fg_select->state == MATTING_STATE_PREVIEW_MASK)
+  if (gimp_foreground_select_tool_is_previewing (fg_select))
     gimp_foreground_select_tool_preview (fg_select);
   else
     gimp_foreground_select_tool_set_trimap (fg_select);
@@ -945,6 +958,8 @@ gimp_foreground_select_tool_halt (GimpForegroundSelectTool *fg_select)
   GimpTool     *tool = GIMP_TOOL (fg_select);
   GimpDrawTool *draw_tool = GIMP_DRAW_TOOL (fg_select);
 
+  gimp_foreground_select_tool_abort_preview (fg_select);
+
   if (draw_tool->preview)
     {
       gimp_draw_tool_remove_preview (draw_tool, fg_select->grayscale_preview);
@@ -1007,10 +1022,29 @@ gimp_foreground_select_tool_commit (GimpForegroundSelectTool *fg_select)
 
   if (tool->display && fg_select->state != MATTING_STATE_FREE_SELECT)
     {
-      GimpImage *image = gimp_display_get_image (tool->display);
-
-      if (fg_select->state != MATTING_STATE_PREVIEW_MASK)
-        gimp_foreground_select_tool_preview (fg_select);
+      GimpForegroundSelectOptions *fg_options;
+      GimpImage                   *image;
+      GimpDrawable                *drawable;
+
+      fg_options = GIMP_FOREGROUND_SELECT_TOOL_GET_OPTIONS (tool);
+      image      = gimp_display_get_image (tool->display);
+      drawable   = gimp_image_get_active_drawable (image);
+
+      /*  the preview is coarse, matted in tiles, or still being
+       *  computed, so compute the final matte of the whole drawable
+       */
+      gimp_foreground_select_tool_abort_preview (fg_select);
+
+      g_clear_object (&fg_select->mask);
+
+      fg_select->mask =
+        gimp_drawable_foreground_extract (drawable,
+                                          fg_options->engine,
+                                          fg_options->iterations,
+                                          fg_options->levels,
+                                          fg_options->active_levels,
+                                          fg_select->trimap,
+                                          GIMP_PROGRESS (fg_select));
 
       gimp_channel_select_buffer (gimp_image_get_mask (image),
                                   C_("command", "Foreground Select"),
@@ -1127,25 +1161,134 @@ gimp_foreground_select_tool_set_preview (GimpForegroundSelectTool *fg_select)
 
 static void
 gimp_foreground_select_tool_preview (GimpForegroundSelectTool *fg_select)
+{
+  GimpTool     *tool     = GIMP_TOOL (fg_select);
+  GimpImage    *image    = gimp_display_get_image (tool->display);
+  GimpDrawable *drawable = gimp_image_get_active_drawable (image);
+  gdouble       scale;
+
+  gimp_foreground_select_tool_abort_preview (fg_select);
+
+  fg_select->progress =
+    gimp_progress_start (GIMP_PROGRESS (tool->display), TRUE,
+                         _("Computing alpha of unknown pixels"));
+
+  if (fg_select->progress)
+    g_signal_connect_swapped (fg_select->progress, "cancel",
+                              G_CALLBACK (gimp_foreground_select_tool_abort_preview),
+                              fg_select);
+
+  /*  show a coarse matte of large drawables first, and refine it
+   *  at full resolution in the background.  the refined matte is only
+   *  computed in tiles around the unknown band, so committing computes
+   *  the final matte of the whole drawable again.
+   */
+  scale = (gdouble) COARSE_PREVIEW_SIZE /
+          MAX (gimp_item_get_width  (GIMP_ITEM (drawable)),
+               gimp_item_get_height (GIMP_ITEM (drawable)));
+
+  if (scale < 0.5)
+    gimp_foreground_select_tool_preview_async (fg_select, scale);
+  else
+    gimp_foreground_select_tool_preview_async (fg_select, 1.0);
+}
+
+static void
+gimp_foreground_select_tool_preview_async (GimpForegroundSelectTool *fg_select,
+                                           gdouble                   scale)
 {
   GimpTool                    *tool     = GIMP_TOOL (fg_select);
   GimpForegroundSelectOptions *options;
   GimpImage                   *image    = gimp_display_get_image (tool->display);
   GimpDrawable                *drawable = gimp_image_get_active_drawable (image);
 
-  options  = GIMP_FOREGROUND_SELECT_TOOL_GET_OPTIONS (tool);
+  options = GIMP_FOREGROUND_SELECT_TOOL_GET_OPTIONS (tool);
 
-  g_clear_object (&fg_select->mask);
+  fg_select->async =
+    gimp_drawable_foreground_extract_async (drawable,
+                                            options->engine,
+                                            options->iterations,
+                                            options->levels,
+                                            options->active_levels,
+                                            fg_select->trimap,
+                                            scale,
+                                            fg_select->progress);
+
+  g_object_set_data (G_OBJECT (fg_select->async),
+                     "gimp-foreground-select-coarse",
+                     GINT_TO_POINTER (scale < 1.0));
+
+  gimp_async_add_callback_for_object (
+    fg_select->async,
+    (GimpAsyncCallback) gimp_foreground_select_tool_preview_cb,
+    fg_select, fg_select);
+}
+
+static void
+gimp_foreground_select_tool_preview_cb (GimpAsync                *async,
+                                        GimpForegroundSelectTool *fg_select)
+{
+  gboolean coarse;
+
+  /*  a newer preview has been started, or the tool was halted  */
+  if (async != fg_select->async)
+    return;
+
+  if (! gimp_async_is_finished (async))
+    {
+      gimp_foreground_select_tool_abort_preview (fg_select);
+      return;
+    }
+
+  coarse = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (async),
+                                               "gimp-foreground-select-coarse"));
 
-  fg_select->mask = gimp_drawable_foreground_extract (drawable,
-                                                      options->engine,
-                                                      options->iterations,
-                                                      options->levels,
-                                                      options->active_levels,
-                                                      fg_select->trimap,
-                                                      GIMP_PROGRESS (fg_select));
+  g_set_object (&fg_select->mask, gimp_async_get_result (async));
+  g_clear_object (&fg_select->async);
 
   gimp_foreground_select_tool_set_preview (fg_select);
+
+  if (coarse)
+    {
+      gimp_foreground_select_tool_preview_async (fg_select, 1.0);
+    }
+  else
+    {
+      gimp_foreground_select_tool_abort_preview (fg_select);
+    }
+}
+
+static void
+gimp_foreground_select_tool_abort_preview (GimpForegroundSelectTool *fg_select)
+{
+  if (fg_select->async)
+    {
+      /*  don't wait for the matting operation, its result is simply
+       *  ignored once it finishes
+       */
+      gimp_cancelable_cancel (GIMP_CANCELABLE (fg_select->async));
+
+      g_clear_object (&fg_select->async);
+    }
+
+  if (fg_select->progress)
+    {
+      g_signal_handlers_disconnect_by_func (
+        fg_select->progress,
+        gimp_foreground_select_tool_abort_preview,
+        fg_select);
+
+      gimp_progress_end (fg_select->progress);
+
+      fg_select->progress = NULL;
+    }
+}
+
+static gboolean
+gimp_foreground_select_tool_is_previewing (GimpForegroundSelectTool *fg_select)
+{
+  return (fg_select->state == MATTING_STATE_PREVIEW_MASK ||
+          fg_select->async != NULL);
 }
 
 static void
@@ -1269,6 +1412,8 @@ gimp_foreground_select_tool_preview_toggled (GtkToggleButton          *button,
         }
       else
         {
+          gimp_foreground_select_tool_abort_preview (fg_select);
+
           if (fg_select->state == MATTING_STATE_PREVIEW_MASK)
             gimp_foreground_select_tool_set_trimap (fg_select);
         }
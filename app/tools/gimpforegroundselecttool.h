@@ -54,6 +54,9 @@ struct _GimpForegroundSelectTool
   GeglBuffer            *trimap;
   GeglBuffer            *mask;
 
+  GimpAsync             *async;
+  GimpProgress          *progress;
+
   GList                 *undo_stack;
   GList                 *redo_stack;
 
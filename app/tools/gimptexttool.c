@@ -43,6 +43,7 @@
 #include "core/gimpimage-undo-push.h"
 #include "core/gimplayer-floating-selection.h"
 #include "core/gimpmarshal.h"
+#include "core/gimppickable.h"
 #include "core/gimptoolinfo.h"
 #include "core/gimpundostack.h"
 
@@ -152,6 +153,8 @@ static void      gimp_text_tool_connect         (GimpTextTool      *text_tool,
 static void      gimp_text_tool_layer_notify    (GimpTextLayer     *layer,
                                                  const GParamSpec  *pspec,
                                                  GimpTextTool      *text_tool);
+static void  gimp_text_tool_layer_size_changed  (GimpTextLayer     *layer,
+                                                 GimpTextTool      *text_tool);
 static void      gimp_text_tool_proxy_notify    (GimpText          *text,
                                                  const GParamSpec  *pspec,
                                                  GimpTextTool      *text_tool);
@@ -368,6 +371,9 @@ gimp_text_tool_control (GimpTool       *tool,
       break;
 
     case GIMP_TOOL_ACTION_COMMIT:
+      /*  bring the layer's pixels up to date with its text  */
+      if (text_tool->layer)
+        gimp_pickable_flush (GIMP_PICKABLE (text_tool->layer));
       break;
     }
 
@@ -1307,6 +1313,12 @@ gimp_text_tool_connect (GimpTextTool  *text_tool,
           g_signal_handlers_disconnect_by_func (text_tool->layer,
                                                 gimp_text_tool_layer_notify,
                                                 text_tool);
+          g_signal_handlers_disconnect_by_func (text_tool->layer,
+                                                gimp_text_tool_layer_size_changed,
+                                                text_tool);
+
+          /*  bring the layer up to date before we let go of it  */
+          gimp_text_layer_end_async_render (text_tool->layer);
 
           /*  don't try to remove the layer if it is not attached,
            *  which can happen if we got here because the layer was
@@ -1324,6 +1336,12 @@ gimp_text_tool_connect (GimpTextTool  *text_tool,
           g_signal_connect_object (text_tool->layer, "notify",
                                    G_CALLBACK (gimp_text_tool_layer_notify),
                                    text_tool, 0);
+          g_signal_connect_object (text_tool->layer, "size-changed",
+                                   G_CALLBACK (gimp_text_tool_layer_size_changed),
+                                   text_tool, 0);
+
+          /*  the layer is rendered in the background while we edit it  */
+          gimp_text_layer_begin_async_render (text_tool->layer);
         }
     }
 }
@@ -1359,6 +1377,20 @@ gimp_text_tool_layer_notify (GimpTextLayer    *layer,
     }
 }
 
+static void
+gimp_text_tool_layer_size_changed (GimpTextLayer *layer,
+                                   GimpTextTool  *text_tool)
+{
+  if (gimp_item_is_attached (GIMP_ITEM (layer)))
+    {
+      gimp_text_tool_block_drawing (text_tool);
+
+      gimp_text_tool_frame_item (text_tool);
+
+      gimp_text_tool_unblock_drawing (text_tool);
+    }
+}
+
 static gboolean
 gimp_text_tool_apply_idle (GimpTextTool *text_tool)
 {
@@ -2015,7 +2047,7 @@ gimp_text_tool_ensure_layout (GimpTextTool *text_tool)
 
       gimp_image_get_resolution (image, &xres, &yres);
 
-      text_tool->layout = gimp_text_layout_new (text_tool->layer->text,
+      text_tool->layout = gimp_text_layout_new (text_tool->layer->text, NULL,
                                                 xres, yres, &error);
       if (error)
         {
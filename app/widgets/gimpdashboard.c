@@ -60,6 +60,7 @@
 #include "core/gimpasync.h"
 #include "core/gimpbacktrace.h"
 #include "core/gimptempbuf.h"
+#include "core/gimpundostack.h"
 #include "core/gimpwaitable.h"
 
 #include "gimpactiongroup.h"
@@ -144,6 +145,8 @@ typedef enum
   VARIABLE_TILE_ALLOC_TOTAL,
   VARIABLE_SCRATCH_TOTAL,
   VARIABLE_TEMP_BUF_TOTAL,
+  VARIABLE_TEMP_BUF_POOL,
+  VARIABLE_UNDO_TOTAL,
 
 
   N_VARIABLES,
@@ -742,6 +745,24 @@ static const VariableInfo variables[] =
     .type             = VARIABLE_TYPE_SIZE,
     .sample_func      = gimp_dashboard_sample_function,
     .data             = gimp_temp_buf_get_total_memsize
+  },
+
+  [VARIABLE_TEMP_BUF_POOL] =
+  { .name             = "temp-buf-pool",
+    .title            = NC_("dashboard-variable", "TempBuf pool"),
+    .description      = N_("Size of temporary buffer memory kept for reuse"),
+    .type             = VARIABLE_TYPE_SIZE,
+    .sample_func      = gimp_dashboard_sample_function,
+    .data             = gimp_temp_buf_get_pool_memsize
+  },
+
+  [VARIABLE_UNDO_TOTAL] =
+  { .name             = "undo-total",
+    .title            = NC_("dashboard-variable", "Undo"),
+    .description      = N_("Total size of the undo history of all images"),
+    .type             = VARIABLE_TYPE_SIZE,
+    .sample_func      = gimp_dashboard_sample_function,
+    .data             = gimp_undo_stack_get_total_memsize
   }
 };
 
@@ -959,6 +980,12 @@ static const GroupInfo groups[] =
                           { .variable       = VARIABLE_TEMP_BUF_TOTAL,
                             .default_active = TRUE
                           },
+                          { .variable       = VARIABLE_TEMP_BUF_POOL,
+                            .default_active = FALSE
+                          },
+                          { .variable       = VARIABLE_UNDO_TOTAL,
+                            .default_active = TRUE
+                          },
 
                           {}
                         }
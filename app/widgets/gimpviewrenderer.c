@@ -55,6 +55,20 @@
 
 #define RGB_EPSILON 1e-6
 
+/*  the scheduler's time budget per idle iteration, in microseconds  */
+#define SCHEDULER_TIME_SLICE  5000
+
+/*  renderers drawn within this many microseconds are likely visible  */
+#define RECENTLY_DRAWN_TIME   500000
+
+/*  the maximal number of concurrent render jobs  */
+#define MAX_RUNNING_JOBS      4
+
+/*  the maximal total size of the rendered surfaces of renderers that
+ *  weren't drawn recently
+ */
+#define MAX_SURFACES_SIZE     (32 << 20)
+
 enum
 {
   UPDATE,
@@ -72,14 +86,53 @@ struct _GimpViewRendererPrivate
   GimpColorTransform *profile_transform;
 
   gboolean            needs_render;
-  guint               idle_id;
+
+  /*  scheduler state  */
+  GList               update_link;
+  gboolean            update_queued;
+
+  GList               job_link;
+  GimpViewRendererJobFunc job_func;
+  gboolean            job_running;
+
+  GList               surface_link;
+  gsize               surface_size;
+
+  gint64              draw_time;
 };
 
 
+/*  all view renderers share one scheduler, which emits their "update"
+ *  signals, starts their render jobs, and limits the memory used by
+ *  their rendered surfaces
+ */
+typedef struct
+{
+  GQueue  updates;         /*  queued updates, recently drawn ones first  */
+  GQueue  jobs;            /*  queued jobs, most recently drawn first     */
+  gint    n_running_jobs;
+
+  GQueue  surfaces;        /*  rendered surfaces, least recently drawn
+                            *  first
+                            */
+  gsize   surfaces_size;
+
+  guint   idle_id;
+} Scheduler;
+
+
 static void      gimp_view_renderer_dispose           (GObject            *object);
 static void      gimp_view_renderer_finalize          (GObject            *object);
 
-static gboolean  gimp_view_renderer_idle_update       (GimpViewRenderer   *renderer);
+static void      gimp_view_renderer_schedule          (void);
+static gboolean  gimp_view_renderer_scheduler_idle    (gpointer            data);
+static gboolean  gimp_view_renderer_recently_drawn    (GimpViewRenderer   *renderer,
+                                                       gint64              time);
+static void      gimp_view_renderer_drop_stale_jobs   (gint64              time);
+static void      gimp_view_renderer_account_surface   (GimpViewRenderer   *renderer,
+                                                       gint64              time);
+static void      gimp_view_renderer_forget_surface    (GimpViewRenderer   *renderer);
+
 static void      gimp_view_renderer_real_set_context  (GimpViewRenderer   *renderer,
                                                        GimpContext        *context);
 static void      gimp_view_renderer_real_invalidate   (GimpViewRenderer   *renderer);
@@ -122,6 +175,8 @@ G_DEFINE_TYPE_WITH_PRIVATE (GimpViewRenderer, gimp_view_renderer, G_TYPE_OBJECT)
 
 static guint renderer_signals[LAST_SIGNAL] = { 0 };
 
+static Scheduler scheduler = { G_QUEUE_INIT, G_QUEUE_INIT, 0, G_QUEUE_INIT, };
+
 static GimpRGB  black_color;
 static GimpRGB  white_color;
 static GimpRGB  green_color;
@@ -178,6 +233,10 @@ gimp_view_renderer_init (GimpViewRenderer *renderer)
   renderer->size         = -1;
 
   renderer->priv->needs_render = TRUE;
+
+  renderer->priv->update_link.data  = renderer;
+  renderer->priv->job_link.data     = renderer;
+  renderer->priv->surface_link.data = renderer;
 }
 
 static void
@@ -195,6 +254,8 @@ gimp_view_renderer_dispose (GObject *object)
     gimp_view_renderer_set_color_config (renderer, NULL);
 
   gimp_view_renderer_remove_idle (renderer);
+  gimp_view_renderer_finish_job (renderer);
+  gimp_view_renderer_forget_surface (renderer);
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
@@ -557,18 +618,9 @@ gimp_view_renderer_invalidate (GimpViewRenderer *renderer)
 {
   g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
 
-  if (renderer->priv->idle_id)
-    {
-      g_source_remove (renderer->priv->idle_id);
-      renderer->priv->idle_id = 0;
-    }
-
   GIMP_VIEW_RENDERER_GET_CLASS (renderer)->invalidate (renderer);
 
-  renderer->priv->idle_id =
-    g_idle_add_full (GIMP_PRIORITY_VIEWABLE_IDLE,
-                     (GSourceFunc) gimp_view_renderer_idle_update,
-                     renderer, NULL);
+  gimp_view_renderer_update_idle (renderer);
 }
 
 void
@@ -576,38 +628,55 @@ gimp_view_renderer_update (GimpViewRenderer *renderer)
 {
   g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
 
-  if (renderer->priv->idle_id)
-    {
-      g_source_remove (renderer->priv->idle_id);
-      renderer->priv->idle_id = 0;
-    }
+  gimp_view_renderer_remove_idle (renderer);
 
   g_signal_emit (renderer, renderer_signals[UPDATE], 0);
 }
 
+/**
+ * gimp_view_renderer_update_idle:
+ * @renderer: a #GimpViewRenderer
+ *
+ * Queues an "update" signal emission.  Repeated calls before the
+ * signal is emitted are coalesced, and recently drawn renderers, which
+ * are likely visible, are updated first.
+ **/
 void
 gimp_view_renderer_update_idle (GimpViewRenderer *renderer)
 {
+  GimpViewRendererPrivate *priv;
+
   g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
 
-  if (renderer->priv->idle_id)
-    g_source_remove (renderer->priv->idle_id);
+  priv = renderer->priv;
 
-  renderer->priv->idle_id =
-    g_idle_add_full (GIMP_PRIORITY_VIEWABLE_IDLE,
-                     (GSourceFunc) gimp_view_renderer_idle_update,
-                     renderer, NULL);
+  if (priv->update_queued)
+    return;
+
+  if (gimp_view_renderer_recently_drawn (renderer, g_get_monotonic_time ()))
+    g_queue_push_head_link (&scheduler.updates, &priv->update_link);
+  else
+    g_queue_push_tail_link (&scheduler.updates, &priv->update_link);
+
+  priv->update_queued = TRUE;
+
+  gimp_view_renderer_schedule ();
 }
 
 void
 gimp_view_renderer_remove_idle (GimpViewRenderer *renderer)
 {
+  GimpViewRendererPrivate *priv;
+
   g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
 
-  if (renderer->priv->idle_id)
+  priv = renderer->priv;
+
+  if (priv->update_queued)
     {
-      g_source_remove (renderer->priv->idle_id);
-      renderer->priv->idle_id = 0;
+      g_queue_unlink (&scheduler.updates, &priv->update_link);
+
+      priv->update_queued = FALSE;
     }
 }
 
@@ -618,6 +687,8 @@ gimp_view_renderer_draw (GimpViewRenderer *renderer,
                          gint              available_width,
                          gint              available_height)
 {
+  gint64 time;
+
   g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
   g_return_if_fail (GTK_IS_WIDGET (widget));
   g_return_if_fail (cr != NULL);
@@ -628,6 +699,17 @@ gimp_view_renderer_draw (GimpViewRenderer *renderer,
   if (! gtk_widget_is_drawable (widget))
     return;
 
+  time = g_get_monotonic_time ();
+
+  renderer->priv->draw_time = time;
+
+  /*  a queued job of a renderer that is being drawn goes first  */
+  if (renderer->priv->job_func && ! renderer->priv->job_running)
+    {
+      g_queue_unlink (&scheduler.jobs, &renderer->priv->job_link);
+      g_queue_push_head_link (&scheduler.jobs, &renderer->priv->job_link);
+    }
+
   if (renderer->viewable)
     {
       cairo_save (cr);
@@ -637,6 +719,8 @@ gimp_view_renderer_draw (GimpViewRenderer *renderer,
                                                      available_height);
 
       cairo_restore (cr);
+
+      gimp_view_renderer_account_surface (renderer, time);
     }
   else
     {
@@ -677,14 +761,144 @@ gimp_view_renderer_draw (GimpViewRenderer *renderer,
 
 /*  private functions  */
 
+static void
+gimp_view_renderer_schedule (void)
+{
+  if (! scheduler.idle_id)
+    {
+      scheduler.idle_id =
+        g_idle_add_full (GIMP_PRIORITY_VIEWABLE_IDLE,
+                         gimp_view_renderer_scheduler_idle,
+                         NULL, NULL);
+    }
+}
+
+static gboolean
+gimp_view_renderer_scheduler_idle (gpointer data)
+{
+  gint64 start_time = g_get_monotonic_time ();
+
+  gimp_view_renderer_drop_stale_jobs (start_time);
+
+  while (scheduler.n_running_jobs < MAX_RUNNING_JOBS &&
+         ! g_queue_is_empty (&scheduler.jobs))
+    {
+      GimpViewRenderer        *renderer = g_queue_peek_head (&scheduler.jobs);
+      GimpViewRendererPrivate *priv     = renderer->priv;
+
+      g_queue_unlink (&scheduler.jobs, &priv->job_link);
+
+      priv->job_running = TRUE;
+      scheduler.n_running_jobs++;
+
+      priv->job_func (renderer, TRUE);
+
+      if (g_get_monotonic_time () - start_time >= SCHEDULER_TIME_SLICE)
+        return G_SOURCE_CONTINUE;
+    }
+
+  while (! g_queue_is_empty (&scheduler.updates))
+    {
+      gimp_view_renderer_update (g_queue_peek_head (&scheduler.updates));
+
+      if (g_get_monotonic_time () - start_time >= SCHEDULER_TIME_SLICE)
+        return G_SOURCE_CONTINUE;
+    }
+
+  /*  jobs that are left wait for a running job to finish  */
+  scheduler.idle_id = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
 static gboolean
-gimp_view_renderer_idle_update (GimpViewRenderer *renderer)
+gimp_view_renderer_recently_drawn (GimpViewRenderer *renderer,
+                                   gint64            time)
+{
+  return (renderer->priv->draw_time &&
+          time - renderer->priv->draw_time < RECENTLY_DRAWN_TIME);
+}
+
+static void
+gimp_view_renderer_drop_stale_jobs (gint64 time)
+{
+  /*  the job queue is ordered by draw time, so the stale jobs are at
+   *  its tail
+   */
+  while (! g_queue_is_empty (&scheduler.jobs))
+    {
+      GimpViewRenderer        *renderer = g_queue_peek_tail (&scheduler.jobs);
+      GimpViewRendererPrivate *priv     = renderer->priv;
+      GimpViewRendererJobFunc  func     = priv->job_func;
+
+      if (gimp_view_renderer_recently_drawn (renderer, time))
+        break;
+
+      g_queue_unlink (&scheduler.jobs, &priv->job_link);
+
+      priv->job_func = NULL;
+
+      func (renderer, FALSE);
+
+      /*  if the renderer is visible after all, updating it makes it
+       *  draw, and queue the job again
+       */
+      priv->needs_render = TRUE;
+
+      gimp_view_renderer_update_idle (renderer);
+    }
+}
+
+static void
+gimp_view_renderer_account_surface (GimpViewRenderer *renderer,
+                                    gint64            time)
 {
-  renderer->priv->idle_id = 0;
+  GimpViewRendererPrivate *priv = renderer->priv;
+
+  gimp_view_renderer_forget_surface (renderer);
+
+  if (renderer->surface &&
+      cairo_surface_get_type (renderer->surface) == CAIRO_SURFACE_TYPE_IMAGE)
+    {
+      priv->surface_size =
+        (gsize) cairo_image_surface_get_stride (renderer->surface) *
+        (gsize) cairo_image_surface_get_height (renderer->surface);
 
-  gimp_view_renderer_update (renderer);
+      scheduler.surfaces_size += priv->surface_size;
 
-  return FALSE;
+      g_queue_push_tail_link (&scheduler.surfaces, &priv->surface_link);
+    }
+
+  /*  free the surfaces of the least recently drawn renderers, they are
+   *  rendered again if they are drawn
+   */
+  while (scheduler.surfaces_size > MAX_SURFACES_SIZE)
+    {
+      GimpViewRenderer *lru = g_queue_peek_head (&scheduler.surfaces);
+
+      if (gimp_view_renderer_recently_drawn (lru, time))
+        break;
+
+      gimp_view_renderer_forget_surface (lru);
+
+      g_clear_pointer (&lru->surface, cairo_surface_destroy);
+
+      lru->priv->needs_render = TRUE;
+    }
+}
+
+static void
+gimp_view_renderer_forget_surface (GimpViewRenderer *renderer)
+{
+  GimpViewRendererPrivate *priv = renderer->priv;
+
+  if (priv->surface_size)
+    {
+      g_queue_unlink (&scheduler.surfaces, &priv->surface_link);
+
+      scheduler.surfaces_size -= priv->surface_size;
+      priv->surface_size       = 0;
+    }
 }
 
 static void
@@ -853,6 +1067,85 @@ gimp_view_renderer_config_notify (GObject          *config,
 
 /*  protected functions  */
 
+/**
+ * gimp_view_renderer_queue_job:
+ * @renderer: a #GimpViewRenderer
+ * @func:     the job's function
+ *
+ * Queues an expensive render job, such as an asynchronous preview
+ * render.  The scheduler runs a limited number of jobs at a time,
+ * starting with the most recently drawn renderers, by calling @func
+ * with @run == %TRUE.  The job is over when the renderer calls
+ * gimp_view_renderer_finish_job().
+ *
+ * If the renderer isn't drawn for a while before its job starts, it
+ * is probably not visible: the job is dropped by calling @func with
+ * @run == %FALSE, and the renderer is invalidated, so that drawing it
+ * again queues a new job.
+ **/
+void
+gimp_view_renderer_queue_job (GimpViewRenderer        *renderer,
+                              GimpViewRendererJobFunc  func)
+{
+  GimpViewRendererPrivate *priv;
+
+  g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
+  g_return_if_fail (func != NULL);
+
+  priv = renderer->priv;
+
+  g_return_if_fail (priv->job_func == NULL);
+
+  priv->job_func = func;
+
+  if (scheduler.n_running_jobs < MAX_RUNNING_JOBS &&
+      g_queue_is_empty (&scheduler.jobs))
+    {
+      priv->job_running = TRUE;
+      scheduler.n_running_jobs++;
+
+      func (renderer, TRUE);
+    }
+  else
+    {
+      g_queue_push_head_link (&scheduler.jobs, &priv->job_link);
+
+      gimp_view_renderer_schedule ();
+    }
+}
+
+/**
+ * gimp_view_renderer_finish_job:
+ * @renderer: a #GimpViewRenderer
+ *
+ * Ends @renderer's job, whether it is finished or canceled, or removes
+ * it from the queue if it hasn't started yet.
+ **/
+void
+gimp_view_renderer_finish_job (GimpViewRenderer *renderer)
+{
+  GimpViewRendererPrivate *priv;
+
+  g_return_if_fail (GIMP_IS_VIEW_RENDERER (renderer));
+
+  priv = renderer->priv;
+
+  if (priv->job_running)
+    {
+      priv->job_running = FALSE;
+      scheduler.n_running_jobs--;
+
+      if (! g_queue_is_empty (&scheduler.jobs))
+        gimp_view_renderer_schedule ();
+    }
+  else if (priv->job_func)
+    {
+      g_queue_unlink (&scheduler.jobs, &priv->job_link);
+    }
+
+  priv->job_func = NULL;
+}
+
 void
 gimp_view_renderer_render_temp_buf_simple (GimpViewRenderer *renderer,
                                            GtkWidget        *widget,
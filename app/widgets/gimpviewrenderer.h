@@ -36,6 +36,9 @@
 typedef struct _GimpViewRendererPrivate GimpViewRendererPrivate;
 typedef struct _GimpViewRendererClass   GimpViewRendererClass;
 
+typedef void (* GimpViewRendererJobFunc) (GimpViewRenderer *renderer,
+                                          gboolean          run);
+
 struct _GimpViewRenderer
 {
   GObject             parent_instance;
@@ -139,6 +142,10 @@ void   gimp_view_renderer_draw             (GimpViewRenderer   *renderer,
 
 /*  protected  */
 
+void   gimp_view_renderer_queue_job              (GimpViewRenderer *renderer,
+                                                  GimpViewRendererJobFunc func);
+void   gimp_view_renderer_finish_job             (GimpViewRenderer *renderer);
+
 void   gimp_view_renderer_render_temp_buf_simple (GimpViewRenderer *renderer,
                                                   GtkWidget        *widget,
                                                   GimpTempBuf      *temp_buf);
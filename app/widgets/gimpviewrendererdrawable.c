@@ -48,6 +48,15 @@ struct _GimpViewRendererDrawablePrivate
   gint       render_buf_x;
   gint       render_buf_y;
   gboolean   render_update;
+  gboolean   rendering;
+
+  gint       render_src_x;
+  gint       render_src_y;
+  gint       render_src_width;
+  gint       render_src_height;
+  gint       render_buf_width;
+  gint       render_buf_height;
+  gboolean   render_empty;
 
   gint       prev_width;
   gint       prev_height;
@@ -62,6 +71,8 @@ static void   gimp_view_renderer_drawable_invalidate    (GimpViewRenderer
 static void   gimp_view_renderer_drawable_render        (GimpViewRenderer         *renderer,
                                                          GtkWidget                *widget);
 
+static void   gimp_view_renderer_drawable_start_render  (GimpViewRenderer         *renderer,
+                                                         gboolean                  run);
 static void   gimp_view_renderer_drawable_cancel_render (GimpViewRendererDrawable *renderdrawable);
 
 
@@ -126,6 +137,8 @@ gimp_view_renderer_drawable_render_async_callback (GimpAsync                *asy
   if (gimp_async_is_canceled (async))
     return;
 
+  gimp_view_renderer_finish_job (GIMP_VIEW_RENDERER (renderdrawable));
+
   widget = renderdrawable->priv->render_widget;
 
   renderdrawable->priv->render_async  = NULL;
@@ -162,7 +175,8 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
   GimpItem                 *item;
   GimpImage                *image;
   const gchar              *icon_name;
-  GimpAsync                *async;
+  gint                      prev_width;
+  gint                      prev_height;
   gint                      image_width;
   gint                      image_height;
   gint                      view_width;
@@ -179,8 +193,9 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
   gdouble                   yres  = 1.0;
   gboolean                  empty = FALSE;
 
-  /* render is already in progress */
-  if (renderdrawable->priv->render_async)
+  /* render is already in progress, or queued */
+  if (renderdrawable->priv->render_async ||
+      renderdrawable->priv->render_widget)
     return;
 
   drawable  = GIMP_DRAWABLE (renderer->viewable);
@@ -278,12 +293,72 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
   dst_width  = MAX (dst_width,  1);
   dst_height = MAX (dst_height, 1);
 
-  if (! empty)
+  renderdrawable->priv->render_widget     = g_object_ref (widget);
+  renderdrawable->priv->render_src_x      = src_x;
+  renderdrawable->priv->render_src_y      = src_y;
+  renderdrawable->priv->render_src_width  = src_width;
+  renderdrawable->priv->render_src_height = src_height;
+  renderdrawable->priv->render_buf_x      = dst_x;
+  renderdrawable->priv->render_buf_y      = dst_y;
+  renderdrawable->priv->render_buf_width  = dst_width;
+  renderdrawable->priv->render_buf_height = dst_height;
+  renderdrawable->priv->render_empty      = empty;
+
+  prev_width  = renderdrawable->priv->prev_width;
+  prev_height = renderdrawable->priv->prev_height;
+
+  renderdrawable->priv->prev_width  = renderer->width;
+  renderdrawable->priv->prev_height = renderer->height;
+
+  /* the render job is started right away if the scheduler has room for it,
+   * otherwise it waits for its turn, and is dropped if the view isn't drawn
+   * again in the meantime.
+   */
+  renderdrawable->priv->rendering = TRUE;
+
+  gimp_view_renderer_queue_job (renderer,
+                                gimp_view_renderer_drawable_start_render);
+
+  renderdrawable->priv->rendering = FALSE;
+
+  /* if rendering isn't done yet, either keep the old drawable preview for
+   * now, or, if size changed (or there's no old preview,) render an icon in
+   * the meantime.
+   */
+  if (renderdrawable->priv->render_widget &&
+      (renderer->width  != prev_width ||
+       renderer->height != prev_height))
+    {
+      gimp_view_renderer_render_icon (renderer, widget, icon_name);
+    }
+}
+
+static void
+gimp_view_renderer_drawable_start_render (GimpViewRenderer *renderer,
+                                          gboolean          run)
+{
+  GimpViewRendererDrawable *renderdrawable = GIMP_VIEW_RENDERER_DRAWABLE (renderer);
+  GimpDrawable             *drawable       = GIMP_DRAWABLE (renderer->viewable);
+  GtkWidget                *widget         = renderdrawable->priv->render_widget;
+  GimpAsync                *async;
+
+  if (! run)
     {
-      async = gimp_drawable_get_sub_preview_async (drawable,
-                                                   src_x, src_y,
-                                                   src_width, src_height,
-                                                   dst_width, dst_height);
+      g_clear_object (&renderdrawable->priv->render_widget);
+
+      return;
+    }
+
+  if (! renderdrawable->priv->render_empty)
+    {
+      async = gimp_drawable_get_sub_preview_async (
+        drawable,
+        renderdrawable->priv->render_src_x,
+        renderdrawable->priv->render_src_y,
+        renderdrawable->priv->render_src_width,
+        renderdrawable->priv->render_src_height,
+        renderdrawable->priv->render_buf_width,
+        renderdrawable->priv->render_buf_height);
     }
   else
     {
@@ -292,7 +367,9 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
 
       async = gimp_async_new ();
 
-      render_buf = gimp_temp_buf_new (dst_width, dst_height, format);
+      render_buf = gimp_temp_buf_new (renderdrawable->priv->render_buf_width,
+                                      renderdrawable->priv->render_buf_height,
+                                      format);
       gimp_temp_buf_data_clear (render_buf);
 
       gimp_async_finish_full (async,
@@ -303,10 +380,7 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
   if (async)
     {
       renderdrawable->priv->render_async  = async;
-      renderdrawable->priv->render_widget = g_object_ref (widget);
-      renderdrawable->priv->render_buf_x  = dst_x;
-      renderdrawable->priv->render_buf_y  = dst_y;
-      renderdrawable->priv->render_update = FALSE;
+      renderdrawable->priv->render_update = ! renderdrawable->priv->rendering;
 
       gimp_async_add_callback_for_object (
         async,
@@ -314,23 +388,9 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
         renderdrawable,
         renderdrawable);
 
-      /* if rendering isn't done yet, update the render-view once it is, and
-       * either keep the old drawable preview for now, or, if size changed (or
-       * there's no old preview,) render an icon in the meantime.
-       */
+      /* if rendering isn't done yet, update the render-view once it is */
       if (renderdrawable->priv->render_async)
-        {
-          renderdrawable->priv->render_update = TRUE;
-
-          if (renderer->width  != renderdrawable->priv->prev_width ||
-              renderer->height != renderdrawable->priv->prev_height)
-            {
-              gimp_view_renderer_render_icon (renderer, widget, icon_name);
-            }
-        }
-
-      renderdrawable->priv->prev_width  = renderer->width;
-      renderdrawable->priv->prev_height = renderer->height;
+        renderdrawable->priv->render_update = TRUE;
 
       g_object_unref (async);
     }
@@ -339,7 +399,16 @@ gimp_view_renderer_drawable_render (GimpViewRenderer *renderer,
       renderdrawable->priv->prev_width  = 0;
       renderdrawable->priv->prev_height = 0;
 
-      gimp_view_renderer_render_icon (renderer, widget, icon_name);
+      gimp_view_renderer_render_icon (
+        renderer, widget,
+        gimp_viewable_get_icon_name (renderer->viewable));
+
+      gimp_view_renderer_finish_job (renderer);
+
+      g_clear_object (&renderdrawable->priv->render_widget);
+
+      if (! renderdrawable->priv->rendering)
+        gimp_view_renderer_update (renderer);
     }
 }
 
@@ -362,5 +431,8 @@ gimp_view_renderer_drawable_cancel_render (GimpViewRendererDrawable *renderdrawa
       renderdrawable->priv->render_async = NULL;
     }
 
+  /* also removes a render job that hasn't started yet from the queue */
+  gimp_view_renderer_finish_job (GIMP_VIEW_RENDERER (renderdrawable));
+
   g_clear_object (&renderdrawable->priv->render_widget);
 }
@@ -51,6 +51,21 @@ typedef enum
 } DisposeType;
 
 
+typedef struct
+{
+  gint         frame_num;
+  gint         delay;
+  gboolean     diff_only;
+
+  guchar      *this_frame;  /* the composed frame                     */
+  guchar      *last_frame;  /* the composed frame before it           */
+  guchar      *opti_frame;  /* the frame's changes, cropped to bbox   */
+
+  gboolean     can_combine;
+  gint32       bbox_left, bbox_top, bbox_right, bbox_bottom;
+} OptimizeFrame;
+
+
 typedef enum
 {
   OPOPTIMIZE   = 0L,
@@ -68,6 +83,9 @@ static  void run   (const gchar      *name,
                     gint             *nreturn_vals,
                     GimpParam       **return_vals);
 
+static  void        optimize_frames_diff (gsize          offset,
+                                          gsize          size,
+                                          OptimizeFrame *frames);
 static  gint32      do_optimizations    (GimpRunMode  run_mode,
                                          gboolean     diff_only);
 
@@ -409,13 +427,311 @@ compose_row (gint          frame_num,
 }
 
 
+/*  finds how each frame of a batch differs from the one before it,
+ *  and crops it to the changed area
+ */
+static void
+optimize_frames_diff (gsize          offset,
+                      gsize          size,
+                      OptimizeFrame *frames)
+{
+  guint32 frame_sizebytes = width * height * pixelstep;
+  gsize   i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      OptimizeFrame *frame          = &frames[i];
+      gint           this_frame_num = frame->frame_num;
+      gboolean       diff_only      = frame->diff_only;
+      guchar        *this_frame     = frame->this_frame;
+      guchar        *last_frame     = frame->last_frame;
+      guchar        *opti_frame     = frame->opti_frame;
+      guchar        *srcptr;
+      guchar        *destptr;
+      gboolean       can_combine;
+      gint32         bbox_top, bbox_bottom, bbox_left, bbox_right;
+      gint32         rbox_top, rbox_bottom, rbox_left, rbox_right;
+
+      can_combine = FALSE;
+      bbox_left   = 0;
+      bbox_top    = 0;
+      bbox_right  = width;
+      bbox_bottom = height;
+      rbox_left   = 0;
+      rbox_top    = 0;
+      rbox_right  = width;
+      rbox_bottom = height;
+
+      /* copy 'this' frame into a buffer which we can safely molest */
+      memcpy (opti_frame, this_frame, frame_sizebytes);
+      /*
+       *
+       * OPTIMIZE HERE!
+       *
+       */
+      if (
+          (this_frame_num != 0) /* Can't delta bottom frame! */
+          && (opmode == OPOPTIMIZE)
+          )
+        {
+          gint xit, yit, byteit;
+
+          can_combine = TRUE;
+
+          /*
+           * SEARCH FOR BOUNDING BOX
+           */
+          bbox_left   = width;
+          bbox_top    = height;
+          bbox_right  = 0;
+          bbox_bottom = 0;
+          rbox_left   = width;
+          rbox_top    = height;
+          rbox_right  = 0;
+          rbox_bottom = 0;
+
+          for (yit=0; yit<height; yit++)
+            {
+              for (xit=0; xit<width; xit++)
+                {
+                  gboolean keep_pix;
+                  gboolean opaq_pix;
+
+                  /* Check if 'this' and 'last' are transparent */
+                  if (!(this_frame[yit*width*pixelstep + xit*pixelstep
+                                  + pixelstep-1]&128)
+                      &&
+                      !(last_frame[yit*width*pixelstep + xit*pixelstep
+                                  + pixelstep-1]&128))
+                    {
+                      keep_pix = FALSE;
+                      opaq_pix = FALSE;
+                      goto decided;
+                    }
+                  /* Check if just 'this' is transparent */
+                  if ((last_frame[yit*width*pixelstep + xit*pixelstep
+                                 + pixelstep-1]&128)
+                      &&
+                      !(this_frame[yit*width*pixelstep + xit*pixelstep
+                                  + pixelstep-1]&128))
+                    {
+                      keep_pix = TRUE;
+                      opaq_pix = FALSE;
+                      can_combine = FALSE;
+                      goto decided;
+                    }
+                  /* Check if just 'last' is transparent */
+                  if (!(last_frame[yit*width*pixelstep + xit*pixelstep
+                                  + pixelstep-1]&128)
+                      &&
+                      (this_frame[yit*width*pixelstep + xit*pixelstep
+                                 + pixelstep-1]&128))
+                    {
+                      keep_pix = TRUE;
+                      opaq_pix = TRUE;
+                      goto decided;
+                    }
+                  /* If 'last' and 'this' are opaque, we have
+                   *  to check if they're the same color - we
+                   *  only have to keep the pixel if 'last' or
+                   *  'this' are opaque and different.
+                   */
+                  keep_pix = FALSE;
+                  opaq_pix = TRUE;
+                  for (byteit=0; byteit<pixelstep-1; byteit++)
+                    {
+                      if ((last_frame[yit*width*pixelstep + xit*pixelstep
+                                     + byteit]
+                           !=
+                           this_frame[yit*width*pixelstep + xit*pixelstep
+                                     + byteit])
+                          )
+                        {
+                          keep_pix = TRUE;
+                          goto decided;
+                        }
+                    }
+                decided:
+                  if (opaq_pix)
+                    {
+                      if (xit<rbox_left) rbox_left=xit;
+                      if (xit>rbox_right) rbox_right=xit;
+                      if (yit<rbox_top) rbox_top=yit;
+                      if (yit>rbox_bottom) rbox_bottom=yit;
+                    }
+                  if (keep_pix)
+                    {
+                      if (xit<bbox_left) bbox_left=xit;
+                      if (xit>bbox_right) bbox_right=xit;
+                      if (yit<bbox_top) bbox_top=yit;
+                      if (yit>bbox_bottom) bbox_bottom=yit;
+                    }
+                  else
+                    {
+                      /* pixel didn't change this frame - make
+                       *  it transparent in our optimized buffer!
+                       */
+                      opti_frame[yit*width*pixelstep + xit*pixelstep
+                                + pixelstep-1] = 0;
+                    }
+                } /* xit */
+            } /* yit */
+
+          if (!can_combine)
+            {
+              bbox_left = rbox_left;
+              bbox_top = rbox_top;
+              bbox_right = rbox_right;
+              bbox_bottom = rbox_bottom;
+            }
+
+          bbox_right++;
+          bbox_bottom++;
+
+          if (can_combine && !diff_only)
+            {
+              /* Try to optimize the pixel data for RLE or LZW compression
+               * by making some transparent pixels non-transparent if they
+               * would have the same color as the adjacent pixels.  This
+               * gives a better compression if the algorithm compresses
+               * the image line by line.
+               * See: http://bugzilla.gnome.org/show_bug.cgi?id=66367
+               * It may not be very efficient to add two additional passes
+               * over the pixels, but this hopefully makes the code easier
+               * to maintain and less error-prone.
+               */
+              for (yit = bbox_top; yit < bbox_bottom; yit++)
+                {
+                  /* Compare with previous pixels from left to right */
+                  for (xit = bbox_left + 1; xit < bbox_right; xit++)
+                    {
+                      if (!(opti_frame[yit*width*pixelstep
+                                       + xit*pixelstep
+                                       + pixelstep-1]&128)
+                          && (opti_frame[yit*width*pixelstep
+                                         + (xit-1)*pixelstep
+                                         + pixelstep-1]&128)
+                          && (last_frame[yit*width*pixelstep
+                                         + xit*pixelstep
+                                         + pixelstep-1]&128))
+                        {
+                          for (byteit=0; byteit<pixelstep-1; byteit++)
+                            {
+                              if (opti_frame[yit*width*pixelstep
+                                             + (xit-1)*pixelstep
+                                             + byteit]
+                                  !=
+                                  last_frame[yit*width*pixelstep
+                                             + xit*pixelstep
+                                             + byteit])
+                                {
+                                  goto skip_right;
+                                }
+                            }
+                          /* copy the color and alpha */
+                          for (byteit=0; byteit<pixelstep; byteit++)
+                            {
+                              opti_frame[yit*width*pixelstep
+                                         + xit*pixelstep
+                                         + byteit]
+                                = last_frame[yit*width*pixelstep
+                                             + xit*pixelstep
+                                             + byteit];
+                            }
+                        }
+                    skip_right:
+                      /* nop */;
+                    } /* xit */
+
+                  /* Compare with next pixels from right to left */
+                  for (xit = bbox_right - 2; xit >= bbox_left; xit--)
+                    {
+                      if (!(opti_frame[yit*width*pixelstep
+                                       + xit*pixelstep
+                                       + pixelstep-1]&128)
+                          && (opti_frame[yit*width*pixelstep
+                                         + (xit+1)*pixelstep
+                                         + pixelstep-1]&128)
+                          && (last_frame[yit*width*pixelstep
+                                         + xit*pixelstep
+                                         + pixelstep-1]&128))
+                        {
+                          for (byteit=0; byteit<pixelstep-1; byteit++)
+                            {
+                              if (opti_frame[yit*width*pixelstep
+                                             + (xit+1)*pixelstep
+                                             + byteit]
+                                  !=
+                                  last_frame[yit*width*pixelstep
+                                             + xit*pixelstep
+                                             + byteit])
+                                {
+                                  goto skip_left;
+                                }
+                            }
+                          /* copy the color and alpha */
+                          for (byteit=0; byteit<pixelstep; byteit++)
+                            {
+                              opti_frame[yit*width*pixelstep
+                                         + xit*pixelstep
+                                         + byteit]
+                                = last_frame[yit*width*pixelstep
+                                             + xit*pixelstep
+                                             + byteit];
+                            }
+                        }
+                    skip_left:
+                      /* nop */;
+                    } /* xit */
+                } /* yit */
+            }
+
+          /*
+           * Collapse opti_frame data down such that the data
+           *  which occupies the bounding box sits at the start
+           *  of the data (for convenience with ..set_rect()).
+           */
+          destptr = opti_frame;
+          /*
+           * If can_combine, then it's safe to use our optimized
+           *  alpha information.  Otherwise, an opaque pixel became
+           *  transparent this frame, and we'll have to use the
+           *  actual true frame's alpha.
+           */
+          if (can_combine)
+            srcptr = opti_frame;
+          else
+            srcptr = this_frame;
+          for (yit=bbox_top; yit<bbox_bottom; yit++)
+            {
+              for (xit=bbox_left; xit<bbox_right; xit++)
+                {
+                  for (byteit=0; byteit<pixelstep; byteit++)
+                    {
+                      *(destptr++) = srcptr[yit*pixelstep*width +
+                                           pixelstep*xit + byteit];
+                    }
+                }
+            }
+        } /* !bot frame? */
+      else
+        {
+          memcpy (opti_frame, this_frame, frame_sizebytes);
+        }
+
+      frame->can_combine = can_combine;
+      frame->bbox_left   = bbox_left;
+      frame->bbox_top    = bbox_top;
+      frame->bbox_right  = bbox_right;
+      frame->bbox_bottom = bbox_bottom;
+    }
+}
+
 static gint32
 do_optimizations (GimpRunMode run_mode,
                   gboolean    diff_only)
 {
   static guchar *rawframe = NULL;
-  guchar        *srcptr;
-  guchar        *destptr;
   gint           row, this_frame_num;
   guint32        frame_sizebytes;
   gint32         new_layer_id;
@@ -436,7 +752,6 @@ do_optimizations (GimpRunMode run_mode,
   gboolean       can_combine;
 
   gint32         bbox_top, bbox_bottom, bbox_left, bbox_right;
-  gint32         rbox_top, rbox_bottom, rbox_left, rbox_right;
 
   switch (opmode)
     {
@@ -466,15 +781,12 @@ do_optimizations (GimpRunMode run_mode,
 
   frame_sizebytes = width * height * pixelstep;
 
-  this_frame = g_malloc (frame_sizebytes);
   last_frame = g_malloc (frame_sizebytes);
-  opti_frame = g_malloc (frame_sizebytes);
 
   if (opmode == OPBACKGROUND ||
       opmode == OPFOREGROUND)
     back_frame = g_malloc (frame_sizebytes);
 
-  total_alpha (this_frame, width*height, pixelstep);
   total_alpha (last_frame, width*height, pixelstep);
 
   new_image_id = gimp_image_new(width, height, imagetype);
@@ -672,432 +984,237 @@ do_optimizations (GimpRunMode run_mode,
     }
   else
     {
-      for (this_frame_num=0; this_frame_num<total_frames; this_frame_num++)
+      OptimizeFrame *frames;
+      gint           first_frame_num;
+      gint           n_frames;
+      gint           batch_size;
+      gint           n_threads;
+      gint           i;
+
+      /* The frames are composed in order by the main thread, which is
+       * the only one that may talk to GIMP, each on top of the one
+       * before it.  How each frame differs from the one before it is
+       * then found in parallel, a batch at a time, and the batch is
+       * added to the new image in order.
+       */
+      g_object_get (gegl_config (),
+                    "threads", &n_threads,
+                    NULL);
+
+      batch_size = 2 * MAX (n_threads, 1);
+      frames     = g_new0 (OptimizeFrame, batch_size);
+
+      for (i = 0; i < batch_size; i++)
         {
-          /*
-           * BUILD THIS FRAME into our 'this_frame' buffer.
-           */
+          frames[i].this_frame = g_malloc (frame_sizebytes);
+          frames[i].opti_frame = g_malloc (frame_sizebytes);
+          frames[i].diff_only  = diff_only;
+        }
 
-          gint32 drawable_ID = layers[total_frames-(this_frame_num+1)];
+      for (first_frame_num = 0;
+           first_frame_num < total_frames;
+           first_frame_num += n_frames)
+        {
+          n_frames = MIN (batch_size, total_frames - first_frame_num);
 
-          /* Image has been closed/etc since we got the layer list? */
-          /* FIXME - How do we tell if a gimp_drawable_get() fails? */
-          if (gimp_drawable_width (drawable_ID) == 0)
+          for (i = 0; i < n_frames; i++)
             {
-              gimp_quit ();
-            }
+              OptimizeFrame *frame = &frames[i];
+              gint32         drawable_ID;
 
-          this_delay = get_frame_duration (this_frame_num);
-          dispose    = get_frame_disposal (this_frame_num);
+              this_frame_num = first_frame_num + i;
+              drawable_ID    = layers[total_frames-(this_frame_num+1)];
 
-          for (row = 0; row < height; row++)
-            {
-              compose_row (this_frame_num,
-                           dispose,
-                           row,
-                           &this_frame[pixelstep*width * row],
-                           width,
-                           drawable_ID,
-                           FALSE
-                           );
-            }
+              /*
+               * BUILD THIS FRAME into its 'this_frame' buffer, on top
+               * of the last one.
+               */
+              this_frame = frame->this_frame;
 
-          if (opmode == OPFOREGROUND)
-            {
-              gint xit, yit, byteit;
+              frame->frame_num  = this_frame_num;
+              frame->last_frame = (i == 0) ? last_frame : frames[i - 1].this_frame;
+
+              memcpy (this_frame, frame->last_frame, frame_sizebytes);
 
-              for (yit=0; yit<height; yit++)
+              /* Image has been closed/etc since we got the layer list? */
+              /* FIXME - How do we tell if a gimp_drawable_get() fails? */
+              if (gimp_drawable_width (drawable_ID) == 0)
                 {
-                  for (xit=0; xit<width; xit++)
-                    {
-                      for (byteit=0; byteit<pixelstep-1; byteit++)
-                        {
-                          if (back_frame[yit*width*pixelstep + xit*pixelstep
-                                        + byteit]
-                              !=
-                              this_frame[yit*width*pixelstep + xit*pixelstep
-                                        + byteit])
-                            {
-                              goto enough;
-                            }
-                        }
-                      this_frame[yit*width*pixelstep + xit*pixelstep
-                                + pixelstep - 1] = 0;
-                    enough:
-                      /* nop */;
-                    }
+                  gimp_quit ();
                 }
-            }
-
-          can_combine = FALSE;
-          bbox_left   = 0;
-          bbox_top    = 0;
-          bbox_right  = width;
-          bbox_bottom = height;
-          rbox_left   = 0;
-          rbox_top    = 0;
-          rbox_right  = width;
-          rbox_bottom = height;
-
-          /* copy 'this' frame into a buffer which we can safely molest */
-          memcpy (opti_frame, this_frame, frame_sizebytes);
-          /*
-           *
-           * OPTIMIZE HERE!
-           *
-           */
-          if (
-              (this_frame_num != 0) /* Can't delta bottom frame! */
-              && (opmode == OPOPTIMIZE)
-              )
-            {
-              gint xit, yit, byteit;
 
-              can_combine = TRUE;
+              frame->delay = get_frame_duration (this_frame_num);
+              dispose      = get_frame_disposal (this_frame_num);
 
-              /*
-               * SEARCH FOR BOUNDING BOX
-               */
-              bbox_left   = width;
-              bbox_top    = height;
-              bbox_right  = 0;
-              bbox_bottom = 0;
-              rbox_left   = width;
-              rbox_top    = height;
-              rbox_right  = 0;
-              rbox_bottom = 0;
-
-              for (yit=0; yit<height; yit++)
+              for (row = 0; row < height; row++)
                 {
-                  for (xit=0; xit<width; xit++)
-                    {
-                      gboolean keep_pix;
-                      gboolean opaq_pix;
-
-                      /* Check if 'this' and 'last' are transparent */
-                      if (!(this_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128)
-                          &&
-                          !(last_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128))
-                        {
-                          keep_pix = FALSE;
-                          opaq_pix = FALSE;
-                          goto decided;
-                        }
-                      /* Check if just 'this' is transparent */
-                      if ((last_frame[yit*width*pixelstep + xit*pixelstep
-                                     + pixelstep-1]&128)
-                          &&
-                          !(this_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128))
-                        {
-                          keep_pix = TRUE;
-                          opaq_pix = FALSE;
-                          can_combine = FALSE;
-                          goto decided;
-                        }
-                      /* Check if just 'last' is transparent */
-                      if (!(last_frame[yit*width*pixelstep + xit*pixelstep
-                                      + pixelstep-1]&128)
-                          &&
-                          (this_frame[yit*width*pixelstep + xit*pixelstep
-                                     + pixelstep-1]&128))
-                        {
-                          keep_pix = TRUE;
-                          opaq_pix = TRUE;
-                          goto decided;
-                        }
-                      /* If 'last' and 'this' are opaque, we have
-                       *  to check if they're the same color - we
-                       *  only have to keep the pixel if 'last' or
-                       *  'this' are opaque and different.
-                       */
-                      keep_pix = FALSE;
-                      opaq_pix = TRUE;
-                      for (byteit=0; byteit<pixelstep-1; byteit++)
-                        {
-                          if ((last_frame[yit*width*pixelstep + xit*pixelstep
-                                         + byteit]
-                               !=
-                               this_frame[yit*width*pixelstep + xit*pixelstep
-                                         + byteit])
-                              )
-                            {
-                              keep_pix = TRUE;
-                              goto decided;
-                            }
-                        }
-                    decided:
-                      if (opaq_pix)
-                        {
-                          if (xit<rbox_left) rbox_left=xit;
-                          if (xit>rbox_right) rbox_right=xit;
-                          if (yit<rbox_top) rbox_top=yit;
-                          if (yit>rbox_bottom) rbox_bottom=yit;
-                        }
-                      if (keep_pix)
-                        {
-                          if (xit<bbox_left) bbox_left=xit;
-                          if (xit>bbox_right) bbox_right=xit;
-                          if (yit<bbox_top) bbox_top=yit;
-                          if (yit>bbox_bottom) bbox_bottom=yit;
-                        }
-                      else
-                        {
-                          /* pixel didn't change this frame - make
-                           *  it transparent in our optimized buffer!
-                           */
-                          opti_frame[yit*width*pixelstep + xit*pixelstep
-                                    + pixelstep-1] = 0;
-                        }
-                    } /* xit */
-                } /* yit */
-
-              if (!can_combine)
-                {
-                  bbox_left = rbox_left;
-                  bbox_top = rbox_top;
-                  bbox_right = rbox_right;
-                  bbox_bottom = rbox_bottom;
+                  compose_row (this_frame_num,
+                               dispose,
+                               row,
+                               &this_frame[pixelstep*width * row],
+                               width,
+                               drawable_ID,
+                               FALSE
+                               );
                 }
 
-              bbox_right++;
-              bbox_bottom++;
-
-              if (can_combine && !diff_only)
+              if (opmode == OPFOREGROUND)
                 {
-                  /* Try to optimize the pixel data for RLE or LZW compression
-                   * by making some transparent pixels non-transparent if they
-                   * would have the same color as the adjacent pixels.  This
-                   * gives a better compression if the algorithm compresses
-                   * the image line by line.
-                   * See: http://bugzilla.gnome.org/show_bug.cgi?id=66367
-                   * It may not be very efficient to add two additional passes
-                   * over the pixels, but this hopefully makes the code easier
-                   * to maintain and less error-prone.
-                   */
-                  for (yit = bbox_top; yit < bbox_bottom; yit++)
-                    {
-                      /* Compare with previous pixels from left to right */
-                      for (xit = bbox_left + 1; xit < bbox_right; xit++)
-                        {
-                          if (!(opti_frame[yit*width*pixelstep
-                                           + xit*pixelstep
-                                           + pixelstep-1]&128)
-                              && (opti_frame[yit*width*pixelstep
-                                             + (xit-1)*pixelstep
-                                             + pixelstep-1]&128)
-                              && (last_frame[yit*width*pixelstep
-                                             + xit*pixelstep
-                                             + pixelstep-1]&128))
-                            {
-                              for (byteit=0; byteit<pixelstep-1; byteit++)
-                                {
-                                  if (opti_frame[yit*width*pixelstep
-                                                 + (xit-1)*pixelstep
-                                                 + byteit]
-                                      !=
-                                      last_frame[yit*width*pixelstep
-                                                 + xit*pixelstep
-                                                 + byteit])
-                                    {
-                                      goto skip_right;
-                                    }
-                                }
-                              /* copy the color and alpha */
-                              for (byteit=0; byteit<pixelstep; byteit++)
-                                {
-                                  opti_frame[yit*width*pixelstep
-                                             + xit*pixelstep
-                                             + byteit]
-                                    = last_frame[yit*width*pixelstep
-                                                 + xit*pixelstep
-                                                 + byteit];
-                                }
-                            }
-                        skip_right:
-                          /* nop */;
-                        } /* xit */
+                  gint xit, yit, byteit;
 
-                      /* Compare with next pixels from right to left */
-                      for (xit = bbox_right - 2; xit >= bbox_left; xit--)
+                  for (yit=0; yit<height; yit++)
+                    {
+                      for (xit=0; xit<width; xit++)
                         {
-                          if (!(opti_frame[yit*width*pixelstep
-                                           + xit*pixelstep
-                                           + pixelstep-1]&128)
-                              && (opti_frame[yit*width*pixelstep
-                                             + (xit+1)*pixelstep
-                                             + pixelstep-1]&128)
-                              && (last_frame[yit*width*pixelstep
-                                             + xit*pixelstep
-                                             + pixelstep-1]&128))
+                          for (byteit=0; byteit<pixelstep-1; byteit++)
                             {
-                              for (byteit=0; byteit<pixelstep-1; byteit++)
+                              if (back_frame[yit*width*pixelstep + xit*pixelstep
+                                            + byteit]
+                                  !=
+                                  this_frame[yit*width*pixelstep + xit*pixelstep
+                                            + byteit])
                                 {
-                                  if (opti_frame[yit*width*pixelstep
-                                                 + (xit+1)*pixelstep
-                                                 + byteit]
-                                      !=
-                                      last_frame[yit*width*pixelstep
-                                                 + xit*pixelstep
-                                                 + byteit])
-                                    {
-                                      goto skip_left;
-                                    }
-                                }
-                              /* copy the color and alpha */
-                              for (byteit=0; byteit<pixelstep; byteit++)
-                                {
-                                  opti_frame[yit*width*pixelstep
-                                             + xit*pixelstep
-                                             + byteit]
-                                    = last_frame[yit*width*pixelstep
-                                                 + xit*pixelstep
-                                                 + byteit];
+                                  goto enough;
                                 }
                             }
-                        skip_left:
+                          this_frame[yit*width*pixelstep + xit*pixelstep
+                                    + pixelstep - 1] = 0;
+                        enough:
                           /* nop */;
-                        } /* xit */
-                    } /* yit */
-                }
-
-              /*
-               * Collapse opti_frame data down such that the data
-               *  which occupies the bounding box sits at the start
-               *  of the data (for convenience with ..set_rect()).
-               */
-              destptr = opti_frame;
-              /*
-               * If can_combine, then it's safe to use our optimized
-               *  alpha information.  Otherwise, an opaque pixel became
-               *  transparent this frame, and we'll have to use the
-               *  actual true frame's alpha.
-               */
-              if (can_combine)
-                srcptr = opti_frame;
-              else
-                srcptr = this_frame;
-              for (yit=bbox_top; yit<bbox_bottom; yit++)
-                {
-                  for (xit=bbox_left; xit<bbox_right; xit++)
-                    {
-                      for (byteit=0; byteit<pixelstep; byteit++)
-                        {
-                          *(destptr++) = srcptr[yit*pixelstep*width +
-                                               pixelstep*xit + byteit];
                         }
                     }
                 }
-            } /* !bot frame? */
-          else
-            {
-              memcpy (opti_frame, this_frame, frame_sizebytes);
             }
 
-          /*
-           *
-           * REMEMBER THE ANIMATION STATUS TO DELTA AGAINST NEXT TIME
-           *
-           */
-          memcpy (last_frame, this_frame, frame_sizebytes);
+          gegl_parallel_distribute_range (
+            n_frames, 1,
+            (GeglParallelDistributeRangeFunc) optimize_frames_diff,
+            frames);
 
+          for (i = 0; i < n_frames; i++)
+            {
+              OptimizeFrame *frame = &frames[i];
 
-          /*
-           *
-           * PUT THIS FRAME INTO A NEW LAYER IN THE NEW IMAGE
-           *
-           */
+              this_frame_num = frame->frame_num;
+              this_delay     = frame->delay;
+              can_combine    = frame->can_combine;
+              bbox_left      = frame->bbox_left;
+              bbox_top       = frame->bbox_top;
+              bbox_right     = frame->bbox_right;
+              bbox_bottom    = frame->bbox_bottom;
+              opti_frame     = frame->opti_frame;
 
-          oldlayer_name =
-            gimp_item_get_name(layers[total_frames-(this_frame_num+1)]);
+              /*
+               *
+               * PUT THIS FRAME INTO A NEW LAYER IN THE NEW IMAGE
+               *
+               */
 
-          buflen = strlen(oldlayer_name) + 40;
+              oldlayer_name =
+                gimp_item_get_name(layers[total_frames-(this_frame_num+1)]);
 
-          newlayer_name = g_malloc(buflen);
+              buflen = strlen(oldlayer_name) + 40;
 
-          remove_disposal_tag(newlayer_name, oldlayer_name);
-          g_free(oldlayer_name);
+              newlayer_name = g_malloc(buflen);
 
-          oldlayer_name = g_malloc(buflen);
+              remove_disposal_tag(newlayer_name, oldlayer_name);
+              g_free(oldlayer_name);
 
-          remove_ms_tag(oldlayer_name, newlayer_name);
+              oldlayer_name = g_malloc(buflen);
 
-          g_snprintf(newlayer_name, buflen, "%s(%dms)%s",
-                     oldlayer_name, this_delay,
-                     (this_frame_num ==  0) ? "" :
-                     can_combine ? "(combine)" : "(replace)");
+              remove_ms_tag(oldlayer_name, newlayer_name);
 
-          g_free(oldlayer_name);
+              g_snprintf(newlayer_name, buflen, "%s(%dms)%s",
+                         oldlayer_name, this_delay,
+                         (this_frame_num ==  0) ? "" :
+                         can_combine ? "(combine)" : "(replace)");
 
-          /* Empty frame! */
-          if (bbox_right <= bbox_left ||
-              bbox_bottom <= bbox_top)
-            {
-              cumulated_delay += this_delay;
+              g_free(oldlayer_name);
 
-              g_free (newlayer_name);
+              /* Empty frame! */
+              if (bbox_right <= bbox_left ||
+                  bbox_bottom <= bbox_top)
+                {
+                  cumulated_delay += this_delay;
 
-              oldlayer_name = gimp_item_get_name (last_true_frame);
+                  g_free (newlayer_name);
 
-              buflen = strlen (oldlayer_name) + 40;
+                  oldlayer_name = gimp_item_get_name (last_true_frame);
 
-              newlayer_name = g_malloc (buflen);
+                  buflen = strlen (oldlayer_name) + 40;
 
-              remove_disposal_tag (newlayer_name, oldlayer_name);
-              g_free (oldlayer_name);
+                  newlayer_name = g_malloc (buflen);
 
-              oldlayer_name = g_malloc (buflen);
+                  remove_disposal_tag (newlayer_name, oldlayer_name);
+                  g_free (oldlayer_name);
 
-              remove_ms_tag (oldlayer_name, newlayer_name);
+                  oldlayer_name = g_malloc (buflen);
 
-              g_snprintf (newlayer_name, buflen, "%s(%dms)%s",
-                          oldlayer_name, cumulated_delay,
-                          (this_frame_num ==  0) ? "" :
-                          can_combine ? "(combine)" : "(replace)");
+                  remove_ms_tag (oldlayer_name, newlayer_name);
 
-              gimp_item_set_name (last_true_frame, newlayer_name);
+                  g_snprintf (newlayer_name, buflen, "%s(%dms)%s",
+                              oldlayer_name, cumulated_delay,
+                              (this_frame_num ==  0) ? "" :
+                              can_combine ? "(combine)" : "(replace)");
 
-              g_free (newlayer_name);
-            }
-          else
-            {
-              GeglBuffer *buffer;
-              const Babl *format;
+                  gimp_item_set_name (last_true_frame, newlayer_name);
 
-              cumulated_delay = this_delay;
+                  g_free (newlayer_name);
+                }
+              else
+                {
+                  GeglBuffer *buffer;
+                  const Babl *format;
 
-              last_true_frame =
-                new_layer_id = gimp_layer_new (new_image_id,
-                                               newlayer_name,
-                                               bbox_right-bbox_left,
-                                               bbox_bottom-bbox_top,
-                                               drawabletype_alpha,
-                                               100.0,
-                                               gimp_image_get_default_new_layer_mode (new_image_id));
-              g_free (newlayer_name);
+                  cumulated_delay = this_delay;
 
-              gimp_image_insert_layer (new_image_id, new_layer_id, -1, 0);
+                  last_true_frame =
+                    new_layer_id = gimp_layer_new (new_image_id,
+                                                   newlayer_name,
+                                                   bbox_right-bbox_left,
+                                                   bbox_bottom-bbox_top,
+                                                   drawabletype_alpha,
+                                                   100.0,
+                                                   gimp_image_get_default_new_layer_mode (new_image_id));
+                  g_free (newlayer_name);
 
-              buffer = gimp_drawable_get_buffer (new_layer_id);
+                  gimp_image_insert_layer (new_image_id, new_layer_id, -1, 0);
 
-              format = get_format (new_layer_id);
+                  buffer = gimp_drawable_get_buffer (new_layer_id);
 
-              gegl_buffer_set (buffer,
-                               GEGL_RECTANGLE (0, 0,
-                                               bbox_right-bbox_left,
-                                               bbox_bottom-bbox_top), 0,
-                               format, opti_frame,
-                               GEGL_AUTO_ROWSTRIDE);
+                  format = get_format (new_layer_id);
 
-              g_object_unref (buffer);
+                  gegl_buffer_set (buffer,
+                                   GEGL_RECTANGLE (0, 0,
+                                                   bbox_right-bbox_left,
+                                                   bbox_bottom-bbox_top), 0,
+                                   format, opti_frame,
+                                   GEGL_AUTO_ROWSTRIDE);
+
+                  g_object_unref (buffer);
+                }
+
+              gimp_progress_update (((gdouble) this_frame_num + 1.0) /
+                                    ((gdouble) total_frames));
             }
 
-          gimp_progress_update (((gdouble) this_frame_num + 1.0) /
-                                ((gdouble) total_frames));
+          /*
+           *
+           * REMEMBER THE ANIMATION STATUS TO DELTA AGAINST NEXT TIME
+           *
+           */
+          memcpy (last_frame, frames[n_frames - 1].this_frame,
+                  frame_sizebytes);
+        }
+
+      for (i = 0; i < batch_size; i++)
+        {
+          g_free (frames[i].this_frame);
+          g_free (frames[i].opti_frame);
         }
 
+      g_free (frames);
+
       gimp_progress_update (1.0);
     }
 
@@ -1112,12 +1229,6 @@ do_optimizations (GimpRunMode run_mode,
   g_free (last_frame);
   last_frame = NULL;
 
-  g_free (this_frame);
-  this_frame = NULL;
-
-  g_free (opti_frame);
-  opti_frame = NULL;
-
   g_free (back_frame);
   back_frame = NULL;
 
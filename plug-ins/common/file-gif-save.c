@@ -99,7 +99,6 @@ static void     comment_entry_callback (GtkTextBuffer    *buffer);
 
 static gboolean  comment_was_edited = FALSE;
 static gchar    *globalcomment      = NULL;
-static gint      Interlace; /* For compression code */
 
 
 const GimpPlugInInfo PLUG_IN_INFO =
@@ -382,15 +381,32 @@ run (const gchar      *name,
 
 #define MAXCOLORS 256
 
-/*
- * Pointer to function returning an int
- */
-typedef gint (* ifunptr) (gint x,
-                          gint y);
+typedef struct _GifCompressor GifCompressor;
+
+typedef struct
+{
+  guchar     *pixels;
+  gint        width;
+  gint        height;
+  gint        offset_x;
+  gint        offset_y;
+  gboolean    has_alpha;
+  gint        disposal;
+  gint        delay89;
+
+  gboolean    ix_used[256];
+  gint        transparent;
+  gint        bpp;
+  gint        interlace;
 
+  GByteArray *data;
+} GifFrame;
 
-static gint find_unused_ia_color           (const guchar  *pixels,
+
+static void find_used_ia_colors            (const guchar  *pixels,
                                             gint           numpixels,
+                                            gboolean      *ix_used);
+static gint find_unused_ia_color           (const gboolean *ix_used,
                                             gint           num_indices,
                                             gint          *colors);
 
@@ -398,12 +414,15 @@ static void special_flatten_indexed_alpha  (guchar        *pixels,
                                             gint           transparent,
                                             gint           numpixels);
 
+static void gif_frames_find_used           (gsize          offset,
+                                            gsize          size,
+                                            GifFrame      *frames);
+static void gif_frames_compress            (gsize          offset,
+                                            gsize          size,
+                                            GifFrame      *frames);
+
 static gint colors_to_bpp                  (gint           colors);
 static gint bpp_to_colors                  (gint           bpp);
-static gint get_pixel                      (gint           x,
-                                            gint           y);
-static gint gif_next_pixel                 (ifunptr        getpixel);
-static void bump_pixel                     (void);
 
 static gboolean gif_encode_header              (GOutputStream  *output,
                                                 gboolean        gif89,
@@ -414,26 +433,15 @@ static gboolean gif_encode_header              (GOutputStream  *output,
                                                 gint           *red,
                                                 gint           *green,
                                                 gint           *blue,
-                                                ifunptr         get_pixel,
                                                 GError        **error);
 static gboolean gif_encode_graphic_control_ext (GOutputStream  *output,
                                                 gint            disposal,
                                                 gint            delay89,
                                                 gint            n_frames,
-                                                gint            width,
-                                                gint            height,
                                                 gint            transparent,
-                                                gint            bpp,
-                                                ifunptr         get_pixel,
                                                 GError        **error);
 static gboolean gif_encode_image_data          (GOutputStream  *output,
-                                                gint            width,
-                                                gint            height,
-                                                gint            interlace,
-                                                gint            bpp,
-                                                ifunptr         get_pixel,
-                                                gint            offset_x,
-                                                gint            offset_y,
+                                                const GifFrame *frame,
                                                 GError        **error);
 static gboolean gif_encode_close               (GOutputStream  *output,
                                                 GError        **error);
@@ -444,65 +452,38 @@ static gboolean gif_encode_comment_ext         (GOutputStream  *output,
                                                 const gchar    *comment,
                                                 GError        **error);
 
-static gint     rowstride;
-static guchar  *pixels;
-static gint     cur_progress;
-static gint     max_progress;
-
-static gboolean compress        (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean no_compress     (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean rle_compress    (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-static gboolean normal_compress (GOutputStream *output,
-                                 gint           init_bits,
-                                 ifunptr        ReadValue,
-                                 GError        **error);
-
-static gboolean put_byte        (GOutputStream  *output,
-                                 guchar          b,
-                                 GError        **error);
-static gboolean put_word        (GOutputStream  *output,
-                                 gint            w,
-                                 GError        **error);
-static gboolean put_string      (GOutputStream  *output,
-                                 const gchar    *s,
-                                 GError        **error);
-static gboolean output_code     (GOutputStream  *output,
-                                 gint            code,
-                                 GError        **error);
-static gboolean cl_block        (GOutputStream  *output,
-                                 GError        **error);
-static void     cl_hash         (glong           hsize);
-
-static void     char_init       (void);
-static gboolean char_out        (GOutputStream  *output,
-                                 gint            c,
-                                 GError        **error);
-static gboolean char_flush      (GOutputStream  *output,
-                                 GError        **error);
+static GByteArray * compress   (const guchar   *pixels,
+                                gint            width,
+                                gint            height,
+                                gboolean        interlace,
+                                gint            init_bits);
 
+static gboolean put_byte       (GOutputStream  *output,
+                                guchar          b,
+                                GError        **error);
+static gboolean put_word       (GOutputStream  *output,
+                                gint            w,
+                                GError        **error);
+static gboolean put_string     (GOutputStream  *output,
+                                const gchar    *s,
+                                GError        **error);
 
-static gint
-find_unused_ia_color (const guchar *pixels,
-                      gint          numpixels,
-                      gint          num_indices,
-                      gint         *colors)
-{
-  gboolean ix_used[256];
-  gint     i;
+static void     output_code    (GifCompressor  *comp,
+                                gint            code);
+static void     cl_block       (GifCompressor  *comp);
+static void     cl_hash        (GifCompressor  *comp);
 
-#ifdef GIFDEBUG
-  g_printerr ("GIF: fuiac: Image claims to use %d/%d indices - finding free "
-              "index...\n", *colors, num_indices);
-#endif
+static void     char_out       (GifCompressor  *comp,
+                                gint            c);
+static void     char_flush     (GifCompressor  *comp);
+
+
+static void
+find_used_ia_colors (const guchar *pixels,
+                     gint          numpixels,
+                     gboolean     *ix_used)
+{
+  gint i;
 
   for (i = 0; i < 256; i++)
     ix_used[i] = FALSE;
@@ -512,6 +493,19 @@ find_unused_ia_color (const guchar *pixels,
       if (pixels[i * 2 + 1])
         ix_used[pixels[i * 2]] = TRUE;
     }
+}
+
+static gint
+find_unused_ia_color (const gboolean *ix_used,
+                      gint            num_indices,
+                      gint           *colors)
+{
+  gint i;
+
+#ifdef GIFDEBUG
+  g_printerr ("GIF: fuiac: Image claims to use %d/%d indices - finding free "
+              "index...\n", *colors, num_indices);
+#endif
 
   for (i = num_indices - 1; i >= 0; i--)
     {
@@ -576,6 +570,57 @@ special_flatten_indexed_alpha (guchar *pixels,
     }
 }
 
+static void
+gif_frames_find_used (gsize     offset,
+                      gsize     size,
+                      GifFrame *frames)
+{
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      GifFrame *frame = &frames[i];
+
+      if (frame->has_alpha)
+        find_used_ia_colors (frame->pixels,
+                             frame->width * frame->height,
+                             frame->ix_used);
+    }
+}
+
+static void
+gif_frames_compress (gsize     offset,
+                     gsize     size,
+                     GifFrame *frames)
+{
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      GifFrame *frame = &frames[i];
+      gint      init_code_size;
+
+      if (frame->has_alpha)
+        special_flatten_indexed_alpha (frame->pixels,
+                                       frame->transparent,
+                                       frame->width * frame->height);
+
+      /*
+       * The initial code size
+       */
+      if (frame->bpp <= 1)
+        init_code_size = 2;
+      else
+        init_code_size = frame->bpp;
+
+      frame->data = compress (frame->pixels, frame->width, frame->height,
+                              frame->interlace, init_code_size + 1);
+
+      g_free (frame->pixels);
+      frame->pixels = NULL;
+    }
+}
+
 
 static gint
 parse_ms_tag (const gchar *str)
@@ -727,15 +772,19 @@ save_image (GFile   *file,
   guint          rows, cols;
   gint           BitsPerPixel;
   gint           liberalBPP = 0;
-  gint           useBPP     = 0;
   gint           colors;
   gint           i;
-  gint           transparent;
-  gint           offset_x, offset_y;
+  gint           j;
 
   gint32        *layers;
   gint           nlayers;
 
+  GifFrame      *frames;
+  gint           n_frames;
+  gint           batch_size;
+  gint           n_threads;
+  gboolean       success = TRUE;
+
   gboolean       is_gif89 = FALSE;
 
   gint           Delay89;
@@ -913,9 +962,8 @@ save_image (GFile   *file,
 
   cols = gimp_image_width (image_ID);
   rows = gimp_image_height (image_ID);
-  Interlace = gsvals.interlace;
   if (! gif_encode_header (output, is_gif89, cols, rows, bgindex,
-                           BitsPerPixel, Red, Green, Blue, get_pixel,
+                           BitsPerPixel, Red, Green, Blue,
                            error))
     return FALSE;
 
@@ -938,135 +986,182 @@ save_image (GFile   *file,
   /*** Now for each layer in the image, save an image in a compound GIF ***/
   /************************************************************************/
 
-  cur_progress = 0;
-  max_progress = nlayers * rows;
+  /* The frames are fetched in batches by the main thread, which is the
+   * only one that may talk to GIMP.  Their transparency is worked out
+   * and they are compressed in parallel, and then written out in order.
+   */
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  batch_size = 2 * MAX (n_threads, 1);
+  frames     = g_new0 (GifFrame, batch_size);
 
-  for (i = nlayers - 1; i >= 0; i--, cur_progress = (nlayers - i) * rows)
+  for (i = nlayers - 1; i >= 0; i -= n_frames)
     {
-      drawable_type = gimp_drawable_type (layers[i]);
-      buffer = gimp_drawable_get_buffer (layers[i]);
-      gimp_drawable_offsets (layers[i], &offset_x, &offset_y);
-      cols = gimp_drawable_width (layers[i]);
-      rows = gimp_drawable_height (layers[i]);
-      rowstride = cols;
+      n_frames = MIN (batch_size, i + 1);
 
-      pixels = g_new (guchar, (cols * rows *
-                               (((drawable_type == GIMP_INDEXEDA_IMAGE) ||
-                                 (drawable_type == GIMP_GRAYA_IMAGE)) ? 2 : 1)));
+      for (j = 0; j < n_frames; j++)
+        {
+          GifFrame *frame = &frames[j];
+          gint32    layer = layers[i - j];
 
-      gegl_buffer_get (buffer, GEGL_RECTANGLE (0, 0, cols, rows), 1.0,
-                       format, pixels,
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+          drawable_type = gimp_drawable_type (layer);
+          buffer = gimp_drawable_get_buffer (layer);
+          gimp_drawable_offsets (layer, &frame->offset_x, &frame->offset_y);
+          frame->width  = gimp_drawable_width (layer);
+          frame->height = gimp_drawable_height (layer);
 
-      /* sort out whether we need to do transparency jiggery-pokery */
-      if ((drawable_type == GIMP_INDEXEDA_IMAGE) ||
-          (drawable_type == GIMP_GRAYA_IMAGE))
-        {
-          /* Try to find an entry which isn't actually used in the
-           * image, for a transparency index.
-           */
+          frame->has_alpha = ((drawable_type == GIMP_INDEXEDA_IMAGE) ||
+                              (drawable_type == GIMP_GRAYA_IMAGE));
 
-          transparent =
-            find_unused_ia_color (pixels,
-                                   cols * rows,
-                                   bpp_to_colors (colors_to_bpp (colors)),
-                                   &colors);
+          frame->pixels = g_new (guchar, (frame->width * frame->height *
+                                          (frame->has_alpha ? 2 : 1)));
 
-          special_flatten_indexed_alpha (pixels,
-                                         transparent,
-                                         cols * rows);
-        }
-      else
-        {
-          transparent = -1;
-        }
+          gegl_buffer_get (buffer,
+                           GEGL_RECTANGLE (0, 0, frame->width, frame->height),
+                           1.0, format, frame->pixels,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-      BitsPerPixel = colors_to_bpp (colors);
+          g_object_unref (buffer);
 
-      if (BitsPerPixel != liberalBPP)
-        {
-          /* We were able to re-use an index within the existing
-           * bitspace, whereas the estimate in the header was
-           * pessimistic but still needs to be upheld...
-           */
-#ifdef GIFDEBUG
-          static gboolean onceonly = FALSE;
+          frame->interlace = (frame->height > 4) ? gsvals.interlace : 0;
 
-          if (! onceonly)
+          if (is_gif89)
             {
-              g_warning ("Promised %d bpp, pondered writing chunk with %d bpp!",
-                         liberalBPP, BitsPerPixel);
-              onceonly = TRUE;
+              if (i - j > 0 && ! gsvals.always_use_default_dispose)
+                {
+                  layer_name = gimp_item_get_name (layers[i - j - 1]);
+                  Disposal = parse_disposal_tag (layer_name);
+                  g_free (layer_name);
+                }
+              else
+                {
+                  Disposal = gsvals.default_dispose;
+                }
+
+              layer_name = gimp_item_get_name (layer);
+              Delay89 = parse_ms_tag (layer_name);
+              g_free (layer_name);
+
+              if (Delay89 < 0 || gsvals.always_use_default_delay)
+                Delay89 = (gsvals.default_delay + 5) / 10;
+              else
+                Delay89 = (Delay89 + 5) / 10;
+
+              /* don't allow a CPU-sucking completely 0-delay looping anim */
+              if ((nlayers > 1) && gsvals.loop && (Delay89 == 0))
+                {
+                  static gboolean onceonly = FALSE;
+
+                  if (! onceonly)
+                    {
+                      g_message (_("Delay inserted to prevent evil "
+                                   "CPU-sucking animation."));
+                      onceonly = TRUE;
+                    }
+
+                  Delay89 = 1;
+                }
+
+              frame->disposal = Disposal;
+              frame->delay89  = Delay89;
             }
-#endif
         }
 
-      useBPP = (BitsPerPixel > liberalBPP) ? BitsPerPixel : liberalBPP;
+      /* Find the indices used by the opaque pixels of each frame */
+      gegl_parallel_distribute_range (
+        n_frames, 1,
+        (GeglParallelDistributeRangeFunc) gif_frames_find_used,
+        frames);
 
-      if (is_gif89)
+      /* Picking the transparency index may add a color, which affects
+       * the following frames, so this is done in order.
+       */
+      for (j = 0; j < n_frames; j++)
         {
-          if (i > 0 && ! gsvals.always_use_default_dispose)
+          GifFrame *frame = &frames[j];
+
+          /* sort out whether we need to do transparency jiggery-pokery */
+          if (frame->has_alpha)
             {
-              layer_name = gimp_item_get_name (layers[i - 1]);
-              Disposal = parse_disposal_tag (layer_name);
-              g_free (layer_name);
+              /* Try to find an entry which isn't actually used in the
+               * image, for a transparency index.
+               */
+
+              frame->transparent =
+                find_unused_ia_color (frame->ix_used,
+                                      bpp_to_colors (colors_to_bpp (colors)),
+                                      &colors);
             }
           else
             {
-              Disposal = gsvals.default_dispose;
+              frame->transparent = -1;
             }
 
-          layer_name = gimp_item_get_name (layers[i]);
-          Delay89 = parse_ms_tag (layer_name);
-          g_free (layer_name);
-
-          if (Delay89 < 0 || gsvals.always_use_default_delay)
-            Delay89 = (gsvals.default_delay + 5) / 10;
-          else
-            Delay89 = (Delay89 + 5) / 10;
+          BitsPerPixel = colors_to_bpp (colors);
 
-          /* don't allow a CPU-sucking completely 0-delay looping anim */
-          if ((nlayers > 1) && gsvals.loop && (Delay89 == 0))
+          if (BitsPerPixel != liberalBPP)
             {
+              /* We were able to re-use an index within the existing
+               * bitspace, whereas the estimate in the header was
+               * pessimistic but still needs to be upheld...
+               */
+#ifdef GIFDEBUG
               static gboolean onceonly = FALSE;
 
               if (! onceonly)
                 {
-                  g_message (_("Delay inserted to prevent evil "
-                               "CPU-sucking animation."));
+                  g_warning ("Promised %d bpp, pondered writing chunk with %d bpp!",
+                             liberalBPP, BitsPerPixel);
                   onceonly = TRUE;
                 }
-
-              Delay89 = 1;
+#endif
             }
 
-          if (! gif_encode_graphic_control_ext (output,
-                                                Disposal, Delay89, nlayers,
-                                                cols, rows,
-                                                transparent,
-                                                useBPP,
-                                                get_pixel,
-                                                error))
-            return FALSE;
+          frame->bpp = (BitsPerPixel > liberalBPP) ? BitsPerPixel : liberalBPP;
         }
 
-      if (! gif_encode_image_data (output, cols, rows,
-                                   (rows > 4) ? gsvals.interlace : 0,
-                                   useBPP,
-                                   get_pixel,
-                                   offset_x, offset_y,
-                                   error))
-        return FALSE;
+      gegl_parallel_distribute_range (
+        n_frames, 1,
+        (GeglParallelDistributeRangeFunc) gif_frames_compress,
+        frames);
+
+      for (j = 0; j < n_frames; j++)
+        {
+          GifFrame *frame = &frames[j];
+
+          if (is_gif89)
+            {
+              if (! gif_encode_graphic_control_ext (output,
+                                                    frame->disposal,
+                                                    frame->delay89,
+                                                    nlayers,
+                                                    frame->transparent,
+                                                    error))
+                success = FALSE;
+            }
+
+          if (success && ! gif_encode_image_data (output, frame, error))
+            success = FALSE;
 
-      gimp_progress_update (1.0);
+          g_byte_array_free (frame->data, TRUE);
+          frame->data = NULL;
+        }
 
-      g_object_unref (buffer);
+      if (! success)
+        break;
 
-      g_free (pixels);
+      gimp_progress_update ((gdouble) (nlayers - i + n_frames - 1) /
+                            (gdouble) nlayers);
     }
 
+  g_free (frames);
   g_free (layers);
 
+  if (! success)
+    return FALSE;
+
   if (! gif_encode_close (output, error))
     return FALSE;
 
@@ -1385,14 +1480,6 @@ bpp_to_colors (gint bpp)
 
 
 
-static gint
-get_pixel (gint x,
-           gint y)
-{
-  return *(pixels + (rowstride * (long) y) + (long) x);
-}
-
-
 /*****************************************************************************
  *
  * GIFENCODE.C    - GIF Image compression interface
@@ -1402,98 +1489,6 @@ get_pixel (gint x,
  *
  *****************************************************************************/
 
-static gint  Width, Height;
-static gint  curx, cury;
-static glong CountDown;
-static gint  Pass = 0;
-
-/*
- * Bump the 'curx' and 'cury' to point to the next pixel
- */
-static void
-bump_pixel (void)
-{
-  /*
-   * Bump the current X position
-   */
-  curx++;
-
-  /*
-   * If we are at the end of a scan line, set curx back to the beginning
-   * If we are interlaced, bump the cury to the appropriate spot,
-   * otherwise, just increment it.
-   */
-  if (curx == Width)
-    {
-      cur_progress++;
-
-      if ((cur_progress % 20) == 0)
-        gimp_progress_update ((gdouble) cur_progress / (gdouble) max_progress);
-
-      curx = 0;
-
-      if (! Interlace)
-        ++cury;
-      else
-        {
-          switch (Pass)
-            {
-
-            case 0:
-              cury += 8;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 4;
-                }
-              break;
-
-            case 1:
-              cury += 8;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 2;
-                }
-              break;
-
-            case 2:
-              cury += 4;
-              if (cury >= Height)
-                {
-                  Pass++;
-                  cury = 1;
-                }
-              break;
-
-            case 3:
-              cury += 2;
-              break;
-            }
-        }
-    }
-}
-
-/*
- * Return the next pixel from the image
- */
-static gint
-gif_next_pixel (ifunptr getpixel)
-{
-  gint r;
-
-  if (CountDown == 0)
-    return EOF;
-
-  --CountDown;
-
-  r = (*getpixel) (curx, cury);
-
-  bump_pixel ();
-
-  return r;
-}
-
 /* public */
 
 static gboolean
@@ -1506,7 +1501,6 @@ gif_encode_header (GOutputStream *output,
                    gint           Red[],
                    gint           Green[],
                    gint           Blue[],
-                   ifunptr        get_pixel,
                    GError       **error)
 {
   gint B;
@@ -1517,26 +1511,11 @@ gif_encode_header (GOutputStream *output,
 
   ColorMapSize = 1 << BitsPerPixel;
 
-  RWidth = Width = GWidth;
-  RHeight = Height = GHeight;
+  RWidth = GWidth;
+  RHeight = GHeight;
 
   Resolution = BitsPerPixel;
 
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write the Magic header
    */
@@ -1603,31 +1582,9 @@ gif_encode_graphic_control_ext (GOutputStream *output,
                                 int            Disposal,
                                 int            Delay89,
                                 int            NumFramesInImage,
-                                int            GWidth,
-                                int            GHeight,
                                 int            Transparent,
-                                int            BitsPerPixel,
-                                ifunptr        get_pixel,
                                 GError       **error)
 {
-  Width = GWidth;
-  Height = GHeight;
-
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width *(long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-
   /*
    * Write out extension for transparent color index, if necessary.
    */
@@ -1672,48 +1629,19 @@ gif_encode_graphic_control_ext (GOutputStream *output,
 
 
 static gboolean
-gif_encode_image_data (GOutputStream *output,
-                       int            GWidth,
-                       int            GHeight,
-                       int            GInterlace,
-                       int            BitsPerPixel,
-                       ifunptr        get_pixel,
-                       gint           offset_x,
-                       gint           offset_y,
-                       GError       **error)
+gif_encode_image_data (GOutputStream   *output,
+                       const GifFrame  *frame,
+                       GError         **error)
 {
-  gint LeftOfs, TopOfs;
   gint InitCodeSize;
 
-  Interlace = GInterlace;
-
-  Width   = GWidth;
-  Height  = GHeight;
-  LeftOfs = (gint) offset_x;
-  TopOfs  = (gint) offset_y;
-
-  /*
-   * Calculate number of bits we are expecting
-   */
-  CountDown = (long) Width * (long) Height;
-
-  /*
-   * Indicate which pass we are on (if interlace)
-   */
-  Pass = 0;
-
   /*
    * The initial code size
    */
-  if (BitsPerPixel <= 1)
+  if (frame->bpp <= 1)
     InitCodeSize = 2;
   else
-    InitCodeSize = BitsPerPixel;
-
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
+    InitCodeSize = frame->bpp;
 
   /*
    * Write an Image separator
@@ -1725,16 +1653,16 @@ gif_encode_image_data (GOutputStream *output,
    * Write the Image header
    */
 
-  if (! put_word (output, LeftOfs, error) ||
-      ! put_word (output, TopOfs,  error) ||
-      ! put_word (output, Width,   error) ||
-      ! put_word (output, Height,  error))
+  if (! put_word (output, frame->offset_x, error) ||
+      ! put_word (output, frame->offset_y, error) ||
+      ! put_word (output, frame->width,    error) ||
+      ! put_word (output, frame->height,   error))
     return FALSE;
 
   /*
    * Write out whether or not the image is interlaced
    */
-  if (Interlace)
+  if (frame->interlace)
     {
       if (! put_byte (output, 0x40, error))
         return FALSE;
@@ -1752,9 +1680,11 @@ gif_encode_image_data (GOutputStream *output,
     return FALSE;
 
   /*
-   * Go and actually compress the data
+   * Write out the data, which was compressed beforehand
    */
-  if (! compress (output, InitCodeSize + 1, get_pixel, error))
+  if (! g_output_stream_write_all (output,
+                                   frame->data->data, frame->data->len,
+                                   NULL, NULL, error))
     return FALSE;
 
   /*
@@ -1763,28 +1693,6 @@ gif_encode_image_data (GOutputStream *output,
   if (! put_byte (output, 0, error))
     return FALSE;
 
-#if 0
-  /***************************/
-  Interlace = GInterlace;
-  Width = GWidth;
-  Height = GHeight;
-  LeftOfs = TopOfs = 0;
-
-  CountDown = (long) Width *(long) Height;
-  Pass = 0;
-  /*
-   * The initial code size
-   */
-  if (BitsPerPixel <= 1)
-    InitCodeSize = 2;
-  else
-    InitCodeSize = BitsPerPixel;
-  /*
-   * Set up the current x and y position
-   */
-  curx = cury = 0;
-#endif
-
   return TRUE;
 }
 
@@ -1909,37 +1817,58 @@ put_string (GOutputStream  *output,
  *
  */
 
-static gint n_bits;                /* number of bits/code */
-static gint maxbits = GIF_BITS;    /* user settable max # bits/code */
-static gint maxcode;               /* maximum code, given n_bits */
-static gint maxmaxcode = (gint) 1 << GIF_BITS;        /* should NEVER generate this code */
+static const gint maxbits = GIF_BITS;    /* user settable max # bits/code */
+static const gint maxmaxcode = (gint) 1 << GIF_BITS; /* should NEVER generate this code */
 #ifdef COMPATIBLE                /* But wrong! */
 #define MAXCODE(Mn_bits)        ((gint) 1 << (Mn_bits) - 1)
 #else /*COMPATIBLE */
 #define MAXCODE(Mn_bits)        (((gint) 1 << (Mn_bits)) - 1)
 #endif /*COMPATIBLE */
 
-static glong   htab[HSIZE];
-static gushort codetab[HSIZE];
-#define HashTabOf(i)       htab[i]
-#define CodeTabOf(i)    codetab[i]
+#define HashTabOf(i)    comp->htab[i]
+#define CodeTabOf(i)    comp->codetab[i]
 
 static const gint hsize = HSIZE; /* the original reason for this being
                                     variable was "for dynamic table sizing",
                                     but since it was never actually changed
                                     I made it const   --Adam. */
 
-static gint free_ent = 0;        /* first unused entry */
-
 /*
- * block compression parameters -- after all codes are used up,
- * and compression rate changes, start over.
+ * The compressor state.  It used to be a set of globals; it's kept
+ * per image now, so that several frames can be compressed at once.
  */
-static gint  clear_flg = 0;
+struct _GifCompressor
+{
+  GByteArray *data;               /* the compressed data sub-blocks */
+
+  glong       htab[HSIZE];
+  gushort     codetab[HSIZE];
+
+  gint        n_bits;             /* number of bits/code */
+  gint        maxcode;            /* maximum code, given n_bits */
+  gint        free_ent;           /* first unused entry */
 
-static gint  offset;
-static glong in_count  = 1;        /* length of input */
-static glong out_count = 0;        /* # of codes output (for debugging) */
+  /*
+   * block compression parameters -- after all codes are used up,
+   * and compression rate changes, start over.
+   */
+  gint        clear_flg;
+
+  gint        g_init_bits;
+
+  gint        ClearCode;
+  gint        EOFCode;
+
+  gulong      cur_accum;
+  gint        cur_bits;
+
+  /*
+   * Number of characters so far in this 'packet', and the storage for
+   * the packet accumulator
+   */
+  gint        a_count;
+  guchar      accum[256];
+};
 
 /*
  * compress stdin to stdout
@@ -1957,15 +1886,7 @@ static glong out_count = 0;        /* # of codes output (for debugging) */
  * questions about this implementation to ames!jaw.
  */
 
-static gint g_init_bits;
-
-static gint ClearCode;
-static gint EOFCode;
-
-static gulong cur_accum;
-static gint   cur_bits;
-
-static gulong masks[] =
+static const gulong masks[] =
 {
   0x0000, 0x0001, 0x0003, 0x0007,
   0x000F, 0x001F, 0x003F, 0x007F,
@@ -1975,156 +1896,64 @@ static gulong masks[] =
 };
 
 
-static gboolean
-compress (GOutputStream  *output,
-          gint            init_bits,
-          ifunptr         ReadValue,
-          GError        **error)
-{
-  if (FALSE)
-    return no_compress (output, init_bits, ReadValue, error);
-  else if (FALSE)
-    return rle_compress (output, init_bits, ReadValue, error);
-  else
-    return normal_compress (output, init_bits, ReadValue, error);
-}
-
-static gboolean
-no_compress (GOutputStream  *output,
-             gint            init_bits,
-             ifunptr         ReadValue,
-             GError        **error)
-{
-  glong fcode;
-  gint  i /* = 0 */ ;
-  gint  c;
-  gint  ent;
-  gint  hsize_reg;
-  gint  hshift;
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   */
-  g_init_bits = init_bits;
-
-  cur_bits = 0;
-  cur_accum = 0;
-
-  /*
-   * Set up the necessary values
-   */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
-
-  /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
-
-
-  char_init();
-
-  ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
-
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
-
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
-    {
-      ++in_count;
-
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
-
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
-
-      ++out_count;
-      ent = c;
-
-      if (free_ent < maxmaxcode)
-        {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        {
-          if (! cl_block (output, error))
-            return FALSE;
-        }
-    }
-
-  /*
-   * Put out the final code.
-   */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
-
-  ++out_count;
-
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
-
-  return TRUE;
-}
-
-static gboolean
-rle_compress (GOutputStream  *output,
-              gint            init_bits,
-              ifunptr         ReadValue,
-              GError        **error)
+/*
+ * Compress the width x height indexed pixels, in interlaced row order
+ * if requested, and return the data as GIF sub-blocks, without the
+ * terminating zero-length block.
+ */
+static GByteArray *
+compress (const guchar *pixels,
+          gint          width,
+          gint          height,
+          gboolean      interlace,
+          gint          init_bits)
 {
-  glong fcode;
-  gint  i /* = 0 */ ;
-  gint  c, last;
-  gint  ent;
-  gint  disp;
-  gint  hsize_reg;
-  gint  hshift;
+  static const gint  pass_start[] = { 0, 4, 2, 1 };
+  static const gint  pass_step[]  = { 8, 8, 4, 2 };
+  GifCompressor     *comp;
+  GByteArray        *data;
+  glong              fcode;
+  gint               i /* = 0 */ ;
+  gint               c;
+  gint               ent;
+  gint               disp;
+  gint               hsize_reg;
+  gint               hshift;
+  gint               n_passes;
+  gint               pass;
+  gint               x;
+  gint               y;
+  gboolean           first = TRUE;
+
+  comp = g_new (GifCompressor, 1);
+
+  comp->data = g_byte_array_sized_new (width * height / 2 + 256);
 
   /*
-   * Set up the globals:  g_init_bits - initial number of bits
+   * Set up the state:  g_init_bits - initial number of bits
    */
-  g_init_bits = init_bits;
+  comp->g_init_bits = init_bits;
 
-  cur_bits = 0;
-  cur_accum = 0;
+  comp->cur_bits = 0;
+  comp->cur_accum = 0;
 
   /*
    * Set up the necessary values
    */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
+  comp->clear_flg = 0;
 
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
+  comp->ClearCode = (1 << (init_bits - 1));
+  comp->EOFCode = comp->ClearCode + 1;
+  comp->free_ent = comp->ClearCode + 2;
 
 
   /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
+  comp->n_bits = comp->g_init_bits;
+  comp->maxcode = MAXCODE (comp->n_bits);
 
+  comp->a_count = 0;
 
-  char_init ();
-
-  last = ent = gif_next_pixel (ReadValue);
+  ent = 0;
 
   hshift = 0;
   for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
@@ -2132,189 +1961,85 @@ rle_compress (GOutputStream  *output,
   hshift = 8 - hshift;                /* set hash code range bound */
 
   hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
+  cl_hash (comp);        /* clear hash table */
 
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
+  output_code (comp, (gint) comp->ClearCode);
 
+  n_passes = interlace ? G_N_ELEMENTS (pass_start) : 1;
 
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
+  for (pass = 0; pass < n_passes; pass++)
     {
-      ++in_count;
-
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
-
-
-      if (last == c) {
-        if (HashTabOf (i) == fcode)
-          {
-            ent = CodeTabOf (i);
-            continue;
-          }
-        else if ((long) HashTabOf (i) < 0)        /* empty slot */
-          goto nomatch;
-        disp = hsize_reg - i;        /* secondary hash (after G. Knott) */
-        if (i == 0)
-          disp = 1;
-      probe:
-        if ((i -= disp) < 0)
-          i += hsize_reg;
-
-        if (HashTabOf (i) == fcode)
-          {
-            ent = CodeTabOf (i);
-            continue;
-          }
-        if ((long) HashTabOf (i) > 0)
-          goto probe;
-        }
-    nomatch:
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
+      gint start = interlace ? pass_start[pass] : 0;
+      gint step  = interlace ? pass_step[pass]  : 1;
 
-      ++out_count;
-      last = ent = c;
-      if (free_ent < maxmaxcode)
+      for (y = start; y < height; y += step)
         {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        {
-          if (! cl_block (output, error))
-            return FALSE;
-        }
-    }
-
-  /*
-   * Put out the final code.
-   */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
-
-  ++out_count;
-
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
-
-  return TRUE;
-}
-
-static gboolean
-normal_compress (GOutputStream  *output,
-                 gint            init_bits,
-                 ifunptr         ReadValue,
-                 GError        **error)
-{
-  glong fcode;
-  gint  i /* = 0 */ ;
-  gint  c;
-  gint  ent;
-  gint  disp;
-  gint  hsize_reg;
-  gint  hshift;
-
-  /*
-   * Set up the globals:  g_init_bits - initial number of bits
-   */
-  g_init_bits = init_bits;
-
-  cur_bits = 0;
-  cur_accum = 0;
-
-  /*
-   * Set up the necessary values
-   */
-  offset = 0;
-  out_count = 0;
-  clear_flg = 0;
-  in_count = 1;
-
-  ClearCode = (1 << (init_bits - 1));
-  EOFCode = ClearCode + 1;
-  free_ent = ClearCode + 2;
-
-
-  /* Had some problems here... should be okay now.  --Adam */
-  n_bits = g_init_bits;
-  maxcode = MAXCODE (n_bits);
-
-
-  char_init();
-
-  ent = gif_next_pixel (ReadValue);
-
-  hshift = 0;
-  for (fcode = (long) hsize; fcode < 65536L; fcode *= 2L)
-    ++hshift;
-  hshift = 8 - hshift;                /* set hash code range bound */
-
-  hsize_reg = hsize;
-  cl_hash ((glong) hsize_reg);        /* clear hash table */
-
-  if (! output_code (output, (gint) ClearCode, error))
-    return FALSE;
+          const guchar *row = pixels + (gsize) y * width;
 
+          for (x = 0; x < width; x++)
+            {
+              c = row[x];
 
-  while ((c = gif_next_pixel (ReadValue)) != EOF)
-    {
-      ++in_count;
+              if (first)
+                {
+                  ent = c;
+                  first = FALSE;
+                  continue;
+                }
 
-      fcode = (long) (((long) c << maxbits) + ent);
-      i = (((gint) c << hshift) ^ ent);        /* xor hashing */
+              fcode = (long) (((long) c << maxbits) + ent);
+              i = (((gint) c << hshift) ^ ent);        /* xor hashing */
 
-      if (HashTabOf (i) == fcode)
-        {
-          ent = CodeTabOf (i);
-          continue;
-        }
-      else if ((long) HashTabOf (i) < 0)        /* empty slot */
-        goto nomatch;
-      disp = hsize_reg - i;        /* secondary hash (after G. Knott) */
-      if (i == 0)
-        disp = 1;
-    probe:
-      if ((i -= disp) < 0)
-        i += hsize_reg;
-
-      if (HashTabOf (i) == fcode)
-        {
-          ent = CodeTabOf (i);
-          continue;
-        }
-      if ((long) HashTabOf (i) > 0)
-        goto probe;
-    nomatch:
-      if (! output_code (output, (gint) ent, error))
-        return FALSE;
+              if (HashTabOf (i) == fcode)
+                {
+                  ent = CodeTabOf (i);
+                  continue;
+                }
+              else if ((long) HashTabOf (i) < 0)        /* empty slot */
+                goto nomatch;
+              disp = hsize_reg - i;        /* secondary hash (after G. Knott) */
+              if (i == 0)
+                disp = 1;
+            probe:
+              if ((i -= disp) < 0)
+                i += hsize_reg;
+
+              if (HashTabOf (i) == fcode)
+                {
+                  ent = CodeTabOf (i);
+                  continue;
+                }
+              if ((long) HashTabOf (i) > 0)
+                goto probe;
+            nomatch:
+              output_code (comp, (gint) ent);
 
-      ++out_count;
-      ent = c;
-      if (free_ent < maxmaxcode)
-        {
-          CodeTabOf (i) = free_ent++;        /* code -> hashtable */
-          HashTabOf (i) = fcode;
-        }
-      else
-        {
-          if (! cl_block (output, error))
-            return FALSE;
+              ent = c;
+              if (comp->free_ent < maxmaxcode)
+                {
+                  CodeTabOf (i) = comp->free_ent++;        /* code -> hashtable */
+                  HashTabOf (i) = fcode;
+                }
+              else
+                {
+                  cl_block (comp);
+                }
+            }
         }
     }
 
   /*
    * Put out the final code.
    */
-  if (! output_code (output, (gint) ent, error))
-    return FALSE;
+  output_code (comp, (gint) ent);
 
-  ++out_count;
+  output_code (comp, (gint) comp->EOFCode);
 
-  if (! output_code (output, (gint) EOFCode, error))
-    return FALSE;
+  data = comp->data;
 
-  return TRUE;
+  g_free (comp);
+
+  return data;
 }
 
 
@@ -2326,7 +2051,7 @@ normal_compress (GOutputStream  *output,
  *      code:   A n_bits-bit integer.  If == -1, then EOF.  This assumes
  *              that n_bits =< (long)wordsize - 1.
  * Outputs:
- *      Outputs code to the file.
+ *      Outputs code to the compressor's data.
  * Assumptions:
  *      Chars are 8 bits long.
  * Algorithm:
@@ -2335,89 +2060,82 @@ normal_compress (GOutputStream  *output,
  * code in turn.  When the buffer fills up empty it and start over.
  */
 
-static gboolean
-output_code (GOutputStream  *output,
-             gint            code,
-             GError        **error)
+static void
+output_code (GifCompressor *comp,
+             gint           code)
 {
-  cur_accum &= masks[cur_bits];
+  comp->cur_accum &= masks[comp->cur_bits];
 
-  if (cur_bits > 0)
-    cur_accum |= ((long) code << cur_bits);
+  if (comp->cur_bits > 0)
+    comp->cur_accum |= ((long) code << comp->cur_bits);
   else
-    cur_accum = code;
+    comp->cur_accum = code;
 
-  cur_bits += n_bits;
+  comp->cur_bits += comp->n_bits;
 
-  while (cur_bits >= 8)
+  while (comp->cur_bits >= 8)
     {
-      if (! char_out (output, (guchar) (cur_accum & 0xff), error))
-        return FALSE;
+      char_out (comp, (guchar) (comp->cur_accum & 0xff));
 
-      cur_accum >>= 8;
-      cur_bits -= 8;
+      comp->cur_accum >>= 8;
+      comp->cur_bits -= 8;
     }
 
   /*
    * If the next entry is going to be too big for the code size,
    * then increase it, if possible.
    */
-  if (free_ent > maxcode || clear_flg)
+  if (comp->free_ent > comp->maxcode || comp->clear_flg)
     {
-      if (clear_flg)
+      if (comp->clear_flg)
         {
-          maxcode = MAXCODE (n_bits = g_init_bits);
-          clear_flg = 0;
+          comp->maxcode = MAXCODE (comp->n_bits = comp->g_init_bits);
+          comp->clear_flg = 0;
         }
       else
         {
-          ++n_bits;
-          if (n_bits == maxbits)
-            maxcode = maxmaxcode;
+          ++comp->n_bits;
+          if (comp->n_bits == maxbits)
+            comp->maxcode = maxmaxcode;
           else
-            maxcode = MAXCODE (n_bits);
+            comp->maxcode = MAXCODE (comp->n_bits);
         }
     }
 
-  if (code == EOFCode)
+  if (code == comp->EOFCode)
     {
       /*
        * At EOF, write the rest of the buffer.
        */
-      while (cur_bits > 0)
+      while (comp->cur_bits > 0)
         {
-          if (! char_out (output, (guchar) (cur_accum & 0xff), error))
-            return FALSE;
+          char_out (comp, (guchar) (comp->cur_accum & 0xff));
 
-          cur_accum >>= 8;
-          cur_bits -= 8;
+          comp->cur_accum >>= 8;
+          comp->cur_bits -= 8;
         }
 
-      if (! char_flush (output, error))
-        return FALSE;
+      char_flush (comp);
     }
-
-  return TRUE;
 }
 
 /*
  * Clear out the hash table
  */
-static gboolean
-cl_block (GOutputStream  *output,
-          GError        **error) /* table clear for block compress */
+static void
+cl_block (GifCompressor *comp) /* table clear for block compress */
 {
-  cl_hash ((glong) hsize);
-  free_ent = ClearCode + 2;
-  clear_flg = 1;
+  cl_hash (comp);
+  comp->free_ent = comp->ClearCode + 2;
+  comp->clear_flg = 1;
 
-  return output_code (output, (gint) ClearCode, error);
+  output_code (comp, (gint) comp->ClearCode);
 }
 
 static void
-cl_hash (glong hsize)        /* reset code table */
+cl_hash (GifCompressor *comp)        /* reset code table */
 {
-  glong *htab_p = htab + hsize;
+  glong *htab_p = comp->htab + hsize;
 
   long i;
   long m1 = -1;
@@ -2454,62 +2172,35 @@ cl_hash (glong hsize)        /* reset code table */
  * GIF Specific routines
  ******************************************************************************/
 
-/*
- * Number of characters so far in this 'packet'
- */
-static int a_count;
-
-/*
- * Set up the 'byte output' routine
- */
-static void
-char_init (void)
-{
-  a_count = 0;
-}
-
-/*
- * Define the storage for the packet accumulator
- */
-static char accum[256];
-
 /*
  * Add a character to the end of the current packet, and if it is 254
- * characters, flush the packet to disk.
+ * characters, flush the packet.
  */
-static gboolean
-char_out (GOutputStream  *output,
-          gint            c,
-          GError        **error)
+static void
+char_out (GifCompressor *comp,
+          gint           c)
 {
-  accum[a_count++] = c;
-
-  if (a_count >= 254)
-    return char_flush (output, error);
+  comp->accum[comp->a_count++] = c;
 
-  return TRUE;
+  if (comp->a_count >= 254)
+    char_flush (comp);
 }
 
 /*
- * Flush the packet to disk, and reset the accumulator
+ * Flush the packet to the compressed data, and reset the accumulator
  */
-static gboolean
-char_flush (GOutputStream  *output,
-            GError        **error)
+static void
+char_flush (GifCompressor *comp)
 {
-  if (a_count > 0)
+  if (comp->a_count > 0)
     {
-      if (! put_byte (output, a_count, error))
-        return FALSE;
+      guchar count = comp->a_count;
 
-      if (! g_output_stream_write_all (output, accum, a_count,
-                                       NULL, NULL, error))
-        return FALSE;
+      g_byte_array_append (comp->data, &count, 1);
+      g_byte_array_append (comp->data, comp->accum, comp->a_count);
 
-      a_count = 0;
+      comp->a_count = 0;
     }
-
-  return TRUE;
 }
 
 
@@ -41,6 +41,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
 #include <glib/gstdio.h>
@@ -49,6 +50,7 @@
 #include <libgimp/gimpui.h>
 
 #include <png.h>                /* PNG library definitions */
+#include <zlib.h>
 
 #include "libgimp/stdplugins-intl.h"
 
@@ -73,6 +75,9 @@
 
 #define PNG_DEFAULTS_PARASITE  "png-save-defaults"
 
+#define IDAT_CHUNK_SIZE        (128 * 1024) /* Uncompressed bytes per chunk */
+#define IDAT_WINDOW_SIZE       32768        /* Size of the deflate window */
+
 /*
  * Structures...
  */
@@ -143,6 +148,47 @@ typedef struct
 }
 PngGlobals;
 
+/* A compressed chunk of the image data */
+typedef struct
+{
+  guchar   *data;
+  gsize     size;
+  gsize     allocated;
+  uLong     adler;
+  gboolean  failed;
+}
+IdatChunk;
+
+/* Writes the image data of non-interlaced images, compressing it in
+ * independently deflated chunks, in parallel.
+ */
+typedef struct
+{
+  png_structp  pp;
+  gint         bit_depth;
+  gint         width;
+  gsize        rowbytes;
+  gint         filter_bpp;      /* Bytes per complete pixel, at least 1 */
+  gboolean     filter;          /* Use adaptive filtering */
+  gint         level;
+  gint         strategy;
+
+  gint         chunk_rows;      /* Rows per chunk */
+  gint         batch_rows;      /* Rows per batch of chunks */
+  gint         n_rows;          /* Rows in the current batch */
+  gint         n_chunks;        /* Chunks in the current batch */
+  gboolean     finish;          /* The current batch is the last one */
+
+  guchar      *raw;             /* Previous row, followed by the batch */
+  guchar      *filtered;        /* Window, followed by the filtered batch */
+  gsize        window;          /* Bytes of the window in use */
+
+  IdatChunk   *chunks;
+  gboolean     started;         /* The zlib header was written */
+  uLong        adler;
+}
+IdatWriter;
+
 
 /*
  * Local functions...
@@ -167,6 +213,23 @@ static gboolean  save_image                (const gchar      *filename,
                                             gboolean         *profile_saved,
                                             GError          **error);
 
+static IdatWriter * idat_writer_new        (png_structp       pp,
+                                            png_infop         info,
+                                            gint              level);
+static void      idat_writer_free          (IdatWriter       *writer);
+static gboolean  idat_writer_write_rows    (IdatWriter       *writer,
+                                            guchar          **rows,
+                                            gint              num);
+static gboolean  idat_writer_finish        (IdatWriter       *writer);
+static gboolean  idat_writer_flush         (IdatWriter       *writer,
+                                            gboolean          finish);
+static void      idat_writer_filter_range  (gsize             offset,
+                                            gsize             size,
+                                            IdatWriter       *writer);
+static void      idat_writer_deflate_range (gsize             offset,
+                                            gsize             size,
+                                            IdatWriter       *writer);
+
 static int       respin_cmap               (png_structp       pp,
                                             png_infop         info,
                                             guchar           *remap,
@@ -1504,6 +1567,7 @@ save_image (const gchar  *filename,
   guchar            remap[256];       /* Re-mapping for the palette */
 
   png_textp         text = NULL;
+  IdatWriter       *volatile writer = NULL; /* protected for setjmp() */
 
   out_linear = FALSE;
   space      = gimp_drawable_get_format (drawable_ID);
@@ -1616,6 +1680,9 @@ save_image (const gchar  *filename,
 
   if (setjmp (png_jmpbuf (pp)))
     {
+      if (writer)
+        idat_writer_free (writer);
+
       g_set_error (error, 0, 0,
                    _("Error while exporting '%s'. Could not export image."),
                    gimp_filename_to_utf8 (filename));
@@ -2072,6 +2139,14 @@ save_image (const gchar  *filename,
       bit_depth < 8)
     png_set_packing (pp);
 
+  /*
+   * Compress the image data of non-interlaced images in parallel, in
+   * independently deflated chunks...
+   */
+
+  if (! pngvals.interlaced)
+    writer = idat_writer_new (pp, info, pngvals.compression_level);
+
   /*
    * Allocate memory for "tile_height" rows and export the image...
    */
@@ -2169,7 +2244,15 @@ save_image (const gchar  *filename,
                 }
             }
 
-          png_write_rows (pp, pixels, num);
+          if (writer)
+            {
+              if (! idat_writer_write_rows (writer, pixels, num))
+                png_error (pp, "Could not compress image data");
+            }
+          else
+            {
+              png_write_rows (pp, pixels, num);
+            }
 
           gimp_progress_update (((double) pass + (double) end /
                                  (double) height) /
@@ -2179,7 +2262,26 @@ save_image (const gchar  *filename,
 
   gimp_progress_update (1.0);
 
-  png_write_end (pp, info);
+  if (writer)
+    {
+      gboolean success = idat_writer_finish (writer);
+
+      idat_writer_free (writer);
+      writer = NULL;
+
+      if (! success)
+        png_error (pp, "Could not compress image data");
+
+      /* png_write_end() insists on its own IDAT chunks, all the other
+       * chunks were written by png_write_info()
+       */
+      png_write_chunk (pp, (png_const_bytep) "IEND", NULL, 0);
+    }
+  else
+    {
+      png_write_end (pp, info);
+    }
+
   png_destroy_write_struct (&pp, &info);
 
   g_free (pixel);
@@ -2203,6 +2305,419 @@ save_image (const gchar  *filename,
   return TRUE;
 }
 
+/* Sets up the writing of the image data in chunks of at least
+ * IDAT_CHUNK_SIZE bytes, which are deflated independently, each using
+ * the end of the previous chunk as its dictionary, and form a single
+ * zlib stream, as in pigz.  Like libpng, we filter all the rows
+ * adaptively, except for indexed and low bit depth images.
+ */
+static IdatWriter *
+idat_writer_new (png_structp pp,
+                 png_infop   info,
+                 gint        level)
+{
+  IdatWriter *writer = g_slice_new0 (IdatWriter);
+  gint        channels;
+  gint        color_type;
+  gint        n_threads;
+
+  channels   = png_get_channels (pp, info);
+  color_type = png_get_color_type (pp, info);
+
+  writer->pp         = pp;
+  writer->bit_depth  = png_get_bit_depth (pp, info);
+  writer->width      = png_get_image_width (pp, info);
+  writer->rowbytes   = png_get_rowbytes (pp, info);
+  writer->filter_bpp = MAX (channels * writer->bit_depth / 8, 1);
+  writer->filter     = color_type != PNG_COLOR_TYPE_PALETTE &&
+                       writer->bit_depth >= 8;
+  writer->level      = level;
+  writer->strategy   = writer->filter ? Z_FILTERED : Z_DEFAULT_STRATEGY;
+
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  writer->chunk_rows = MAX (IDAT_CHUNK_SIZE / (writer->rowbytes + 1), 1);
+  writer->batch_rows = writer->chunk_rows * 2 * MAX (n_threads, 1);
+
+  /* The row before the first one is all zeros */
+  writer->raw      = g_malloc0 ((writer->batch_rows + 1) * writer->rowbytes);
+  writer->filtered = g_malloc (IDAT_WINDOW_SIZE +
+                               writer->batch_rows * (writer->rowbytes + 1));
+  writer->chunks   = g_new0 (IdatChunk, 2 * MAX (n_threads, 1));
+
+  writer->adler = adler32 (0, NULL, 0);
+
+  return writer;
+}
+
+static void
+idat_writer_free (IdatWriter *writer)
+{
+  gint i;
+
+  for (i = 0; i < writer->batch_rows / writer->chunk_rows; i++)
+    g_free (writer->chunks[i].data);
+
+  g_free (writer->chunks);
+  g_free (writer->filtered);
+  g_free (writer->raw);
+
+  g_slice_free (IdatWriter, writer);
+}
+
+static gboolean
+idat_writer_write_rows (IdatWriter  *writer,
+                        guchar     **rows,
+                        gint         num)
+{
+  gint i;
+
+  for (i = 0; i < num; i++)
+    {
+      const guchar *src;
+      gsize         k;
+      guchar       *dest;
+
+      /* Only compress full batches here, the last one has to end the
+       * stream
+       */
+      if (writer->n_rows == writer->batch_rows &&
+          ! idat_writer_flush (writer, FALSE))
+        {
+          return FALSE;
+        }
+
+      src  = rows[i];
+      dest = writer->raw + (writer->n_rows + 1) * writer->rowbytes;
+
+      /* Do what png_set_swap() and png_set_packing() do for us
+       * otherwise
+       */
+      if (writer->bit_depth == 16 && G_BYTE_ORDER == G_LITTLE_ENDIAN)
+        {
+          for (k = 0; k < writer->rowbytes; k += 2)
+            {
+              dest[k]     = src[k + 1];
+              dest[k + 1] = src[k];
+            }
+        }
+      else if (writer->bit_depth < 8)
+        {
+          gint per_byte = 8 / writer->bit_depth;
+
+          memset (dest, 0, writer->rowbytes);
+
+          for (k = 0; k < (gsize) writer->width; k++)
+            {
+              gint shift = 8 - writer->bit_depth * (k % per_byte + 1);
+
+              dest[k / per_byte] |= src[k] << shift;
+            }
+        }
+      else
+        {
+          memcpy (dest, src, writer->rowbytes);
+        }
+
+      writer->n_rows++;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+idat_writer_finish (IdatWriter *writer)
+{
+  return idat_writer_flush (writer, TRUE);
+}
+
+/* Filters and compresses the current batch, and writes it as IDAT
+ * chunks, ending the stream if this is the last batch.
+ */
+static gboolean
+idat_writer_flush (IdatWriter *writer,
+                   gboolean    finish)
+{
+  gsize stride = writer->rowbytes + 1;
+  gsize size;
+  gsize keep;
+  gint  i;
+
+  writer->n_chunks = (writer->n_rows + writer->chunk_rows - 1) /
+                     writer->chunk_rows;
+  writer->finish   = finish;
+
+  /* Chunks use the filtered data before them as their dictionary, so
+   * we need to filter the whole batch first
+   */
+  gegl_parallel_distribute_range (
+    writer->n_rows, writer->chunk_rows,
+    (GeglParallelDistributeRangeFunc) idat_writer_filter_range,
+    writer);
+
+  gegl_parallel_distribute_range (
+    writer->n_chunks, 1,
+    (GeglParallelDistributeRangeFunc) idat_writer_deflate_range,
+    writer);
+
+  for (i = 0; i < writer->n_chunks; i++)
+    {
+      if (writer->chunks[i].failed)
+        return FALSE;
+    }
+
+  for (i = 0; i < writer->n_chunks; i++)
+    {
+      IdatChunk *chunk = &writer->chunks[i];
+      guchar     header[2];
+      guchar     trailer[4];
+      gsize      header_size  = 0;
+      gsize      trailer_size = 0;
+      gint       rows;
+
+      rows = MIN (writer->n_rows - i * writer->chunk_rows, writer->chunk_rows);
+
+      writer->adler = adler32_combine (writer->adler, chunk->adler,
+                                       rows * stride);
+
+      if (! writer->started)
+        {
+          guint flevel;
+          guint cmf_flg;
+
+          /* The same compression level hint as zlib's */
+          if (writer->level < 2)
+            flevel = 0;
+          else if (writer->level < 6)
+            flevel = 1;
+          else if (writer->level == 6)
+            flevel = 2;
+          else
+            flevel = 3;
+
+          cmf_flg  = (0x78 << 8) | (flevel << 6);
+          cmf_flg += 31 - cmf_flg % 31;
+
+          header[0] = cmf_flg >> 8;
+          header[1] = cmf_flg & 0xff;
+
+          header_size = 2;
+
+          writer->started = TRUE;
+        }
+
+      if (finish && i == writer->n_chunks - 1)
+        {
+          trailer[0] = writer->adler >> 24;
+          trailer[1] = writer->adler >> 16;
+          trailer[2] = writer->adler >> 8;
+          trailer[3] = writer->adler;
+
+          trailer_size = 4;
+        }
+
+      png_write_chunk_start (writer->pp, (png_const_bytep) "IDAT",
+                             header_size + chunk->size + trailer_size);
+
+      if (header_size)
+        png_write_chunk_data (writer->pp, header, header_size);
+
+      png_write_chunk_data (writer->pp, chunk->data, chunk->size);
+
+      if (trailer_size)
+        png_write_chunk_data (writer->pp, trailer, trailer_size);
+
+      png_write_chunk_end (writer->pp);
+    }
+
+  /* Keep the end of the batch as the window of the next one, and its
+   * last row as the previous row of the next batch's first row
+   */
+  size = writer->n_rows * stride;
+  keep = MIN (writer->window + size, IDAT_WINDOW_SIZE);
+
+  memmove (writer->filtered + IDAT_WINDOW_SIZE - keep,
+           writer->filtered + IDAT_WINDOW_SIZE + size - keep,
+           keep);
+
+  writer->window = keep;
+
+  memcpy (writer->raw,
+          writer->raw + writer->n_rows * writer->rowbytes,
+          writer->rowbytes);
+
+  writer->n_rows = 0;
+
+  return TRUE;
+}
+
+static inline gint
+idat_paeth (gint a,
+            gint b,
+            gint c)
+{
+  gint pa = ABS (b - c);
+  gint pb = ABS (a - c);
+  gint pc = ABS (a + b - 2 * c);
+
+  if (pa <= pb && pa <= pc)
+    return a;
+  else if (pb <= pc)
+    return b;
+  else
+    return c;
+}
+
+/* Filters each row with the filter whose output has the smallest sum
+ * of absolute (signed) values, the same heuristic libpng uses.
+ */
+static void
+idat_writer_filter_range (gsize       offset,
+                          gsize       size,
+                          IdatWriter *writer)
+{
+  gsize   rowbytes = writer->rowbytes;
+  gsize   bpp      = writer->filter_bpp;
+  guchar *scratch  = NULL;
+  gsize   i;
+
+  if (writer->filter)
+    scratch = g_malloc (4 * rowbytes);
+
+  for (i = offset; i < offset + size; i++)
+    {
+      const guchar *prev = writer->raw + i * rowbytes;
+      const guchar *row  = prev + rowbytes;
+      guchar       *dest = writer->filtered + IDAT_WINDOW_SIZE +
+                           i * (rowbytes + 1);
+      const guchar *best = row;
+      guchar        type = PNG_FILTER_VALUE_NONE;
+
+      if (writer->filter)
+        {
+          guchar *sub   = scratch;
+          guchar *up    = scratch + rowbytes;
+          guchar *avg   = scratch + 2 * rowbytes;
+          guchar *paeth = scratch + 3 * rowbytes;
+          guint   sums[5] = { 0, };
+          gsize   k;
+          gint    j;
+
+          for (k = 0; k < rowbytes; k++)
+            {
+              gint a = k >= bpp ? row[k - bpp]  : 0;
+              gint b = prev[k];
+              gint c = k >= bpp ? prev[k - bpp] : 0;
+
+              sub[k]   = row[k] - a;
+              up[k]    = row[k] - b;
+              avg[k]   = row[k] - ((a + b) >> 1);
+              paeth[k] = row[k] - idat_paeth (a, b, c);
+
+              sums[0] += ABS ((gint8) row[k]);
+              sums[1] += ABS ((gint8) sub[k]);
+              sums[2] += ABS ((gint8) up[k]);
+              sums[3] += ABS ((gint8) avg[k]);
+              sums[4] += ABS ((gint8) paeth[k]);
+            }
+
+          for (j = 1; j < 5; j++)
+            {
+              if (sums[j] < sums[type])
+                type = j;
+            }
+
+          if (type != PNG_FILTER_VALUE_NONE)
+            best = scratch + (type - 1) * rowbytes;
+        }
+
+      dest[0] = type;
+      memcpy (dest + 1, best, rowbytes);
+    }
+
+  g_free (scratch);
+}
+
+static void
+idat_writer_deflate_range (gsize       offset,
+                           gsize       size,
+                           IdatWriter *writer)
+{
+  gsize stride = writer->rowbytes + 1;
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      IdatChunk    *chunk = &writer->chunks[i];
+      z_stream      strm  = { 0, };
+      const guchar *data;
+      gsize         data_size;
+      gsize         dict_size;
+      gsize         bound;
+      gint          first;
+      gint          rows;
+      gboolean      last;
+      gint          ret;
+
+      first = i * writer->chunk_rows;
+      rows  = MIN (writer->n_rows - first, writer->chunk_rows);
+      last  = writer->finish && i == (gsize) writer->n_chunks - 1;
+
+      data      = writer->filtered + IDAT_WINDOW_SIZE + first * stride;
+      data_size = rows * stride;
+      dict_size = MIN (writer->window + first * stride, IDAT_WINDOW_SIZE);
+
+      chunk->failed = TRUE;
+      chunk->size   = 0;
+      chunk->adler  = adler32 (adler32 (0, NULL, 0), data, data_size);
+
+      /* A raw deflate stream, the zlib header and trailer are written
+       * separately
+       */
+      if (deflateInit2 (&strm, writer->level, Z_DEFLATED, -MAX_WBITS, 8,
+                        writer->strategy) != Z_OK)
+        continue;
+
+      if (dict_size > 0)
+        deflateSetDictionary (&strm, data - dict_size, dict_size);
+
+      /* Leave room for the empty block of Z_SYNC_FLUSH */
+      bound = deflateBound (&strm, data_size) + 16;
+
+      if (chunk->allocated < bound)
+        {
+          g_free (chunk->data);
+
+          chunk->data      = g_try_malloc (bound);
+          chunk->allocated = chunk->data ? bound : 0;
+        }
+
+      if (chunk->data)
+        {
+          strm.next_in   = (Bytef *) data;
+          strm.avail_in  = data_size;
+          strm.next_out  = chunk->data;
+          strm.avail_out = chunk->allocated;
+
+          /* Non-final chunks end on a byte boundary, so that the next
+           * chunk can simply be appended
+           */
+          ret = deflate (&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+
+          if (last ? ret == Z_STREAM_END :
+                     ret == Z_OK && strm.avail_in == 0 && strm.avail_out > 0)
+            {
+              chunk->size   = strm.total_out;
+              chunk->failed = FALSE;
+            }
+        }
+
+      deflateEnd (&strm);
+    }
+}
+
 static gboolean
 ia_has_transparent_pixels (GeglBuffer *buffer)
 {
@@ -33,6 +33,7 @@
 #include <string.h>
 #include <math.h>
 #include <glib.h>
+#include <gegl.h>
 
 #include "dds.h"
 #include "dxt.h"
@@ -1016,152 +1017,141 @@ encode_alpha_block_BC3 (unsigned char       *dst,
 #define BLOCK_COUNT(w, h)          ((((h) + 3) >> 2) * (((w) + 3) >> 2))
 #define BLOCK_OFFSET(x, y, w, bs)  (((y) >> 2) * ((bs) * (((w) + 3) >> 2)) + ((bs) * ((x) >> 2)))
 
+typedef struct
+{
+  unsigned char       *dst;
+  const unsigned char *src;
+  int                  w;
+  int                  h;
+  int                  flags;
+} compress_data_t;
+
+typedef void (*compressfunc_t)(gsize, gsize, const compress_data_t *);
+
+/* the compression functions encode a range of blocks each, the blocks
+ * are independent of each other, so that the result doesn't depend on
+ * how they are distributed over threads
+ */
+
 static void
-compress_BC1 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h,
-              int                  flags)
+compress_BC1 (gsize                  offset,
+              gsize                  size,
+              const compress_data_t *data)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
+  const int w = data->w;
+  gsize i;
   unsigned char block[64], *p;
   int x, y;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  for (i = offset; i < offset + size; ++i)
     {
       x = (i % ((w + 3) >> 2)) << 2;
       y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 8);
-      extract_block(src, x, y, w, h, block);
-      encode_color_block(p, block, DXT_BC1 | flags);
+      p = data->dst + BLOCK_OFFSET(x, y, w, 8);
+      extract_block(data->src, x, y, w, data->h, block);
+      encode_color_block(p, block, DXT_BC1 | data->flags);
     }
 }
 
 static void
-compress_BC2 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h,
-              int                  flags)
+compress_BC2 (gsize                  offset,
+              gsize                  size,
+              const compress_data_t *data)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
+  const int w = data->w;
+  gsize i;
   unsigned char block[64], *p;
   int x, y;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  for (i = offset; i < offset + size; ++i)
     {
       x = (i % ((w + 3) >> 2)) << 2;
       y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
+      p = data->dst + BLOCK_OFFSET(x, y, w, 16);
+      extract_block(data->src, x, y, w, data->h, block);
       encode_alpha_block_BC2(p, block);
-      encode_color_block(p + 8, block, DXT_BC2 | flags);
+      encode_color_block(p + 8, block, DXT_BC2 | data->flags);
     }
 }
 
 static void
-compress_BC3 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h,
-              int                  flags)
+compress_BC3 (gsize                  offset,
+              gsize                  size,
+              const compress_data_t *data)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
+  const int w = data->w;
+  gsize i;
   unsigned char block[64], *p;
   int x, y;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  for (i = offset; i < offset + size; ++i)
     {
       x = (i % ((w + 3) >> 2)) << 2;
       y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
+      p = data->dst + BLOCK_OFFSET(x, y, w, 16);
+      extract_block(data->src, x, y, w, data->h, block);
       encode_alpha_block_BC3(p, block, 0);
-      encode_color_block(p + 8, block, DXT_BC3 | flags);
+      encode_color_block(p + 8, block, DXT_BC3 | data->flags);
     }
 }
 
 static void
-compress_BC4 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h)
+compress_BC4 (gsize                  offset,
+              gsize                  size,
+              const compress_data_t *data)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
+  const int w = data->w;
+  gsize i;
   unsigned char block[64], *p;
   int x, y;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  for (i = offset; i < offset + size; ++i)
     {
       x = (i % ((w + 3) >> 2)) << 2;
       y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 8);
-      extract_block(src, x, y, w, h, block);
+      p = data->dst + BLOCK_OFFSET(x, y, w, 8);
+      extract_block(data->src, x, y, w, data->h, block);
       encode_alpha_block_BC3(p, block, -1);
     }
 }
 
 static void
-compress_BC5 (unsigned char       *dst,
-              const unsigned char *src,
-              int                  w,
-              int                  h)
+compress_BC5 (gsize                  offset,
+              gsize                  size,
+              const compress_data_t *data)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
+  const int w = data->w;
+  gsize i;
   unsigned char block[64], *p;
   int x, y;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  for (i = offset; i < offset + size; ++i)
     {
       x = (i % ((w + 3) >> 2)) << 2;
       y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
+      p = data->dst + BLOCK_OFFSET(x, y, w, 16);
+      extract_block(data->src, x, y, w, data->h, block);
       encode_alpha_block_BC3(p, block, -2);
       encode_alpha_block_BC3(p + 8, block, -1);
     }
 }
 
 static void
-compress_YCoCg (unsigned char       *dst,
-                const unsigned char *src,
-                int                  w,
-                int                  h)
+compress_YCoCg (gsize                  offset,
+                gsize                  size,
+                const compress_data_t *data)
 {
-  const unsigned int block_count = BLOCK_COUNT(w, h);
-  unsigned int i;
+  const int w = data->w;
+  gsize i;
   unsigned char block[64], *p;
   int x, y;
 
-#ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic, 256) private(block, p, x, y)
-#endif
-  for (i = 0; i < block_count; ++i)
+  for (i = offset; i < offset + size; ++i)
     {
       x = (i % ((w + 3) >> 2)) << 2;
       y = (i / ((w + 3) >> 2)) << 2;
-      p = dst + BLOCK_OFFSET(x, y, w, 16);
-      extract_block(src, x, y, w, h, block);
+      p = data->dst + BLOCK_OFFSET(x, y, w, 16);
+      extract_block(data->src, x, y, w, data->h, block);
       encode_alpha_block_BC3(p, block, 0);
       encode_YCoCg_block(p + 8, block);
     }
@@ -1182,6 +1172,8 @@ dxt_compress (unsigned char *dst,
   unsigned char *tmp = NULL;
   int j;
   unsigned char *s;
+  compressfunc_t compress_func;
+  compress_data_t data;
 
   if (bpp == 1)
     {
@@ -1236,6 +1228,35 @@ dxt_compress (unsigned char *dst,
       bpp = 4;
     }
 
+  switch (format)
+    {
+    case DDS_COMPRESS_BC1:
+      compress_func = compress_BC1;
+      break;
+    case DDS_COMPRESS_BC2:
+      compress_func = compress_BC2;
+      break;
+    case DDS_COMPRESS_BC3:
+    case DDS_COMPRESS_BC3N:
+    case DDS_COMPRESS_RXGB:
+    case DDS_COMPRESS_AEXP:
+    case DDS_COMPRESS_YCOCG:
+      compress_func = compress_BC3;
+      break;
+    case DDS_COMPRESS_BC4:
+      compress_func = compress_BC4;
+      break;
+    case DDS_COMPRESS_BC5:
+      compress_func = compress_BC5;
+      break;
+    case DDS_COMPRESS_YCOCGS:
+      compress_func = compress_YCoCg;
+      break;
+    default:
+      compress_func = compress_BC3;
+      break;
+    }
+
   offset = 0;
   w = width;
   h = height;
@@ -1243,34 +1264,16 @@ dxt_compress (unsigned char *dst,
 
   for (i = 0; i < mipmaps; ++i)
     {
-      switch (format)
-        {
-        case DDS_COMPRESS_BC1:
-          compress_BC1(dst + offset, s, w, h, flags);
-          break;
-        case DDS_COMPRESS_BC2:
-          compress_BC2(dst + offset, s, w, h, flags);
-          break;
-        case DDS_COMPRESS_BC3:
-        case DDS_COMPRESS_BC3N:
-        case DDS_COMPRESS_RXGB:
-        case DDS_COMPRESS_AEXP:
-        case DDS_COMPRESS_YCOCG:
-          compress_BC3(dst + offset, s, w, h, flags);
-          break;
-        case DDS_COMPRESS_BC4:
-          compress_BC4(dst + offset, s, w, h);
-          break;
-        case DDS_COMPRESS_BC5:
-          compress_BC5(dst + offset, s, w, h);
-          break;
-        case DDS_COMPRESS_YCOCGS:
-          compress_YCoCg(dst + offset, s, w, h);
-          break;
-        default:
-          compress_BC3(dst + offset, s, w, h, flags);
-          break;
-        }
+      data.dst   = dst + offset;
+      data.src   = s;
+      data.w     = w;
+      data.h     = h;
+      data.flags = flags;
+
+      gegl_parallel_distribute_range (BLOCK_COUNT(w, h), 256,
+                                      (GeglParallelDistributeRangeFunc) compress_func,
+                                      &data);
+
       s += (w * h * bpp);
       offset += get_mipmapped_size(w, h, 0, 0, 1, format);
       w = MAX(1, w >> 1);
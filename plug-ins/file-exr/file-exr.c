@@ -28,6 +28,8 @@
 #define PLUG_IN_BINARY  "file-exr"
 #define PLUG_IN_VERSION "0.0.0"
 
+#define MAX_BAND_SIZE   (64 * 1024 * 1024) /* Bytes read at once */
+
 
 /*
  * Declare some local functions.
@@ -160,18 +162,17 @@ load_image (const gchar  *filename,
   EXRLoader        *loader;
   gint              width;
   gint              height;
-  gboolean          has_alpha;
   GimpImageBaseType image_type;
   GimpPrecision     image_precision;
   gint32            image = -1;
-  GimpImageType     layer_type;
-  gint32            layer;
-  const Babl       *format;
   GeglBuffer       *buffer = NULL;
-  gint              bpp;
+  gint              n_threads;
+  gint              n_layers;
   gint              tile_height;
   gchar            *pixels = NULL;
-  gint              begin;
+  gint              total_rows;
+  gint              done_rows;
+  gint              i;
   gint32            success = FALSE;
   gchar            *comment = NULL;
   GimpColorProfile *profile = NULL;
@@ -183,7 +184,11 @@ load_image (const gchar  *filename,
   gimp_progress_init_printf (_("Opening '%s'"),
                              gimp_filename_to_utf8 (filename));
 
-  loader = exr_loader_new (filename);
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  loader = exr_loader_new (filename, n_threads);
 
   if (! loader)
     {
@@ -204,8 +209,6 @@ load_image (const gchar  *filename,
       goto out;
     }
 
-  has_alpha = exr_loader_has_alpha (loader) ? TRUE : FALSE;
-
   switch (exr_loader_get_precision (loader))
     {
     case PREC_UINT:
@@ -228,11 +231,9 @@ load_image (const gchar  *filename,
     {
     case IMAGE_TYPE_RGB:
       image_type = GIMP_RGB;
-      layer_type = has_alpha ? GIMP_RGBA_IMAGE : GIMP_RGB_IMAGE;
       break;
     case IMAGE_TYPE_GRAY:
       image_type = GIMP_GRAY;
-      layer_type = has_alpha ? GIMP_GRAYA_IMAGE : GIMP_GRAY_IMAGE;
       break;
     default:
       g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
@@ -264,47 +265,94 @@ load_image (const gchar  *filename,
         gimp_image_set_color_profile (image, profile);
     }
 
-  layer = gimp_layer_new (image, _("Background"), width, height,
-                          layer_type, 100,
-                          gimp_image_get_default_new_layer_mode (image));
-  gimp_image_insert_layer (image, layer, -1, 0);
-
-  buffer = gimp_drawable_get_buffer (layer);
-  format = gimp_drawable_get_format (layer);
-  bpp = babl_format_get_bytes_per_pixel (format);
-
+  /* every part of the file, and every layer of channels in it, becomes
+   * a layer, the first one on top
+   */
+  n_layers    = exr_loader_get_n_layers (loader);
   tile_height = gimp_tile_height ();
-  pixels = g_new0 (gchar, tile_height * width * bpp);
+  total_rows  = 0;
+  done_rows   = 0;
 
-  for (begin = 0; begin < height; begin += tile_height)
+  for (i = 0; i < n_layers; i++)
     {
-      gint end;
-      gint num;
-      gint i;
+      gint x, y;
+      gint layer_width;
+      gint layer_height;
+
+      exr_loader_get_layer_bounds (loader, i,
+                                   &x, &y, &layer_width, &layer_height);
 
-      end = MIN (begin + tile_height, height);
-      num = end - begin;
+      total_rows += layer_height;
+    }
 
-      for (i = 0; i < num; i++)
+  for (i = 0; i < n_layers; i++)
+    {
+      const gchar   *name = exr_loader_get_layer_name (loader, i);
+      GimpImageType  layer_type;
+      gint32         layer;
+      const Babl    *format;
+      gint           x, y;
+      gint           layer_width;
+      gint           layer_height;
+      gint           bpp;
+      gint           block_height;
+      gint           band_height;
+      gint           begin;
+
+      exr_loader_get_layer_bounds (loader, i,
+                                   &x, &y, &layer_width, &layer_height);
+
+      if (exr_loader_layer_has_alpha (loader, i))
+        layer_type = image_type == GIMP_RGB ? GIMP_RGBA_IMAGE : GIMP_GRAYA_IMAGE;
+      else
+        layer_type = image_type == GIMP_RGB ? GIMP_RGB_IMAGE : GIMP_GRAY_IMAGE;
+
+      layer = gimp_layer_new (image, *name ? name : _("Background"),
+                              layer_width, layer_height,
+                              layer_type, 100,
+                              gimp_image_get_default_new_layer_mode (image));
+      gimp_layer_set_offsets (layer, x, y);
+      gimp_image_insert_layer (image, layer, -1, i);
+
+      buffer = gimp_drawable_get_buffer (layer);
+      format = gimp_drawable_get_format (layer);
+      bpp    = babl_format_get_bytes_per_pixel (format);
+
+      /* read bands of whole scanline blocks or tiles, which are decoded
+       * by OpenEXR's thread pool, and large enough to keep it busy
+       */
+      block_height = MAX (exr_loader_get_layer_block_height (loader, i), 1);
+      band_height  = MAX (tile_height, 2 * n_threads * block_height);
+      band_height  = MIN (band_height,
+                          MAX (MAX_BAND_SIZE / (layer_width * bpp), 1));
+      band_height  = MAX (band_height / block_height, 1) * block_height;
+
+      g_free (pixels);
+      pixels = g_new0 (gchar, (gsize) band_height * layer_width * bpp);
+
+      for (begin = 0; begin < layer_height; begin += band_height)
         {
-          gint retval;
+          gint num = MIN (band_height, layer_height - begin);
 
-          retval = exr_loader_read_pixel_row (loader,
-                                              pixels + (i * width * bpp),
-                                              bpp, begin + i);
-          if (retval < 0)
+          if (exr_loader_read_pixel_rows (loader, i,
+                                          pixels, bpp, begin, num) < 0)
             {
               g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                            _("Error reading pixel data from '%s'"),
                            gimp_filename_to_utf8 (filename));
               goto out;
             }
-        }
 
-      gegl_buffer_set (buffer, GEGL_RECTANGLE (0, begin, width, num),
-                       0, NULL, pixels, GEGL_AUTO_ROWSTRIDE);
+          gegl_buffer_set (buffer,
+                           GEGL_RECTANGLE (0, begin, layer_width, num),
+                           0, NULL, pixels, GEGL_AUTO_ROWSTRIDE);
+
+          done_rows += num;
+
+          gimp_progress_update ((gdouble) done_rows / (gdouble) total_rows);
+        }
 
-      gimp_progress_update ((gdouble) begin / (gdouble) height);
+      g_clear_object (&buffer);
     }
 
   /* try to read the file comment */
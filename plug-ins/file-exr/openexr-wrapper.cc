@@ -17,7 +17,10 @@
 
 #include "config.h"
 
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <lcms2.h>
 
@@ -51,8 +54,11 @@
 /* ignore deprecated warnings from OpenEXR headers */
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated"
-#include <ImfInputFile.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfInputPart.h>
+#include <ImfPartType.h>
 #include <ImfChannelList.h>
+#include <ImfThreading.h>
 #include <ImfRgbaFile.h>
 #include <ImfRgbaYca.h>
 #include <ImfStandardAttributes.h>
@@ -74,119 +80,234 @@ static bool XYZ_equal(cmsCIEXYZ *a, cmsCIEXYZ *b)
          fabs ((a->Z / a->Y * b->Y) - b->Z) < epsilon;
 }
 
+/* A set of channels that is loaded as one GIMP layer: the R, G, B (or
+ * Y) and A channels of a layer, in the EXR sense, of one of the parts
+ */
+struct EXRLayer
+{
+  int part;
+  std::string name;
+  std::string prefix;
+  Box2i data_window;
+  EXRImageType image_type;
+  PixelType pt;
+  bool has_alpha;
+  int block_height;
+};
+
 struct _EXRLoader
 {
-  _EXRLoader(const char* filename) :
+  _EXRLoader(const char* filename,
+             int n_threads) :
     refcount_(1),
-    file_(filename),
-    data_window_(file_.header().dataWindow()),
-    channels_(file_.header().channels())
+    file_(filename, n_threads)
   {
-    const Channel* chan;
-
-    if (channels_.findChannel("R") ||
-        channels_.findChannel("G") ||
-        channels_.findChannel("B"))
+    for (int i = 0; i < file_.parts(); i++)
       {
-        format_string_ = "RGB";
-        image_type_ = IMAGE_TYPE_RGB;
+        const Header& header = file_.header(i);
+        std::set<std::string> layer_names;
 
-        if ((chan = channels_.findChannel("R")))
-          pt_ = chan->type;
-        else if ((chan = channels_.findChannel("G")))
-          pt_ = chan->type;
-        else
-          pt_ = channels_.findChannel("B")->type;
-      }
-    else if (channels_.findChannel("Y") &&
-             (channels_.findChannel("RY") ||
-              channels_.findChannel("BY")))
-      {
-        format_string_ = "RGB";
-        image_type_ = IMAGE_TYPE_RGB;
+        // deep data doesn't fit into a flat frame buffer
+        if (header.hasType() && isDeepData(header.type()))
+          continue;
 
-        pt_ = channels_.findChannel("Y")->type;
+        addLayer(i, header, "");
 
-        // FIXME: no chroma handling for now.
-        throw;
-      }
-    else if (channels_.findChannel("Y"))
-      {
-        format_string_ = "Y";
-        image_type_ = IMAGE_TYPE_GRAY;
+        header.channels().layers(layer_names);
 
-        pt_ = channels_.findChannel("Y")->type;
-      }
-    else
-      {
-        throw;
+        for (std::set<std::string>::const_iterator name = layer_names.begin();
+             name != layer_names.end();
+             ++name)
+          {
+            addLayer(i, header, *name + ".");
+          }
       }
 
-    if (channels_.findChannel("A"))
-      {
-        format_string_.append("A");
-        has_alpha_ = true;
-      }
-    else
+    if (layers_.empty())
+      throw std::runtime_error("no loadable channels");
+
+    // the image spans the data windows of all the layers, which are
+    // gray only if all of them are
+    data_window_ = layers_[0].data_window;
+    image_type_ = IMAGE_TYPE_GRAY;
+    pt_ = layers_[0].pt;
+
+    for (size_t i = 0; i < layers_.size(); i++)
       {
-        has_alpha_ = false;
+        data_window_.extendBy(layers_[i].data_window);
+
+        if (layers_[i].image_type == IMAGE_TYPE_RGB)
+          image_type_ = IMAGE_TYPE_RGB;
       }
 
     switch (pt_)
       {
       case UINT:
-        format_string_.append(" u32");
         bpc_ = 4;
         break;
       case HALF:
-        format_string_.append(" half");
         bpc_ = 2;
         break;
       case FLOAT:
       default:
-        format_string_.append(" float");
         bpc_ = 4;
       }
   }
 
-  int readPixelRow(char* pixels,
-                   int bpp,
-                   int row)
+  void addLayer(int part,
+                const Header& header,
+                const std::string& prefix)
   {
-    const int actual_row = data_window_.min.y + row;
+    const ChannelList& channels = header.channels();
+    const Channel* chan;
+    EXRLayer layer;
+
+    if ((chan = channels.findChannel((prefix + "R").c_str())) ||
+        (chan = channels.findChannel((prefix + "G").c_str())) ||
+        (chan = channels.findChannel((prefix + "B").c_str())))
+      {
+        layer.image_type = IMAGE_TYPE_RGB;
+      }
+    else if (channels.findChannel((prefix + "RY").c_str()) ||
+             channels.findChannel((prefix + "BY").c_str()))
+      {
+        // FIXME: no chroma handling for now.
+        return;
+      }
+    else if ((chan = channels.findChannel((prefix + "Y").c_str())))
+      {
+        layer.image_type = IMAGE_TYPE_GRAY;
+      }
+    else
+      {
+        return;
+      }
+
+    layer.part = part;
+    layer.prefix = prefix;
+    layer.data_window = header.dataWindow();
+    layer.pt = chan->type;
+    layer.has_alpha = channels.findChannel((prefix + "A").c_str()) != NULL;
+
+    if (header.hasName())
+      layer.name = header.name();
+
+    if (! prefix.empty())
+      {
+        if (! layer.name.empty())
+          layer.name.append(".");
+
+        layer.name.append(prefix, 0, prefix.size() - 1);
+      }
+
+    // the number of rows that are compressed together, reading whole
+    // blocks avoids decompressing them more than once
+    if (header.hasTileDescription())
+      {
+        layer.block_height = header.tileDescription().ySize;
+      }
+    else
+      {
+        switch (header.compression())
+          {
+          case NO_COMPRESSION:
+          case RLE_COMPRESSION:
+          case ZIPS_COMPRESSION:
+            layer.block_height = 1;
+            break;
+          case ZIP_COMPRESSION:
+          case PXR24_COMPRESSION:
+            layer.block_height = 16;
+            break;
+          default:
+            layer.block_height = 32;
+            break;
+          }
+      }
+
+    layers_.push_back(layer);
+  }
+
+  int readPixelRows(int layer_index,
+                    char* pixels,
+                    int bpp,
+                    int row,
+                    int n_rows)
+  {
+    const EXRLayer& layer = layers_.at(layer_index);
+    const std::string& prefix = layer.prefix;
+    const int width = layer.data_window.max.x - layer.data_window.min.x + 1;
+    const size_t stride = (size_t) width * bpp;
+    const int first_row = layer.data_window.min.y + row;
+    InputPart part(file_, layer.part);
     FrameBuffer fb;
-    // This is necessary because OpenEXR expects the buffer to begin at
-    // (0, 0). Though it probably results in some unmapped address,
-    // hopefully OpenEXR will not make use of it. :/
-    char* base = pixels - (data_window_.min.x * bpp);
+    // This is necessary because OpenEXR addresses the frame buffer by
+    // pixel coordinates. Though it probably results in some unmapped
+    // address, OpenEXR only accesses the rows we ask for. :/
+    char* base = pixels - ((ptrdiff_t) layer.data_window.min.x * bpp +
+                           (ptrdiff_t) first_row * (ptrdiff_t) stride);
 
     switch (image_type_)
       {
       case IMAGE_TYPE_GRAY:
-        fb.insert("Y", Slice(pt_, base, bpp, 0, 1, 1, 0.5));
-        if (hasAlpha())
+        fb.insert((prefix + "Y").c_str(),
+                  Slice(pt_, base, bpp, stride, 1, 1, 0.5));
+        if (layer.has_alpha)
           {
-            fb.insert("A", Slice(pt_, base + bpc_, bpp, 0, 1, 1, 1.0));
+            fb.insert((prefix + "A").c_str(),
+                      Slice(pt_, base + bpc_, bpp, stride, 1, 1, 1.0));
           }
         break;
 
       case IMAGE_TYPE_RGB:
       default:
-        fb.insert("R", Slice(pt_, base + (bpc_ * 0), bpp, 0, 1, 1, 0.0));
-        fb.insert("G", Slice(pt_, base + (bpc_ * 1), bpp, 0, 1, 1, 0.0));
-        fb.insert("B", Slice(pt_, base + (bpc_ * 2), bpp, 0, 1, 1, 0.0));
-        if (hasAlpha())
+        if (layer.image_type == IMAGE_TYPE_GRAY)
           {
-            fb.insert("A", Slice(pt_, base + (bpc_ * 3), bpp, 0, 1, 1, 1.0));
+            // copied to G and B below
+            fb.insert((prefix + "Y").c_str(),
+                      Slice(pt_, base, bpp, stride, 1, 1, 0.5));
+          }
+        else
+          {
+            fb.insert((prefix + "R").c_str(),
+                      Slice(pt_, base + (bpc_ * 0), bpp, stride, 1, 1, 0.0));
+            fb.insert((prefix + "G").c_str(),
+                      Slice(pt_, base + (bpc_ * 1), bpp, stride, 1, 1, 0.0));
+            fb.insert((prefix + "B").c_str(),
+                      Slice(pt_, base + (bpc_ * 2), bpp, stride, 1, 1, 0.0));
+          }
+        if (layer.has_alpha)
+          {
+            fb.insert((prefix + "A").c_str(),
+                      Slice(pt_, base + (bpc_ * 3), bpp, stride, 1, 1, 1.0));
           }
       }
 
-    file_.setFrameBuffer(fb);
-    file_.readPixels(actual_row);
+    // the whole range is decoded at once, by OpenEXR's thread pool
+    part.setFrameBuffer(fb);
+    part.readPixels(first_row, first_row + n_rows - 1);
+
+    if (image_type_ == IMAGE_TYPE_RGB &&
+        layer.image_type == IMAGE_TYPE_GRAY)
+      {
+        char* p = pixels;
+
+        for (size_t i = 0; i < (size_t) width * n_rows; i++)
+          {
+            memcpy (p + bpc_,     p, bpc_);
+            memcpy (p + bpc_ * 2, p, bpc_);
+
+            p += bpp;
+          }
+      }
 
     return 0;
   }
 
+  const Header& header() const {
+    return file_.header(layers_[0].part);
+  }
+
   int getWidth() const {
     return data_window_.max.x - data_window_.min.x + 1;
   }
@@ -218,8 +339,12 @@ struct _EXRLoader
     return image_type_;
   }
 
-  int hasAlpha() const {
-    return has_alpha_ ? 1 : 0;
+  int getNLayers() const {
+    return layers_.size();
+  }
+
+  const EXRLayer& getLayer(int layer) const {
+    return layers_.at(layer);
   }
 
   GimpColorProfile *getProfile() const {
@@ -236,22 +361,22 @@ struct _EXRLoader
     cmsCIEXYZ exr_r_XYZ, exr_g_XYZ, exr_b_XYZ, exr_w_XYZ;
 
     // get the color information from the EXR
-    if (hasChromaticities (file_.header ()))
-      chromaticities = Imf::chromaticities (file_.header ());
+    if (hasChromaticities (header ()))
+      chromaticities = Imf::chromaticities (header ());
     else
       return NULL;
 
-    if (Imf::hasWhiteLuminance (file_.header ()))
-      whiteLuminance = Imf::whiteLuminance (file_.header ());
+    if (Imf::hasWhiteLuminance (header ()))
+      whiteLuminance = Imf::whiteLuminance (header ());
     else
       return NULL;
 
 #if 0
     std::cout << "hasChromaticities: "
-              << hasChromaticities (file_.header ())
+              << hasChromaticities (header ())
               << std::endl;
     std::cout << "hasWhiteLuminance: "
-              << hasWhiteLuminance (file_.header ())
+              << hasWhiteLuminance (header ())
               << std::endl;
     std::cout << whiteLuminance << std::endl;
     std::cout << chromaticities.red << std::endl;
@@ -334,7 +459,7 @@ struct _EXRLoader
 
   gchar *getComment() const {
     char *result = NULL;
-    const Imf::StringAttribute *comment = file_.header().findTypedAttribute<Imf::StringAttribute>("comment");
+    const Imf::StringAttribute *comment = header().findTypedAttribute<Imf::StringAttribute>("comment");
     if (comment)
       result = g_strdup (comment->value().c_str());
     return result;
@@ -345,7 +470,7 @@ struct _EXRLoader
     guchar *exif_data = NULL;
     *size = 0;
 
-    const Imf::BlobAttribute *exif = file_.header().findTypedAttribute<Imf::BlobAttribute>("exif");
+    const Imf::BlobAttribute *exif = header().findTypedAttribute<Imf::BlobAttribute>("exif");
 
     if (exif)
       {
@@ -365,7 +490,7 @@ struct _EXRLoader
   guchar *getXmp(guint *size) const {
     guchar *result = NULL;
     *size = 0;
-    const Imf::StringAttribute *xmp = file_.header().findTypedAttribute<Imf::StringAttribute>("xmp");
+    const Imf::StringAttribute *xmp = header().findTypedAttribute<Imf::StringAttribute>("xmp");
     if (xmp)
       {
         *size = xmp->value().size();
@@ -375,18 +500,17 @@ struct _EXRLoader
   }
 
   size_t refcount_;
-  InputFile file_;
-  const Box2i data_window_;
-  const ChannelList& channels_;
+  MultiPartInputFile file_;
+  std::vector<EXRLayer> layers_;
+  Box2i data_window_;
   PixelType pt_;
   int bpc_;
   EXRImageType image_type_;
-  bool has_alpha_;
-  std::string format_string_;
 };
 
 EXRLoader*
-exr_loader_new (const char *filename)
+exr_loader_new (const char *filename,
+                int         n_threads)
 {
   EXRLoader* file;
 
@@ -394,7 +518,9 @@ exr_loader_new (const char *filename)
   try
     {
       Imf::BlobAttribute::registerAttributeType();
-      file = new EXRLoader(filename);
+      // the files use the global thread pool
+      Imf::setGlobalThreadCount(n_threads);
+      file = new EXRLoader(filename, n_threads);
     }
   catch (...)
     {
@@ -469,10 +595,47 @@ exr_loader_get_precision (EXRLoader *loader)
 }
 
 int
-exr_loader_has_alpha (EXRLoader *loader)
+exr_loader_get_n_layers (EXRLoader *loader)
 {
   // This does not throw.
-  return loader->hasAlpha();
+  return loader->getNLayers();
+}
+
+const char *
+exr_loader_get_layer_name (EXRLoader *loader,
+                           int        layer)
+{
+  return loader->getLayer(layer).name.c_str();
+}
+
+void
+exr_loader_get_layer_bounds (EXRLoader *loader,
+                             int        layer,
+                             int       *x,
+                             int       *y,
+                             int       *width,
+                             int       *height)
+{
+  const Box2i& data_window = loader->getLayer(layer).data_window;
+
+  *x      = data_window.min.x - loader->data_window_.min.x;
+  *y      = data_window.min.y - loader->data_window_.min.y;
+  *width  = data_window.max.x - data_window.min.x + 1;
+  *height = data_window.max.y - data_window.min.y + 1;
+}
+
+int
+exr_loader_get_layer_block_height (EXRLoader *loader,
+                                   int        layer)
+{
+  return loader->getLayer(layer).block_height;
+}
+
+int
+exr_loader_layer_has_alpha (EXRLoader *loader,
+                            int        layer)
+{
+  return loader->getLayer(layer).has_alpha ? 1 : 0;
 }
 
 GimpColorProfile *
@@ -502,16 +665,18 @@ exr_loader_get_xmp (EXRLoader *loader,
 }
 
 int
-exr_loader_read_pixel_row (EXRLoader *loader,
-                           char *pixels,
-                           int bpp,
-                           int row)
+exr_loader_read_pixel_rows (EXRLoader *loader,
+                            int        layer,
+                            char      *pixels,
+                            int        bpp,
+                            int        row,
+                            int        n_rows)
 {
   int retval = -1;
   // Don't let any exceptions propagate to the C layer.
   try
     {
-      retval = loader->readPixelRow(pixels, bpp, row);
+      retval = loader->readPixelRows(layer, pixels, bpp, row, n_rows);
     }
   catch (...)
     {
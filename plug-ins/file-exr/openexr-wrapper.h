@@ -39,7 +39,8 @@ typedef enum
 } EXRImageType;
 
 
-EXRLoader        * exr_loader_new            (const char *filename);
+EXRLoader        * exr_loader_new            (const char *filename,
+                                              int         n_threads);
 
 EXRLoader        * exr_loader_ref            (EXRLoader  *loader);
 void               exr_loader_unref          (EXRLoader  *loader);
@@ -49,7 +50,23 @@ int                exr_loader_get_height     (EXRLoader  *loader);
 
 EXRPrecision       exr_loader_get_precision  (EXRLoader  *loader);
 EXRImageType       exr_loader_get_image_type (EXRLoader  *loader);
-int                exr_loader_has_alpha      (EXRLoader  *loader);
+
+int                exr_loader_get_n_layers   (EXRLoader  *loader);
+const char       * exr_loader_get_layer_name (EXRLoader  *loader,
+                                              int         layer);
+void               exr_loader_get_layer_bounds
+                                             (EXRLoader  *loader,
+                                              int         layer,
+                                              int        *x,
+                                              int        *y,
+                                              int        *width,
+                                              int        *height);
+int                exr_loader_get_layer_block_height
+                                             (EXRLoader  *loader,
+                                              int         layer);
+int                exr_loader_layer_has_alpha
+                                             (EXRLoader  *loader,
+                                              int         layer);
 
 GimpColorProfile * exr_loader_get_profile    (EXRLoader  *loader);
 gchar            * exr_loader_get_comment    (EXRLoader  *loader);
@@ -58,10 +75,13 @@ guchar           * exr_loader_get_exif       (EXRLoader  *loader,
 guchar           * exr_loader_get_xmp        (EXRLoader  *loader,
                                               guint      *size);
 
-int                exr_loader_read_pixel_row (EXRLoader *loader,
-                                              char      *pixels,
-                                              int        bpp,
-                                              int        row);
+int                exr_loader_read_pixel_rows
+                                             (EXRLoader  *loader,
+                                              int         layer,
+                                              char       *pixels,
+                                              int         bpp,
+                                              int         row,
+                                              int         n_rows);
 
 G_END_DECLS
 
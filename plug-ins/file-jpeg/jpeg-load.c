@@ -40,6 +40,10 @@
 #include "jpeg-settings.h"
 #include "jpeg-load.h"
 
+static gint      jpeg_load_scale_denom      (struct jpeg_decompress_struct
+                                                       *cinfo,
+                                             gint      size);
+
 static gboolean  jpeg_load_resolution       (gint32    image_ID,
                                              struct jpeg_decompress_struct
                                                        *cinfo);
@@ -55,10 +59,16 @@ static void      jpeg_load_cmyk_to_rgb      (guchar   *buf,
 gint32 volatile  preview_image_ID;
 gint32           preview_layer_ID;
 
+/* Loads the JPEG image in filename.  If size is greater than 0, the
+ * image is scaled down by libjpeg while decoding it, by the largest
+ * factor that keeps its larger dimension at least size pixels, using
+ * the faster but less accurate integer DCT.
+ */
 gint32
 load_image (const gchar  *filename,
             GimpRunMode   runmode,
             gboolean      preview,
+            gint          size,
             gboolean     *resolution_loaded,
             GError      **error)
 {
@@ -161,6 +171,17 @@ load_image (const gchar  *filename,
 
   cinfo.dct_method = JDCT_FLOAT;
 
+  /* - step 4.1: for a reduced-size ("draft") image, let libjpeg
+   *   scale it down in the DCT, which skips most of the decoding work
+   */
+  if (size > 0)
+    {
+      cinfo.scale_num           = 1;
+      cinfo.scale_denom         = jpeg_load_scale_denom (&cinfo, size);
+      cinfo.dct_method          = JDCT_IFAST;
+      cinfo.do_fancy_upsampling = FALSE;
+    }
+
   /* Step 5: Start decompressor */
 
   jpeg_start_decompress (&cinfo);
@@ -438,6 +459,20 @@ load_image (const gchar  *filename,
   return image_ID;
 }
 
+/* libjpeg can scale the image by 1/1, 1/2, 1/4 and 1/8 */
+static gint
+jpeg_load_scale_denom (struct jpeg_decompress_struct *cinfo,
+                       gint                           size)
+{
+  gint image_size  = MAX (cinfo->image_width, cinfo->image_height);
+  gint scale_denom = 1;
+
+  while (scale_denom < 8 && image_size / (scale_denom * 2) >= size)
+    scale_denom *= 2;
+
+  return scale_denom;
+}
+
 static gboolean
 jpeg_load_resolution (gint32                         image_ID,
                       struct jpeg_decompress_struct *cinfo)
@@ -509,8 +544,12 @@ jpeg_load_sanitize_comment (gchar *comment)
     }
 }
 
+/* Loads the Exif thumbnail of the image, or if there is none, a
+ * reduced-size version of the image itself, of at least size pixels.
+ */
 gint32
 load_thumbnail_image (GFile         *file,
+                      gint           size,
                       gint          *width,
                       gint          *height,
                       GimpImageType *type,
@@ -520,19 +559,20 @@ load_thumbnail_image (GFile         *file,
   struct jpeg_decompress_struct cinfo;
   struct my_error_mgr           jerr;
   FILE                         *infile   = NULL;
+  gchar                        *filename;
 
   gimp_progress_init_printf (_("Opening thumbnail for '%s'"),
                              g_file_get_parse_name (file));
 
-  image_ID = gimp_image_metadata_load_thumbnail (file, error);
-  if (image_ID < 1)
-    return -1;
+  image_ID = gimp_image_metadata_load_thumbnail (file, NULL);
 
   cinfo.err = jpeg_std_error (&jerr.pub);
   jerr.pub.error_exit     = my_error_exit;
   jerr.pub.output_message = my_output_message;
 
-  if ((infile = g_fopen (g_file_get_path (file), "rb")) == NULL)
+  filename = g_file_get_path (file);
+
+  if ((infile = g_fopen (filename, "rb")) == NULL)
     {
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                    _("Could not open '%s' for reading: %s"),
@@ -541,6 +581,8 @@ load_thumbnail_image (GFile         *file,
       if (image_ID != -1)
         gimp_image_delete (image_ID);
 
+      g_free (filename);
+
       return -1;
     }
 
@@ -553,9 +595,13 @@ load_thumbnail_image (GFile         *file,
        */
       jpeg_destroy_decompress (&cinfo);
 
+      fclose (infile);
+
       if (image_ID != -1)
         gimp_image_delete (image_ID);
 
+      g_free (filename);
+
       return -1;
     }
 
@@ -599,8 +645,11 @@ load_thumbnail_image (GFile         *file,
                  cinfo.output_components, cinfo.out_color_space,
                  cinfo.jpeg_color_space);
 
-      gimp_image_delete (image_ID);
+      if (image_ID != -1)
+        gimp_image_delete (image_ID);
+
       image_ID = -1;
+      size     = 0;
       break;
     }
 
@@ -613,6 +662,17 @@ load_thumbnail_image (GFile         *file,
 
   fclose (infile);
 
+  /* Without an Exif thumbnail, decode a reduced-size version of the
+   * image, instead of letting GIMP fall back to loading all of it
+   */
+  if (image_ID < 1 && size > 0)
+    {
+      image_ID = load_image (filename, GIMP_RUN_NONINTERACTIVE, FALSE,
+                             size, NULL, error);
+    }
+
+  g_free (filename);
+
   return image_ID;
 }
 
@@ -21,10 +21,12 @@
 gint32 load_image           (const gchar  *filename,
                              GimpRunMode   runmode,
                              gboolean      preview,
+                             gint          size,
                              gboolean     *resolution_loaded,
                              GError      **error);
 
 gint32 load_thumbnail_image (GFile         *file,
+                             gint           size,
                              gint          *width,
                              gint          *height,
                              GimpImageType *type,
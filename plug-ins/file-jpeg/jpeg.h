@@ -18,11 +18,12 @@
 #ifndef __JPEG_H__
 #define __JPEG_H__
 
-#define LOAD_PROC       "file-jpeg-load"
-#define LOAD_THUMB_PROC "file-jpeg-load-thumb"
-#define SAVE_PROC       "file-jpeg-save"
-#define PLUG_IN_BINARY  "file-jpeg"
-#define PLUG_IN_ROLE    "gimp-file-jpeg"
+#define LOAD_PROC        "file-jpeg-load"
+#define LOAD_THUMB_PROC  "file-jpeg-load-thumb"
+#define LOAD_SCALED_PROC "file-jpeg-load-scaled"
+#define SAVE_PROC        "file-jpeg-save"
+#define PLUG_IN_BINARY   "file-jpeg"
+#define PLUG_IN_ROLE     "gimp-file-jpeg"
 
 /* headers used in some APPn markers */
 #define JPEG_APP_HEADER_EXIF "Exif\0\0"
@@ -38,6 +38,28 @@
 
 #define COMP_MODE_SIZE sizeof(guint16)
 
+/* Minimum number of RLE rows decoded per thread */
+#define MIN_PARALLEL_RLE_ROWS 64
+
+
+/* Compressed channel data, read sequentially from the file and
+ * decoded in parallel by decode_channels()
+ */
+typedef struct
+{
+  PSDchannel   *channel;                /* Channel to decode into */
+  guint16       bps;
+  guint16       compression;
+  guint32       readline_len;
+  gchar        *src;                    /* Compressed data */
+  gsize         src_len;
+  guint16      *rle_pack_len;           /* RLE row lengths */
+  gsize        *rle_offsets;            /* RLE row offsets into src */
+  gchar        *raw_data;               /* Decompressed data */
+  const gchar  *error_message;
+  gboolean      failed;
+} PSDchannelDecode;
+
 
 /*  Local function prototypes  */
 static gint             read_header_block          (PSDimage     *img_a,
@@ -98,7 +120,16 @@ static gint             read_channel_data          (PSDchannel     *channel,
                                                     const guint16  *rle_pack_len,
                                                     FILE           *f,
                                                     guint32         comp_len,
+                                                    GArray         *decodes,
                                                     GError        **error);
+static gint             decode_channels            (GArray         *decodes,
+                                                    GError        **error);
+static void             decode_channel_range       (gsize             offset,
+                                                    gsize             size,
+                                                    PSDchannelDecode *decodes);
+static void             decode_rle_rows            (gsize             offset,
+                                                    gsize             size,
+                                                    PSDchannelDecode *decode);
 
 static void             convert_1_bit              (const gchar *src,
                                                     gchar       *dst,
@@ -1118,6 +1149,7 @@ add_layers (gint32     image_id,
             GError   **error)
 {
   PSDchannel          **lyr_chn;
+  GArray               *decodes;
   GArray               *parent_group_stack;
   gint32                parent_group_id = -1;
   guchar               *pixels;
@@ -1168,6 +1200,8 @@ add_layers (gint32     image_id,
       return -1;
     }
 
+  decodes = g_array_new (FALSE, FALSE, sizeof (PSDchannelDecode));
+
   /* set the root of the group hierarchy */
   parent_group_stack = g_array_new (FALSE, FALSE, sizeof (gint32));
   g_array_append_val (parent_group_stack, parent_group_id);
@@ -1289,7 +1323,7 @@ add_layers (gint32     image_id,
                                           lyr_a[lidx]->chn_info[cidx].data_len - 2);
                         if (read_channel_data (lyr_chn[cidx], img_a->bps,
                                                PSD_COMP_RAW, NULL, f, 0,
-                                               error) < 1)
+                                               decodes, error) < 1)
                           return -1;
                         break;
 
@@ -1315,7 +1349,7 @@ add_layers (gint32     image_id,
                         IFDBG(3) g_debug ("RLE decode - data");
                         if (read_channel_data (lyr_chn[cidx], img_a->bps,
                                                PSD_COMP_RLE, rle_pack_len, f, 0,
-                                               error) < 1)
+                                               decodes, error) < 1)
                           return -1;
 
                         g_free (rle_pack_len);
@@ -1326,7 +1360,7 @@ add_layers (gint32     image_id,
                         if (read_channel_data (lyr_chn[cidx], img_a->bps,
                                                comp_mode, NULL, f,
                                                lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                               error) < 1)
+                                               decodes, error) < 1)
                           return -1;
                         break;
 
@@ -1339,6 +1373,12 @@ add_layers (gint32     image_id,
                 }
             }
 
+          /* Decode the layer's channels, which were read above, in
+           * parallel
+           */
+          if (decode_channels (decodes, error) < 1)
+            return -1;
+
           /* Draw layer */
 
           alpha = FALSE;
@@ -1677,6 +1717,7 @@ add_layers (gint32     image_id,
     }
   g_free (lyr_a);
   g_array_free (parent_group_stack, FALSE);
+  g_array_free (decodes, TRUE);
 
   /* Set the active layer */
   if (active_layer_id >= 0)
@@ -1692,6 +1733,7 @@ add_merged_image (gint32     image_id,
                   GError   **error)
 {
   PSDchannel            chn_a[MAX_CHANNELS];
+  GArray               *decodes;
   gchar                *alpha_name;
   guchar               *pixels;
   guint16               comp_mode;
@@ -1760,6 +1802,8 @@ add_merged_image (gint32     image_id,
       block_start = img_a->merged_image_start;
       block_len = img_a->merged_image_len;
 
+      decodes = g_array_new (FALSE, FALSE, sizeof (PSDchannelDecode));
+
       fseek (f, block_start, SEEK_SET);
 
       if (fread (&comp_mode, COMP_MODE_SIZE, 1, f) < 1)
@@ -1779,7 +1823,7 @@ add_merged_image (gint32     image_id,
                 chn_a[cidx].rows = img_a->rows;
                 if (read_channel_data (&chn_a[cidx], img_a->bps,
                                        PSD_COMP_RAW, NULL, f, 0,
-                                       error) < 1)
+                                       decodes, error) < 1)
                   return -1;
               }
             break;
@@ -1819,7 +1863,7 @@ add_merged_image (gint32     image_id,
               {
                 if (read_channel_data (&chn_a[cidx], img_a->bps,
                                        PSD_COMP_RLE, rle_pack_len[cidx], f, 0,
-                                       error) < 1)
+                                       decodes, error) < 1)
                   return -1;
                 g_free (rle_pack_len[cidx]);
               }
@@ -1833,6 +1877,11 @@ add_merged_image (gint32     image_id,
             return -1;
             break;
         }
+
+      if (decode_channels (decodes, error) < 1)
+        return -1;
+
+      g_array_free (decodes, TRUE);
     }
 
   /* ----- Draw merged image ----- */
@@ -2115,13 +2164,12 @@ read_channel_data (PSDchannel     *channel,
                    const guint16  *rle_pack_len,
                    FILE           *f,
                    guint32         comp_len,
+                   GArray         *decodes,
                    GError        **error)
 {
-  gchar    *raw_data;
-  gchar    *src;
-  gchar    *dst;
-  guint32   readline_len;
-  gint      i, j;
+  PSDchannelDecode decode = { 0, };
+  guint32          readline_len;
+  gint             i;
 
   if (bps == 1)
     readline_len = ((channel->columns + 7) / 8);
@@ -2140,147 +2188,244 @@ read_channel_data (PSDchannel     *channel,
       return -1;
     }
 
-  raw_data = g_malloc (readline_len * channel->rows);
+  decode.channel      = channel;
+  decode.bps          = bps;
+  decode.compression  = compression;
+  decode.readline_len = readline_len;
+
+  /* Only read the compressed data here, since reading from the file is
+   * sequential; it is decoded by decode_channels().
+   */
   switch (compression)
     {
       case PSD_COMP_RAW:
-        if (fread (raw_data, readline_len, channel->rows, f) < 1)
-          {
-            psd_set_error (feof (f), errno, error);
-            return -1;
-          }
+        decode.src_len = (gsize) readline_len * channel->rows;
         break;
 
       case PSD_COMP_RLE:
+        decode.rle_pack_len = g_memdup (rle_pack_len,
+                                        channel->rows * sizeof (guint16));
+        decode.rle_offsets  = g_new (gsize, channel->rows);
+
         for (i = 0; i < channel->rows; ++i)
           {
-            src = g_malloc (rle_pack_len[i]);
-            dst = g_malloc (readline_len);
-/*      FIXME check for over-run
-            if (ftell (f) + rle_pack_len[i] > block_end)
-              {
-                psd_set_error (TRUE, errno, error);
-                return -1;
-              }
-*/
-            if (fread (src, rle_pack_len[i], 1, f) < 1)
-              {
-                psd_set_error (feof (f), errno, error);
-                g_free (src);
-                g_free (dst);
-                return -1;
-              }
-            /* FIXME check for errors returned from decode packbits */
-            decode_packbits (src, dst, rle_pack_len[i], readline_len);
-            g_free (src);
-            memcpy (raw_data + i * readline_len, dst, readline_len);
-            g_free (dst);
+            decode.rle_offsets[i]  = decode.src_len;
+            decode.src_len        += rle_pack_len[i];
           }
         break;
+
       case PSD_COMP_ZIP:
       case PSD_COMP_ZIP_PRED:
-        {
-          z_stream zs;
+        decode.src_len = comp_len;
+        break;
+    }
 
-          src = g_malloc (comp_len);
-          if (fread (src, comp_len, 1, f) < 1)
-            {
-              psd_set_error (feof (f), errno, error);
-              g_free (src);
-              return -1;
-            }
+  decode.src = g_malloc (decode.src_len);
 
-          zs.next_in = (guchar*) src;
-          zs.avail_in = comp_len;
-          zs.next_out = (guchar*) raw_data;
-          zs.avail_out = readline_len * channel->rows;
-          zs.zalloc = zzalloc;
-          zs.zfree = zzfree;
+  if (decode.src_len > 0 && fread (decode.src, decode.src_len, 1, f) < 1)
+    {
+      psd_set_error (feof (f), errno, error);
+      g_free (decode.src);
+      g_free (decode.rle_pack_len);
+      g_free (decode.rle_offsets);
+      return -1;
+    }
 
-          if (inflateInit (&zs) == Z_OK &&
-              inflate (&zs, Z_FINISH) == Z_STREAM_END)
-            {
-              inflateEnd (&zs);
-            }
-          else
-            {
-              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                           _("Failed to decompress data"));
-              g_free (src);
-              return -1;
-            }
+  g_array_append_val (decodes, decode);
 
-          g_free (src);
-          break;
+  return 1;
+}
+
+static gint
+decode_channels (GArray  *decodes,
+                 GError **error)
+{
+  gint  result = 1;
+  guint i;
+
+  if (decodes->len == 0)
+    return 1;
+
+  gegl_parallel_distribute_range (
+    decodes->len, 1,
+    (GeglParallelDistributeRangeFunc) decode_channel_range,
+    decodes->data);
+
+  for (i = 0; i < decodes->len; i++)
+    {
+      PSDchannelDecode *decode = &g_array_index (decodes, PSDchannelDecode, i);
+
+      if (decode->failed && result > 0)
+        {
+          if (decode->error_message)
+            g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                 decode->error_message);
+
+          result = -1;
         }
+
+      g_free (decode->src);
+      g_free (decode->rle_pack_len);
+      g_free (decode->rle_offsets);
     }
 
-  /* Convert channel data to GIMP format */
-  switch (bps)
+  g_array_set_size (decodes, 0);
+
+  return result;
+}
+
+static void
+decode_channel_range (gsize             offset,
+                      gsize             size,
+                      PSDchannelDecode *decodes)
+{
+  gsize n;
+
+  for (n = offset; n < offset + size; n++)
     {
-    case 32:
-      {
-        guint32 *src = (guint32*) raw_data;
-        guint32 *dst = g_malloc (channel->rows * channel->columns * 4);
+      PSDchannelDecode *decode  = &decodes[n];
+      PSDchannel       *channel = decode->channel;
+      guint16           bps     = decode->bps;
+      gchar            *raw_data;
+      gint              i, j;
 
-        channel->data = (gchar*) dst;
+      switch (decode->compression)
+        {
+          case PSD_COMP_RAW:
+            raw_data    = decode->src;
+            decode->src = NULL;
+            break;
 
-        for (i = 0; i < channel->rows * channel->columns; ++i)
-          dst[i] = GUINT32_FROM_BE (src[i]);
+          case PSD_COMP_RLE:
+            raw_data = g_malloc (decode->readline_len * channel->rows);
+            decode->raw_data = raw_data;
+
+            /* Rows are packed separately, and can be decoded in parallel
+             * when there's only a single channel to decode
+             */
+            gegl_parallel_distribute_range (
+              channel->rows, MIN_PARALLEL_RLE_ROWS,
+              (GeglParallelDistributeRangeFunc) decode_rle_rows,
+              decode);
+            break;
 
-        if (compression == PSD_COMP_ZIP_PRED)
-          {
-            for (i = 0; i < channel->rows; ++i)
-              for (j = 1; j < channel->columns; ++j)
-                dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
-          }
-        break;
-      }
+          case PSD_COMP_ZIP:
+          case PSD_COMP_ZIP_PRED:
+            {
+              z_stream zs;
 
-    case 16:
-      {
-        guint16 *src = (guint16*) raw_data;
-        guint16 *dst = g_malloc (channel->rows * channel->columns * 2);
+              raw_data = g_malloc (decode->readline_len * channel->rows);
 
-        channel->data = (gchar*) dst;
+              zs.next_in = (guchar*) decode->src;
+              zs.avail_in = decode->src_len;
+              zs.next_out = (guchar*) raw_data;
+              zs.avail_out = decode->readline_len * channel->rows;
+              zs.zalloc = zzalloc;
+              zs.zfree = zzfree;
 
-        for (i = 0; i < channel->rows * channel->columns; ++i)
-          dst[i] = GUINT16_FROM_BE (src[i]);
+              if (inflateInit (&zs) == Z_OK &&
+                  inflate (&zs, Z_FINISH) == Z_STREAM_END)
+                {
+                  inflateEnd (&zs);
+                }
+              else
+                {
+                  decode->error_message = _("Failed to decompress data");
+                  decode->failed        = TRUE;
+                  g_free (raw_data);
+                  continue;
+                }
+              break;
+            }
 
-        if (compression == PSD_COMP_ZIP_PRED)
+          default:
+            decode->failed = TRUE;
+            continue;
+        }
+
+      /* Convert channel data to GIMP format */
+      switch (bps)
+        {
+        case 32:
           {
-            for (i = 0; i < channel->rows; ++i)
-              for (j = 1; j < channel->columns; ++j)
-                dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
-          }
-        break;
-      }
+            guint32 *src = (guint32*) raw_data;
+            guint32 *dst = g_malloc (channel->rows * channel->columns * 4);
 
-      case 8:
-        channel->data = g_malloc (channel->rows * channel->columns * bps / 8 );
-        memcpy (channel->data, raw_data, (channel->rows * channel->columns * bps / 8));
+            channel->data = (gchar*) dst;
+
+            for (i = 0; i < channel->rows * channel->columns; ++i)
+              dst[i] = GUINT32_FROM_BE (src[i]);
 
-        if (compression == PSD_COMP_ZIP_PRED)
+            if (decode->compression == PSD_COMP_ZIP_PRED)
+              {
+                for (i = 0; i < channel->rows; ++i)
+                  for (j = 1; j < channel->columns; ++j)
+                    dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
+              }
+            break;
+          }
+
+        case 16:
           {
-            for (i = 0; i < channel->rows; ++i)
-              for (j = 1; j < channel->columns; ++j)
-                channel->data[i * channel->columns + j] += channel->data[i * channel->columns + j - 1];
+            guint16 *src = (guint16*) raw_data;
+            guint16 *dst = g_malloc (channel->rows * channel->columns * 2);
+
+            channel->data = (gchar*) dst;
+
+            for (i = 0; i < channel->rows * channel->columns; ++i)
+              dst[i] = GUINT16_FROM_BE (src[i]);
+
+            if (decode->compression == PSD_COMP_ZIP_PRED)
+              {
+                for (i = 0; i < channel->rows; ++i)
+                  for (j = 1; j < channel->columns; ++j)
+                    dst[i * channel->columns + j] += dst[i * channel->columns + j - 1];
+              }
+            break;
           }
-        break;
 
-      case 1:
-        channel->data = (gchar *) g_malloc (channel->rows * channel->columns);
-        convert_1_bit (raw_data, channel->data, channel->rows, channel->columns);
-        break;
+          case 8:
+            channel->data = g_malloc (channel->rows * channel->columns * bps / 8 );
+            memcpy (channel->data, raw_data, (channel->rows * channel->columns * bps / 8));
 
-      default:
-        return -1;
-        break;
+            if (decode->compression == PSD_COMP_ZIP_PRED)
+              {
+                for (i = 0; i < channel->rows; ++i)
+                  for (j = 1; j < channel->columns; ++j)
+                    channel->data[i * channel->columns + j] += channel->data[i * channel->columns + j - 1];
+              }
+            break;
+
+          case 1:
+            channel->data = (gchar *) g_malloc (channel->rows * channel->columns);
+            convert_1_bit (raw_data, channel->data, channel->rows, channel->columns);
+            break;
+
+          default:
+            decode->failed = TRUE;
+            break;
+        }
+
+      g_free (raw_data);
+      decode->raw_data = NULL;
     }
+}
 
-  g_free (raw_data);
+static void
+decode_rle_rows (gsize             offset,
+                 gsize             size,
+                 PSDchannelDecode *decode)
+{
+  gsize i;
 
-  return 1;
+  for (i = offset; i < offset + size; i++)
+    {
+      /* FIXME check for errors returned from decode packbits */
+      decode_packbits (decode->src + decode->rle_offsets[i],
+                       decode->raw_data + i * decode->readline_len,
+                       decode->rle_pack_len[i],
+                       decode->readline_len);
+    }
 }
 
 static void
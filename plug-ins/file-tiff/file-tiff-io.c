@@ -66,7 +66,10 @@ static gint      tiff_io_close         (thandle_t    handle);
 static toff_t    tiff_io_get_file_size (thandle_t    handle);
 
 
-static TiffIO tiff_io = { 0, };
+/* libtiff's warning and error handlers are global, and only the thread
+ * that opened the first file may pass messages on to GIMP.
+ */
+static GThread *tiff_io_main_thread = NULL;
 
 
 TIFF *
@@ -74,40 +77,60 @@ tiff_open (GFile        *file,
            const gchar  *mode,
            GError      **error)
 {
+  TiffIO *tiff_io;
+  TIFF   *tif;
+
   TIFFSetWarningHandler ((TIFFErrorHandler) tiff_io_warning);
   TIFFSetErrorHandler ((TIFFErrorHandler) tiff_io_error);
 
-  tiff_io.file = file;
+  if (! tiff_io_main_thread)
+    tiff_io_main_thread = g_thread_self ();
+
+  /* each TIFF gets its own I/O state, so that a file can be opened
+   * several times, e.g. to read it from multiple threads.
+   */
+  tiff_io = g_slice_new0 (TiffIO);
+
+  tiff_io->file = file;
 
   if (! strcmp (mode, "r"))
     {
-      tiff_io.input = G_INPUT_STREAM (g_file_read (file, NULL, error));
-      if (! tiff_io.input)
-        return NULL;
+      tiff_io->input = G_INPUT_STREAM (g_file_read (file, NULL, error));
+      if (! tiff_io->input)
+        {
+          g_slice_free (TiffIO, tiff_io);
+          return NULL;
+        }
 
-      tiff_io.stream = G_OBJECT (tiff_io.input);
+      tiff_io->stream = G_OBJECT (tiff_io->input);
     }
-  else if(! strcmp (mode, "w"))
+  else if(! strcmp (mode, "w") || ! strcmp (mode, "w8"))
     {
-      tiff_io.output = G_OUTPUT_STREAM (g_file_replace (file,
+      tiff_io->output = G_OUTPUT_STREAM (g_file_replace (file,
                                                         NULL, FALSE,
                                                         G_FILE_CREATE_NONE,
                                                         NULL, error));
-      if (! tiff_io.output)
-        return NULL;
+      if (! tiff_io->output)
+        {
+          g_slice_free (TiffIO, tiff_io);
+          return NULL;
+        }
 
-      tiff_io.stream = G_OBJECT (tiff_io.output);
+      tiff_io->stream = G_OBJECT (tiff_io->output);
     }
   else if(! strcmp (mode, "a"))
     {
       GIOStream *iostream = G_IO_STREAM (g_file_open_readwrite (file, NULL,
                                                                 error));
       if (! iostream)
-        return NULL;
+        {
+          g_slice_free (TiffIO, tiff_io);
+          return NULL;
+        }
 
-      tiff_io.input  = g_io_stream_get_input_stream (iostream);
-      tiff_io.output = g_io_stream_get_output_stream (iostream);
-      tiff_io.stream = G_OBJECT (iostream);
+      tiff_io->input  = g_io_stream_get_input_stream (iostream);
+      tiff_io->output = g_io_stream_get_output_stream (iostream);
+      tiff_io->stream = G_OBJECT (iostream);
     }
   else
     {
@@ -116,18 +139,26 @@ tiff_open (GFile        *file,
 
 #if 0
 #warning FIXME !can_seek code is broken
-  tiff_io.can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io.stream));
+  tiff_io->can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io->stream));
 #endif
-  tiff_io.can_seek = TRUE;
-
-  return TIFFClientOpen ("file-tiff", mode,
-                         (thandle_t) &tiff_io,
-                         tiff_io_read,
-                         tiff_io_write,
-                         tiff_io_seek,
-                         tiff_io_close,
-                         tiff_io_get_file_size,
-                         NULL, NULL);
+  tiff_io->can_seek = TRUE;
+
+  tif = TIFFClientOpen ("file-tiff", mode,
+                        (thandle_t) tiff_io,
+                        tiff_io_read,
+                        tiff_io_write,
+                        tiff_io_seek,
+                        tiff_io_close,
+                        tiff_io_get_file_size,
+                        NULL, NULL);
+
+  if (! tif)
+    {
+      g_object_unref (tiff_io->stream);
+      g_slice_free (TiffIO, tiff_io);
+    }
+
+  return tif;
 }
 
 static void
@@ -168,6 +199,17 @@ tiff_io_warning (const gchar *module,
   if (tag >= 32768)
     return;
 
+  /* Only the main thread may talk to GIMP. */
+  if (g_thread_self () != tiff_io_main_thread)
+    {
+      gchar *msg = g_strdup_vprintf (fmt, ap);
+
+      g_printerr ("%s: %s\n", module, msg);
+      g_free (msg);
+
+      return;
+    }
+
   /* Other unknown fields are only reported to stderr. */
   if (tag > 0)
     {
@@ -203,6 +245,17 @@ tiff_io_error (const gchar *module,
   if (! strcmp (fmt, "Compression algorithm does not support random access"))
     return;
 
+  /* Only the main thread may talk to GIMP. */
+  if (g_thread_self () != tiff_io_main_thread)
+    {
+      gchar *msg = g_strdup_vprintf (fmt, ap);
+
+      g_printerr ("%s: %s\n", module, msg);
+      g_free (msg);
+
+      return;
+    }
+
   g_logv (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE, fmt, ap);
 }
 
@@ -443,16 +496,9 @@ tiff_io_close (thandle_t handle)
     }
 
   g_object_unref (io->stream);
-  io->stream = NULL;
-  io->input  = NULL;
-  io->output = NULL;
-
   g_free (io->buffer);
-  io->buffer = NULL;
 
-  io->allocated = 0;
-  io->used      = 0;
-  io->position  = 0;
+  g_slice_free (TiffIO, io);
 
   return closed ? 0 : -1;
 }
@@ -60,6 +60,9 @@
 
 #define PLUG_IN_ROLE "gimp-file-tiff-load"
 
+/* Minimum number of rows loaded by a thread at a time */
+#define MIN_BAND_HEIGHT 64
+
 
 typedef struct
 {
@@ -77,6 +80,44 @@ typedef struct
   guchar     *pixel;
 } ChannelData;
 
+typedef struct _LoadData LoadData;
+
+typedef void (* LoadBandFunc) (LoadData *data,
+                               TIFF     *tif,
+                               guint32   y,
+                               guint32   height);
+
+struct _LoadData
+{
+  GFile        *file;
+  TIFF         *tif;              /* the main thread's handle    */
+  GThread      *main_thread;
+  tdir_t        directory;
+  GMutex        mutex;
+  GSList       *handles;          /* other threads' idle handles */
+
+  ChannelData  *channel;
+  const Babl   *src_format;
+  gboolean      is_bw;
+  gint          extra;
+  gint          bytes_per_pixel;
+
+  guint32       image_width;
+  guint32       image_height;
+  guint32       tile_width;
+  guint32       tile_height;
+  gboolean      flip_horizontal;
+  gboolean      flip_vertical;
+  gboolean      failed;
+
+  guint32       band_height;
+  gint          n_bands;
+  gint          next_band;
+  gint          batch_end;
+
+  LoadBandFunc  load_band;
+};
+
 typedef enum
 {
   GIMP_TIFF_LOAD_ASSOCALPHA,
@@ -88,22 +129,44 @@ typedef enum
 
 static GimpColorProfile * load_profile     (TIFF              *tif);
 
+static void               load_bands       (LoadData          *data,
+                                            guint32            block_height);
+static void               load_bands_thread (gint              i,
+                                             gint              n,
+                                             LoadData         *data);
+static void               load_bands_run   (LoadData          *data,
+                                            TIFF              *tif);
 static void               load_rgba        (TIFF              *tif,
+                                            GFile             *file,
                                             ChannelData       *channel);
+static void               load_rgba_band   (LoadData          *data,
+                                            TIFF              *tif,
+                                            guint32            y,
+                                            guint32            height);
 static void               load_contiguous  (TIFF              *tif,
+                                            GFile             *file,
                                             ChannelData       *channel,
                                             const Babl        *type,
                                             gushort            bps,
                                             gushort            spp,
                                             gboolean           is_bw,
                                             gint               extra);
+static void               load_contiguous_band (LoadData      *data,
+                                                TIFF          *tif,
+                                                guint32        y,
+                                                guint32        height);
 static void               load_separate    (TIFF              *tif,
+                                            GFile             *file,
                                             ChannelData       *channel,
                                             const Babl        *type,
                                             gushort            bps,
                                             gushort            spp,
                                             gboolean           is_bw,
                                             gint               extra);
+static void               load_separate_band (LoadData        *data,
+                                              TIFF            *tif,
+                                              guint32          y,
+                                              guint32          height);
 static void               load_paths       (TIFF              *tif,
                                             gint               image,
                                             gint               width,
@@ -1100,15 +1163,15 @@ load_image (GFile        *file,
 
       if (worst_case)
         {
-          load_rgba (tif, channel);
+          load_rgba (tif, file, channel);
         }
       else if (planar == PLANARCONFIG_CONTIG)
         {
-          load_contiguous (tif, channel, type, bps, spp, is_bw, extra);
+          load_contiguous (tif, file, channel, type, bps, spp, is_bw, extra);
         }
       else
         {
-          load_separate (tif, channel, type, bps, spp, is_bw, extra);
+          load_separate (tif, file, channel, type, bps, spp, is_bw, extra);
         }
 
       if (TIFFGetField (tif, TIFFTAG_ORIENTATION, &orientation))
@@ -1262,49 +1325,277 @@ load_profile (TIFF *tif)
   return profile;
 }
 
+/* Load the current directory in bands of rows, which are aligned to the
+ * file's strips or tiles, so they can be decoded independently.  The
+ * bands are spread over multiple threads, each reading through its own
+ * TIFF handle, and written directly into the channel buffers.
+ */
+static void
+load_bands (LoadData *data,
+            guint32   block_height)
+{
+  gint n_threads;
+  gint batch_size;
+
+  TIFFGetField (data->tif, TIFFTAG_IMAGEWIDTH,  &data->image_width);
+  TIFFGetField (data->tif, TIFFTAG_IMAGELENGTH, &data->image_height);
+
+  block_height = CLAMP (block_height, 1, MAX (data->image_height, 1));
+
+  data->main_thread = g_thread_self ();
+  data->directory   = TIFFCurrentDirectory (data->tif);
+  data->band_height = block_height * MAX (1, MIN_BAND_HEIGHT / block_height);
+  data->n_bands     = (data->image_height + data->band_height - 1) /
+                      data->band_height;
+  data->next_band   = 0;
+
+  g_mutex_init (&data->mutex);
+
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  /* process the bands in batches, so that we can update the progress
+   * in between; only the main thread may talk to GIMP.
+   */
+  batch_size = 2 * MAX (n_threads, 1);
+
+  while (data->next_band < data->n_bands)
+    {
+      data->batch_end = MIN (data->next_band + batch_size, data->n_bands);
+
+      gegl_parallel_distribute (data->batch_end - data->next_band,
+                                (GeglParallelDistributeFunc) load_bands_thread,
+                                data);
+
+      /* load the bands left over by threads that couldn't open the
+       * file
+       */
+      load_bands_run (data, data->tif);
+
+      /* the threads overshoot the counter while looking for bands  */
+      data->next_band = data->batch_end;
+
+      gimp_progress_update ((gdouble) data->next_band /
+                            (gdouble) data->n_bands);
+    }
+
+  g_slist_free_full (data->handles, (GDestroyNotify) TIFFClose);
+  data->handles = NULL;
+
+  g_mutex_clear (&data->mutex);
+}
+
+static void
+load_bands_thread (gint      i,
+                   gint      n,
+                   LoadData *data)
+{
+  TIFF *tif = NULL;
+
+  if (g_thread_self () == data->main_thread)
+    {
+      load_bands_run (data, data->tif);
+
+      return;
+    }
+
+  g_mutex_lock (&data->mutex);
+
+  if (data->handles)
+    {
+      tif = data->handles->data;
+
+      data->handles = g_slist_delete_link (data->handles, data->handles);
+    }
+
+  g_mutex_unlock (&data->mutex);
+
+  if (! tif)
+    {
+      tif = tiff_open (data->file, "r", NULL);
+
+      if (! tif)
+        return;
+
+      if (! TIFFSetDirectory (tif, data->directory))
+        {
+          TIFFClose (tif);
+
+          return;
+        }
+    }
+
+  load_bands_run (data, tif);
+
+  g_mutex_lock (&data->mutex);
+
+  data->handles = g_slist_prepend (data->handles, tif);
+
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+load_bands_run (LoadData *data,
+                TIFF     *tif)
+{
+  gint band;
+
+  while ((band = g_atomic_int_add (&data->next_band, 1)) < data->batch_end)
+    {
+      guint32 y      = band * data->band_height;
+      guint32 height = MIN (data->band_height, data->image_height - y);
+
+      data->load_band (data, tif, y, height);
+    }
+}
+
 static void
 load_rgba (TIFF        *tif,
+           GFile       *file,
            ChannelData *channel)
 {
-  guint32  image_width;
+  LoadData data = { 0, };
   guint32  image_height;
-  guint32  row;
-  guint32 *buffer;
+  guint16  orientation;
 
   g_printerr ("%s\n", __func__);
 
-  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
+  data.file      = file;
+  data.tif       = tif;
+  data.channel   = channel;
+  data.load_band = load_rgba_band;
+
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH, &data.tile_width);
+
+  if (TIFFIsTiled (tif))
+    {
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &data.tile_width);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, &data.tile_height);
+    }
+  else
+    {
+      TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &data.tile_height);
+    }
+
+  /* libtiff's RGBA reader returns the blocks bottom-up, flipping them
+   * according to the orientation; see setorientation() in libtiff.
+   */
+  TIFFGetFieldDefaulted (tif, TIFFTAG_ORIENTATION, &orientation);
+
+  switch (orientation)
+    {
+    case ORIENTATION_BOTLEFT:
+    case ORIENTATION_LEFTBOT:
+      break;
+
+    case ORIENTATION_BOTRIGHT:
+    case ORIENTATION_RIGHTBOT:
+      data.flip_horizontal = TRUE;
+      break;
+
+    case ORIENTATION_TOPRIGHT:
+    case ORIENTATION_RIGHTTOP:
+      data.flip_horizontal = TRUE;
+      data.flip_vertical   = TRUE;
+      break;
+
+    default:
+      data.flip_vertical = TRUE;
+      break;
+    }
+
   TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
 
-  buffer = g_new (uint32, image_width * image_height);
+  data.tile_height = MIN (data.tile_height, image_height);
+
+  load_bands (&data, data.tile_height);
 
-  if (! TIFFReadRGBAImage (tif, image_width, image_height, buffer, 0))
+  if (data.failed)
     g_message ("Unsupported layout, no RGBA loader");
+}
+
+static void
+load_rgba_band (LoadData *data,
+                TIFF     *tif,
+                guint32   y0,
+                guint32   height)
+{
+  gboolean  tiled = TIFFIsTiled (tif);
+  guint32  *raster;
+  guint32   y;
+
+  raster = g_new (guint32, data->tile_width * data->tile_height);
 
-  for (row = 0; row < image_height; row++)
+  for (y = y0; y < y0 + height; y += data->tile_height)
     {
+      guint32 x;
+
+      for (x = 0; x < data->image_width; x += data->tile_width)
+        {
+          guint32 rows = MIN (data->image_height - y, data->tile_height);
+          guint32 cols = MIN (data->image_width  - x, data->tile_width);
+          guint32 dest_x;
+          guint32 row;
+
+          if (! (tiled ?
+                 TIFFReadRGBATile  (tif, x, y, raster) :
+                 TIFFReadRGBAStrip (tif, y, raster)))
+            {
+              data->failed = TRUE;
+              continue;
+            }
+
+          if (data->flip_horizontal)
+            dest_x = data->image_width - x - cols;
+          else
+            dest_x = x;
+
+          for (row = 0; row < rows; row++)
+            {
+              guint32 *src;
+              guint32  src_row;
+              guint32  dest_y;
+
+              if (data->flip_vertical)
+                {
+                  src_row = rows - 1 - row;
+                  dest_y  = y + row;
+                }
+              else
+                {
+                  src_row = row;
+                  dest_y  = data->image_height - 1 - (y + row);
+                }
+
+              /* partial tiles are aligned to the bottom of the raster,
+               * partial strips to its top.
+               */
+              if (tiled)
+                src_row += data->tile_height - rows;
+
+              src = raster + src_row * data->tile_width;
+
 #if G_BYTE_ORDER != G_LITTLE_ENDIAN
-      /* Make sure our channels are in the right order */
-      guint32 row_start = row * image_width;
-      guint32 row_end   = row_start + image_width;
-      guint32 i;
+              {
+                guint32 i;
 
-      for (i = row_start; i < row_end; i++)
-        buffer[i] = GUINT32_TO_LE (buffer[i]);
+                /* Make sure our channels are in the right order */
+                for (i = 0; i < cols; i++)
+                  src[i] = GUINT32_TO_LE (src[i]);
+              }
 #endif
 
-      gegl_buffer_set (channel[0].buffer,
-                       GEGL_RECTANGLE (0, image_height - row - 1,
-                                       image_width, 1),
-                       0, channel[0].format,
-                       ((guchar *) buffer) + row * image_width * 4,
-                       GEGL_AUTO_ROWSTRIDE);
-
-      if ((row % 32) == 0)
-        gimp_progress_update ((gdouble) row / (gdouble) image_height);
+              gegl_buffer_set (data->channel[0].buffer,
+                               GEGL_RECTANGLE (dest_x, dest_y, cols, 1),
+                               0, data->channel[0].format,
+                               src,
+                               GEGL_AUTO_ROWSTRIDE);
+            }
+        }
     }
 
-  g_free (buffer);
+  g_free (raster);
 }
 
 static void
@@ -1506,6 +1797,7 @@ load_paths (TIFF *tif,
 
 static void
 load_contiguous (TIFF        *tif,
+                 GFile       *file,
                  ChannelData *channel,
                  const Babl  *type,
                  gushort      bps,
@@ -1513,97 +1805,106 @@ load_contiguous (TIFF        *tif,
                  gboolean     is_bw,
                  gint         extra)
 {
-  guint32     image_width;
-  guint32     image_height;
-  guint32     tile_width;
-  guint32     tile_height;
-  gint        bytes_per_pixel;
-  const Babl *src_format;
-  guchar     *buffer;
-  guchar     *bw_buffer = NULL;
-  gdouble     progress  = 0.0;
-  gdouble     one_row;
-  guint32     y;
-  gint        i;
+  LoadData data = { 0, };
+  guint32  block_height;
+  gint     i;
 
   g_printerr ("%s\n", __func__);
 
-  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
-  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
+  data.file      = file;
+  data.tif       = tif;
+  data.channel   = channel;
+  data.is_bw     = is_bw;
+  data.extra     = extra;
+  data.load_band = load_contiguous_band;
 
-  tile_width = image_width;
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH, &data.tile_width);
 
   if (TIFFIsTiled (tif))
     {
-      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &tile_width);
-      TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &data.tile_width);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, &data.tile_height);
 
-      buffer = g_malloc (TIFFTileSize (tif));
+      block_height = data.tile_height;
     }
   else
     {
-      tile_width  = image_width;
-      tile_height = 1;
+      data.tile_height = 1;
 
-      buffer = g_malloc (TIFFScanlineSize (tif));
+      TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &block_height);
     }
 
-  if (is_bw)
-    bw_buffer = g_malloc (tile_width * tile_height);
-
-  one_row = (gdouble) tile_height / (gdouble) image_height;
-
-  src_format = babl_format_n (type, spp);
+  data.src_format = babl_format_n (type, spp);
 
   /* consistency check */
-  bytes_per_pixel = 0;
+  data.bytes_per_pixel = 0;
   for (i = 0; i <= extra; i++)
-    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
+    data.bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
 
   g_printerr ("bytes_per_pixel: %d, format: %d\n",
-              bytes_per_pixel,
-              babl_format_get_bytes_per_pixel (src_format));
+              data.bytes_per_pixel,
+              babl_format_get_bytes_per_pixel (data.src_format));
+
+  load_bands (&data, block_height);
+}
 
-  for (y = 0; y < image_height; y += tile_height)
+static void
+load_contiguous_band (LoadData *data,
+                      TIFF     *tif,
+                      guint32   y0,
+                      guint32   height)
+{
+  ChannelData *channel   = data->channel;
+  guchar      *buffer;
+  guchar      *bw_buffer = NULL;
+  guint32      y;
+  gint         i;
+
+  if (TIFFIsTiled (tif))
+    buffer = g_malloc (TIFFTileSize (tif));
+  else
+    buffer = g_malloc (TIFFScanlineSize (tif));
+
+  if (data->is_bw)
+    bw_buffer = g_malloc (data->tile_width * data->tile_height);
+
+  for (y = y0; y < y0 + height; y += data->tile_height)
     {
       guint32 x;
 
-      for (x = 0; x < image_width; x += tile_width)
+      for (x = 0; x < data->image_width; x += data->tile_width)
         {
           GeglBuffer *src_buf;
           guint32     rows;
           guint32     cols;
           gint        offset;
 
-          gimp_progress_update (progress + one_row *
-                                ((gdouble) x / (gdouble) image_width));
-
           if (TIFFIsTiled (tif))
             TIFFReadTile (tif, buffer, x, y, 0, 0);
           else
             TIFFReadScanline (tif, buffer, y, 0);
 
-          cols = MIN (image_width  - x, tile_width);
-          rows = MIN (image_height - y, tile_height);
+          cols = MIN (data->image_width  - x, data->tile_width);
+          rows = MIN (data->image_height - y, data->tile_height);
 
-          if (is_bw)
+          if (data->is_bw)
             convert_bit2byte (buffer, bw_buffer, cols, rows);
 
-          src_buf = gegl_buffer_linear_new_from_data (is_bw ? bw_buffer : buffer,
-                                                      src_format,
+          src_buf = gegl_buffer_linear_new_from_data (data->is_bw ? bw_buffer : buffer,
+                                                      data->src_format,
                                                       GEGL_RECTANGLE (0, 0, cols, rows),
-                                                      tile_width * bytes_per_pixel,
+                                                      data->tile_width * data->bytes_per_pixel,
                                                       NULL, NULL);
 
           offset = 0;
 
-          for (i = 0; i <= extra; i++)
+          for (i = 0; i <= data->extra; i++)
             {
               GeglBufferIterator *iter;
               gint                src_bpp;
               gint                dest_bpp;
 
-              src_bpp  = babl_format_get_bytes_per_pixel (src_format);
+              src_bpp  = babl_format_get_bytes_per_pixel (data->src_format);
               dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
 
               iter = gegl_buffer_iterator_new (src_buf,
@@ -1637,8 +1938,6 @@ load_contiguous (TIFF        *tif,
 
           g_object_unref (src_buf);
         }
-
-      progress += one_row;
     }
 
   g_free (buffer);
@@ -1648,6 +1947,7 @@ load_contiguous (TIFF        *tif,
 
 static void
 load_separate (TIFF        *tif,
+               GFile       *file,
                ChannelData *channel,
                const Babl  *type,
                gushort      bps,
@@ -1655,59 +1955,71 @@ load_separate (TIFF        *tif,
                gboolean     is_bw,
                gint         extra)
 {
-  guint32     image_width;
-  guint32     image_height;
-  guint32     tile_width;
-  guint32     tile_height;
-  gint        bytes_per_pixel;
-  const Babl *src_format;
-  guchar     *buffer;
-  guchar     *bw_buffer = NULL;
-  gdouble     progress  = 0.0;
-  gdouble     one_row;
-  gint        i, compindex;
+  LoadData data = { 0, };
+  guint32  block_height;
+  gint     i;
 
   g_printerr ("%s\n", __func__);
 
-  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
-  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
+  data.file      = file;
+  data.tif       = tif;
+  data.channel   = channel;
+  data.is_bw     = is_bw;
+  data.extra     = extra;
+  data.load_band = load_separate_band;
 
-  tile_width = image_width;
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH, &data.tile_width);
 
   if (TIFFIsTiled (tif))
     {
-      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &tile_width);
-      TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &data.tile_width);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, &data.tile_height);
 
-      buffer = g_malloc (TIFFTileSize (tif));
+      block_height = data.tile_height;
     }
   else
     {
-      tile_width  = image_width;
-      tile_height = 1;
+      data.tile_height = 1;
 
-      buffer = g_malloc (TIFFScanlineSize (tif));
+      TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &block_height);
     }
 
-  if (is_bw)
-    bw_buffer = g_malloc (tile_width * tile_height);
-
-  one_row = (gdouble) tile_height / (gdouble) image_height;
-
-  src_format = babl_format_n (type, 1);
+  data.src_format = babl_format_n (type, 1);
 
   /* consistency check */
-  bytes_per_pixel = 0;
+  data.bytes_per_pixel = 0;
   for (i = 0; i <= extra; i++)
-    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
+    data.bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
 
   g_printerr ("bytes_per_pixel: %d, format: %d\n",
-              bytes_per_pixel,
-              babl_format_get_bytes_per_pixel (src_format));
+              data.bytes_per_pixel,
+              babl_format_get_bytes_per_pixel (data.src_format));
+
+  load_bands (&data, block_height);
+}
+
+static void
+load_separate_band (LoadData *data,
+                    TIFF     *tif,
+                    guint32   y0,
+                    guint32   height)
+{
+  ChannelData *channel   = data->channel;
+  guchar      *buffer;
+  guchar      *bw_buffer = NULL;
+  gint         i, compindex;
+
+  if (TIFFIsTiled (tif))
+    buffer = g_malloc (TIFFTileSize (tif));
+  else
+    buffer = g_malloc (TIFFScanlineSize (tif));
+
+  if (data->is_bw)
+    bw_buffer = g_malloc (data->tile_width * data->tile_height);
 
   compindex = 0;
 
-  for (i = 0; i <= extra; i++)
+  for (i = 0; i <= data->extra; i++)
     {
       gint n_comps;
       gint src_bpp;
@@ -1716,7 +2028,7 @@ load_separate (TIFF        *tif,
       gint j;
 
       n_comps  = babl_format_get_n_components (channel[i].format);
-      src_bpp  = babl_format_get_bytes_per_pixel (src_format);
+      src_bpp  = babl_format_get_bytes_per_pixel (data->src_format);
       dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
 
       offset = 0;
@@ -1725,33 +2037,30 @@ load_separate (TIFF        *tif,
         {
           guint32 y;
 
-          for (y = 0; y < image_height; y += tile_height)
+          for (y = y0; y < y0 + height; y += data->tile_height)
             {
               guint32 x;
 
-              for (x = 0; x < image_width; x += tile_width)
+              for (x = 0; x < data->image_width; x += data->tile_width)
                 {
                   GeglBuffer         *src_buf;
                   GeglBufferIterator *iter;
                   guint32             rows;
                   guint32             cols;
 
-                  gimp_progress_update (progress + one_row *
-                                        ((gdouble) x / (gdouble) image_width));
-
                   if (TIFFIsTiled (tif))
                     TIFFReadTile (tif, buffer, x, y, 0, compindex);
                   else
                     TIFFReadScanline (tif, buffer, y, compindex);
 
-                  cols = MIN (image_width  - x, tile_width);
-                  rows = MIN (image_height - y, tile_height);
+                  cols = MIN (data->image_width  - x, data->tile_width);
+                  rows = MIN (data->image_height - y, data->tile_height);
 
-                  if (is_bw)
+                  if (data->is_bw)
                     convert_bit2byte (buffer, bw_buffer, cols, rows);
 
-                  src_buf = gegl_buffer_linear_new_from_data (is_bw ? bw_buffer : buffer,
-                                                              src_format,
+                  src_buf = gegl_buffer_linear_new_from_data (data->is_bw ? bw_buffer : buffer,
+                                                              data->src_format,
                                                               GEGL_RECTANGLE (0, 0, cols, rows),
                                                               GEGL_AUTO_ROWSTRIDE,
                                                               NULL, NULL);
@@ -1790,8 +2099,6 @@ load_separate (TIFF        *tif,
           offset += src_bpp;
           compindex++;
         }
-
-      progress += one_row;
     }
 
   g_free (buffer);
@@ -48,6 +48,7 @@
 #include <string.h>
 
 #include <tiffio.h>
+#include <zlib.h>
 #include <gexiv2/gexiv2.h>
 
 #include <libgimp/gimp.h>
@@ -61,6 +62,84 @@
 
 #define PLUG_IN_ROLE "gimp-file-tiff-save"
 
+/* layers holding at least this much pixel data are saved as tiles,
+ * which are compressed in parallel
+ */
+#define MIN_TILED_SIZE   (16 * 1024 * 1024)
+
+/* the minimal width and height of the tiles */
+#define MIN_TILE_SIZE    256
+
+/* files whose pixel data might not fit into the 32-bit offsets of a
+ * classic TIFF are saved as BigTIFF.  save_image() estimates the worst
+ * case of the pixel data; the rest of the 4 GiB are left for the other
+ * parts of the file, like the thumbnail and the directories.
+ */
+#define MIN_BIGTIFF_SIZE ((guint64) 15 << 28)
+
+/* TIFF LZW codes */
+#define LZW_CLEAR        256
+#define LZW_EOI          257
+#define LZW_FIRST        258
+#define LZW_MAX_CODE     4095
+#define LZW_HASH_BITS    13
+#define LZW_HASH_SIZE    (1 << LZW_HASH_BITS)
+
+
+typedef struct
+{
+  guchar       *raw;
+  guchar       *data;
+  const guchar *out;
+  gsize         size;
+} SaveTile;
+
+typedef struct
+{
+  gushort       compression;
+  gboolean      predictor;
+  gint          bitspersample;
+  gint          samplesperpixel;
+  gboolean      is_bw;
+  gboolean      invert;
+  gint          bpp;
+  gint          cols;
+  gint          rows;
+
+  gint          tile_width;
+  gint          tile_height;
+  gsize         tile_stride;
+  gsize         raw_size;
+  gsize         max_size;
+  gint          tiles_across;
+
+  const guchar *src;
+  gint          src_stride;
+  gint          src_rows;
+  SaveTile     *tiles;
+} SaveTilesData;
+
+
+static gboolean  save_tiles             (TIFF          *tif,
+                                         GeglBuffer    *buffer,
+                                         const Babl    *format,
+                                         SaveTilesData *data,
+                                         gdouble        progress_base,
+                                         gdouble        progress_fraction);
+static void      save_tiles_range       (gsize          offset,
+                                         gsize          size,
+                                         SaveTilesData *data);
+static gint      save_tiles_get_size    (gint           gegl_tile_size);
+static void      save_tiles_predict     (guchar        *row,
+                                         gint           n_samples,
+                                         gint           samplesperpixel,
+                                         gint           bitspersample);
+static gsize     lzw_encode             (const guchar  *src,
+                                         gsize          size,
+                                         guchar        *dest);
+static gsize     packbits_encode        (const guchar  *src,
+                                         gsize          size,
+                                         guchar        *dest);
 
 static gboolean  save_paths             (TIFF          *tif,
                                          gint32         image,
@@ -315,6 +394,8 @@ save_layer (TIFF         *tif,
   gdouble           yresolution;
   gushort           save_unit = RESUNIT_INCH;
   gint              offset_x, offset_y;
+  gboolean          tiled = FALSE;
+  SaveTilesData     tiles = { 0, };
 
   compression = tsvals->compression;
 
@@ -622,6 +703,47 @@ save_layer (TIFF         *tif,
     }
 
 
+  /* Large layers are saved as tiles matching the buffer's tiles, and
+   * compressed by ourselves, so that it can be done in parallel.
+   */
+  if ((gsize) bytesperrow * rows >= MIN_TILED_SIZE &&
+      (compression == COMPRESSION_NONE          ||
+       compression == COMPRESSION_LZW           ||
+       compression == COMPRESSION_ADOBE_DEFLATE ||
+       compression == COMPRESSION_PACKBITS))
+    {
+      gint tile_width;
+      gint tile_height;
+
+      tiles.compression     = compression;
+      tiles.predictor       = (compression == COMPRESSION_LZW ||
+                               compression == COMPRESSION_ADOBE_DEFLATE) &&
+                              predictor != 0;
+      tiles.bitspersample   = bitspersample;
+      tiles.samplesperpixel = samplesperpixel;
+      tiles.is_bw           = is_bw;
+      tiles.invert          = invert;
+      tiles.bpp             = babl_format_get_bytes_per_pixel (format);
+      tiles.cols            = cols;
+      tiles.rows            = rows;
+
+      g_object_get (buffer,
+                    "tile-width",  &tile_width,
+                    "tile-height", &tile_height,
+                    NULL);
+
+      tiles.tile_width  = save_tiles_get_size (tile_width);
+      tiles.tile_height = save_tiles_get_size (tile_height);
+
+      if (is_bw)
+        tiles.tile_stride = tiles.tile_width / 8;
+      else
+        tiles.tile_stride = (gsize) tiles.tile_width * tiles.bpp;
+
+      /* there is no horizontal differencing of 64-bit samples */
+      tiled = ! tiles.predictor || bitspersample <= 32;
+    }
+
   /* Set TIFF parameters. */
   if (num_pages > 1)
     {
@@ -662,8 +784,16 @@ save_layer (TIFF         *tif,
 
   TIFFSetField (tif, TIFFTAG_PHOTOMETRIC, photometric);
   TIFFSetField (tif, TIFFTAG_SAMPLESPERPIXEL, samplesperpixel);
-  TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
-  /* TIFFSetField( tif, TIFFTAG_STRIPBYTECOUNTS, rows / rowsperstrip ); */
+  if (tiled)
+    {
+      TIFFSetField (tif, TIFFTAG_TILEWIDTH,  tiles.tile_width);
+      TIFFSetField (tif, TIFFTAG_TILELENGTH, tiles.tile_height);
+    }
+  else
+    {
+      TIFFSetField (tif, TIFFTAG_ROWSPERSTRIP, rowsperstrip);
+      /* TIFFSetField( tif, TIFFTAG_STRIPBYTECOUNTS, rows / rowsperstrip ); */
+    }
   TIFFSetField (tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
 
   /* resolution fields */
@@ -700,62 +830,71 @@ save_layer (TIFF         *tif,
   if (page == 0)
     save_paths (tif, orig_image, cols, rows, offset_x, offset_y);
 
-  /* array to rearrange data */
-  src  = g_new (guchar, bytesperrow * tile_height);
-  data = g_new (guchar, bytesperrow);
-
-  /* Now write the TIFF data. */
-  for (y = 0; y < rows; y = yend)
+  if (tiled)
     {
-      yend = y + tile_height;
-      yend = MIN (yend, rows);
-
-      gegl_buffer_get (buffer,
-                       GEGL_RECTANGLE (0, y, cols, yend - y), 1.0,
-                       format, src,
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      if (! save_tiles (tif, buffer, format, &tiles,
+                        progress_base, progress_fraction))
+        goto out;
+    }
+  else
+    {
+      /* array to rearrange data */
+      src  = g_new (guchar, bytesperrow * tile_height);
+      data = g_new (guchar, bytesperrow);
 
-      for (row = y; row < yend; row++)
+      /* Now write the TIFF data. */
+      for (y = 0; y < rows; y = yend)
         {
-          guchar *t = src + bytesperrow * (row - y);
+          yend = y + tile_height;
+          yend = MIN (yend, rows);
+
+          gegl_buffer_get (buffer,
+                           GEGL_RECTANGLE (0, y, cols, yend - y), 1.0,
+                           format, src,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-          switch (drawable_type)
+          for (row = y; row < yend; row++)
             {
-            case GIMP_INDEXED_IMAGE:
-            case GIMP_INDEXEDA_IMAGE:
-              if (is_bw)
-                {
-                  byte2bit (t, bytesperrow, data, invert);
-                  success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
-                }
-              else
+              guchar *t = src + bytesperrow * (row - y);
+
+              switch (drawable_type)
                 {
+                case GIMP_INDEXED_IMAGE:
+                case GIMP_INDEXEDA_IMAGE:
+                  if (is_bw)
+                    {
+                      byte2bit (t, bytesperrow, data, invert);
+                      success = (TIFFWriteScanline (tif, data, row, 0) >= 0);
+                    }
+                  else
+                    {
+                      success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
+                    }
+                  break;
+
+                case GIMP_GRAY_IMAGE:
+                case GIMP_GRAYA_IMAGE:
+                case GIMP_RGB_IMAGE:
+                case GIMP_RGBA_IMAGE:
                   success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
-                }
-              break;
+                  break;
 
-            case GIMP_GRAY_IMAGE:
-            case GIMP_GRAYA_IMAGE:
-            case GIMP_RGB_IMAGE:
-            case GIMP_RGBA_IMAGE:
-              success = (TIFFWriteScanline (tif, t, row, 0) >= 0);
-              break;
+                default:
+                  success = FALSE;
+                  break;
+                }
 
-            default:
-              success = FALSE;
-              break;
+              if (!success)
+                {
+                  g_message (_("Failed a scanline write on row %d"), row);
+                  goto out;
+                }
             }
 
-          if (!success)
-            {
-              g_message (_("Failed a scanline write on row %d"), row);
-              goto out;
-            }
+          if ((row % 32) == 0)
+            gimp_progress_update (progress_base + progress_fraction
+                                  * (gdouble) row / (gdouble) rows);
         }
-
-      if ((row % 32) == 0)
-        gimp_progress_update (progress_base + progress_fraction
-                              * (gdouble) row / (gdouble) rows);
     }
 
   TIFFWriteDirectory (tif);
@@ -775,6 +914,414 @@ out:
   return status;
 }
 
+/* Write the layer as tiles, fetching as many rows of tiles at a time as
+ * needed to keep all threads busy.  The tiles are filtered and compressed
+ * in parallel, and written in order by the main thread.
+ */
+static gboolean
+save_tiles (TIFF          *tif,
+            GeglBuffer    *buffer,
+            const Babl    *format,
+            SaveTilesData *data,
+            gdouble        progress_base,
+            gdouble        progress_fraction)
+{
+  guchar   *src;
+  gint      n_threads;
+  gint      band_height;
+  gint      n_tiles;
+  gint      y;
+  gint      i;
+  gboolean  success = TRUE;
+
+  g_object_get (gegl_config (),
+                "threads", &n_threads,
+                NULL);
+
+  data->tiles_across = (data->cols + data->tile_width - 1) / data->tile_width;
+  data->raw_size     = data->tile_stride * data->tile_height;
+
+  switch (data->compression)
+    {
+    case COMPRESSION_ADOBE_DEFLATE:
+      data->max_size = compressBound (data->raw_size);
+      break;
+
+    case COMPRESSION_LZW:
+      /* at most one 12-bit code per byte, plus the occasional clear code */
+      data->max_size = data->raw_size + data->raw_size / 2 +
+                       data->raw_size / 1024 + 16;
+      break;
+
+    case COMPRESSION_PACKBITS:
+      data->max_size = (data->tile_stride + data->tile_stride / 128 + 1) *
+                       data->tile_height;
+      break;
+
+    default:
+      data->max_size = 0;
+      break;
+    }
+
+  band_height = data->tile_height *
+                MAX (1, (2 * MAX (n_threads, 1) + data->tiles_across - 1) /
+                        data->tiles_across);
+  n_tiles     = data->tiles_across * (band_height / data->tile_height);
+
+  data->src_stride = data->cols * data->bpp;
+
+  src         = g_new (guchar, (gsize) data->src_stride * band_height);
+  data->src   = src;
+  data->tiles = g_new0 (SaveTile, n_tiles);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      data->tiles[i].raw = g_new (guchar, data->raw_size);
+
+      if (data->max_size)
+        data->tiles[i].data = g_new (guchar, data->max_size);
+    }
+
+  for (y = 0; success && y < data->rows; y += band_height)
+    {
+      gint band_tiles;
+
+      data->src_rows = MIN (band_height, data->rows - y);
+
+      gegl_buffer_get (buffer,
+                       GEGL_RECTANGLE (0, y, data->cols, data->src_rows), 1.0,
+                       format, src,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      band_tiles = data->tiles_across *
+                   ((data->src_rows + data->tile_height - 1) /
+                    data->tile_height);
+
+      gegl_parallel_distribute_range (
+        band_tiles, 1,
+        (GeglParallelDistributeRangeFunc) save_tiles_range,
+        data);
+
+      for (i = 0; i < band_tiles; i++)
+        {
+          SaveTile *tile = &data->tiles[i];
+          gint      tx   = (i % data->tiles_across) * data->tile_width;
+          gint      ty   = (i / data->tiles_across) * data->tile_height + y;
+
+          if (! tile->size ||
+              TIFFWriteRawTile (tif, TIFFComputeTile (tif, tx, ty, 0, 0),
+                                (tdata_t) tile->out, tile->size) < 0)
+            {
+              g_message (_("Failed a tile write at %d, %d"), tx, ty);
+              success = FALSE;
+              break;
+            }
+        }
+
+      gimp_progress_update (progress_base + progress_fraction *
+                            (gdouble) (y + data->src_rows) /
+                            (gdouble) data->rows);
+    }
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      g_free (data->tiles[i].raw);
+      g_free (data->tiles[i].data);
+    }
+
+  g_free (data->tiles);
+  g_free (src);
+
+  return success;
+}
+
+static void
+save_tiles_range (gsize          offset,
+                  gsize          size,
+                  SaveTilesData *data)
+{
+  gsize i;
+
+  for (i = offset; i < offset + size; i++)
+    {
+      SaveTile *tile  = &data->tiles[i];
+      gint      x0    = (i % data->tiles_across) * data->tile_width;
+      gint      y0    = (i / data->tiles_across) * data->tile_height;
+      gint      width = MIN (data->tile_width, data->cols - x0);
+      gsize     used;
+      gint      row;
+
+      /* copy the tile out of the band, padding it to the full tile size */
+      for (row = 0; row < data->tile_height; row++)
+        {
+          const guchar *s = data->src + (gsize) (y0 + row) * data->src_stride +
+                            (gsize) x0 * data->bpp;
+          guchar       *d = tile->raw + row * data->tile_stride;
+
+          if (y0 + row >= data->src_rows)
+            {
+              memset (d, 0, data->tile_stride);
+              continue;
+            }
+
+          if (data->is_bw)
+            {
+              byte2bit (s, width, d, data->invert);
+              used = (width + 7) / 8;
+            }
+          else
+            {
+              memcpy (d, s, (gsize) width * data->bpp);
+              used = (gsize) width * data->bpp;
+            }
+
+          memset (d + used, 0, data->tile_stride - used);
+
+          if (data->predictor)
+            save_tiles_predict (d, data->tile_width * data->samplesperpixel,
+                                data->samplesperpixel, data->bitspersample);
+        }
+
+      switch (data->compression)
+        {
+        case COMPRESSION_ADOBE_DEFLATE:
+          {
+            uLongf length = data->max_size;
+
+            if (compress2 (tile->data, &length, tile->raw, data->raw_size,
+                           Z_DEFAULT_COMPRESSION) == Z_OK)
+              tile->size = length;
+            else
+              tile->size = 0;
+          }
+          break;
+
+        case COMPRESSION_LZW:
+          tile->size = lzw_encode (tile->raw, data->raw_size, tile->data);
+          break;
+
+        case COMPRESSION_PACKBITS:
+          /* runs may not cross rows */
+          tile->size = 0;
+
+          for (row = 0; row < data->tile_height; row++)
+            {
+              tile->size += packbits_encode (tile->raw +
+                                             row * data->tile_stride,
+                                             data->tile_stride,
+                                             tile->data + tile->size);
+            }
+          break;
+
+        default:
+          tile->out  = tile->raw;
+          tile->size = data->raw_size;
+          continue;
+        }
+
+      tile->out = tile->data;
+    }
+}
+
+/* TIFF tiles must be a multiple of 16 pixels wide and high, and we
+ * make them a multiple of the buffer's tiles, too.
+ */
+static gint
+save_tiles_get_size (gint gegl_tile_size)
+{
+  gint size = MAX (gegl_tile_size, 1);
+
+  size *= (MIN_TILE_SIZE + size - 1) / size;
+
+  return (size + 15) / 16 * 16;
+}
+
+/* Horizontal differencing, i.e. TIFF predictor 2 */
+static void
+save_tiles_predict (guchar *row,
+                    gint    n_samples,
+                    gint    samplesperpixel,
+                    gint    bitspersample)
+{
+  gint i;
+
+  switch (bitspersample)
+    {
+    case 8:
+      for (i = n_samples - 1; i >= samplesperpixel; i--)
+        row[i] -= row[i - samplesperpixel];
+      break;
+
+    case 16:
+      {
+        guint16 *p = (guint16 *) row;
+
+        for (i = n_samples - 1; i >= samplesperpixel; i--)
+          p[i] -= p[i - samplesperpixel];
+      }
+      break;
+
+    case 32:
+      {
+        guint32 *p = (guint32 *) row;
+
+        for (i = n_samples - 1; i >= samplesperpixel; i--)
+          p[i] -= p[i - samplesperpixel];
+      }
+      break;
+    }
+}
+
+#define LZW_PUT_CODE(code)                          \
+  G_STMT_START                                      \
+    {                                               \
+      bits    = (bits << n_bits) | (code);          \
+      n_extra += n_bits;                            \
+                                                    \
+      while (n_extra >= 8)                          \
+        {                                           \
+          n_extra -= 8;                             \
+          *out++   = bits >> n_extra;               \
+        }                                           \
+                                                    \
+      bits &= (1 << n_extra) - 1;                   \
+    }                                               \
+  G_STMT_END
+
+/* Compress a tile with TIFF's flavor of LZW, which starts with a clear
+ * code, and switches to longer codes one code earlier than GIF does.
+ */
+static gsize
+lzw_encode (const guchar *src,
+            gsize         size,
+            guchar       *dest)
+{
+  gint32   keys[LZW_HASH_SIZE];
+  guint16  codes[LZW_HASH_SIZE];
+  guchar  *out      = dest;
+  guint32  bits     = 0;
+  gint     n_extra  = 0;
+  gint     n_bits   = 9;
+  gint     max_code = (1 << 9) - 1;
+  gint     next     = LZW_FIRST;
+  gint     prefix;
+  gsize    i;
+
+  memset (keys, 0xff, sizeof (keys));
+
+  LZW_PUT_CODE (LZW_CLEAR);
+
+  if (size > 0)
+    {
+      prefix = src[0];
+
+      for (i = 1; i < size; i++)
+        {
+          gint32 key  = (prefix << 8) | src[i];
+          guint  hash = ((guint32) key * 2654435761u) >> (32 - LZW_HASH_BITS);
+
+          while (keys[hash] != -1 && keys[hash] != key)
+            hash = (hash + 1) & (LZW_HASH_SIZE - 1);
+
+          if (keys[hash] == key)
+            {
+              prefix = codes[hash];
+              continue;
+            }
+
+          LZW_PUT_CODE (prefix);
+
+          prefix      = src[i];
+          keys[hash]  = key;
+          codes[hash] = next++;
+
+          if (next == LZW_MAX_CODE - 1)
+            {
+              /* the table is full, start over */
+              LZW_PUT_CODE (LZW_CLEAR);
+
+              memset (keys, 0xff, sizeof (keys));
+
+              next     = LZW_FIRST;
+              n_bits   = 9;
+              max_code = (1 << 9) - 1;
+            }
+          else if (next > max_code)
+            {
+              n_bits++;
+              max_code = (1 << n_bits) - 1;
+            }
+        }
+
+      LZW_PUT_CODE (prefix);
+
+      /* the decoder adds one more code, which may change the code size */
+      next++;
+
+      if (next == LZW_MAX_CODE - 1)
+        {
+          LZW_PUT_CODE (LZW_CLEAR);
+
+          n_bits = 9;
+        }
+      else if (next > max_code)
+        {
+          n_bits++;
+        }
+    }
+
+  LZW_PUT_CODE (LZW_EOI);
+
+  if (n_extra > 0)
+    *out++ = bits << (8 - n_extra);
+
+  return out - dest;
+}
+
+#undef LZW_PUT_CODE
+
+static gsize
+packbits_encode (const guchar *src,
+                 gsize         size,
+                 guchar       *dest)
+{
+  guchar *out = dest;
+  gsize   i   = 0;
+
+  while (i < size)
+    {
+      gsize run = 1;
+
+      while (i + run < size && run < 128 && src[i + run] == src[i])
+        run++;
+
+      if (run > 1)
+        {
+          *out++ = (guchar) (257 - run);
+          *out++ = src[i];
+
+          i += run;
+        }
+      else
+        {
+          gsize start = i;
+
+          while (i < size && i - start < 128 &&
+                 (i + 1 == size || src[i + 1] != src[i]))
+            {
+              i++;
+            }
+
+          *out++ = (guchar) (i - start - 1);
+          memcpy (out, src + start, i - start);
+
+          out += i - start;
+        }
+    }
+
+  return out - dest;
+}
+
 static void
 save_thumbnail (TiffSaveVals *tsvals,
                 gint32        image,
@@ -888,7 +1435,11 @@ save_metadata (GFile                 *file,
     "Exif.Image.SampleFormat",
     "Exif.Image.SamplesPerPixel",
     "Exif.Image.StripByteCounts",
-    "Exif.Image.StripOffsets"
+    "Exif.Image.StripOffsets",
+    "Exif.Image.TileByteCounts",
+    "Exif.Image.TileLength",
+    "Exif.Image.TileOffsets",
+    "Exif.Image.TileWidth"
   };
   static const guint n_keys = G_N_ELEMENTS(exif_tags_to_remove);
 
@@ -959,14 +1510,53 @@ save_image (GFile                  *file,
   gint        number_of_sub_IFDs  = 1;
   toff_t      sub_IFDs_offsets[1] = { 0UL };
   gint32      num_layers, *layers, current_layer = 0;
+  guint64     data_size           = 0;
+  gboolean    bigtiff;
+  gint        i;
 
   layers = gimp_image_get_layers (image, &num_layers);
 
   gimp_progress_init_printf (_("Exporting '%s'"),
                              gimp_file_get_utf8_name (file));
 
+  /* Estimate the worst-case size of the pixel data */
+  for (i = 0; i < num_layers; i++)
+    {
+      data_size += (guint64) gimp_drawable_width  (layers[i]) *
+                   (guint64) gimp_drawable_height (layers[i]) *
+                   (guint64) gimp_drawable_bpp    (layers[i]);
+    }
+
+  /* save_layer() promotes 8-bit data to 16 bits when its TRC doesn't
+   * match the exported profile's, which is only known once the profile
+   * is loaded below
+   */
+  switch (gimp_image_get_precision (image))
+    {
+    case GIMP_PRECISION_U8_LINEAR:
+      data_size *= 2;
+      break;
+
+    case GIMP_PRECISION_U8_NON_LINEAR:
+    case GIMP_PRECISION_U8_PERCEPTUAL:
+      if (tsvals->save_profile)
+        data_size *= 2;
+      break;
+
+    default:
+      break;
+    }
+
+  /* incompressible data can grow by up to half its size with LZW, and
+   * by less than that with the other compressions
+   */
+  if (tsvals->compression != COMPRESSION_NONE)
+    data_size += data_size / 2;
+
+  bigtiff = data_size >= MIN_BIGTIFF_SIZE;
+
   /* Open file and write some gloabl data */
-  tif = tiff_open (file, "w", error);
+  tif = tiff_open (file, bigtiff ? "w8" : "w", error);
 
   if (! tif)
     {
@@ -1074,7 +1664,21 @@ save_image (GFile                  *file,
   TIFFClose (tif);
   tif = NULL;
   if (metadata)
-    save_metadata (file, tsvals, image, metadata, metadata_flags, *saved_bpp);
+    {
+      /* exiv2 can't rewrite BigTIFF files */
+      if (! bigtiff)
+        {
+          save_metadata (file, tsvals, image, metadata, metadata_flags,
+                         *saved_bpp);
+        }
+      else if (tsvals->save_exif || tsvals->save_xmp || tsvals->save_iptc)
+        {
+          g_message (_("The image is too large for a classic TIFF file, "
+                       "and was exported as BigTIFF.\n"
+                       "Exif, XMP and IPTC metadata can't be saved in "
+                       "BigTIFF files, and were not saved."));
+        }
+    }
 
   /* write the remaining layers */
   if (num_layers > 1)
@@ -359,6 +359,22 @@ save_dialog (WebPSaveParams *params,
                         &params->force_delay);
   }
 
+  /* Multi-threaded encoding */
+  toggle = gtk_check_button_new_with_mnemonic (_("Use _multiple threads"));
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle), params->threads);
+  gtk_box_pack_start (GTK_BOX (vbox), toggle, FALSE, FALSE, 0);
+  gtk_widget_show (toggle);
+
+  gimp_help_set_help_data (toggle,
+                           _("Encode on several threads at once.  Animations "
+                             "without \"Minimize output size\" are split at "
+                             "their key-frames and encoded in parallel."),
+                           NULL);
+
+  g_signal_connect (toggle, "toggled",
+                    G_CALLBACK (gimp_toggle_button_update),
+                    &params->threads);
+
   /* Save EXIF data */
   toggle = gtk_check_button_new_with_mnemonic (_("Save _Exif data"));
   gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (toggle), params->exif);
@@ -35,6 +35,7 @@
 #include <libgimp/gimpui.h>
 
 #include <webp/encode.h>
+#include <webp/demux.h>
 #include <webp/mux.h>
 
 #include "file-webp-save.h"
@@ -42,6 +43,43 @@
 #include "libgimp/stdplugins-intl.h"
 
 
+/* The maximal size of the frames waiting to be encoded, in bytes */
+#define ANIM_MAX_QUEUED_SIZE (256 * 1024 * 1024)
+
+
+typedef struct
+{
+  GMutex              mutex;
+  GCond               cond;
+  gsize               queued_size;
+} AnimQueue;
+
+typedef struct
+{
+  guchar             *pixels;
+  gint                width;
+  gint                height;
+  gint                bpp;
+  gboolean            has_alpha;
+  gint                timestamp;
+  gboolean            last;
+} AnimFrame;
+
+typedef struct
+{
+  AnimQueue          *queue;
+  const WebPConfig   *config;
+  WebPAnimEncoder    *enc;
+  GAsyncQueue        *frames;
+  GThread            *thread;
+  gint                start;
+  gint                duration;
+  gboolean            finished;
+  WebPData            data;
+  gboolean            status;
+} AnimSegment;
+
+
 int           webp_anim_file_writer (FILE              *outfile,
                                      const uint8_t     *data,
                                      size_t             data_size);
@@ -67,6 +105,25 @@ gboolean      save_animation        (const gchar       *filename,
                                      WebPSaveParams    *params,
                                      GError           **error);
 
+static gpointer      anim_segment_encode (AnimSegment                  *segment);
+static AnimSegment * anim_segment_new    (AnimQueue                    *queue,
+                                          const WebPConfig             *config,
+                                          const WebPAnimEncoderOptions *enc_options,
+                                          gint                          width,
+                                          gint                          height,
+                                          gint                          start);
+static void          anim_segment_push   (AnimSegment                  *segment,
+                                          AnimFrame                    *frame);
+static void          anim_segment_finish (AnimSegment                  *segment,
+                                          gint                          end);
+static gboolean      anim_segment_join   (AnimSegment                  *segment);
+static void          anim_segment_free   (AnimSegment                  *segment);
+static gboolean      anim_segments_merge (GPtrArray                    *segments,
+                                          gint                          width,
+                                          gint                          height,
+                                          const WebPAnimEncoderOptions *enc_options,
+                                          WebPData                     *webp_data);
+
 static void   webp_decide_output    (gint32             image_ID,
                                      WebPSaveParams    *params,
                                      GimpColorProfile **profile,
@@ -244,6 +301,7 @@ save_layer (const gchar    *filename,
       config.lossless      = params->lossless;
       config.method        = 6;  /* better quality */
       config.alpha_quality = params->alpha_quality;
+      config.thread_level  = params->threads ? 1 : 0;
 
       /* Prepare the WebP structure */
       WebPPictureInit (&picture);
@@ -498,6 +556,282 @@ combine_buffers (GeglBuffer *layer_buffer,
   return buffer;
 }
 
+/* Encodes the frames of one segment of the animation, as they are queued
+ * by the main thread.  Every segment starts with a key-frame, so segments
+ * can be encoded concurrently and joined afterwards.
+ */
+static gpointer
+anim_segment_encode (AnimSegment *segment)
+{
+  AnimQueue *queue = segment->queue;
+
+  while (TRUE)
+    {
+      AnimFrame *frame = g_async_queue_pop (segment->frames);
+      gboolean   last  = frame->last;
+
+      if (last)
+        {
+          if (segment->status)
+            {
+              WebPAnimEncoderAdd (segment->enc, NULL, frame->timestamp, NULL);
+
+              if (! WebPAnimEncoderAssemble (segment->enc, &segment->data))
+                {
+                  g_printerr ("ERROR: %s\n",
+                              WebPAnimEncoderGetError (segment->enc));
+                  segment->status = FALSE;
+                }
+            }
+        }
+      else
+        {
+          gsize       size = (gsize) frame->width * frame->height * frame->bpp;
+          WebPPicture picture;
+
+          if (segment->status)
+            {
+              WebPPictureInit (&picture);
+              picture.use_argb = 1;
+              picture.width    = frame->width;
+              picture.height   = frame->height;
+
+              if (frame->has_alpha)
+                segment->status = WebPPictureImportRGBA (&picture, frame->pixels,
+                                                         frame->width * frame->bpp);
+              else
+                segment->status = WebPPictureImportRGB (&picture, frame->pixels,
+                                                        frame->width * frame->bpp);
+
+              if (! segment->status)
+                {
+                  g_printerr ("%s: memory error in WebPPictureImportRGB(A)().",
+                              G_STRFUNC);
+                }
+              else if (! WebPAnimEncoderAdd (segment->enc, &picture,
+                                             frame->timestamp, segment->config))
+                {
+                  g_printerr ("ERROR[%d]: %s\n",
+                              picture.error_code,
+                              webp_error_string (picture.error_code));
+                  segment->status = FALSE;
+                }
+
+              WebPPictureFree (&picture);
+            }
+
+          g_free (frame->pixels);
+
+          g_mutex_lock (&queue->mutex);
+          queue->queued_size -= size;
+          g_cond_signal (&queue->cond);
+          g_mutex_unlock (&queue->mutex);
+        }
+
+      g_slice_free (AnimFrame, frame);
+
+      if (last)
+        break;
+    }
+
+  return NULL;
+}
+
+static AnimSegment *
+anim_segment_new (AnimQueue                    *queue,
+                  const WebPConfig             *config,
+                  const WebPAnimEncoderOptions *enc_options,
+                  gint                          width,
+                  gint                          height,
+                  gint                          start)
+{
+  AnimSegment *segment = g_slice_new0 (AnimSegment);
+
+  segment->enc = WebPAnimEncoderNew (width, height, enc_options);
+
+  if (! segment->enc)
+    {
+      g_printerr ("ERROR: enc == null\n");
+      g_slice_free (AnimSegment, segment);
+
+      return NULL;
+    }
+
+  segment->queue  = queue;
+  segment->config = config;
+  segment->frames = g_async_queue_new ();
+  segment->start  = start;
+  segment->status = TRUE;
+
+  WebPDataInit (&segment->data);
+
+  segment->thread = g_thread_new ("webp-encode",
+                                  (GThreadFunc) anim_segment_encode,
+                                  segment);
+
+  return segment;
+}
+
+/* Queues a frame for encoding, waiting for the encoders to catch up when
+ * too much pixel data is already pending.
+ */
+static void
+anim_segment_push (AnimSegment *segment,
+                   AnimFrame   *frame)
+{
+  AnimQueue *queue = segment->queue;
+  gsize      size  = (gsize) frame->width * frame->height * frame->bpp;
+
+  g_mutex_lock (&queue->mutex);
+
+  while (queue->queued_size > 0 &&
+         queue->queued_size + size > ANIM_MAX_QUEUED_SIZE)
+    {
+      g_cond_wait (&queue->cond, &queue->mutex);
+    }
+
+  queue->queued_size += size;
+
+  g_mutex_unlock (&queue->mutex);
+
+  frame->timestamp -= segment->start;
+
+  g_async_queue_push (segment->frames, frame);
+}
+
+static void
+anim_segment_finish (AnimSegment *segment,
+                     gint         end)
+{
+  AnimFrame *frame;
+
+  if (segment->finished)
+    return;
+
+  segment->duration = end - segment->start;
+  segment->finished = TRUE;
+
+  frame = g_slice_new0 (AnimFrame);
+  frame->timestamp = segment->duration;
+  frame->last      = TRUE;
+
+  g_async_queue_push (segment->frames, frame);
+}
+
+static gboolean
+anim_segment_join (AnimSegment *segment)
+{
+  if (segment->thread)
+    {
+      g_thread_join (segment->thread);
+      segment->thread = NULL;
+    }
+
+  return segment->status;
+}
+
+static void
+anim_segment_free (AnimSegment *segment)
+{
+  anim_segment_finish (segment, segment->start);
+  anim_segment_join (segment);
+
+  WebPDataClear (&segment->data);
+  WebPAnimEncoderDelete (segment->enc);
+  g_async_queue_unref (segment->frames);
+
+  g_slice_free (AnimSegment, segment);
+}
+
+/* Joins the separately encoded segments into a single animation. */
+static gboolean
+anim_segments_merge (GPtrArray                    *segments,
+                     gint                          width,
+                     gint                          height,
+                     const WebPAnimEncoderOptions *enc_options,
+                     WebPData                     *webp_data)
+{
+  WebPMux  *mux;
+  gboolean  status = TRUE;
+  guint     i;
+
+  mux = WebPMuxNew ();
+  if (! mux)
+    return FALSE;
+
+  for (i = 0; status && i < segments->len; i++)
+    {
+      AnimSegment  *segment = g_ptr_array_index (segments, i);
+      WebPDemuxer  *demux;
+      WebPIterator  iter;
+      gboolean      animated;
+
+      demux = WebPDemux (&segment->data);
+      if (! demux)
+        {
+          status = FALSE;
+          break;
+        }
+
+      /* A segment holding a single frame is assembled as a still image */
+      animated = (WebPDemuxGetI (demux, WEBP_FF_FORMAT_FLAGS) &
+                  ANIMATION_FLAG) != 0;
+
+      if (WebPDemuxGetFrame (demux, 1, &iter))
+        {
+          do
+            {
+              WebPMuxFrameInfo info = { 0 };
+
+              info.bitstream = iter.fragment;
+              info.x_offset  = iter.x_offset;
+              info.y_offset  = iter.y_offset;
+              info.id        = WEBP_CHUNK_ANMF;
+
+              if (animated)
+                {
+                  info.duration       = iter.duration;
+                  info.dispose_method = iter.dispose_method;
+                  info.blend_method   = iter.blend_method;
+                }
+              else
+                {
+                  info.duration       = segment->duration;
+                  info.dispose_method = WEBP_MUX_DISPOSE_NONE;
+                  info.blend_method   = WEBP_MUX_NO_BLEND;
+                }
+
+              if (WebPMuxPushFrame (mux, &info, 1) != WEBP_MUX_OK)
+                status = FALSE;
+            }
+          while (status && WebPDemuxNextFrame (&iter));
+
+          WebPDemuxReleaseIterator (&iter);
+        }
+      else
+        {
+          status = FALSE;
+        }
+
+      WebPDemuxDelete (demux);
+    }
+
+  if (status)
+    {
+      if (WebPMuxSetCanvasSize (mux, width, height) != WEBP_MUX_OK ||
+          WebPMuxSetAnimationParams (mux,
+                                     &enc_options->anim_params) != WEBP_MUX_OK ||
+          WebPMuxAssemble (mux, webp_data) != WEBP_MUX_OK)
+        {
+          status = FALSE;
+        }
+    }
+
+  WebPMuxDelete (mux);
+
+  return status;
+}
+
 gboolean
 save_animation (const gchar    *filename,
                 gint32          nLayers,
@@ -509,9 +843,7 @@ save_animation (const gchar    *filename,
 {
   gboolean               status   = TRUE;
   FILE                  *outfile  = NULL;
-  guchar                *buffer   = NULL;
-  gint                   buffer_size = 0;
-  gint                   w, h;
+  gint                   w = 0, h = 0;
   gint                   bpp;
   gboolean               has_alpha;
   const gchar           *encoding;
@@ -519,9 +851,16 @@ save_animation (const gchar    *filename,
   const Babl            *space   = NULL;
   GimpColorProfile      *profile = NULL;
   WebPAnimEncoderOptions enc_options;
+  WebPConfig             config;
   WebPData               webp_data;
   int                    frame_timestamp = 0;
-  WebPAnimEncoder       *enc = NULL;
+  AnimQueue              queue;
+  GPtrArray             *segments;
+  AnimSegment           *segment = NULL;
+  guint                  n_joined = 0;
+  gint                   n_threads = 1;
+  gint                   segment_length;
+  gint                   i;
   GeglBuffer            *prev_frame = NULL;
   gboolean               out_linear = FALSE;
 
@@ -547,6 +886,39 @@ save_animation (const gchar    *filename,
   if (! space)
     space = gimp_drawable_get_format (drawable_ID);
 
+  /* When key-frames are placed at fixed distances, each run of frames
+   * starting with a key-frame can be encoded on its own thread.  The
+   * frames themselves are always fetched by the main thread, and encoded
+   * while the next ones are being fetched.
+   *
+   * The first frame of each encoder is cropped to its non-transparent
+   * area, unlike a key-frame in the middle of an animation, which covers
+   * the whole canvas.  Joined segments would therefore let the previous
+   * frames show through transparent areas, so animations with alpha are
+   * encoded in one piece.
+   */
+  if (params->threads)
+    g_object_get (gegl_config (), "threads", &n_threads, NULL);
+
+  n_threads = MAX (n_threads, 1);
+
+  for (i = 0; n_threads > 1 && i < nLayers; i++)
+    {
+      if (gimp_drawable_has_alpha (allLayers[i]))
+        n_threads = 1;
+    }
+
+  if (n_threads > 1 && ! params->minimize_size && params->kf_distance > 0)
+    segment_length = params->kf_distance;
+  else
+    segment_length = nLayers;
+
+  g_mutex_init (&queue.mutex);
+  g_cond_init (&queue.cond);
+  queue.queued_size = 0;
+
+  segments = g_ptr_array_new_with_free_func ((GDestroyNotify) anim_segment_free);
+
   gimp_image_undo_freeze (image_ID);
 
   WebPDataInit (&webp_data);
@@ -593,14 +965,21 @@ save_animation (const gchar    *filename,
           enc_options.kmin = params->kf_distance - 1;
         }
 
+      WebPConfigPreset (&config, params->preset, params->quality);
+
+      config.lossless      = params->lossless;
+      config.method        = 6;  /* better quality */
+      config.alpha_quality = params->alpha_quality;
+      config.exact         = 1;
+      config.thread_level  = params->threads ? 1 : 0;
+
       for (loop = 0; loop < nLayers; loop++)
         {
           GeglBuffer       *geglbuffer;
           GeglBuffer       *current_frame;
           GeglRectangle     extent;
-          WebPConfig        config;
-          WebPPicture       picture;
-          WebPMemoryWriter  mw = { 0 };
+          AnimFrame        *frame;
+          guchar           *buffer;
           gint32            drawable = allLayers[nLayers - 1 - loop];
           gint              delay = get_layer_delay (drawable);
           gboolean          needs_combine = get_layer_needs_combine (drawable);
@@ -635,51 +1014,45 @@ save_animation (const gchar    *filename,
           w = extent.width;
           h = extent.height;
 
-          if (loop == 0)
+          /* Start a new segment, once enough of the previous ones are done */
+          if (loop % segment_length == 0)
             {
-              enc = WebPAnimEncoderNew (w, h, &enc_options);
-              if (! enc)
+              if (segment)
+                anim_segment_finish (segment, frame_timestamp);
+
+              if (segments->len - n_joined >= (guint) n_threads)
                 {
-                  g_printerr ("ERROR: enc == null\n");
-                  status = FALSE;
-                  break;
+                  if (! anim_segment_join (g_ptr_array_index (segments,
+                                                              n_joined++)))
+                    {
+                      g_object_unref (geglbuffer);
+                      status = FALSE;
+                      break;
+                    }
                 }
-            }
-
-          /* Attempt to allocate a buffer of the appropriate size */
-          if (! buffer || buffer_size < w * h * bpp)
-            {
-              buffer = g_try_realloc (buffer, w * h * bpp);
 
-              if (! buffer)
+              segment = anim_segment_new (&queue, &config, &enc_options,
+                                          w, h, frame_timestamp);
+              if (! segment)
                 {
-                  g_printerr ("Buffer error: 'buffer null'\n");
+                  g_object_unref (geglbuffer);
                   status = FALSE;
                   break;
                 }
-              else
-                {
-                  buffer_size = w * h * bpp;
-                }
-            }
-
-          WebPConfigPreset (&config, params->preset, params->quality);
 
-          config.lossless      = params->lossless;
-          config.method        = 6;  /* better quality */
-          config.alpha_quality = params->alpha_quality;
-          config.exact         = 1;
+              g_ptr_array_add (segments, segment);
+            }
 
-          WebPMemoryWriterInit (&mw);
+          /* Attempt to allocate a buffer of the appropriate size */
+          buffer = g_try_malloc ((gsize) w * h * bpp);
 
-          /* Prepare the WebP structure */
-          WebPPictureInit (&picture);
-          picture.use_argb      = 1;
-          picture.argb_stride   = w * bpp;
-          picture.width         = w;
-          picture.height        = h;
-          picture.custom_ptr    = &mw;
-          picture.writer        = WebPMemoryWrite;
+          if (! buffer)
+            {
+              g_printerr ("Buffer error: 'buffer null'\n");
+              g_object_unref (geglbuffer);
+              status = FALSE;
+              break;
+            }
 
           if (loop == 0 || ! needs_combine)
             {
@@ -700,50 +1073,44 @@ save_animation (const gchar    *filename,
           gegl_buffer_get (current_frame, &extent, 1.0, format, buffer,
                            GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-          /* Use the appropriate function to import the data from the buffer */
-          if (! has_alpha)
-            {
-              status = WebPPictureImportRGB (&picture, buffer, w * bpp);
-            }
-          else
-            {
-              status = WebPPictureImportRGBA (&picture, buffer, w * bpp);
-            }
-
-          if (! status)
-            {
-              g_printerr ("%s: memory error in WebPPictureImportRGB(A)().",
-                          G_STRFUNC);
-            }
-          /* Perform the actual encode */
-          else if (! WebPAnimEncoderAdd (enc, &picture, frame_timestamp, &config))
-            {
-              g_printerr ("ERROR[%d]: %s\n",
-                          picture.error_code,
-                          webp_error_string (picture.error_code));
-              status = FALSE;
-            }
+          /* Hand the frame over to the segment's encoder thread */
+          frame = g_slice_new0 (AnimFrame);
+          frame->pixels    = buffer;
+          frame->width     = w;
+          frame->height    = h;
+          frame->bpp       = bpp;
+          frame->has_alpha = has_alpha;
+          frame->timestamp = frame_timestamp;
 
-          WebPMemoryWriterClear (&mw);
-          WebPPictureFree (&picture);
-
-          if (status == FALSE)
-            break;
+          anim_segment_push (segment, frame);
 
           gimp_progress_update ((loop + 1.0) / nLayers);
           frame_timestamp += (delay <= 0 || force_delay) ? default_delay : delay;
         }
-      g_free (buffer);
 
       if (status == FALSE)
         break;
 
-      WebPAnimEncoderAdd (enc, NULL, frame_timestamp, NULL);
+      anim_segment_finish (segment, frame_timestamp);
 
-      if (! WebPAnimEncoderAssemble (enc, &webp_data))
+      for (; n_joined < segments->len; n_joined++)
         {
-          g_printerr ("ERROR: %s\n",
-                      WebPAnimEncoderGetError (enc));
+          if (! anim_segment_join (g_ptr_array_index (segments, n_joined)))
+            status = FALSE;
+        }
+
+      if (status == FALSE)
+        break;
+
+      if (segments->len == 1)
+        {
+          webp_data = segment->data;
+          WebPDataInit (&segment->data);
+        }
+      else if (! anim_segments_merge (segments, w, h, &enc_options,
+                                      &webp_data))
+        {
+          g_printerr ("ERROR: could not join the animation segments\n");
           status = FALSE;
           break;
         }
@@ -784,8 +1151,11 @@ save_animation (const gchar    *filename,
   while (0);
 
   /* Free any resources */
+  g_ptr_array_free (segments, TRUE);
+  g_mutex_clear (&queue.mutex);
+  g_cond_clear (&queue.cond);
+
   WebPDataClear (&webp_data);
-  WebPAnimEncoderDelete (enc);
   g_clear_object (&profile);
 
   if (prev_frame != NULL)
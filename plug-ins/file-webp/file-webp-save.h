@@ -39,6 +39,7 @@ typedef struct
   gboolean   profile;
   gint       delay;
   gboolean   force_delay;
+  gboolean   threads;
 } WebPSaveParams;
 
 
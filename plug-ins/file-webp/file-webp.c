@@ -206,6 +206,7 @@ run (const gchar      *name,
           params.xmp           = FALSE;
           params.delay         = 200;
           params.force_delay   = FALSE;
+          params.threads       = TRUE;
 
           /* Override the defaults with preferences. */
           metadata = gimp_image_metadata_save_prepare (image_ID,
@@ -259,6 +260,7 @@ run (const gchar      *name,
               params.xmp           = param[15].data.d_int32;
               params.delay         = param[16].data.d_int32;
               params.force_delay   = param[17].data.d_int32;
+              params.threads       = TRUE;
             }
           break;
 